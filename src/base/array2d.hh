@@ -31,9 +31,12 @@
 #define PF_ARRAY_2D_H
 
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <iostream>
 
+#include "scratch_arena.hh"
+
 //#define ARRAY2D_DEBUG 1
 //#include "pixelmatrix.hh"
 
@@ -112,7 +115,7 @@ namespace PF {
 #endif
     }
     if( buf ) {
-      free( buf );
+      ScratchArena::get().release( buf, size_allocated );
 #ifdef ARRAY2D_DEBUG
       std::cout<<"Array2D<T>::~Array2D(): buffer deallocated"<<std::endl;
 #endif
@@ -141,8 +144,14 @@ namespace PF {
 #ifdef ARRAY2D_DEBUG
       std::cout<<"Array2D<T>::Init("<<w<<","<<h<<","<<r_offset<<","<<c_offset<<"): old buf="<<buf;
 #endif
-      //Array2DManager::Ref().Allocate(size_new);
-      buf = (T*)realloc(buf,size_new);
+      // The buffers are taken from the scratch arena of the calling thread,
+      // since the arrays are mostly used as temporary storage for a single tile
+      T* buf_new = (T*)ScratchArena::get().alloc( size_new );
+      if( buf ) {
+        memcpy( buf_new, buf, size_allocated );
+        ScratchArena::get().release( buf, size_allocated );
+      }
+      buf = buf_new;
       size_allocated = size_new;
 #ifdef ARRAY2D_DEBUG
       std::cout<<"  new buf="<<buf<<std::endl;
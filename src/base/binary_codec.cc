@@ -0,0 +1,114 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#include <string.h>
+#include <zlib.h>
+#include <glib.h>
+
+#include "binary_codec.hh"
+
+
+// Upper limit for the size of decoded values, to protect against corrupted data
+#define PF_BINARY_MAX_SIZE (1<<30)
+
+
+void PF::BinaryWriter::put_float( float val )
+{
+  guint32 ival;
+  memcpy( &ival, &val, sizeof(ival) );
+  for( int i = 0; i < 4; i++ ) {
+    data.push_back( (char)(ival & 0xFF) );
+    ival >>= 8;
+  }
+}
+
+
+bool PF::BinaryReader::get_float( float& val )
+{
+  if( end - ptr < 4 ) {
+    failed = true;
+    return false;
+  }
+  guint32 ival = 0;
+  for( int i = 3; i >= 0; i-- )
+    ival = (ival << 8) | ptr[i];
+  ptr += 4;
+  memcpy( &val, &ival, sizeof(val) );
+  return true;
+}
+
+
+std::string PF::binary_encode( const std::string& data )
+{
+  // The uncompressed size is stored in front of the zlib stream
+  BinaryWriter header;
+  header.put_uint( data.size() );
+  std::string& buf = header.get_data();
+  size_t hsize = buf.size();
+
+  uLongf csize = compressBound( data.size() );
+  buf.resize( hsize + csize );
+  if( compress2( (Bytef*)&(buf[hsize]), &csize, (const Bytef*)data.data(),
+                 data.size(), Z_DEFAULT_COMPRESSION ) != Z_OK )
+    return std::string();
+  buf.resize( hsize + csize );
+
+  gchar* b64 = g_base64_encode( (const guchar*)buf.data(), buf.size() );
+  std::string result = std::string(PF_BINARY_TAG) + b64;
+  g_free( b64 );
+  return result;
+}
+
+
+bool PF::binary_decode( const std::string& str, std::string& data )
+{
+  size_t tlen = strlen( PF_BINARY_TAG );
+  if( str.compare( 0, tlen, PF_BINARY_TAG ) != 0 ) return false;
+
+  gsize len = 0;
+  guchar* buf = g_base64_decode( str.c_str()+tlen, &len );
+  if( !buf ) return false;
+  std::string compressed( (const char*)buf, len );
+  g_free( buf );
+
+  BinaryReader header( compressed );
+  unsigned int size;
+  if( !header.get_uint( size ) || size > PF_BINARY_MAX_SIZE ) return false;
+  size_t hsize = compressed.size() - header.get_remaining();
+
+  data.resize( size );
+  uLongf dsize = size;
+  if( size > 0 &&
+      uncompress( (Bytef*)&(data[0]), &dsize, (const Bytef*)&(compressed[hsize]),
+                  compressed.size()-hsize ) != Z_OK )
+    return false;
+  if( dsize != size ) return false;
+  return true;
+}
@@ -0,0 +1,214 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef PF_BINARY_CODEC_H
+#define PF_BINARY_CODEC_H
+
+#include <ctype.h>
+
+#include <string>
+#include <list>
+#include <vector>
+
+#include "property.hh"
+
+
+// Prefix that identifies property values stored in binary form
+#define PF_BINARY_TAG "pfb1:"
+
+
+namespace PF
+{
+
+  /* Compact binary serialization of property values.
+   *
+   * Integers are stored as variable-length quantities (7 bits per byte, signed values
+   * zig-zag encoded), floats as 4 little-endian bytes. The resulting byte stream is
+   * compressed with zlib and base64-encoded, so that it can be embedded in the .pfi
+   * XML attributes.
+   */
+  class BinaryWriter
+  {
+    std::string data;
+  public:
+    void put_uint( unsigned int val )
+    {
+      while( val >= 0x80 ) {
+        data.push_back( (char)((val & 0x7F) | 0x80) );
+        val >>= 7;
+      }
+      data.push_back( (char)val );
+    }
+    void put_int( int val )
+    {
+      put_uint( (((unsigned int)val) << 1) ^ (unsigned int)(val >> 31) );
+    }
+    void put_float( float val );
+
+    std::string& get_data() { return data; }
+  };
+
+
+  class BinaryReader
+  {
+    const unsigned char* ptr;
+    const unsigned char* end;
+    bool failed;
+  public:
+    BinaryReader( const std::string& d ):
+      ptr( (const unsigned char*)d.data() ), end( ptr+d.size() ), failed( false ) {}
+
+    bool get_uint( unsigned int& val )
+    {
+      val = 0;
+      for( int shift = 0; shift < 35; shift += 7 ) {
+        if( ptr >= end ) { failed = true; return false; }
+        unsigned char c = *ptr++;
+        val |= ((unsigned int)(c & 0x7F)) << shift;
+        if( !(c & 0x80) ) return true;
+      }
+      failed = true;
+      return false;
+    }
+    bool get_int( int& val )
+    {
+      unsigned int uval;
+      if( !get_uint( uval ) ) return false;
+      val = (int)(uval >> 1) ^ -(int)(uval & 1);
+      return true;
+    }
+    bool get_float( float& val );
+
+    // Number of bytes not read yet, used to reject corrupted element counts
+    size_t get_remaining() { return( end - ptr ); }
+    bool is_failed() { return failed; }
+  };
+
+
+  // Compress and base64-encode the data, adding the PF_BINARY_TAG prefix
+  std::string binary_encode( const std::string& data );
+
+  // Inverse of binary_encode(); returns false if the string is not in binary form
+  // or is corrupted
+  bool binary_decode( const std::string& str, std::string& data );
+
+
+  template<class T>
+  void to_binary( BinaryWriter& w, const std::list<T>& list )
+  {
+    w.put_uint( list.size() );
+    typename std::list<T>::const_iterator i;
+    for( i = list.begin(); i != list.end(); i++ )
+      to_binary( w, *i );
+  }
+
+  template<class T>
+  bool from_binary( BinaryReader& r, std::list<T>& list )
+  {
+    list.clear();
+    unsigned int nelt;
+    if( !r.get_uint( nelt ) || nelt > r.get_remaining() ) return false;
+    for( unsigned int i = 0; i < nelt; i++ ) {
+      list.push_back( T() );
+      if( !from_binary( r, list.back() ) ) return false;
+    }
+    return true;
+  }
+
+  template<class T>
+  void to_binary( BinaryWriter& w, const std::vector<T>& vector )
+  {
+    w.put_uint( vector.size() );
+    typename std::vector<T>::const_iterator i;
+    for( i = vector.begin(); i != vector.end(); i++ )
+      to_binary( w, *i );
+  }
+
+  template<class T>
+  bool from_binary( BinaryReader& r, std::vector<T>& vector )
+  {
+    vector.clear();
+    unsigned int nelt;
+    if( !r.get_uint( nelt ) || nelt > r.get_remaining() ) return false;
+    vector.resize( nelt );
+    for( unsigned int i = 0; i < nelt; i++ ) {
+      if( !from_binary( r, vector[i] ) ) return false;
+    }
+    return true;
+  }
+
+
+  /* Property whose value is saved in binary form. Values in the text
+   * format used by Property<T> are still accepted, so that older
+   * documents can be loaded.
+   */
+  template< typename T >
+  class BinaryProperty: public Property<T>
+  {
+  public:
+    BinaryProperty(std::string name, OpParBase* par): Property<T>(name, par) {}
+    BinaryProperty(std::string name, OpParBase* par, const T& v): Property<T>(name, par, v) {}
+
+    void from_stream(std::istream& str)
+    {
+      // The text format always starts with an element count
+      str>>std::ws;
+      if( isdigit( str.peek() ) ) {
+        Property<T>::from_stream( str );
+        return;
+      }
+      std::string encoded, data;
+      str>>encoded;
+      if( !binary_decode( encoded, data ) ) {
+        std::cout<<"BinaryProperty::from_stream(): cannot decode value of property \""
+                 <<this->get_name()<<"\""<<std::endl;
+        return;
+      }
+      T newval;
+      BinaryReader reader( data );
+      if( !from_binary( reader, newval ) ) {
+        std::cout<<"BinaryProperty::from_stream(): invalid value for property \""
+                 <<this->get_name()<<"\""<<std::endl;
+        return;
+      }
+      this->set( newval );
+    }
+
+    void to_stream(std::ostream& str)
+    {
+      BinaryWriter writer;
+      to_binary( writer, this->get() );
+      str<<binary_encode( writer.get_data() );
+    }
+  };
+}
+
+
+#endif
@@ -42,43 +42,56 @@ public:
       out[pos] = top[pos];
     }
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<colorspace>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 
 
 /*
   RGB colorspace
+
+  The pixels are processed in chunks of PF_COLOR_ROW_CHUNK_SIZE, using
+  small floating-point buffers and the row kernels from color_kernels.hh
  */
 template<typename T, int CHMIN, int CHMAX>
 class BlendColor<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false>: 
   public BlendBase<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false>
 {
-  int pos, ch;
-  double temp_top;
-  double rgb[3];
+  float irgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+  float rgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+  float lumi[PF_COLOR_ROW_CHUNK_SIZE];
 public:
-  void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
+  // If pmap is not NULL, the opacity is modulated by the per-pixel mask values
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix, T* pmap=NULL) 
   {
-    // RGB values of the bottom layer
-    double ired = (double(bottom[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double igreen = (double(bottom[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double iblue = (double(bottom[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    // Luminance value of the bottom layer
-    double lumi = PF::luminance( ired, igreen, iblue );
-
-    // RGB values of the top layer
-    double ored = (double(top[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double ogreen = (double(top[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double oblue = (double(top[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-
-    // Color blend: the color of the top layer is mixed with
-    // the luminance of the bottom one
-    rgb[0] = ored; rgb[1] = ogreen; rgb[2] = oblue;
-    PF::lc_blend( rgb[0], rgb[1], rgb[2], lumi );
-
-    pos = x;
-    for( ch=CHMIN; ch<=CHMAX; ch++, pos++ ) {
-      out[pos] = (T)(( (rgb[ch]*opacity)+(rgb[ch]*(1.0f-opacity)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
+    for( int x0 = 0; x0 < npix; x0 += PF_COLOR_ROW_CHUNK_SIZE ) {
+      int n = npix - x0;
+      if( n > PF_COLOR_ROW_CHUNK_SIZE ) n = PF_COLOR_ROW_CHUNK_SIZE;
+      int nval = n*3, pos = x0*3;
+
+      // Luminance value of the bottom layer
+      to_float_row( bottom+pos, irgb, nval );
+      luminance_row( irgb, lumi, n );
+
+      // Color blend: the color of the top layer is mixed with
+      // the luminance of the bottom one
+      to_float_row( top+pos, rgb, nval );
+      lc_blend_row( rgb, lumi, n );
+
+      for( int i = 0, x = 0; i < n; i++ ) {
+        float op = (pmap) ? opacity*(pmap[x0+i]+FormatInfo<T>::MIN)/(FormatInfo<T>::RANGE) : opacity;
+        for( int ch = 0; ch < 3; ch++, x++ ) {
+          if( ch < CHMIN || ch > CHMAX ) rgb[x] = irgb[x];
+          else rgb[x] = (rgb[x]*op)+(irgb[x]*(1.0f-op));
+        }
+      }
+      from_float_row( rgb, out+pos, nval );
     }
   }
 };
@@ -88,13 +101,10 @@ class BlendColor<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, true>:
   public BlendBase<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, true>
 {
   BlendColor<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false> blender;
-  float opacity_real;
 public:
-  void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix) 
   {
-    float opacity_real = opacity*(this->pmap[xomap]+FormatInfo<T>::MIN)/(FormatInfo<T>::RANGE);
-    xomap += 1;
-    blender.blend( opacity_real, bottom, top, out, x, xomap );
+    blender.blend_row( opacity, bottom, top, out, npix, this->pmap );
   }
 };
 
@@ -109,8 +119,8 @@ class BlendColor<T, PF_COLORSPACE_LAB, CHMIN, CHMAX, false>:
   public BlendBase<T, PF_COLORSPACE_LAB, CHMIN, CHMAX, false>
 {
   int pos, ch;
-  double temp_top;
-  double rgb[3];
+  float temp_top;
+  float rgb[3];
 public:
   void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
   {
@@ -120,6 +130,13 @@ public:
     for( ; ch<=CHMAX; ch++, pos++ ) 
       out[pos] = top[pos];
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<PF_COLORSPACE_LAB>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 template<typename T, int CHMIN, int CHMAX>
@@ -135,6 +152,13 @@ public:
     xomap += 1;
     blender.blend( opacity_real, bottom, top, out, x, xomap );
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<PF_COLORSPACE_LAB>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 
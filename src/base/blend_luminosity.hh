@@ -42,44 +42,57 @@ public:
       out[pos] = top[pos];
     }
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<colorspace>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 
 
 /*
   RGB colorspace
+
+  The pixels are processed in chunks of PF_COLOR_ROW_CHUNK_SIZE, using
+  small floating-point buffers and the row kernels from color_kernels.hh
  */
 template<typename T, int CHMIN, int CHMAX>
 class BlendLuminosity<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false>: 
   public BlendBase<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false>
 {
-  int pos, ch;
-  double temp_top;
-  double irgb[3];
-  double rgb[3];
+  float irgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+  float rgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+  float lumi[PF_COLOR_ROW_CHUNK_SIZE];
 public:
-  void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
+  // If pmap is not NULL, the opacity is modulated by the per-pixel mask values
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix, T* pmap=NULL) 
   {
-    // RGB values of the bottom layer
-    irgb[0] = (double(bottom[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    irgb[1] = (double(bottom[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    irgb[2] = (double(bottom[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-
-    // RGB values of the top layer
-    double ored = (double(top[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double ogreen = (double(top[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    double oblue = (double(top[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-    // Luminance value of the top layer
-    double lumi = PF::luminance( ored, ogreen, oblue );
-
-    // Luminosity blend: the color of the bottom layer is mixed with
-    // the luminance of the top one
-    rgb[0] = irgb[0]; rgb[1] = irgb[1]; rgb[2] = irgb[2];
-    PF::lc_blend( rgb[0], rgb[1], rgb[2], lumi );
-
-    pos = x;
-    for( ch=CHMIN; ch<=CHMAX; ch++, pos++ ) {
-      out[pos] = (T)(( (rgb[ch]*opacity)+(irgb[ch]*(1.0f-opacity)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
+    for( int x0 = 0; x0 < npix; x0 += PF_COLOR_ROW_CHUNK_SIZE ) {
+      int n = npix - x0;
+      if( n > PF_COLOR_ROW_CHUNK_SIZE ) n = PF_COLOR_ROW_CHUNK_SIZE;
+      int nval = n*3, pos = x0*3;
+
+      // Luminance value of the top layer
+      to_float_row( top+pos, rgb, nval );
+      luminance_row( rgb, lumi, n );
+
+      // Luminosity blend: the color of the bottom layer is mixed with
+      // the luminance of the top one
+      to_float_row( bottom+pos, irgb, nval );
+      for( int i = 0; i < nval; i++ ) rgb[i] = irgb[i];
+      lc_blend_row( rgb, lumi, n );
+
+      for( int i = 0, x = 0; i < n; i++ ) {
+        float op = (pmap) ? opacity*(pmap[x0+i]+FormatInfo<T>::MIN)/(FormatInfo<T>::RANGE) : opacity;
+        for( int ch = 0; ch < 3; ch++, x++ ) {
+          if( ch < CHMIN || ch > CHMAX ) rgb[x] = irgb[x];
+          else rgb[x] = (rgb[x]*op)+(irgb[x]*(1.0f-op));
+        }
+      }
+      from_float_row( rgb, out+pos, nval );
     }
   }
 };
@@ -89,13 +102,10 @@ class BlendLuminosity<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, true>:
   public BlendBase<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, true>
 {
   BlendLuminosity<T, PF_COLORSPACE_RGB, CHMIN, CHMAX, false> blender;
-  float opacity_real;
 public:
-  void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix) 
   {
-    float opacity_real = opacity*(this->pmap[xomap]+FormatInfo<T>::MIN)/(FormatInfo<T>::RANGE);
-    xomap += 1;
-    blender.blend( opacity_real, bottom, top, out, x, xomap );
+    blender.blend_row( opacity, bottom, top, out, npix, this->pmap );
   }
 };
 
@@ -110,8 +120,8 @@ class BlendLuminosity<T, PF_COLORSPACE_LAB, CHMIN, CHMAX, false>:
   public BlendBase<T, PF_COLORSPACE_LAB, CHMIN, CHMAX, false>
 {
   int pos, ch;
-  double temp_top;
-  double rgb[3];
+  float temp_top;
+  float rgb[3];
 public:
   void blend(const float& opacity, T* bottom, T* top, T* out, const int& x, int& xomap) 
   {
@@ -121,6 +131,13 @@ public:
     for( ; ch<=CHMAX; ch++, pos++ ) 
       out[pos] = bottom[pos];
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<PF_COLORSPACE_LAB>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 template<typename T, int CHMIN, int CHMAX>
@@ -136,6 +153,13 @@ public:
     xomap += 1;
     blender.blend( opacity_real, bottom, top, out, x, xomap );
   }
+  void blend_row(const float& opacity, T* bottom, T* top, T* out, int npix)
+  {
+    const int nch = PF::ColorspaceInfo<PF_COLORSPACE_LAB>::NCH;
+    int xomap = 0;
+    for( int x = 0; x < npix*nch; x += nch )
+      blend( opacity, bottom, top, out, x, xomap );
+  }
 };
 
 
@@ -50,12 +50,11 @@ namespace PF
   }
 
 
-#define BLEND_LOOP2( theblender ) {                               \
-    theblender.init_line( omap, r->left, y0 );                    \
-    for( x=0, xomap=0; x < line_size; ) {                         \
-      theblender.blend( opacity, pbottom, ptop, pout, x, xomap ); \
-      x += PF::ColorspaceInfo<colorspace>::NCH;                   \
-    }                                                             \
+// Blends a whole row at once, for the modes that
+// process the pixels through the row kernels
+#define BLEND_ROW( theblender ) {                                       \
+    theblender.init_line( omap, r->left, y0 );                          \
+    theblender.blend_row( opacity, pbottom, ptop, pout, r->width );     \
   }
 
 
@@ -137,10 +136,10 @@ namespace PF
           BLEND_LOOP(blend_darken);
           break;
         case PF_BLEND_LUMI:
-          BLEND_LOOP2(blend_lumi);
+          BLEND_ROW(blend_lumi);
           break;
         case PF_BLEND_COLOR:
-          BLEND_LOOP2(blend_color);
+          BLEND_ROW(blend_color);
           break;
         case PF_BLEND_UNKNOWN:
           break;
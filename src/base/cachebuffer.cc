@@ -41,24 +41,50 @@
 #include "photoflow.hh"
 #include "cachebuffer.hh"
 #include "exif_data.hh"
+#include "half_float.hh"
+#include "disk_tile_cache.hh"
 
 
-PF::CacheBuffer::CacheBuffer():
+PF::CacheBuffer::CacheBuffer( bool p ):
   image( NULL ), cached( NULL ), fd(-1),
-  initialized( false ), completed( false ), step_x(0), step_y(0)
+  initialized( false ), completed( false ), step_x(0), step_y(0),
+  memory_size( 0 ), preview( p ), half_float( false ), on_demand( false )
 {
 }
 
 
-void PF::CacheBuffer::reset( bool reinitialize )
+size_t PF::CacheBuffer::get_storage_pel_size()
+{
+  if( !image ) return 0;
+  if( half_float ) return( sizeof(unsigned short)*image->Bands );
+  return VIPS_IMAGE_SIZEOF_PEL( image );
+}
+
+
+void PF::CacheBuffer::set_cached( VipsImage* img )
 {
   if( cached ) 
-    PF_UNREF( cached, "CacheBuffer::reset(): cached image unref" );
-  cached = NULL;
+    PF_UNREF( cached, "CacheBuffer::set_cached(): cached image unref" );
+  PF::MemoryManager::Instance().released( PF_MEM_CACHE_BUFFER, memory_size );
+  cached = img;
+  // The memory manager is informed about the size of the stored data,
+  // which is smaller than the decoded image when half values are used.
+  // On-demand buffers only take disk space.
+  memory_size = (cached && !on_demand) ? get_storage_pel_size()*cached->Xsize*cached->Ysize : 0;
+  PF::MemoryManager::Instance().allocated( PF_MEM_CACHE_BUFFER, memory_size );
+}
+
+
+void PF::CacheBuffer::reset( bool reinitialize )
+{
+  set_cached( NULL );
   image = NULL;
   completed = false;
   step_x = step_y = 0;
+  half_float = false;
+  on_demand = false;
   pyramid.reset();
+  stats.reset();
   if( fd > 0 ) {
     close( fd );
     unlink( filename.c_str() );
@@ -70,13 +96,56 @@ void PF::CacheBuffer::reset( bool reinitialize )
 }
 
 
+bool PF::CacheBuffer::open_buffer()
+{
+  if( fd >= 0 ) return true;
+
+  char fname[500];
+  sprintf( fname,"%spfraw-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
+  //fd = mkostemp( fname, O_CREAT|O_RDWR|O_TRUNC );
+  fd = pf_mkstemp( fname );
+  if( fd < 0 ) return false;
+  filename = fname;
+
+  // Only the preview buffers of floating-point images are stored at reduced precision,
+  // the ones used for exporting always keep the full precision
+  half_float = preview && PF::PhotoFlow::Instance().get_preview_cache_half() &&
+      (image->BandFmt == VIPS_FORMAT_FLOAT) && (image->Coding == VIPS_CODING_NONE);
+  return true;
+}
+
+
+void PF::CacheBuffer::init_on_demand()
+{
+  half_float = preview && PF::PhotoFlow::Instance().get_preview_cache_half() &&
+      (image->BandFmt == VIPS_FORMAT_FLOAT) && (image->Coding == VIPS_CODING_NONE);
+  on_demand = true;
+  VipsImage* out = PF::disk_tile_cache( image, half_float );
+  if( !out ) {
+    std::cout<<"CacheBuffer::init_on_demand(): disk_tile_cache() failed"<<std::endl;
+    on_demand = false;
+    return;
+  }
+  set_cached( out );
+  completed = true;
+  // The statistics are not accumulated, since the tiles are only computed when requested
+  pyramid.init( cached );
+#ifndef NDEBUG
+  std::cout<<"CacheBuffer: on-demand disk cache initialized"<<(half_float ? " (half precision)" : "")<<std::endl;
+#endif
+}
+
+
 void PF::CacheBuffer::step()
 {
   if( completed ) return;
   if( !image ) return;
-  
-  bool result = false;
 
+  if( PF::PhotoFlow::Instance().is_out_of_core() ) {
+    init_on_demand();
+    return;
+  }
+  
   VipsRect tile_area = { step_x, step_y, PF_CACHE_BUFFER_TILE_SIZE, PF_CACHE_BUFFER_TILE_SIZE };
   VipsRect image_area = { 0, 0, image->Xsize, image->Ysize };
 
@@ -90,26 +159,32 @@ void PF::CacheBuffer::step()
   if( vips_region_prepare( reg, &tile_area ) )
     return;
 
+  stats.update( reg, tile_area );
+
   // Copy the tile into the disk buffer. Create the disk buffer if not yet done.
-  if( fd < 0 ) {
-		char fname[500];
-		sprintf( fname,"%spfraw-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
-		//fd = mkostemp( fname, O_CREAT|O_RDWR|O_TRUNC );
-		fd = pf_mkstemp( fname );
-		if( fd >= 0 )
-			filename = fname;
-	}
-  if( fd < 0 ) return;
+  if( !open_buffer() ) {
+    VIPS_UNREF( reg );
+    return;
+  }
+
+  size_t pelsz = get_storage_pel_size();
+  size_t linesz = pelsz*tile_area.width;
+  std::vector<unsigned short> halfbuf;
+  if( half_float ) halfbuf.resize( tile_area.width*image->Bands );
 
   guchar* p;
-  off_t offset = VIPS_IMAGE_SIZEOF_LINE(image)*tile_area.top+VIPS_IMAGE_SIZEOF_PEL(image)*tile_area.left;
+  off_t offset = (off_t(image->Xsize)*tile_area.top+tile_area.left)*pelsz;
   for( int y = 0; y < tile_area.height; y++ ) {
     lseek( fd, offset, SEEK_SET );
     p = VIPS_REGION_ADDR( reg, tile_area.left, tile_area.top+y );
-    ssize_t n = ::write( fd, p, VIPS_REGION_SIZEOF_LINE(reg) );
-    if( n != VIPS_REGION_SIZEOF_LINE(reg) )
+    if( half_float ) {
+      PF::float_to_half( (float*)p, &(halfbuf[0]), tile_area.width*image->Bands );
+      p = (guchar*)&(halfbuf[0]);
+    }
+    ssize_t n = ::write( fd, p, linesz );
+    if( n != (ssize_t)linesz )
       break;
-    offset += VIPS_IMAGE_SIZEOF_LINE(image);
+    offset += off_t(image->Xsize)*pelsz;
   }
 
   VIPS_UNREF( reg );
@@ -122,76 +197,7 @@ void PF::CacheBuffer::step()
   }
   if( step_y >= image->Ysize ) {
     completed = true;
-    void *profile_data;
-    size_t profile_length;
-    if( vips_image_get_blob( image, VIPS_META_ICC_NAME, 
-                             &profile_data, &profile_length ) )
-      profile_data = NULL;
-  
-    size_t blobsz;
-    void* image_data;
-    if( vips_image_get_blob( image, "raw_image_data",
-                             &image_data, 
-                             &blobsz ) )
-      image_data = NULL;
-
-    size_t exifsz;
-    void* exif_data;
-    if( vips_image_get_blob( image, PF_META_EXIF_NAME,
-        &exif_data,&exifsz ) ) {
-      exif_data = NULL;
-    }
-
-    int width = image->Xsize;
-    int height = image->Ysize;
-    int size = (width>height) ? width : height;
-    int nbands = image->Bands;
-
-    VipsImage* rawimg;
-
-    vips_rawload( filename.c_str(), &rawimg, width, height, 
-                  VIPS_IMAGE_SIZEOF_PEL( image ), NULL );
-    vips_copy( rawimg, &cached, 
-	       "format", image->BandFmt,
-	       "bands", image->Bands,
-	       "coding", image->Coding,
-	       "interpretation", image->Type,
-	       NULL );
-    PF_UNREF( rawimg, "CacheBuffer::step() completed" );
-
-    if( profile_data ) {
-      void* profile_data2 = malloc( profile_length );
-      if( profile_data2 ) {
-        memcpy( profile_data2, profile_data, profile_length );
-        vips_image_set_blob( cached, VIPS_META_ICC_NAME, 
-                             (VipsCallbackFn) g_free, 
-                             profile_data2, profile_length );
-      }
-    }
-
-    if( image_data ) {
-      void* image_data2 = malloc( blobsz );
-      if( image_data2 ) {
-        memcpy( image_data2, image_data, blobsz );
-        vips_image_set_blob( cached, "raw_image_data", 
-            (VipsCallbackFn) g_free,
-            image_data2, blobsz );
-      }
-    }
-
-    if( exif_data ) {
-      void* exif_data2 = malloc( exifsz );
-      if( exif_data2 ) {
-        memcpy( exif_data2, exif_data, exifsz );
-        vips_image_set_blob( cached, PF_META_EXIF_NAME,
-            (VipsCallbackFn) PF::exif_free,
-            exif_data2, exifsz );
-      }
-    }
-
-    pyramid.init( cached );
-    std::cout<<"CacheBuffer: caching completed"<<std::endl;
-    result = true;
+    load_cached();
   }
 
   return;
@@ -204,100 +210,118 @@ void PF::CacheBuffer::write()
   if( completed ) return;
   if( !image ) return;
 
-  bool result = false;
+  if( PF::PhotoFlow::Instance().is_out_of_core() ) {
+    init_on_demand();
+    return;
+  }
 
   // Copy the image into the disk buffer. Create the disk buffer if not yet done.
-  if( fd < 0 ) {
-    char fname[500];
-    sprintf( fname,"%spfraw-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
-    //fd = mkostemp( fname, O_CREAT|O_RDWR|O_TRUNC );
-    fd = pf_mkstemp( fname );
-    if( fd >= 0 )
-      filename = fname;
-  }
-  if( fd < 0 ) return;
+  if( !open_buffer() ) return;
 
-  std::cout<<"CacheBuffer::write(): saving image data into "<<filename<<std::endl;
+  std::cout<<"CacheBuffer::write(): saving image data into "<<filename
+      <<(half_float ? " (half precision)" : "")<<std::endl;
 
-  int fail = vips_rawsave_fd( image, fd, NULL );
+  VipsImage* out = image;
+  if( half_float ) {
+    out = PF::half_float_encode( image );
+    if( !out ) {
+      std::cout<<"CacheBuffer: half_float_encode() failed"<<std::endl;
+      return;
+    }
+  }
+  int fail = vips_rawsave_fd( out, fd, NULL );
+  if( half_float )
+    PF_UNREF( out, "CacheBuffer::write() encoded image unref" );
   if( fail ) {
     std::cout<<"CacheBuffer: vips_rawsave_fd() failed"<<std::endl;
     return;
   }
   close( fd );
 
+  completed = true;
+  load_cached();
+}
 
-    completed = true;
-    void *profile_data;
-    size_t profile_length;
-    if( vips_image_get_blob( image, VIPS_META_ICC_NAME,
-                             &profile_data, &profile_length ) )
-      profile_data = NULL;
-
-    size_t blobsz;
-    void* image_data;
-    if( vips_image_get_blob( image, "raw_image_data",
-                             &image_data,
-                             &blobsz ) )
-      image_data = NULL;
-
-    size_t exifsz;
-    void* exif_data;
-    if( vips_image_get_blob( image, PF_META_EXIF_NAME,
-        &exif_data,&exifsz ) ) {
-      exif_data = NULL;
-    }
 
-    int width = image->Xsize;
-    int height = image->Ysize;
-    int size = (width>height) ? width : height;
-    int nbands = image->Bands;
-
-    VipsImage* rawimg;
-
-    vips_rawload( filename.c_str(), &rawimg, width, height,
-                  VIPS_IMAGE_SIZEOF_PEL( image ), NULL );
-    vips_copy( rawimg, &cached,
-         "format", image->BandFmt,
-         "bands", image->Bands,
-         "coding", image->Coding,
-         "interpretation", image->Type,
-         NULL );
-    PF_UNREF( rawimg, "CacheBuffer::step() completed" );
-
-    if( profile_data ) {
-      void* profile_data2 = malloc( profile_length );
-      if( profile_data2 ) {
-        memcpy( profile_data2, profile_data, profile_length );
-        vips_image_set_blob( cached, VIPS_META_ICC_NAME,
-                             (VipsCallbackFn) g_free,
-                             profile_data2, profile_length );
-      }
-    }
+void PF::CacheBuffer::load_cached()
+{
+  void *profile_data;
+  size_t profile_length;
+  if( vips_image_get_blob( image, VIPS_META_ICC_NAME,
+                           &profile_data, &profile_length ) )
+    profile_data = NULL;
+
+  size_t blobsz;
+  void* image_data;
+  if( vips_image_get_blob( image, "raw_image_data",
+                           &image_data,
+                           &blobsz ) )
+    image_data = NULL;
+
+  size_t exifsz;
+  void* exif_data;
+  if( vips_image_get_blob( image, PF_META_EXIF_NAME,
+      &exif_data,&exifsz ) ) {
+    exif_data = NULL;
+  }
+
+  int width = image->Xsize;
+  int height = image->Ysize;
+
+  VipsImage* rawimg;
+
+  vips_rawload( filename.c_str(), &rawimg, width, height,
+                get_storage_pel_size(), NULL );
+  VipsImage* copy;
+  vips_copy( rawimg, &copy,
+       "format", half_float ? VIPS_FORMAT_USHORT : image->BandFmt,
+       "bands", image->Bands,
+       "coding", image->Coding,
+       "interpretation", image->Type,
+       NULL );
+  PF_UNREF( rawimg, "CacheBuffer::load_cached() rawimg unref" );
+  if( half_float ) {
+    // The half values are converted back to floats when the cached image is read
+    VipsImage* decoded = PF::half_float_decode( copy );
+    PF_UNREF( copy, "CacheBuffer::load_cached() copy unref" );
+    copy = decoded;
+  }
+  set_cached( copy );
+  if( !cached ) {
+    std::cout<<"CacheBuffer::load_cached(): cannot map "<<filename<<std::endl;
+    return;
+  }
 
-    if( image_data ) {
-      void* image_data2 = malloc( blobsz );
-      if( image_data2 ) {
-        memcpy( image_data2, image_data, blobsz );
-        vips_image_set_blob( cached, "raw_image_data",
-            (VipsCallbackFn) g_free,
-            image_data2, blobsz );
-      }
+  if( profile_data ) {
+    void* profile_data2 = malloc( profile_length );
+    if( profile_data2 ) {
+      memcpy( profile_data2, profile_data, profile_length );
+      vips_image_set_blob( cached, VIPS_META_ICC_NAME,
+                           (VipsCallbackFn) g_free,
+                           profile_data2, profile_length );
     }
+  }
 
-    if( exif_data ) {
-      void* exif_data2 = malloc( exifsz );
-      if( exif_data2 ) {
-        memcpy( exif_data2, exif_data, exifsz );
-        vips_image_set_blob( cached, PF_META_EXIF_NAME,
-            (VipsCallbackFn) PF::exif_free,
-            exif_data2, exifsz );
-      }
+  if( image_data ) {
+    void* image_data2 = malloc( blobsz );
+    if( image_data2 ) {
+      memcpy( image_data2, image_data, blobsz );
+      vips_image_set_blob( cached, "raw_image_data",
+          (VipsCallbackFn) g_free,
+          image_data2, blobsz );
     }
+  }
 
-    pyramid.init( cached );
-    std::cout<<"CacheBuffer: caching completed"<<std::endl;
-    result = true;
+  if( exif_data ) {
+    void* exif_data2 = malloc( exifsz );
+    if( exif_data2 ) {
+      memcpy( exif_data2, exif_data, exifsz );
+      vips_image_set_blob( cached, PF_META_EXIF_NAME,
+          (VipsCallbackFn) PF::exif_free,
+          exif_data2, exifsz );
+    }
+  }
 
-  return;
+  pyramid.init( cached );
+  std::cout<<"CacheBuffer: caching completed"<<(half_float ? " (half precision)" : "")<<std::endl;
 }
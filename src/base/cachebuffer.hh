@@ -56,6 +56,10 @@
 
 #include "imagepyramid.hh"
 
+#include "image_stats.hh"
+
+#include "memory_manager.hh"
+
 
 
 #define PF_CACHE_BUFFER_TILE_SIZE 128
@@ -73,6 +77,9 @@ namespace PF
 
     ImagePyramid pyramid;
 
+    // Statistics of the cached image, accumulated while the tiles are written
+    ImageStats stats;
+
     std::string filename;
     int fd;
 
@@ -86,13 +93,39 @@ namespace PF
     // Coordinates of the tile being processed
     int step_x, step_y;
 
+    // Size of the cached image, as reported to the memory manager
+    size_t memory_size;
+
+    // Flag indicating that the buffer is used by a preview pipeline,
+    // and therefore that the data can be stored at reduced precision
+    bool preview;
+
+    // Flag indicating that the floating-point data is stored as half values
+    bool half_float;
+
+    // Flag indicating that the buffer is a sparse disk cache filled on demand (out-of-core mode)
+    bool on_demand;
+
+    // Size of one pixel in the disk buffer
+    size_t get_storage_pel_size();
+
+    // Create the disk buffer if not yet done
+    bool open_buffer();
+
+    // Map the completed disk buffer and copy the image metadata
+    void load_cached();
+
+    // Wrap the image into a sparse disk cache, without computing anything in advance
+    void init_on_demand();
+
+    void set_cached( VipsImage* img );
+
   public:
-    CacheBuffer();
+    CacheBuffer( bool preview=false );
 
     virtual ~CacheBuffer()
     {
-      if( cached )
-        PF_UNREF( cached, "~CacheBuffer() cached image unref" );
+      set_cached( NULL );
     }
 
     bool is_initialized() { return initialized; }
@@ -101,8 +134,13 @@ namespace PF
     VipsImage* get_image() { return image; }
     void set_image( VipsImage* img ) { image = img; }
 
+    // Image associated to the completed disk buffer
+    VipsImage* get_cached_image() { return cached; }
+
     ImagePyramid& get_pyramid() { return pyramid; }
 
+    ImageStats& get_stats() { return stats; }
+
     void reset( bool reinitialize=false );
     bool is_completed() { return completed; }
 
@@ -219,6 +219,12 @@ namespace PF
     return( r*0.3 + g*0.59 + b*0.11 );
   }
 
+  // Single-precision version, used by the color and luminosity blend modes
+  inline float luminance(const float& r, const float& g, const float& b)
+  {
+    return( r*0.3f + g*0.59f + b*0.11f );
+  }
+
 
   // Clips the RGB values resulting from a luminosity/color blend
   template<class T>
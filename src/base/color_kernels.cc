@@ -0,0 +1,238 @@
+/* 
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "color.hh"
+#include "color_kernels.hh"
+
+
+#ifdef __SSE2__
+
+// Loads the R, G and B channels of 4 consecutive pixels into separate registers
+#define PF_LOAD_RGB4( p, r, g, b )              \
+  r = _mm_set_ps( p[9], p[6], p[3], p[0] );     \
+  g = _mm_set_ps( p[10], p[7], p[4], p[1] );    \
+  b = _mm_set_ps( p[11], p[8], p[5], p[2] )
+
+// Stores 3 registers into the channels of 4 consecutive pixels
+#define PF_STORE_RGB4( p, r, g, b )             \
+  {                                             \
+    float _r[4], _g[4], _b[4];                  \
+    _mm_storeu_ps( _r, r );                     \
+    _mm_storeu_ps( _g, g );                     \
+    _mm_storeu_ps( _b, b );                     \
+    for( int _i = 0; _i < 4; _i++ ) {           \
+      p[_i*3] = _r[_i];                         \
+      p[_i*3+1] = _g[_i];                       \
+      p[_i*3+2] = _b[_i];                       \
+    }                                           \
+  }
+
+// mask ? a : b
+static inline __m128 pf_select_ps( __m128 mask, __m128 a, __m128 b )
+{
+  return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+static inline __m128 pf_floor_ps( __m128 x )
+{
+  __m128 f = _mm_cvtepi32_ps( _mm_cvttps_epi32( x ) );
+  return _mm_sub_ps( f, _mm_and_ps( _mm_cmpgt_ps( f, x ), _mm_set1_ps(1.0f) ) );
+}
+
+#endif
+
+
+static inline void rgb2hsv_pixel( const float* in, float* out )
+{
+  float r = in[0], g = in[1], b = in[2];
+  float max = (r > g) ? r : g; if( b > max ) max = b;
+  float min = (r < g) ? r : g; if( b < min ) min = b;
+  float c = max - min;
+  float ic = (c > 0) ? 1.0f/c : 0.0f;
+  float h = (r == max) ? (g-b)*ic : ( (g == max) ? (b-r)*ic + 2.0f : (r-g)*ic + 4.0f );
+  h *= 60.0f;
+  if( h < 0 ) h += 360.0f;
+  out[0] = (c > 0) ? h : 0.0f;
+  out[1] = (max > 0) ? c/max : 0.0f;
+  out[2] = max;
+}
+
+
+void PF::rgb2hsv_row( const float* in, float* out, int npix )
+{
+  int x = 0;
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps( 1.0f );
+  const __m128 two = _mm_set1_ps( 2.0f );
+  const __m128 four = _mm_set1_ps( 4.0f );
+  const __m128 c60 = _mm_set1_ps( 60.0f );
+  const __m128 c360 = _mm_set1_ps( 360.0f );
+  __m128 r, g, b;
+  for( ; x < npix-3; x += 4, in += 12, out += 12 ) {
+    PF_LOAD_RGB4( in, r, g, b );
+    __m128 max = _mm_max_ps( _mm_max_ps( r, g ), b );
+    __m128 min = _mm_min_ps( _mm_min_ps( r, g ), b );
+    __m128 c = _mm_sub_ps( max, min );
+    __m128 cpos = _mm_cmpgt_ps( c, zero );
+    // the division by zero is masked out
+    __m128 ic = _mm_and_ps( cpos, _mm_div_ps( one, c ) );
+    __m128 hr = _mm_mul_ps( _mm_sub_ps( g, b ), ic );
+    __m128 hg = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( b, r ), ic ), two );
+    __m128 hb = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( r, g ), ic ), four );
+    __m128 h = pf_select_ps( _mm_cmpeq_ps( r, max ), hr,
+                             pf_select_ps( _mm_cmpeq_ps( g, max ), hg, hb ) );
+    h = _mm_mul_ps( h, c60 );
+    h = _mm_add_ps( h, _mm_and_ps( _mm_cmplt_ps( h, zero ), c360 ) );
+    h = _mm_and_ps( cpos, h );
+    __m128 s = _mm_and_ps( _mm_cmpgt_ps( max, zero ), _mm_div_ps( c, max ) );
+    PF_STORE_RGB4( out, h, s, max );
+  }
+#endif
+  for( ; x < npix; x++, in += 3, out += 3 )
+    rgb2hsv_pixel( in, out );
+}
+
+
+// Uses the alternative formulation of the HSV -> RGB conversion:
+// f(n) = V - V*S*max(0, min(k, 4-k, 1)), k = (n + H/60) mod 6, n = 5, 3, 1 for R, G, B
+static inline float hsv_channel( float n, float h6, float v, float vs )
+{
+  float k = n + h6;
+  k -= 6.0f * floorf( k / 6.0f );
+  float t = 4.0f - k;
+  if( t < k ) k = t;
+  if( k > 1.0f ) k = 1.0f;
+  if( k < 0.0f ) k = 0.0f;
+  return( v - vs*k );
+}
+
+
+void PF::hsv2rgb_row( const float* in, float* out, int npix )
+{
+  int x = 0;
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps( 1.0f );
+  const __m128 four = _mm_set1_ps( 4.0f );
+  const __m128 six = _mm_set1_ps( 6.0f );
+  const __m128 isix = _mm_set1_ps( 1.0f/6.0f );
+  const __m128 i60 = _mm_set1_ps( 1.0f/60.0f );
+  const __m128 n[3] = { _mm_set1_ps( 5.0f ), _mm_set1_ps( 3.0f ), _mm_set1_ps( 1.0f ) };
+  __m128 h, s, v, rgb[3];
+  for( ; x < npix-3; x += 4, in += 12, out += 12 ) {
+    PF_LOAD_RGB4( in, h, s, v );
+    __m128 h6 = _mm_mul_ps( h, i60 );
+    __m128 vs = _mm_mul_ps( v, s );
+    for( int ch = 0; ch < 3; ch++ ) {
+      __m128 k = _mm_add_ps( n[ch], h6 );
+      k = _mm_sub_ps( k, _mm_mul_ps( six, pf_floor_ps( _mm_mul_ps( k, isix ) ) ) );
+      k = _mm_min_ps( k, _mm_sub_ps( four, k ) );
+      k = _mm_max_ps( _mm_min_ps( k, one ), zero );
+      rgb[ch] = _mm_sub_ps( v, _mm_mul_ps( vs, k ) );
+    }
+    PF_STORE_RGB4( out, rgb[0], rgb[1], rgb[2] );
+  }
+#endif
+  for( ; x < npix; x++, in += 3, out += 3 ) {
+    float h6 = in[0] / 60.0f, v = in[2], vs = in[1]*in[2];
+    out[0] = hsv_channel( 5.0f, h6, v, vs );
+    out[1] = hsv_channel( 3.0f, h6, v, vs );
+    out[2] = hsv_channel( 1.0f, h6, v, vs );
+  }
+}
+
+
+void PF::luminance_row( const float* rgb, float* lumi, int npix )
+{
+  int x = 0;
+#ifdef __SSE2__
+  const __m128 wr = _mm_set1_ps( 0.3f );
+  const __m128 wg = _mm_set1_ps( 0.59f );
+  const __m128 wb = _mm_set1_ps( 0.11f );
+  __m128 r, g, b;
+  for( ; x < npix-3; x += 4, rgb += 12 ) {
+    PF_LOAD_RGB4( rgb, r, g, b );
+    __m128 l = _mm_add_ps( _mm_add_ps( _mm_mul_ps( r, wr ), _mm_mul_ps( g, wg ) ),
+                           _mm_mul_ps( b, wb ) );
+    _mm_storeu_ps( lumi+x, l );
+  }
+#endif
+  for( ; x < npix; x++, rgb += 3 )
+    lumi[x] = rgb[0]*0.3f + rgb[1]*0.59f + rgb[2]*0.11f;
+}
+
+
+// Same formulas as lc_blend() and clip_lc_blend() in color.hh,
+// with the [0,1] range of the floating-point format
+void PF::lc_blend_row( float* rgb, const float* lumi, int npix )
+{
+  int x = 0;
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps( 1.0f );
+  const __m128 wr = _mm_set1_ps( 0.3f );
+  const __m128 wg = _mm_set1_ps( 0.59f );
+  const __m128 wb = _mm_set1_ps( 0.11f );
+  __m128 r, g, b;
+  for( ; x < npix-3; x += 4, rgb += 12 ) {
+    PF_LOAD_RGB4( rgb, r, g, b );
+    __m128 l = _mm_add_ps( _mm_add_ps( _mm_mul_ps( r, wr ), _mm_mul_ps( g, wg ) ),
+                           _mm_mul_ps( b, wb ) );
+    __m128 diff = _mm_sub_ps( _mm_loadu_ps( lumi+x ), l );
+    r = _mm_add_ps( r, diff );
+    g = _mm_add_ps( g, diff );
+    b = _mm_add_ps( b, diff );
+    l = _mm_add_ps( _mm_add_ps( _mm_mul_ps( r, wr ), _mm_mul_ps( g, wg ) ),
+                    _mm_mul_ps( b, wb ) );
+    __m128 min = _mm_min_ps( _mm_min_ps( r, g ), b );
+    __m128 max = _mm_max_ps( _mm_max_ps( r, g ), b );
+    // the scale factors of the lanes that do not need clipping are discarded,
+    // so the divisions by zero are harmless
+    __m128 lo = _mm_cmplt_ps( min, zero );
+    __m128 hi = _mm_cmpgt_ps( max, one );
+    __m128 slo = _mm_div_ps( l, _mm_sub_ps( l, min ) );
+    __m128 shi = _mm_div_ps( _mm_sub_ps( one, l ), _mm_sub_ps( max, l ) );
+    __m128 s = pf_select_ps( hi, shi, pf_select_ps( lo, slo, one ) );
+    r = _mm_add_ps( l, _mm_mul_ps( _mm_sub_ps( r, l ), s ) );
+    g = _mm_add_ps( l, _mm_mul_ps( _mm_sub_ps( g, l ), s ) );
+    b = _mm_add_ps( l, _mm_mul_ps( _mm_sub_ps( b, l ), s ) );
+    PF_STORE_RGB4( rgb, r, g, b );
+  }
+#endif
+  for( ; x < npix; x++, rgb += 3 )
+    PF::lc_blend( rgb[0], rgb[1], rgb[2], lumi[x] );
+}
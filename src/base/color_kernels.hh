@@ -0,0 +1,99 @@
+/* 
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef PF_COLOR_KERNELS_H
+#define PF_COLOR_KERNELS_H
+
+#include "format_info.hh"
+
+/*
+  Color model conversions operating on whole rows of interleaved pixels.
+
+  All the kernels work on floating-point data normalized to the [0,1] range,
+  with the hue expressed in degrees in the [0,360) range. Input and output
+  buffers can be the same. When SSE2 instructions are available, groups of
+  four pixels are converted without branches; the remaining pixels at the
+  end of each row go through a scalar version of the same formulas.
+ */
+
+// Number of pixels converted at once by the callers that process
+// whole rows through small floating-point buffers on the stack
+#define PF_COLOR_ROW_CHUNK_SIZE 256
+
+namespace PF
+{
+
+  // Conversion of a row of values between the pixel format and normalized floats
+  template<class T>
+  void to_float_row( const T* in, float* out, int n )
+  {
+    const float min = FormatInfo<T>::MIN;
+    const float norm = 1.0f / FormatInfo<T>::RANGE;
+    for( int i = 0; i < n; i++ )
+      out[i] = (static_cast<float>(in[i])+min)*norm;
+  }
+
+  template<class T>
+  void from_float_row( const float* in, T* out, int n )
+  {
+    const float min = FormatInfo<T>::MIN;
+    const float range = FormatInfo<T>::RANGE;
+    for( int i = 0; i < n; i++ )
+      out[i] = static_cast<T>( in[i]*range - min );
+  }
+
+  template<>
+  inline void to_float_row<float>( const float* in, float* out, int n )
+  {
+    if( in == out ) return;
+    for( int i = 0; i < n; i++ ) out[i] = in[i];
+  }
+
+  template<>
+  inline void from_float_row<float>( const float* in, float* out, int n )
+  {
+    if( in == out ) return;
+    for( int i = 0; i < n; i++ ) out[i] = in[i];
+  }
+
+  // RGB <-> HSV
+  void rgb2hsv_row( const float* in, float* out, int npix );
+  void hsv2rgb_row( const float* in, float* out, int npix );
+
+  // Luminance of a row of RGB pixels, with the same weights as luminance()
+  void luminance_row( const float* rgb, float* lumi, int npix );
+
+  // Row version of lc_blend(): the luminance of each RGB pixel is replaced
+  // by the corresponding value in lumi, and the result is clipped to [0,1]
+  // while preserving the luminance
+  void lc_blend_row( float* rgb, const float* lumi, int npix );
+}
+
+
+#endif
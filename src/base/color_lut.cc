@@ -0,0 +1,272 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "color_lut.hh"
+
+
+// Number of test points per axis used to verify the LUT accuracy
+#define PF_LUT3D_CHECK_SIZE 15
+
+
+static std::string profile_to_string( cmsHPROFILE profile )
+{
+  std::string result;
+  cmsUInt32Number length;
+  if( !profile ) return result;
+  if( !cmsSaveProfileToMem( profile, NULL, &length ) ) return result;
+  result.resize( length );
+  cmsSaveProfileToMem( profile, &(result[0]), &length );
+  return result;
+}
+
+
+PF::ColorLUT3D::ColorLUT3D():
+  size( 0 ), nodes( NULL ), max_delta_e( 0 )
+{
+}
+
+
+PF::ColorLUT3D::~ColorLUT3D()
+{
+  reset();
+}
+
+
+void PF::ColorLUT3D::reset()
+{
+  if( nodes ) free( nodes );
+  nodes = NULL;
+  size = 0;
+  max_delta_e = 0;
+  profile_in_data.clear();
+  profile_out_data.clear();
+}
+
+
+bool PF::ColorLUT3D::is_computed_for( cmsHPROFILE profile_in, cmsHPROFILE profile_out, int sz )
+{
+  if( !nodes || (sz != size) ) return false;
+  if( profile_to_string( profile_in ) != profile_in_data ) return false;
+  if( profile_to_string( profile_out ) != profile_out_data ) return false;
+  return true;
+}
+
+
+bool PF::ColorLUT3D::init( cmsHPROFILE profile_in, cmsHPROFILE profile_out, int intent, int sz )
+{
+  reset();
+
+  if( !profile_in || !profile_out || (sz < 2) ) return false;
+  if( cmsGetColorSpace( profile_in ) != cmsSigRgbData ) return false;
+  if( cmsGetColorSpace( profile_out ) != cmsSigRgbData ) return false;
+
+  cmsHTRANSFORM transform = cmsCreateTransform( profile_in, TYPE_RGB_FLT,
+      profile_out, TYPE_RGB_FLT, intent, cmsFLAGS_NOCACHE );
+  if( !transform ) return false;
+
+  int npoints = sz*sz*sz;
+  float* grid = (float*)malloc( sizeof(float)*npoints*3 );
+  nodes = (float*)malloc( sizeof(float)*npoints*4 );
+  if( !grid || !nodes ) {
+    if( grid ) free( grid );
+    cmsDeleteTransform( transform );
+    reset();
+    return false;
+  }
+  size = sz;
+
+  // Grid points are ordered with the red index running fastest
+  float delta = 1.0f / (sz-1);
+  float* pg = grid;
+  for( int b = 0; b < sz; b++ ) {
+    for( int g = 0; g < sz; g++ ) {
+      for( int r = 0; r < sz; r++ ) {
+        *pg++ = delta*r;
+        *pg++ = delta*g;
+        *pg++ = delta*b;
+      }
+    }
+  }
+  cmsDoTransform( transform, grid, grid, npoints );
+  for( int i = 0; i < npoints; i++ ) {
+    nodes[i*4]   = grid[i*3];
+    nodes[i*4+1] = grid[i*3+1];
+    nodes[i*4+2] = grid[i*3+2];
+    nodes[i*4+3] = 0;
+  }
+  free( grid );
+
+  max_delta_e = check_accuracy( transform, profile_out );
+  cmsDeleteTransform( transform );
+
+  if( max_delta_e > PF_LUT3D_MAX_DELTA_E ) {
+    std::cout<<"ColorLUT3D::init(): max. deltaE="<<max_delta_e<<" too large, LUT disabled"<<std::endl;
+    reset();
+    return false;
+  }
+
+  profile_in_data = profile_to_string( profile_in );
+  profile_out_data = profile_to_string( profile_out );
+
+#ifndef NDEBUG
+  std::cout<<"ColorLUT3D::init(): "<<size<<"^3 LUT computed, max. deltaE="<<max_delta_e<<std::endl;
+#endif
+  return true;
+}
+
+
+float PF::ColorLUT3D::check_accuracy( cmsHTRANSFORM transform, cmsHPROFILE profile_out )
+{
+  // The test points are placed at the center of the cells of a coarser grid;
+  // an odd grid size guarantees that they almost never coincide with the LUT nodes
+  int npoints = PF_LUT3D_CHECK_SIZE*PF_LUT3D_CHECK_SIZE*PF_LUT3D_CHECK_SIZE;
+  float* test = (float*)malloc( sizeof(float)*npoints*3 );
+  float* exact = (float*)malloc( sizeof(float)*npoints*3 );
+  float* approx = (float*)malloc( sizeof(float)*npoints*3 );
+  if( !test || !exact || !approx ) {
+    if( test ) free( test );
+    if( exact ) free( exact );
+    if( approx ) free( approx );
+    return 1.0e10;
+  }
+
+  float* pt = test;
+  for( int b = 0; b < PF_LUT3D_CHECK_SIZE; b++ ) {
+    for( int g = 0; g < PF_LUT3D_CHECK_SIZE; g++ ) {
+      for( int r = 0; r < PF_LUT3D_CHECK_SIZE; r++ ) {
+        *pt++ = (0.5f+r)/PF_LUT3D_CHECK_SIZE;
+        *pt++ = (0.5f+g)/PF_LUT3D_CHECK_SIZE;
+        *pt++ = (0.5f+b)/PF_LUT3D_CHECK_SIZE;
+      }
+    }
+  }
+
+  cmsDoTransform( transform, test, exact, npoints );
+  apply( test, approx, npoints );
+
+  float result = 1.0e10;
+  cmsHPROFILE profile_lab = cmsCreateLab4Profile( NULL );
+  cmsHTRANSFORM transform_lab = cmsCreateTransform( profile_out, TYPE_RGB_FLT,
+      profile_lab, TYPE_Lab_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOCACHE );
+  if( transform_lab ) {
+    cmsDoTransform( transform_lab, exact, exact, npoints );
+    cmsDoTransform( transform_lab, approx, approx, npoints );
+    result = 0;
+    for( int i = 0; i < npoints*3; i += 3 ) {
+      float dL = exact[i] - approx[i];
+      float da = exact[i+1] - approx[i+1];
+      float db = exact[i+2] - approx[i+2];
+      float de = sqrtf( dL*dL + da*da + db*db );
+      if( de > result ) result = de;
+    }
+    cmsDeleteTransform( transform_lab );
+  }
+  if( profile_lab ) cmsCloseProfile( profile_lab );
+
+  free( test );
+  free( exact );
+  free( approx );
+  return result;
+}
+
+
+void PF::ColorLUT3D::apply( const float* in, float* out, int npix )
+{
+  if( !nodes ) return;
+
+  const int smax = size - 1;
+  const float fmax = smax;
+  // offsets of the neighbouring nodes along the R, G and B axis
+  const int dr = 4, dg = size*4, db = size*size*4;
+
+  for( int x = 0; x < npix*3; x += 3 ) {
+    float fr = in[x]*fmax, fg = in[x+1]*fmax, fb = in[x+2]*fmax;
+    if( !(fr > 0) ) fr = 0; if( fr > fmax ) fr = fmax;
+    if( !(fg > 0) ) fg = 0; if( fg > fmax ) fg = fmax;
+    if( !(fb > 0) ) fb = 0; if( fb > fmax ) fb = fmax;
+    int ir = (int)fr, ig = (int)fg, ib = (int)fb;
+    if( ir == smax ) ir -= 1;
+    if( ig == smax ) ig -= 1;
+    if( ib == smax ) ib -= 1;
+    fr -= ir; fg -= ig; fb -= ib;
+
+    // Select the tetrahedron containing the point; the interpolated value is
+    // c000*(1-w1) + cA*(w1-w2) + cB*(w2-w3) + c111*w3, with w1 >= w2 >= w3
+    int oA, oB;
+    float w1, w2, w3;
+    if( fr >= fg ) {
+      if( fg >= fb ) {        // r > g > b
+        oA = dr; oB = dr+dg; w1 = fr; w2 = fg; w3 = fb;
+      } else if( fr >= fb ) { // r > b > g
+        oA = dr; oB = dr+db; w1 = fr; w2 = fb; w3 = fg;
+      } else {                // b > r > g
+        oA = db; oB = dr+db; w1 = fb; w2 = fr; w3 = fg;
+      }
+    } else {
+      if( fb >= fg ) {        // b > g > r
+        oA = db; oB = dg+db; w1 = fb; w2 = fg; w3 = fr;
+      } else if( fb >= fr ) { // g > b > r
+        oA = dg; oB = dg+db; w1 = fg; w2 = fb; w3 = fr;
+      } else {                // g > r > b
+        oA = dg; oB = dr+dg; w1 = fg; w2 = fr; w3 = fb;
+      }
+    }
+
+    const float* c000 = nodes + ((ib*size + ig)*size + ir)*4;
+    const float* cA = c000 + oA;
+    const float* cB = c000 + oB;
+    const float* c111 = c000 + dr + dg + db;
+
+#ifdef __SSE2__
+    __m128 v = _mm_mul_ps( _mm_loadu_ps(c000), _mm_set1_ps(1.0f-w1) );
+    v = _mm_add_ps( v, _mm_mul_ps( _mm_loadu_ps(cA), _mm_set1_ps(w1-w2) ) );
+    v = _mm_add_ps( v, _mm_mul_ps( _mm_loadu_ps(cB), _mm_set1_ps(w2-w3) ) );
+    v = _mm_add_ps( v, _mm_mul_ps( _mm_loadu_ps(c111), _mm_set1_ps(w3) ) );
+    float res[4];
+    _mm_storeu_ps( res, v );
+    out[x]   = res[0];
+    out[x+1] = res[1];
+    out[x+2] = res[2];
+#else
+    float k0 = 1.0f-w1, kA = w1-w2, kB = w2-w3;
+    out[x]   = c000[0]*k0 + cA[0]*kA + cB[0]*kB + c111[0]*w3;
+    out[x+1] = c000[1]*k0 + cA[1]*kA + cB[1]*kB + c111[1]*w3;
+    out[x+2] = c000[2]*k0 + cA[2]*kA + cB[2]*kB + c111[2]*w3;
+#endif
+  }
+}
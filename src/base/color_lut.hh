@@ -0,0 +1,128 @@
+/*
+    File color_lut.hh: implementation of the ColorLUT3D class.
+
+    The ColorLUT3D objects hold a pre-computed RGB -> RGB color transform,
+    sampled on a regular NxNxN grid and evaluated through tetrahedral interpolation.
+    They are used to speed-up the color conversions needed for the preview, while
+    the exact LCMS2 transforms are still used for the final export.
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef PF_COLOR_LUT_HH
+#define PF_COLOR_LUT_HH
+
+#include <string>
+
+#include <lcms2.h>
+
+#include "color.hh"
+
+
+// Default number of grid points per axis
+#define PF_LUT3D_DEFAULT_SIZE 33
+
+// Maximum CIE76 deltaE between the exact transform and the interpolated one;
+// LUTs that exceed this limit are discarded and the exact transform is used instead
+#define PF_LUT3D_MAX_DELTA_E 1.0f
+
+
+namespace PF
+{
+
+  class ColorLUT3D
+  {
+    // number of grid points per axis
+    int size;
+
+    // grid nodes, stored as RGBx quadruplets with the red index running fastest
+    float* nodes;
+
+    // maximum deltaE measured when the LUT was initialized
+    float max_delta_e;
+
+    // ICC data of the profiles the LUT was computed from
+    std::string profile_in_data;
+    std::string profile_out_data;
+
+    float check_accuracy( cmsHTRANSFORM transform, cmsHPROFILE profile_out );
+
+  public:
+    ColorLUT3D();
+    ~ColorLUT3D();
+
+    bool is_valid() { return( nodes != NULL ); }
+    int get_size() { return size; }
+    float get_max_delta_e() { return max_delta_e; }
+
+    // Returns true if the LUT was already computed for the given pair of profiles
+    bool is_computed_for( cmsHPROFILE profile_in, cmsHPROFILE profile_out, int sz );
+
+    // Sample the in -> out transform on the grid and verify the accuracy of the
+    // interpolation. Returns false if the transform cannot be represented by a LUT
+    // (non-RGB profiles) or if the interpolation error exceeds PF_LUT3D_MAX_DELTA_E
+    bool init( cmsHPROFILE profile_in, cmsHPROFILE profile_out, int intent,
+               int sz=PF_LUT3D_DEFAULT_SIZE );
+
+    void reset();
+
+    // Apply the LUT to a row of npix interleaved RGB pixels
+    void apply( const float* in, float* out, int npix );
+
+    template<class T>
+    void apply( const T* in, T* out, int npix )
+    {
+      float pin[3], pout[3];
+      for( int x = 0; x < npix*3; x += 3 ) {
+        to_float( in[x], pin[0] );
+        to_float( in[x+1], pin[1] );
+        to_float( in[x+2], pin[2] );
+        apply( pin, pout, 1 );
+        from_float( pout[0], out[x] );
+        from_float( pout[1], out[x+1] );
+        from_float( pout[2], out[x+2] );
+      }
+    }
+
+    // True if all the n values are within the [0,1] domain of the LUT;
+    // integer values always are
+    template<class T>
+    static bool in_domain( const T* in, int n ) { return true; }
+  };
+
+
+  template<>
+  inline bool ColorLUT3D::in_domain<float>( const float* in, int n )
+  {
+    for( int i = 0; i < n; i++ )
+      if( !(in[i] >= 0) || (in[i] > 1) ) return false;
+    return true;
+  }
+}
+
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "pf_mkstemp.hh"
+#include "photoflow.hh"
+#include "half_float.hh"
+#include "disk_tile_cache.hh"
+
+
+struct DiskTileStore
+{
+  VipsImage* in;
+  std::string filename;
+  int fd;
+  int ntiles_x, ntiles_y;
+  size_t pelsz;
+  // Each tile has a fixed slot in the file, large enough for a full tile
+  off_t slot_size;
+  // Tiles that are already stored in the file
+  std::vector<bool> present;
+  // Incremented each time the stored tiles are dropped
+  unsigned int serial;
+  GMutex* mutex;
+};
+
+
+static bool store_io( DiskTileStore* store, bool write, void* buf, size_t size, off_t offset )
+{
+#ifdef WIN32
+  // No positional I/O: the file position is shared, therefore seek and
+  // transfer must happen atomically
+  g_mutex_lock( store->mutex );
+  lseek( store->fd, offset, SEEK_SET );
+  ssize_t n = write ? ::write( store->fd, buf, size ) : ::read( store->fd, buf, size );
+  g_mutex_unlock( store->mutex );
+#else
+  ssize_t n = write ? pwrite( store->fd, buf, size, offset ) : pread( store->fd, buf, size, offset );
+#endif
+  return( n == (ssize_t)size );
+}
+
+
+static void store_free( VipsObject* obj, DiskTileStore* store )
+{
+  if( store->fd >= 0 )
+    close( store->fd );
+  unlink( store->filename.c_str() );
+  g_object_unref( store->in );
+  vips_g_mutex_free( store->mutex );
+  delete store;
+}
+
+
+static void store_invalidate( VipsImage* image, DiskTileStore* store )
+{
+  g_mutex_lock( store->mutex );
+  store->present.assign( store->present.size(), false );
+  store->serial += 1;
+  g_mutex_unlock( store->mutex );
+}
+
+
+static int disk_tile_cache_gen( VipsRegion* oreg, void* seq, void* a, void* b, gboolean* stop )
+{
+  VipsRegion* ireg = (VipsRegion*) seq;
+  DiskTileStore* store = (DiskTileStore*) a;
+  VipsRect* r = &oreg->valid;
+  VipsRect image_area = { 0, 0, oreg->im->Xsize, oreg->im->Ysize };
+
+  int tx0 = r->left / PF_DISK_TILE_SIZE;
+  int ty0 = r->top / PF_DISK_TILE_SIZE;
+  int tx1 = (r->left + r->width - 1) / PF_DISK_TILE_SIZE;
+  int ty1 = (r->top + r->height - 1) / PF_DISK_TILE_SIZE;
+
+  for( int ty = ty0; ty <= ty1; ty++ ) {
+    for( int tx = tx0; tx <= tx1; tx++ ) {
+      int tid = ty*store->ntiles_x + tx;
+      off_t slot = store->slot_size*tid;
+      VipsRect tile = { tx*PF_DISK_TILE_SIZE, ty*PF_DISK_TILE_SIZE,
+          PF_DISK_TILE_SIZE, PF_DISK_TILE_SIZE };
+      vips_rect_intersectrect( &image_area, &tile, &tile );
+      VipsRect area;
+      vips_rect_intersectrect( r, &tile, &area );
+      size_t tile_linesz = store->pelsz*tile.width;
+
+      g_mutex_lock( store->mutex );
+      bool present = store->present[tid];
+      unsigned int serial = store->serial;
+      g_mutex_unlock( store->mutex );
+
+      if( present ) {
+        bool ok = true;
+        for( int y = area.top; ok && (y < area.top+area.height); y++ ) {
+          off_t offset = slot + (y-tile.top)*tile_linesz + (area.left-tile.left)*store->pelsz;
+          ok = store_io( store, false, VIPS_REGION_ADDR( oreg, area.left, y ),
+              store->pelsz*area.width, offset );
+        }
+        if( ok ) continue;
+        std::cout<<"disk_tile_cache(): cannot read tile "<<tid<<" from "<<store->filename<<std::endl;
+      }
+
+      // The whole tile is computed and stored, even if only part of it is needed
+      if( vips_region_prepare( ireg, &tile ) )
+        return( -1 );
+      bool ok = true;
+      for( int y = tile.top; ok && (y < tile.top+tile.height); y++ ) {
+        ok = store_io( store, true, VIPS_REGION_ADDR( ireg, tile.left, y ),
+            tile_linesz, slot + (y-tile.top)*tile_linesz );
+      }
+      // The tile is not marked as stored if the cache was invalidated in the meantime,
+      // since the data might be outdated
+      g_mutex_lock( store->mutex );
+      if( ok && (serial == store->serial) )
+        store->present[tid] = true;
+      g_mutex_unlock( store->mutex );
+
+      vips_region_copy( ireg, oreg, &area, area.left, area.top );
+    }
+  }
+  return( 0 );
+}
+
+
+static VipsImage* disk_tile_cache_new( VipsImage* in )
+{
+  char fname[500];
+  snprintf( fname, 499, "%spftiles-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
+  int fd = pf_mkstemp( fname );
+  if( fd < 0 ) {
+    std::cout<<"disk_tile_cache(): cannot create cache file"<<std::endl;
+    return NULL;
+  }
+
+  VipsImage* out = vips_image_new();
+  if( vips_image_pipelinev( out, VIPS_DEMAND_STYLE_SMALLTILE, in, NULL ) ) {
+    g_object_unref( out );
+    close( fd );
+    unlink( fname );
+    return NULL;
+  }
+
+  DiskTileStore* store = new DiskTileStore;
+  store->in = in;
+  store->filename = fname;
+  store->fd = fd;
+  store->ntiles_x = (in->Xsize + PF_DISK_TILE_SIZE - 1) / PF_DISK_TILE_SIZE;
+  store->ntiles_y = (in->Ysize + PF_DISK_TILE_SIZE - 1) / PF_DISK_TILE_SIZE;
+  store->pelsz = VIPS_IMAGE_SIZEOF_PEL( in );
+  store->slot_size = off_t(store->pelsz)*PF_DISK_TILE_SIZE*PF_DISK_TILE_SIZE;
+  store->present.assign( store->ntiles_x*store->ntiles_y, false );
+  store->serial = 0;
+  store->mutex = vips_g_mutex_new();
+  // The input image must stay alive as long as the output one
+  g_object_ref( in );
+
+  // The store is released together with the output image
+  g_signal_connect( out, "close", G_CALLBACK( store_free ), store );
+  g_signal_connect( out, "invalidate", G_CALLBACK( store_invalidate ), store );
+
+  if( vips_image_generate( out, vips_start_one, disk_tile_cache_gen, vips_stop_one, in, store ) ) {
+    g_object_unref( out );
+    return NULL;
+  }
+
+#ifndef NDEBUG
+  std::cout<<"disk_tile_cache(): "<<in->Xsize<<"x"<<in->Ysize<<" image cached in "<<fname<<std::endl;
+#endif
+  return out;
+}
+
+
+VipsImage* PF::disk_tile_cache( VipsImage* in, bool half_float )
+{
+  if( !in ) return NULL;
+
+  half_float = half_float && (in->BandFmt == VIPS_FORMAT_FLOAT) && (in->Coding == VIPS_CODING_NONE);
+  if( !half_float )
+    return disk_tile_cache_new( in );
+
+  VipsImage* encoded = PF::half_float_encode( in );
+  if( !encoded ) return NULL;
+  VipsImage* cached = disk_tile_cache_new( encoded );
+  PF_UNREF( encoded, "disk_tile_cache(): encoded image unref" );
+  if( !cached ) return NULL;
+  VipsImage* out = PF::half_float_decode( cached );
+  PF_UNREF( cached, "disk_tile_cache(): cached image unref" );
+  return out;
+}
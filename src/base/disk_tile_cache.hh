@@ -0,0 +1,58 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef PF_DISK_TILE_CACHE_HH
+#define PF_DISK_TILE_CACHE_HH
+
+#include <vips/vips.h>
+
+
+// Size of the square tiles stored in the on-disk caches
+#define PF_DISK_TILE_SIZE 128
+
+
+namespace PF
+{
+
+  // Wrap an image into a sparse, tiled disk cache: each tile is computed
+  // from the input image the first time it is requested, written into a temporary
+  // file in the cache directory and read back from the file afterwards.
+  // Nothing is computed in advance, and the tiles that are never requested
+  // do not take any disk space, so that the memory footprint does not depend
+  // on the image size.
+  // The stored tiles are dropped when the returned image is invalidated.
+  // If "half_float" is true, floating-point data is stored as half values.
+  // The returned image holds a reference to the input one; returns NULL on failure.
+  VipsImage* disk_tile_cache( VipsImage* in, bool half_float = false );
+
+}
+
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+// The F16C row conversions are compiled in either unconditionally, if the
+// whole build targets a CPU with F16C support, or with per-function target
+// attributes and selected at runtime, which does not require any special
+// compiler flag
+#if defined(__F16C__)
+#define PF_HAVE_F16C 1
+#define PF_F16C_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PF_HAVE_F16C 1
+#define PF_F16C_DISPATCH 1
+#define PF_F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+
+#ifdef PF_HAVE_F16C
+#include <immintrin.h>
+#endif
+
+#include "half_float.hh"
+
+
+// Largest finite half value
+#define PF_HALF_MAX 65504.0f
+
+
+#ifdef PF_HAVE_F16C
+
+static bool cpu_has_f16c()
+{
+#ifdef PF_F16C_DISPATCH
+  __builtin_cpu_init();
+  return( __builtin_cpu_supports( "avx" ) && __builtin_cpu_supports( "f16c" ) );
+#else
+  return true;
+#endif
+}
+
+// The CPU features are only checked once
+static bool use_f16c()
+{
+  static const bool has_f16c = cpu_has_f16c();
+  return has_f16c;
+}
+
+
+// Both functions convert groups of 8 values, and return the number of
+// converted values; the remaining ones are left to the scalar code
+PF_F16C_TARGET
+static int float_to_half_f16c( const float* in, unsigned short* out, int n )
+{
+  // The clipping is done before the conversion, with the operands ordered
+  // such that NaNs are passed through
+  const __m256 vmax = _mm256_set1_ps( PF_HALF_MAX );
+  const __m256 vmin = _mm256_set1_ps( -PF_HALF_MAX );
+  int i = 0;
+  for( ; i+8 <= n; i += 8 ) {
+    __m256 v = _mm256_loadu_ps( in+i );
+    v = _mm256_max_ps( vmin, _mm256_min_ps( vmax, v ) );
+    _mm_storeu_si128( (__m128i*)(out+i), _mm256_cvtps_ph( v, 0 ) );
+  }
+  return i;
+}
+
+
+PF_F16C_TARGET
+static int half_to_float_f16c( const unsigned short* in, float* out, int n )
+{
+  int i = 0;
+  for( ; i+8 <= n; i += 8 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i*)(in+i) );
+    _mm256_storeu_ps( out+i, _mm256_cvtph_ps( v ) );
+  }
+  return i;
+}
+
+#endif
+
+
+unsigned short PF::float_to_half( float val )
+{
+  union { float f; unsigned int u; } v;
+  v.f = val;
+  unsigned int sign = (v.u >> 16) & 0x8000;
+  unsigned int abs = v.u & 0x7fffffff;
+
+  // NaN: keep the most significant bits of the payload, and make sure it stays a NaN
+  if( abs > 0x7f800000 )
+    return( sign | 0x7e00 | ((abs >> 13) & 0x3ff) );
+  // Values that would round to infinity are clipped
+  if( abs >= 0x477ff000 )
+    return( sign | 0x7bff );
+
+  unsigned int h, rem, halfway;
+  if( abs >= 0x38800000 ) {
+    // normal numbers: re-bias the exponent and round the mantissa to nearest even
+    h = (abs - 0x38000000) >> 13;
+    rem = abs & 0x1fff;
+    halfway = 0x1000;
+  } else {
+    // subnormal numbers (and zero)
+    if( abs <= 0x33000000 )
+      return( sign );
+    unsigned int shift = 126 - (abs >> 23);
+    unsigned int mant = (abs & 0x7fffff) | 0x800000;
+    h = mant >> shift;
+    rem = mant & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  }
+  if( rem > halfway || (rem == halfway && (h & 1)) )
+    h += 1;
+  return( sign | h );
+}
+
+
+float PF::half_to_float( unsigned short val )
+{
+  union { float f; unsigned int u; } v;
+  unsigned int sign = ((unsigned int)(val & 0x8000)) << 16;
+  unsigned int exp = (val >> 10) & 0x1f;
+  unsigned int mant = val & 0x3ff;
+
+  if( exp == 0x1f ) {
+    // infinity or NaN
+    v.u = sign | 0x7f800000 | (mant << 13);
+  } else if( exp != 0 ) {
+    v.u = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if( mant == 0 ) {
+    v.u = sign;
+  } else {
+    // subnormal half values are normal floats
+    exp = 113;
+    while( !(mant & 0x400) ) {
+      mant <<= 1;
+      exp -= 1;
+    }
+    v.u = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  return v.f;
+}
+
+
+void PF::float_to_half( const float* in, unsigned short* out, int n )
+{
+  int i = 0;
+#ifdef PF_HAVE_F16C
+  if( use_f16c() )
+    i = float_to_half_f16c( in, out, n );
+#endif
+  for( ; i < n; i++ )
+    out[i] = float_to_half( in[i] );
+}
+
+
+void PF::half_to_float( const unsigned short* in, float* out, int n )
+{
+  int i = 0;
+#ifdef PF_HAVE_F16C
+  if( use_f16c() )
+    i = half_to_float_f16c( in, out, n );
+#endif
+  for( ; i < n; i++ )
+    out[i] = half_to_float( in[i] );
+}
+
+
+static int half_float_encode_gen( VipsRegion* oreg, void* seq, void* a, void* b, gboolean* stop )
+{
+  VipsRegion* ireg = (VipsRegion*) seq;
+  VipsRect* r = &oreg->valid;
+  if( vips_region_prepare( ireg, r ) )
+    return( -1 );
+
+  int n = r->width * oreg->im->Bands;
+  for( int y = 0; y < r->height; y++ ) {
+    float* p = (float*)VIPS_REGION_ADDR( ireg, r->left, r->top+y );
+    unsigned short* q = (unsigned short*)VIPS_REGION_ADDR( oreg, r->left, r->top+y );
+    PF::float_to_half( p, q, n );
+  }
+  return( 0 );
+}
+
+
+static int half_float_decode_gen( VipsRegion* oreg, void* seq, void* a, void* b, gboolean* stop )
+{
+  VipsRegion* ireg = (VipsRegion*) seq;
+  VipsRect* r = &oreg->valid;
+  if( vips_region_prepare( ireg, r ) )
+    return( -1 );
+
+  int n = r->width * oreg->im->Bands;
+  for( int y = 0; y < r->height; y++ ) {
+    unsigned short* p = (unsigned short*)VIPS_REGION_ADDR( ireg, r->left, r->top+y );
+    float* q = (float*)VIPS_REGION_ADDR( oreg, r->left, r->top+y );
+    PF::half_to_float( p, q, n );
+  }
+  return( 0 );
+}
+
+
+static VipsImage* half_float_convert( VipsImage* in, VipsBandFormat in_fmt, VipsBandFormat out_fmt,
+    VipsGenerateFn gen )
+{
+  if( !in || in->BandFmt != in_fmt || in->Coding != VIPS_CODING_NONE )
+    return NULL;
+
+  VipsImage* out = vips_image_new();
+  if( vips_image_pipelinev( out, VIPS_DEMAND_STYLE_THINSTRIP, in, NULL ) ) {
+    g_object_unref( out );
+    return NULL;
+  }
+  out->BandFmt = out_fmt;
+
+  if( vips_image_generate( out, vips_start_one, gen, vips_stop_one, in, NULL ) ) {
+    g_object_unref( out );
+    return NULL;
+  }
+
+  // The input image must stay alive as long as the output one
+  g_object_ref( in );
+  vips_object_local( out, in );
+  return out;
+}
+
+
+VipsImage* PF::half_float_encode( VipsImage* in )
+{
+  return half_float_convert( in, VIPS_FORMAT_FLOAT, VIPS_FORMAT_USHORT, half_float_encode_gen );
+}
+
+
+VipsImage* PF::half_float_decode( VipsImage* in )
+{
+  return half_float_convert( in, VIPS_FORMAT_USHORT, VIPS_FORMAT_FLOAT, half_float_decode_gen );
+}
@@ -0,0 +1,60 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef PF_HALF_FLOAT_HH
+#define PF_HALF_FLOAT_HH
+
+#include <vips/vips.h>
+
+
+namespace PF
+{
+
+  // Conversion between single-precision floats and IEEE 754 half-precision
+  // values, stored as unsigned shorts. Values outside of the half range are
+  // clipped to the largest finite value, NaNs are preserved.
+  unsigned short float_to_half( float val );
+  float half_to_float( unsigned short val );
+
+  // Row conversions, using the F16C instructions when the CPU supports them
+  void float_to_half( const float* in, unsigned short* out, int n );
+  void half_to_float( const unsigned short* in, float* out, int n );
+
+  // Wrap a FLOAT image into an USHORT image holding the corresponding half values
+  // (encode), or the other way around (decode). The conversion is performed on demand,
+  // region by region; the returned image holds a reference to the input one.
+  // Returns NULL on failure.
+  VipsImage* half_float_encode( VipsImage* in );
+  VipsImage* half_float_decode( VipsImage* in );
+
+}
+
+
+#endif
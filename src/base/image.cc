@@ -36,8 +36,10 @@
 #include "image.hh"
 #include "imageprocessor.hh"
 #include "pf_file_loader.hh"
+#include "../operations/blender.hh"
 #include "../operations/convert2srgb.hh"
 #include "../operations/convertformat.hh"
+#include "../operations/stats_tap.hh"
 
 
 
@@ -93,7 +95,10 @@ PF::Image::Image():
   modified( false ), 
   rebuilding( false ), 
   loaded( false ),
-  disable_update( false )
+  disable_update( false ),
+  sampler_image( NULL ),
+  sampler_layer_id( -1 ),
+  sampler_exact( true )
 {
   rebuild_mutex = vips_g_mutex_new();
   //g_mutex_lock( rebuild_mutex );
@@ -114,6 +119,7 @@ PF::Image::Image():
   layer_manager.signal_modified.connect(sigc::mem_fun(this, &Image::update_all) );
   convert2srgb = new PF::Processor<PF::Convert2sRGBPar,PF::Convert2sRGBProc>();
   convert_format = new PF::Processor<PF::ConvertFormatPar,PF::ConvertFormatProc>();
+  stats_tap = new PF::Processor<PF::StatsTapPar,PF::StatsTapProc>();
 
   //add_pipeline( VIPS_FORMAT_UCHAR, 0 );
   //add_pipeline( VIPS_FORMAT_UCHAR, 0 );
@@ -193,6 +199,104 @@ void PF::Image::update( PF::Pipeline* target_pipeline, bool sync )
 }
 
 
+unsigned int PF::Image::get_preview_level()
+{
+  bool found = false;
+  unsigned int level = 0;
+  for( unsigned int i = 0; i < pipelines.size(); i++ ) {
+    PF::Pipeline* pipeline = pipelines[i];
+    if( !pipeline || !pipeline->has_sinks() ) continue;
+    if( pipeline->get_render_mode() != PF_RENDER_PREVIEW ) continue;
+    if( !found || (pipeline->get_level() < level) )
+      level = pipeline->get_level();
+    found = true;
+  }
+  return level;
+}
+
+
+bool PF::Image::do_hot_update( PF::Pipeline* target_pipeline )
+{
+  std::list<PF::Layer*> hot_layers;
+  std::list<PF::Layer*> switched_layers;
+  if( !get_layer_manager().get_hot_layers( hot_layers, switched_layers ) )
+    return false;
+
+  // The switched layers must be built behind a switch node in all pipelines
+  std::list<PF::Layer*>::iterator li;
+  for( unsigned int i = 0; i < get_npipelines(); i++ ) {
+    PF::Pipeline* pipeline = get_pipeline( i );
+    if( !pipeline ) continue;
+    for( li = switched_layers.begin(); li != switched_layers.end(); li++ ) {
+      PF::PipelineNode* node = pipeline->get_node( (*li)->get_id() );
+      if( !node || !node->blended || !node->blender ) return false;
+      PF::BlenderPar* bpar = dynamic_cast<PF::BlenderPar*>( node->blender->get_par() );
+      if( !bpar || !bpar->is_switch() ) return false;
+    }
+  }
+
+  // First copy the new values into the operations of all pipelines; if any
+  // of them refuses the change, the master copy stays modified and the
+  // pipelines are re-built as usual
+  for( unsigned int i = 0; i < get_npipelines(); i++ ) {
+    PF::Pipeline* pipeline = get_pipeline( i );
+    if( !pipeline ) continue;
+    for( li = hot_layers.begin(); li != hot_layers.end(); li++ ) {
+      PF::PipelineNode* node = pipeline->get_node( (*li)->get_id() );
+      if( !node || !node->processor || !node->processor->get_par() ) continue;
+      if( !node->processor->get_par()->import_hot_settings( (*li)->get_processor()->get_par() ) )
+        return false;
+    }
+    for( li = switched_layers.begin(); li != switched_layers.end(); li++ ) {
+      PF::PipelineNode* node = pipeline->get_node( (*li)->get_id() );
+      PF::BlenderPar* bpar = dynamic_cast<PF::BlenderPar*>( node->blender->get_par() );
+      PF::OpParBase* blender = (*li)->get_blender() ? (*li)->get_blender()->get_par() : NULL;
+      if( blender && blender->is_modified() &&
+          !bpar->import_hot_settings( blender ) )
+        return false;
+      bpar->hot_write_lock();
+      bpar->set_enabled( (*li)->is_visible() );
+      bpar->hot_write_unlock();
+    }
+  }
+
+#ifndef NDEBUG
+  std::cout<<"PF::Image::do_hot_update(): updating "<<hot_layers.size()<<" layer(s) and "
+           <<switched_layers.size()<<" switch(es) without re-building"<<std::endl;
+#endif
+
+  // The cached pixels of the modified layers, and of everything downstream,
+  // are discarded; the sinks then re-compute what they need
+  for( unsigned int i = 0; i < get_npipelines(); i++ ) {
+    PF::Pipeline* pipeline = get_pipeline( i );
+    if( !pipeline ) continue;
+    for( li = hot_layers.begin(); li != hot_layers.end(); li++ ) {
+      PF::PipelineNode* node = pipeline->get_node( (*li)->get_id() );
+      if( !node ) continue;
+      if( node->image ) vips_image_invalidate_all( node->image );
+      for( unsigned int j = 0; j < node->images.size(); j++ )
+        if( node->images[j] ) vips_image_invalidate_all( node->images[j] );
+    }
+    for( li = switched_layers.begin(); li != switched_layers.end(); li++ ) {
+      PF::PipelineNode* node = pipeline->get_node( (*li)->get_id() );
+      if( node && node->blended ) vips_image_invalidate_all( node->blended );
+    }
+  }
+
+  get_layer_manager().rebuild_finalize();
+  clear_modified();
+
+  for( unsigned int i = 0; i < get_npipelines(); i++ ) {
+    PF::Pipeline* pipeline = get_pipeline( i );
+    if( !pipeline ) continue;
+    if( target_pipeline && (pipeline != target_pipeline) ) continue;
+    pipeline->invalidate();
+  }
+
+  return true;
+}
+
+
 void PF::Image::do_update( PF::Pipeline* target_pipeline )
 {
   //std::cout<<"PF::Image::do_update(): is_modified()="<<is_modified()<<std::endl;
@@ -201,6 +305,9 @@ void PF::Image::do_update( PF::Pipeline* target_pipeline )
 #ifndef NDEBUG
   std::cout<<std::endl<<"============================================"<<std::endl;
 #endif
+  if( do_hot_update( target_pipeline ) )
+    return;
+
   //std::cout<<"PF::Image::do_update(): is_modified()="<<is_modified()<<std::endl;
   bool result = get_layer_manager().rebuild_prepare();
   /*
@@ -276,152 +383,140 @@ void PF::Image::sample( int layer_id, int x, int y, int size,
 {
 	int left = (int)x-size/2;
 	int top = (int)y-size/2;
-	int width = size;
-	int height = size;
-	VipsRect area = {left, top, width, height};
+	VipsRect area = {left, top, size, size};
+  std::vector<VipsRect> areas( 1, area );
+  std::vector<SampleStats> stats;
+
+  values.clear();
+  if( sample( layer_id, areas, stats, true ) && !stats.empty() )
+    values = stats[0].mean;
+  if(image)
+    *image = sampler_image;
+}
 
-  if( PF::PhotoFlow::Instance().is_batch() ) {
-    do_sample( layer_id, area );
-  } else {
-    ProcessRequestInfo request;
-    request.image = this;
-		request.layer_id = layer_id;
-    request.request = PF::IMAGE_SAMPLE;
-		request.area.left = area.left;
-		request.area.top = area.top;
-		request.area.width = area.width;
-		request.area.height = area.height;
-    
-    g_mutex_lock( sample_mutex );
-    //#ifndef NDEBUG
-    std::cout<<"PF::Image::sample(): submitting sample request..."<<std::endl;
-    //#endif
-    PF::ImageProcessor::Instance().submit_request( request );
-    //#ifndef NDEBUG
-    std::cout<<"PF::Image::sample(): request submitted."<<std::endl;
-    //#endif
-    
-    g_cond_wait( sample_done, sample_mutex );
-    g_mutex_unlock( sample_mutex );
 
-		if(image)
-			*image = sampler_image;
-    values.clear();
-		values = sampler_values;
+bool PF::Image::sample( int layer_id, const std::vector<VipsRect>& areas,
+                        std::vector<SampleStats>& stats, bool exact )
+{
+  if( PF::PhotoFlow::Instance().is_batch() )
+    return do_sample( layer_id, areas, stats, exact );
+
+  ProcessRequestInfo request;
+  request.image = this;
+  request.layer_id = layer_id;
+  request.request = PF::IMAGE_SAMPLE;
+
+  g_mutex_lock( sample_mutex );
+  sampler_layer_id = layer_id;
+  sampler_exact = exact;
+  sampler_areas = areas;
+  sampler_stats.clear();
+  PF::ImageProcessor::Instance().submit_request( request );
+  g_cond_wait( sample_done, sample_mutex );
+  stats = sampler_stats;
+  g_mutex_unlock( sample_mutex );
+
+  return( stats.size() == areas.size() );
+}
+
+
+void PF::Image::do_sample()
+{
+  do_sample( sampler_layer_id, sampler_areas, sampler_stats, sampler_exact );
+}
+
+
+bool PF::Image::prefetch()
+{
+  for( unsigned int i = 0; i < pipelines.size(); i++ ) {
+    if( pipelines[i] && pipelines[i]->prefetch() ) return true;
   }
+  return false;
+}
 
-  /*
-  if( is_async() )
-    update_async();
-  else
-    update_sync();
-  */
+
+bool PF::Image::compute_layer_stats( int layer_id, unsigned int pipeline_id, ImageStats& stats )
+{
+  PF::Pipeline* pipeline = get_pipeline( pipeline_id );
+  if( !pipeline ) {
+    std::cout<<"Image::compute_layer_stats(): NULL pipeline"<<std::endl;
+    return false;
+  }
+
+  PF::PipelineNode* node = pipeline->get_node( layer_id );
+  if( !node || !(node->image) ) {
+    std::cout<<"Image::compute_layer_stats(): NULL pipeline node"<<std::endl;
+    return false;
+  }
+
+  // For cached layers, the node image is read from the corresponding
+  // level of the cache pyramid, therefore no re-computation is involved
+  return stats.compute( node->image );
 }
 
 
-void PF::Image::do_sample( int layer_id, VipsRect& area )
+bool PF::Image::do_sample( int layer_id, const std::vector<VipsRect>& areas,
+                           std::vector<SampleStats>& stats, bool exact )
 {
-  // Get the default pipeline of the image 
-  // (it is supposed to be at 1:1 zoom level 
-  // and floating point accuracy)
+  stats.clear();
+  sampler_image = NULL;
+
+  // The default pipeline of the image is at 1:1 zoom level and
+  // floating point accuracy. For cached layers, the node image is
+  // read from the cache buffer, therefore no re-computation is involved.
   PF::Pipeline* pipeline = get_pipeline( 0 );
   if( !pipeline ) {
     std::cout<<"Image::do_sample(): NULL pipeline"<<std::endl;
-    return;
+    return false;
   }
-
-  // Get the node associated to the layer
   PF::PipelineNode* node = pipeline->get_node( layer_id );
-  if( !node ) {
+  if( !node || !(node->image) ) {
     std::cout<<"Image::do_sample(): NULL pipeline node"<<std::endl;
-    return;
-  }
-
-  // Finally, get the underlying VIPS image associated to the layer
-  VipsImage* image = node->image;
-  if( !image ) {
-    std::cout<<"Image::do_sample(): NULL image"<<std::endl;
-    return;
+    return false;
   }
+  sampler_image = node->image;
 
-	// Now we have to process a small portion of the image 
-	// to get the corresponding Lab values
-	VipsImage* spot;
-	VipsRect all = {0 ,0, image->Xsize, image->Ysize};
-	VipsRect clipped;
-	vips_rect_intersectrect( &area, &all, &clipped );
-  
-  /*
-	if( vips_crop( image, &spot, 
-								 clipped.left, clipped.top, 
-								 clipped.width+1, clipped.height+1, 
-								 NULL ) ) {
-    std::cout<<"Image::do_sample(): vips_crop() failed"<<std::endl;
-		return;
-  }
-	VipsRect rspot = {0 ,0, spot->Xsize, spot->Ysize};
-  */
-  spot = image;
-
-	VipsRect rspot = {clipped.left, clipped.top, clipped.width, clipped.height};
-
-	//VipsImage* outimg = im_open( "spot_wb_img", "p" );
-	//if (vips_sink_screen (spot, outimg, NULL,
-	//											64, 64, 1, 
-  //												0, NULL, this))
-	//	return;
-  
-  PF::ProcessorBase* convert_format = new PF::Processor<PF::ConvertFormatPar,PF::ConvertFormatProc>();
-  std::vector<VipsImage*> in;
-  in.push_back( spot );
-  convert_format->get_par()->set_image_hints( spot );
-  convert_format->get_par()->set_format( VIPS_FORMAT_FLOAT );
+  // Approximate values can be read from the coarsest pipeline in which
+  // all the areas are still at least PF_SAMPLE_MIN_SIZE pixels wide.
+  // Such pipelines are normally used for the preview, and their tiles
+  // are likely to be already computed.
   unsigned int level = 0;
-  VipsImage* outimg = convert_format->get_par()->build( in, 0, NULL, NULL, level );
-  if( outimg == NULL ) {
-    std::cout<<"Image::do_sample(): NULL image after convert_format"<<std::endl;
-    return;
+  if( !exact ) {
+    int min_size = 0;
+    for( unsigned int ai = 0; ai < areas.size(); ai++ ) {
+      int size = MIN( areas[ai].width, areas[ai].height );
+      if( ai == 0 || size < min_size ) min_size = size;
+    }
+    for( unsigned int pi = 1; pi < get_npipelines(); pi++ ) {
+      PF::Pipeline* p = get_pipeline( pi );
+      if( !p || p->get_level() <= level ) continue;
+      if( (min_size >> p->get_level()) < PF_SAMPLE_MIN_SIZE ) continue;
+      PF::PipelineNode* n = p->get_node( layer_id );
+      if( !n || !(n->image) ) continue;
+      pipeline = p;
+      node = n;
+      level = p->get_level();
+    }
   }
-  //PF_UNREF( spot, "Image::do_sample() spot unref" )
-	//if( vips_sink_memory( spot ) )
-	//  return;
-
-  //PF_PRINT_REF( outimg, "Image::do_sample(): outimg refcount before vips_region_new()" )
-	VipsRegion* region = vips_region_new( outimg );
-	if (vips_region_prepare (region, &rspot)) {
-    std::cout<<"Image::do_sample(): vips_region_prepare() failed"<<std::endl;
-		return;
+
+  VipsRegion* region = vips_region_new( node->image );
+  stats.resize( areas.size() );
+  for( unsigned int ai = 0; ai < areas.size(); ai++ ) {
+    VipsRect area = areas[ai];
+    if( level > 0 ) {
+      area.left >>= level; area.top >>= level;
+      area.width >>= level; area.height >>= level;
+    }
+    if( !stats[ai].compute( region, area ) ) {
+      std::cout<<"Image::do_sample(): area #"<<ai<<" cannot be sampled"<<std::endl;
+    }
+#ifndef NDEBUG
+    std::cout<<"Image::do_sample(): area #"<<ai<<" ("<<area.width<<"x"<<area.height
+             <<"+"<<area.left<<"+"<<area.top<<") sampled at level "<<level<<std::endl;
+#endif
   }
-  //PF_PRINT_REF( outimg, "Image::do_sample(): outimg refcount after vips_region_new()" )
-
-	int row, col, b;
-	int line_size = clipped.width*image->Bands;
-	float* p;
-	float avg[16];
-  for( int i = 0; i < 16; i++ ) avg[i] = 0;
-	for( row = 0; row < clipped.height; row++ ) {
-		p = (float*)VIPS_REGION_ADDR( region, rspot.left, rspot.top+row );
-    std::cout<<"do_sample(): rspot.left="<<rspot.left<<"  rspot.top+row="<<rspot.top+row<<std::endl;
-		for( col = 0; col < line_size; col += image->Bands ) {
-			for( b = 0; b < image->Bands; b++ ) {
-				avg[b] += p[col+b];
-        std::cout<<"do_sample(): p["<<row<<"]["<<col+b<<"]="<<p[col+b]<<std::endl;
-			}
-		}
-	}
-
-	sampler_values.clear();
-	for( b = 0; b < image->Bands; b++ ) {
-		avg[b] /= clipped.width*clipped.height;
-		sampler_values.push_back( avg[b] );
-	}
-	sampler_image = image;
-
-	//g_object_unref( spot );
-  //PF_PRINT_REF( outimg, "Image::do_sample(): outimg refcount before region unref" );
-	PF_UNREF( region, "Image::do_sample(): region unref" );
-  //PF_PRINT_REF( outimg, "Image::do_sample(): outimg refcount after region unref" );
-  PF_UNREF( outimg, "Image::do_sample(): outimg unref" );
+  PF_UNREF( region, "Image::do_sample(): region unref" );
+  return true;
 }
 
 
@@ -613,8 +708,23 @@ bool PF::Image::save( std::string filename )
 
 
 
-void PF::Image::export_merged( std::string filename )
+bool PF::Image::export_merged( std::string filename )
 {
+  // The layers that need the whole image at once are refused in out-of-core mode,
+  // and exporting the image without them would silently drop the corresponding edits
+  if( PF::PhotoFlow::Instance().is_out_of_core() ) {
+    std::list<PF::Layer*> whole_image_layers;
+    layer_manager.get_whole_image_layers( whole_image_layers );
+    if( !whole_image_layers.empty() ) {
+      std::cerr<<"ERROR: the image cannot be exported in out-of-core mode, because"<<std::endl
+               <<"       the following layers need the whole image at once:"<<std::endl;
+      std::list<PF::Layer*>::iterator li;
+      for( li = whole_image_layers.begin(); li != whole_image_layers.end(); ++li )
+        std::cerr<<"       \""<<(*li)->get_name()<<"\""<<std::endl;
+      return false;
+    }
+  }
+
   if( PF::PhotoFlow::Instance().is_batch() ) {
     do_export_merged( filename );
   } else {
@@ -642,6 +752,7 @@ void PF::Image::export_merged( std::string filename )
 
     g_mutex_unlock( export_mutex );
   }
+  return true;
 }
 
 
@@ -678,7 +789,15 @@ void PF::Image::do_export_merged( std::string filename )
     std::string msg = std::string("PF::Image::export_merged(") + filename + "), image";
     PF_UNREF( image, msg.c_str() );
     */
-    VipsImage* srgbimg = image;
+    // The statistics of the exported image are accumulated while
+    // the image is written to disk
+    export_stats.reset();
+    PF::StatsTapPar* tappar = dynamic_cast<PF::StatsTapPar*>( stats_tap->get_par() );
+    if( tappar ) tappar->set_stats( &export_stats );
+    in.clear(); in.push_back( image );
+    stats_tap->get_par()->set_image_hints( image );
+    stats_tap->get_par()->set_format( pipeline->get_format() );
+    VipsImage* srgbimg = stats_tap->get_par()->build( in, 0, NULL, NULL, level );
 
 		outimg = srgbimg;
     std::string msg;
@@ -689,8 +808,8 @@ void PF::Image::do_export_merged( std::string filename )
       convert_format->get_par()->set_format( VIPS_FORMAT_UCHAR );
       outimg = convert_format->get_par()->build( in, 0, NULL, NULL, level );
       //g_object_unref( srgbimg );
-      // msg = std::string("PF::Image::export_merged(") + filename + "), srgbimg";
-      //PF_UNREF( srgbimg, msg.c_str() );
+      msg = std::string("PF::Image::export_merged(") + filename + "), srgbimg";
+      PF_UNREF( srgbimg, msg.c_str() );
     vips_image_write_to_file( outimg, filename.c_str(), NULL );
 		}
     
@@ -701,8 +820,8 @@ void PF::Image::do_export_merged( std::string filename )
       convert_format->get_par()->set_format( VIPS_FORMAT_USHORT );
       outimg = convert_format->get_par()->build( in, 0, NULL, NULL, level );
       //g_object_unref( srgbimg );
-      //msg = std::string("PF::Image::export_merged(") + filename + "), srgbimg";
-      //PF_UNREF( srgbimg, msg.c_str() );
+      msg = std::string("PF::Image::export_merged(") + filename + "), srgbimg";
+      PF_UNREF( srgbimg, msg.c_str() );
     int predictor = 2;
     vips_tiffsave( outimg, filename.c_str(), "compression", VIPS_FOREIGN_TIFF_COMPRESSION_DEFLATE,
         "predictor", VIPS_FOREIGN_TIFF_PREDICTOR_HORIZONTAL, NULL );
@@ -714,7 +833,9 @@ void PF::Image::do_export_merged( std::string filename )
     PF_UNREF( outimg, msg.c_str() );
     remove_pipeline( pipeline );
     delete pipeline;
-    layer_manager.reset_cache_buffers( PF_RENDER_NORMAL, true );
+    // The NORMAL cache buffers are kept, so that the next export can start
+    // from the cached layers whose input and parameters have not changed
+    // in the meantime (see LayerManager::update_dirty())
     std::cout<<"Image saved to file "<<filename<<std::endl;
   }
 }
@@ -36,9 +36,13 @@
 
 #include "layermanager.hh"
 #include "pipeline.hh"
+#include "image_stats.hh"
 
 #define PREVIEW_PIPELINE_ID 1
 
+// Minimum size, in pixels, of the areas sampled from reduced-size pipelines
+#define PF_SAMPLE_MIN_SIZE 3
+
 
 
 namespace PF
@@ -80,13 +84,22 @@ namespace PF
 
     ProcessorBase* convert2srgb;
     ProcessorBase* convert_format;
+    ProcessorBase* stats_tap;
+
+    // Statistics of the last exported image
+    ImageStats export_stats;
 
     void remove_from_inputs( PF::Layer* layer );
     void remove_from_inputs( PF::Layer* layer, std::list<Layer*>& list );
     void remove_layer( PF::Layer* layer, std::list<Layer*>& list );
 
 		VipsImage* sampler_image;
-		std::vector<float> sampler_values;
+
+    // Parameters and results of the pending sampling request
+    int sampler_layer_id;
+    bool sampler_exact;
+    std::vector<VipsRect> sampler_areas;
+    std::vector<SampleStats> sampler_stats;
 
     void update_async();
 
@@ -122,6 +135,11 @@ namespace PF
 
     unsigned int get_npipelines() { return pipelines.size(); }
 
+    // Lowest level of the preview pipelines that are displayed, or 0 if none
+    // is displayed. The operations that process the whole image at once are
+    // run at this level in preview mode.
+    unsigned int get_preview_level();
+
     Pipeline* get_pipeline(unsigned int n) 
     {
       if( n >= pipelines.size() ) return NULL;
@@ -158,17 +176,44 @@ namespace PF
     void update_all() { update( NULL ); }
     void do_update( PF::Pipeline* pipeline=NULL );
 
+    // Publish changes that only involve hot properties to the existing
+    // pipelines, without re-building them. Returns false if a full
+    // re-build is needed.
+    bool do_hot_update( PF::Pipeline* pipeline=NULL );
+
+    // Use the idle time of the image processor to compute pixels that are
+    // likely to be displayed soon. Returns false when there is nothing left to do.
+    bool prefetch();
+
 
 		void sample( int layer_id, int x, int y, int size, 
 								 VipsImage** image, std::vector<float>& values );
-		void do_sample( int layer_id, VipsRect& area); 
+
+    // Compute the statistics of several areas of the output of a given layer,
+    // in a single request to the image processor. The areas are expressed in the
+    // coordinates of the full-resolution image, and the results are returned in
+    // the same order. If exact is false, the values can be read from a
+    // lower-resolution pipeline, as long as the areas remain large enough.
+    bool sample( int layer_id, const std::vector<VipsRect>& areas,
+                 std::vector<SampleStats>& stats, bool exact=true );
+    bool do_sample( int layer_id, const std::vector<VipsRect>& areas,
+                    std::vector<SampleStats>& stats, bool exact );
+    // Process the pending sampling request; called by the image processor
+    void do_sample();
 
     bool open( std::string filename );
 
 		std::string get_filename() { return file_name; }
     bool save( std::string filename );
-    void export_merged( std::string filename );
+    // Returns false if the image cannot be exported
+    bool export_merged( std::string filename );
     void do_export_merged( std::string filename );
+
+    ImageStats& get_export_stats() { return export_stats; }
+
+    // Compute the statistics of the output of a given layer in a given pipeline.
+    // The computation is performed at the resolution of the pipeline.
+    bool compute_layer_stats( int layer_id, unsigned int pipeline_id, ImageStats& stats );
   };
 
   gint image_rebuild_callback( gpointer data );
@@ -0,0 +1,422 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#include <float.h>
+
+#include "color.hh"
+#include "image_stats.hh"
+
+
+#define PF_STATS_TILE_SIZE 128
+
+
+void PF::ImageStatsTile::init( int nbands )
+{
+  npixels = 0;
+  min.assign( nbands, FLT_MAX );
+  max.assign( nbands, -FLT_MAX );
+  sum.assign( nbands, 0 );
+  clipped_low.assign( nbands, 0 );
+  clipped_high.assign( nbands, 0 );
+  histogram.assign( nbands*PF_STATS_NBINS, 0 );
+}
+
+
+void PF::ImageStatsTile::add( const ImageStatsTile& tile )
+{
+  npixels += tile.npixels;
+  for( unsigned int b = 0; b < min.size() && b < tile.min.size(); b++ ) {
+    if( tile.min[b] < min[b] ) min[b] = tile.min[b];
+    if( tile.max[b] > max[b] ) max[b] = tile.max[b];
+    sum[b] += tile.sum[b];
+    clipped_low[b] += tile.clipped_low[b];
+    clipped_high[b] += tile.clipped_high[b];
+  }
+  for( unsigned int i = 0; i < histogram.size() && i < tile.histogram.size(); i++ )
+    histogram[i] += tile.histogram[i];
+}
+
+
+template<class T>
+static void accumulate( VipsRegion* reg, const VipsRect& area, PF::ImageStatsTile& tile )
+{
+  int nbands = reg->im->Bands;
+  int line_size = area.width*nbands;
+  float val;
+  for( int y = 0; y < area.height; y++ ) {
+    T* p = (T*)VIPS_REGION_ADDR( reg, area.left, area.top+y );
+    for( int x = 0; x < line_size; x += nbands ) {
+      for( int b = 0; b < nbands; b++ ) {
+        PF::to_float( p[x+b], val );
+        if( val < tile.min[b] ) tile.min[b] = val;
+        if( val > tile.max[b] ) tile.max[b] = val;
+        tile.sum[b] += val;
+        int bin;
+        if( !(val > 0) ) {
+          tile.clipped_low[b] += 1;
+          bin = 0;
+        } else if( val >= 1 ) {
+          tile.clipped_high[b] += 1;
+          bin = PF_STATS_NBINS-1;
+        } else {
+          bin = (int)(val*PF_STATS_NBINS);
+        }
+        tile.histogram[b*PF_STATS_NBINS+bin] += 1;
+      }
+    }
+  }
+  tile.npixels += area.width*area.height;
+}
+
+
+template<class T>
+static void collect( VipsRegion* reg, const VipsRect& area, std::vector< std::vector<float> >& values )
+{
+  int nbands = reg->im->Bands;
+  int line_size = area.width*nbands;
+  float val;
+  for( int y = 0; y < area.height; y++ ) {
+    T* p = (T*)VIPS_REGION_ADDR( reg, area.left, area.top+y );
+    for( int x = 0; x < line_size; x += nbands ) {
+      for( int b = 0; b < nbands; b++ ) {
+        PF::to_float( p[x+b], val );
+        values[b].push_back( val );
+      }
+    }
+  }
+}
+
+
+bool PF::SampleStats::compute( VipsRegion* reg, const VipsRect& a )
+{
+  npixels = 0;
+  min.clear(); max.clear(); mean.clear(); median.clear();
+  if( !reg || !reg->im ) return false;
+
+  VipsRect all = { 0, 0, reg->im->Xsize, reg->im->Ysize };
+  vips_rect_intersectrect( (VipsRect*)&a, &all, &area );
+  if( vips_rect_isempty( &area ) ) return false;
+  if( vips_region_prepare( reg, &area ) ) return false;
+
+  int nbands = reg->im->Bands;
+  std::vector< std::vector<float> > values( nbands );
+  for( int b = 0; b < nbands; b++ )
+    values[b].reserve( area.width*area.height );
+  switch( reg->im->BandFmt ) {
+  case VIPS_FORMAT_UCHAR:
+    collect<unsigned char>( reg, area, values );
+    break;
+  case VIPS_FORMAT_USHORT:
+    collect<unsigned short int>( reg, area, values );
+    break;
+  case VIPS_FORMAT_FLOAT:
+    collect<float>( reg, area, values );
+    break;
+  case VIPS_FORMAT_DOUBLE:
+    collect<double>( reg, area, values );
+    break;
+  default:
+    return false;
+  }
+
+  npixels = area.width*area.height;
+  for( int b = 0; b < nbands; b++ ) {
+    std::vector<float>& v = values[b];
+    double sum = 0;
+    float vmin = FLT_MAX, vmax = -FLT_MAX;
+    for( unsigned int i = 0; i < v.size(); i++ ) {
+      sum += v[i];
+      if( v[i] < vmin ) vmin = v[i];
+      if( v[i] > vmax ) vmax = v[i];
+    }
+    min.push_back( vmin );
+    max.push_back( vmax );
+    mean.push_back( sum/npixels );
+    std::nth_element( v.begin(), v.begin()+v.size()/2, v.end() );
+    median.push_back( v[v.size()/2] );
+  }
+  return true;
+}
+
+
+PF::ImageStats::ImageStats():
+  nbands( 0 ), total_dirty( false ), serial( 0 )
+{
+  mutex = vips_g_mutex_new();
+  total.init( 0 );
+}
+
+
+PF::ImageStats::~ImageStats()
+{
+  vips_g_mutex_free( mutex );
+}
+
+
+void PF::ImageStats::reset()
+{
+  g_mutex_lock( mutex );
+  tiles.clear();
+  nbands = 0;
+  total.init( 0 );
+  total_dirty = false;
+  serial += 1;
+  g_mutex_unlock( mutex );
+}
+
+
+void PF::ImageStats::invalidate( const VipsRect& area )
+{
+  g_mutex_lock( mutex );
+  std::map<TileKey, ImageStatsTile>::iterator i = tiles.begin();
+  while( i != tiles.end() ) {
+    VipsRect r = { i->first.left, i->first.top, i->first.width, i->first.height };
+    if( vips_rect_overlapsrect( &r, (VipsRect*)&area ) ) {
+      tiles.erase( i++ );
+      total_dirty = true;
+    } else {
+      ++i;
+    }
+  }
+  if( total_dirty ) serial += 1;
+  g_mutex_unlock( mutex );
+}
+
+
+void PF::ImageStats::update( VipsRegion* reg, const VipsRect& area )
+{
+  if( !reg || !reg->im ) return;
+
+  // The area is extended to the cells of the statistics grid, so that each
+  // cell is always replaced as a whole and no pixel is lost or counted twice
+  VipsRect image_area = { 0, 0, reg->im->Xsize, reg->im->Ysize };
+  VipsRect r;
+  vips_rect_intersectrect( &image_area, (VipsRect*)&area, &r );
+  if( vips_rect_isempty( &r ) ) return;
+  int left = (r.left/PF_STATS_TILE_SIZE)*PF_STATS_TILE_SIZE;
+  int top = (r.top/PF_STATS_TILE_SIZE)*PF_STATS_TILE_SIZE;
+  int right = ((VIPS_RECT_RIGHT(&r)+PF_STATS_TILE_SIZE-1)/PF_STATS_TILE_SIZE)*PF_STATS_TILE_SIZE;
+  int bottom = ((VIPS_RECT_BOTTOM(&r)+PF_STATS_TILE_SIZE-1)/PF_STATS_TILE_SIZE)*PF_STATS_TILE_SIZE;
+  VipsRect grid_area = { left, top, right-left, bottom-top };
+  vips_rect_intersectrect( &image_area, &grid_area, &grid_area );
+  if( !vips_rect_includesrect( &(reg->valid), &grid_area ) &&
+      vips_region_prepare( reg, &grid_area ) )
+    return;
+
+  // The statistics are computed outside of the lock, so that
+  // several threads can process their tiles in parallel
+  std::vector<TileKey> keys;
+  std::vector<ImageStatsTile> cells;
+  for( int y = grid_area.top; y < VIPS_RECT_BOTTOM(&grid_area); y += PF_STATS_TILE_SIZE ) {
+    for( int x = grid_area.left; x < VIPS_RECT_RIGHT(&grid_area); x += PF_STATS_TILE_SIZE ) {
+      VipsRect cell = { x, y, PF_STATS_TILE_SIZE, PF_STATS_TILE_SIZE };
+      vips_rect_intersectrect( &grid_area, &cell, &cell );
+      ImageStatsTile tile;
+      tile.init( reg->im->Bands );
+      switch( reg->im->BandFmt ) {
+      case VIPS_FORMAT_UCHAR:
+        accumulate<unsigned char>( reg, cell, tile );
+        break;
+      case VIPS_FORMAT_USHORT:
+        accumulate<unsigned short int>( reg, cell, tile );
+        break;
+      case VIPS_FORMAT_FLOAT:
+        accumulate<float>( reg, cell, tile );
+        break;
+      case VIPS_FORMAT_DOUBLE:
+        accumulate<double>( reg, cell, tile );
+        break;
+      default:
+        return;
+      }
+      TileKey key = { cell.left, cell.top, cell.width, cell.height };
+      keys.push_back( key );
+      cells.push_back( tile );
+    }
+  }
+
+  g_mutex_lock( mutex );
+  if( nbands != reg->im->Bands ) {
+    tiles.clear();
+    nbands = reg->im->Bands;
+  }
+  for( unsigned int i = 0; i < keys.size(); i++ )
+    tiles[keys[i]] = cells[i];
+  total_dirty = true;
+  serial += 1;
+  g_mutex_unlock( mutex );
+}
+
+
+bool PF::ImageStats::compute( VipsImage* image )
+{
+  if( !image ) return false;
+
+  reset();
+
+  VipsRegion* reg = vips_region_new( image );
+  VipsRect image_area = { 0, 0, image->Xsize, image->Ysize };
+  bool result = true;
+  for( int y = 0; y < image->Ysize; y += PF_STATS_TILE_SIZE ) {
+    for( int x = 0; x < image->Xsize; x += PF_STATS_TILE_SIZE ) {
+      VipsRect tile_area = { x, y, PF_STATS_TILE_SIZE, PF_STATS_TILE_SIZE };
+      vips_rect_intersectrect( &image_area, &tile_area, &tile_area );
+      if( vips_region_prepare( reg, &tile_area ) ) {
+        std::cout<<"ImageStats::compute(): vips_region_prepare() failed"<<std::endl;
+        result = false;
+        break;
+      }
+      update( reg, tile_area );
+    }
+    if( !result ) break;
+  }
+  VIPS_UNREF( reg );
+
+  return result;
+}
+
+
+void PF::ImageStats::update_total()
+{
+  if( !total_dirty ) return;
+  total.init( nbands );
+  std::map<TileKey, ImageStatsTile>::iterator i;
+  for( i = tiles.begin(); i != tiles.end(); i++ )
+    total.add( i->second );
+  total_dirty = false;
+}
+
+
+unsigned int PF::ImageStats::get_serial()
+{
+  g_mutex_lock( mutex );
+  unsigned int result = serial;
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+int PF::ImageStats::get_nbands()
+{
+  g_mutex_lock( mutex );
+  int result = nbands;
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+long int PF::ImageStats::get_npixels()
+{
+  g_mutex_lock( mutex );
+  update_total();
+  long int result = total.npixels;
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+float PF::ImageStats::get_min( int band )
+{
+  float result = 0;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands && total.npixels > 0 ) result = total.min[band];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+float PF::ImageStats::get_max( int band )
+{
+  float result = 0;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands && total.npixels > 0 ) result = total.max[band];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+float PF::ImageStats::get_mean( int band )
+{
+  float result = 0;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands && total.npixels > 0 ) result = total.sum[band]/total.npixels;
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+long int PF::ImageStats::get_clipped_low( int band )
+{
+  long int result = 0;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands ) result = total.clipped_low[band];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+long int PF::ImageStats::get_clipped_high( int band )
+{
+  long int result = 0;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands ) result = total.clipped_high[band];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+bool PF::ImageStats::get_histogram( int band, std::vector<long int>& hist )
+{
+  bool result = false;
+  g_mutex_lock( mutex );
+  update_total();
+  if( band >= 0 && band < nbands ) {
+    hist.assign( total.histogram.begin()+band*PF_STATS_NBINS,
+                 total.histogram.begin()+(band+1)*PF_STATS_NBINS );
+    result = true;
+  }
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+void PF::ImageStats::print( std::ostream& str )
+{
+  int nb = get_nbands();
+  str<<"Image statistics: "<<get_npixels()<<" pixels, "<<nb<<" channels"<<std::endl;
+  for( int b = 0; b < nb; b++ ) {
+    str<<"  channel "<<b<<": min="<<get_min(b)<<"  max="<<get_max(b)<<"  mean="<<get_mean(b)
+       <<"  clipped low="<<get_clipped_low(b)<<"  clipped high="<<get_clipped_high(b)<<std::endl;
+  }
+}
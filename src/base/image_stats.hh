@@ -0,0 +1,149 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef PF_IMAGE_STATS_H
+#define PF_IMAGE_STATS_H
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include <vips/vips.h>
+
+
+// Number of histogram bins per channel; pixel values are normalized to [0,1]
+#define PF_STATS_NBINS 256
+
+
+namespace PF
+{
+
+  // Statistics of a rectangular image area
+  struct ImageStatsTile
+  {
+    long int npixels;
+    std::vector<float> min, max;
+    std::vector<double> sum;
+    std::vector<long int> clipped_low, clipped_high;
+    std::vector<long int> histogram;
+
+    void init( int nbands );
+    void add( const ImageStatsTile& tile );
+  };
+
+
+  // Statistics of a small image area, as returned by the image samplers.
+  // Pixel values are normalized to [0,1].
+  struct SampleStats
+  {
+    // sampled area, clipped to the image boundaries
+    VipsRect area;
+    long int npixels;
+    std::vector<float> min, max, mean, median;
+
+    // Compute the statistics of the given area, which is prepared in the region.
+    // Returns false if the area is empty or the region cannot be computed.
+    bool compute( VipsRegion* reg, const VipsRect& area );
+  };
+
+
+  /* Per-channel histograms, min/max/mean values and clipped pixel counts of an image.
+   *
+   * The statistics are accumulated tile-by-tile, as the image areas get computed.
+   * The contribution of each cell of a fixed grid is stored separately, so that
+   * re-computed cells replace the old values instead of being counted twice,
+   * and cells that are invalidated can be dropped without re-scanning the whole image.
+   * All methods are thread-safe.
+   */
+  class ImageStats
+  {
+    struct TileKey
+    {
+      int left, top, width, height;
+      bool operator<( const TileKey& k ) const
+      {
+        if( top != k.top ) return( top < k.top );
+        if( left != k.left ) return( left < k.left );
+        if( height != k.height ) return( height < k.height );
+        return( width < k.width );
+      }
+    };
+
+    GMutex* mutex;
+
+    int nbands;
+    std::map<TileKey, ImageStatsTile> tiles;
+
+    ImageStatsTile total;
+    bool total_dirty;
+
+    // Incremented each time the statistics change
+    unsigned int serial;
+
+    void update_total();
+
+    ImageStats( const ImageStats& );
+    ImageStats& operator=( const ImageStats& );
+
+  public:
+    ImageStats();
+    ~ImageStats();
+
+    // Remove all the accumulated data
+    void reset();
+
+    // Drop the contribution of the grid cells that intersect the given area
+    void invalidate( const VipsRect& area );
+
+    // Accumulate the statistics of the grid cells that intersect the given area.
+    // The region is prepared over the cells if it does not already cover them.
+    void update( VipsRegion* reg, const VipsRect& area );
+
+    // Compute the statistics of the whole image, tile-by-tile.
+    // Meant to be used with the reduced-size pyramid levels.
+    bool compute( VipsImage* image );
+
+    unsigned int get_serial();
+    int get_nbands();
+    long int get_npixels();
+    float get_min( int band );
+    float get_max( int band );
+    float get_mean( int band );
+    long int get_clipped_low( int band );
+    long int get_clipped_high( int band );
+    bool get_histogram( int band, std::vector<long int>& hist );
+
+    void print( std::ostream& str );
+  };
+
+}
+
+
+#endif
@@ -31,6 +31,7 @@
 #include <string.h>
 
 #include "imageprocessor.hh"
+#include "memory_manager.hh"
 
 
 static gpointer run_image_processor( gpointer data )
@@ -151,6 +152,11 @@ void PF::ImageProcessor::run()
           caching_completed = true;
           g_cond_signal( caching_completed_cond );
           g_mutex_unlock( caching_completed_mutex );
+
+          // Compute in advance the pixels that are likely to be displayed next,
+          // one small step at a time so that new requests are not delayed
+          if( image->prefetch() )
+            continue;
         }
       }
       /*
@@ -213,8 +219,7 @@ void PF::ImageProcessor::run()
         //std::cout<<"PF::ImageProcessor::run(): locking image..."<<std::endl;
         request.image->sample_lock();
         //std::cout<<"PF::ImageProcessor::run(IMAGE_SAMPLE): image locked."<<std::endl;
-        if( (request.area.width!=0) && (request.area.height!=0) )
-          request.image->do_sample( request.layer_id, request.area );
+        request.image->do_sample();
         request.image->sample_unlock();
         request.image->sample_done_signal();
         //std::cout<<"PF::ImageProcessor::run(IMAGE_SAMPLE): sampling done."<<std::endl;
@@ -269,6 +274,10 @@ void PF::ImageProcessor::run()
         break;
       }
     }
+
+    // Apply the memory eviction policies between two batches of requests,
+    // when none of the pipelines is being modified
+    PF::MemoryManager::Instance().enforce_budget();
   }
 }
 
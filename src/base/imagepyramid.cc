@@ -37,25 +37,87 @@
 #include "photoflow.hh"
 #include "imagepyramid.hh"
 #include "exif_data.hh"
+#include "half_float.hh"
+#include "disk_tile_cache.hh"
+#include "scratch_arena.hh"
+
+// Number of rows of a pyramid level computed by each prefetch() call
+#define PF_PYRAMID_PREFETCH_ROWS 64
+
 
 VipsImage* PF::pyramid_test_image = NULL;
 GObject* PF::pyramid_test_obj = NULL;
 
 
+// All the existing pyramids, for prefetch_all()
+static std::list<PF::ImagePyramid*> pyramids;
+static GMutex* pyramids_mutex = NULL;
+
+static GMutex* get_pyramids_mutex()
+{
+  static gsize initialized = 0;
+  if( g_once_init_enter( &initialized ) ) {
+    pyramids_mutex = vips_g_mutex_new();
+    g_once_init_leave( &initialized, 1 );
+  }
+  return pyramids_mutex;
+}
+
+
+PF::ImagePyramid::ImagePyramid()
+{
+  PF::MemoryManager::Instance().add_client( this, PF_MEM_PRIORITY_PYRAMID );
+  g_mutex_lock( get_pyramids_mutex() );
+  pyramids.push_back( this );
+  g_mutex_unlock( get_pyramids_mutex() );
+}
+
 
 PF::ImagePyramid::~ImagePyramid()
+{
+  g_mutex_lock( get_pyramids_mutex() );
+  pyramids.remove( this );
+  g_mutex_unlock( get_pyramids_mutex() );
+  PF::MemoryManager::Instance().remove_client( this );
+  release_levels( 1 );
+}
+
+
+void PF::ImagePyramid::release_levels( unsigned int first )
 {
   char tstr[500];
-  for( unsigned int i = 1; i < levels.size(); i++ ) {
-    //g_object_unref( levels[i].image );
-    snprintf(tstr, 499, "PF::ImagePyramid::~ImagePyramid() levels[%d].image",i);
+  // A level being computed in advance is derived from the released ones
+  if( first < levels.size() || first <= 1 )
+    drop_pending_level();
+  for( unsigned int i = first; i < levels.size(); i++ ) {
+    PF::MemoryManager::Instance().released( PF_MEM_PYRAMID, levels[i].memory_size );
+    snprintf(tstr, 499, "PF::ImagePyramid::release_levels() levels[%d].image",i);
     PF_UNREF( levels[i].image, tstr );
-    //if( i < 1 ) continue;
     if( levels[i].fd >= 0 ) 
       close( levels[i].fd );
     unlink( levels[i].raw_file_name.c_str() );
-    //std::cout<<"PF::ImagePyramid::~ImagePyramid(): "<<levels[i].raw_file_name<<" removed."<<std::endl;
   }
+  if( first < levels.size() )
+    levels.erase( levels.begin()+first, levels.end() );
+}
+
+
+size_t PF::ImagePyramid::release_memory( size_t amount )
+{
+  // Levels are computed one from the other, therefore only the
+  // smallest ones can be dropped, up to the first level still in use
+  size_t released = 0;
+  unsigned int first = levels.size();
+  while( first > 1 && released < amount ) {
+    VipsImage* img = levels[first-1].image;
+    if( G_OBJECT(img)->ref_count > 1 ) break;
+    // on-demand levels only take disk space
+    if( levels[first-1].on_demand ) break;
+    released += levels[first-1].memory_size;
+    first -= 1;
+  }
+  release_levels( first );
+  return released;
 }
 
 
@@ -76,15 +138,7 @@ void PF::ImagePyramid::init( VipsImage* img, int fd )
     }
   }
 
-  char tstr[500];
-  for( unsigned int i = 1; i < levels.size(); i++ ) {
-    //g_object_unref( levels[i].image );
-    snprintf(tstr, 499, "PF::ImagePyramid::init() levels[%d].image",i);
-    PF_UNREF( levels[i].image, tstr );
-    if( levels[i].fd >= 0 ) 
-      close( levels[i].fd );
-    unlink( levels[i].raw_file_name.c_str() );
-  }
+  release_levels( 1 );
   levels.clear();
 
   PF::PyramidLevel level;
@@ -104,20 +158,7 @@ void PF::ImagePyramid::reset()
   if( levels.size() < 1 ) 
     return;
 
-  PF::PyramidLevel level = levels[0];
-
-  char tstr[500];
-  for( unsigned int i = 1; i < levels.size(); i++ ) {
-    //g_object_unref( levels[i].image );
-    snprintf(tstr, 499, "PF::ImagePyramid::reset() levels[%d].image",i);
-    PF_UNREF( levels[i].image, tstr );
-    if( levels[i].fd >= 0 ) 
-      close( levels[i].fd );
-    unlink( levels[i].raw_file_name.c_str() );
-  }
-  levels.clear();
-
-  levels.push_back( level );
+  release_levels( 1 );
 }
 
 
@@ -129,6 +170,16 @@ void PF::ImagePyramid::update( const VipsRect& area )
   if( levels.empty() ) 
     return;
 
+  // A level being computed in advance would miss the update
+  drop_pending_level();
+
+  // The on-demand levels are derived from the full-scale image through the vips
+  // pipeline; invalidating the latter drops the stored tiles of all the levels
+  if( (levels.size() > 1) && levels[1].on_demand ) {
+    vips_image_invalidate_all( levels[0].image );
+    return;
+  }
+
   if( levels[0].fd < 0 ) return;
 
   VipsImage* in = levels.back().image;
@@ -151,6 +202,13 @@ void PF::ImagePyramid::update( const VipsRect& area )
     if( levels[li].fd < 0 ) break;
     if( !levels[li].image ) break;
 
+    // Half-precision levels cannot be updated by copying the raw pixel data;
+    // they are dropped instead, and re-computed when needed
+    if( levels[li].half_float || levels[li-1].half_float ) {
+      release_levels( li );
+      break;
+    }
+
 #ifndef NDEBUG
 		std::cout<<"PF::ImagePyramid::update(): processing level #"<<li<<std::endl;
 #endif
@@ -197,10 +255,10 @@ void PF::ImagePyramid::update( const VipsRect& area )
 
     unsigned int x, x2, y, in_linesz = area_in.width*pelsz, out_linesz = area_out.width*pelsz;
 
-    unsigned char* buf_in = new unsigned char[in_linesz];
-    if( !buf_in ) break;
-    unsigned char* buf_out = new unsigned char[out_linesz];
-    if( !buf_out ) { delete( buf_in ); break; }
+    ScratchBuffer<unsigned char> buf_in( in_linesz );
+    if( !buf_in.get() ) break;
+    ScratchBuffer<unsigned char> buf_out( out_linesz );
+    if( !buf_out.get() ) break;
 
     for( y = area_out.top; y <= out_bottom; y++ ) {
 
@@ -223,13 +281,258 @@ void PF::ImagePyramid::update( const VipsRect& area )
     area_in.top = area_out.top;
     area_in.width = area_out.width;
     area_in.height = area_out.height;
-
-    delete( buf_in );
-    delete( buf_out );
   }  
 }
 
 
+// Blur and down-scale an image by a factor of two
+VipsImage* PF::ImagePyramid::reduce( VipsImage* in )
+{
+  VipsImage* blurred;
+  if( vips_gaussblur( in, &blurred, 0.7, NULL ) )
+    return NULL;
+  VipsImage* out;
+  if( vips_subsample( blurred, &out, 2, 2, NULL ) ) {
+    PF_UNREF( blurred, "ImagePyramid::reduce(): blurred unref" );
+    return NULL;
+  }
+  PF_UNREF( blurred, "ImagePyramid::reduce(): blurred unref" );
+#ifndef NDEBUG
+  std::cout<<"ImagePyramid::reduce() subsample in="<<in<<"  out="<<out<<std::endl;
+#endif
+  return out;
+}
+
+
+bool PF::ImagePyramid::start_level()
+{
+  VipsImage* img = levels[0].image;
+  VipsImage* in = levels.back().image;
+
+  // The reduced-size levels are only used for previewing, and can therefore
+  // be stored at reduced precision
+  bool half_float = PF::PhotoFlow::Instance().get_preview_cache_half() &&
+      (img->BandFmt == VIPS_FORMAT_FLOAT) && (img->Coding == VIPS_CODING_NONE);
+
+  VipsImage* out = reduce( in );
+  if( !out )
+    return false;
+
+  if( half_float ) {
+    VipsImage* encoded = PF::half_float_encode( out );
+    PF_UNREF( out, "ImagePyramid::start_level(): out unref" );
+    if( !encoded )
+      return false;
+    out = encoded;
+  }
+
+  char fname[500];
+  sprintf( fname,"%spfraw-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
+  int fd = pf_mkstemp( fname );
+  if( fd < 0 ) {
+    PF_UNREF( out, "ImagePyramid::start_level(): out unref" );
+    return false;
+  }
+  std::cout<<"ImagePyramid: cache file: "<<fname<<std::endl;
+
+  pending.image = out;
+  pending.region = NULL;
+  pending.fd = fd;
+  pending.raw_file_name = fname;
+  pending.row = 0;
+  pending.half_float = half_float;
+  return true;
+}
+
+
+int PF::ImagePyramid::save_level_rows( int nrows )
+{
+  VipsImage* out = pending.image;
+  if( !out )
+    return -1;
+
+  if( !pending.region && !(pending.region = vips_region_new( out )) ) {
+    drop_pending_level();
+    return -1;
+  }
+
+  VipsRect area = { 0, pending.row, out->Xsize, MIN( nrows, out->Ysize - pending.row ) };
+  if( vips_region_prepare( pending.region, &area ) ) {
+    std::cout<<"ImagePyramid::save_level_rows(): vips_region_prepare() failed"<<std::endl;
+    drop_pending_level();
+    return -1;
+  }
+  size_t linesz = VIPS_IMAGE_SIZEOF_LINE( out );
+  for( int y = area.top; y < VIPS_RECT_BOTTOM( &area ); y++ ) {
+    if( write( pending.fd, VIPS_REGION_ADDR( pending.region, 0, y ), linesz ) != (ssize_t)linesz ) {
+      std::cout<<"ImagePyramid::save_level_rows(): cannot write cache file"<<std::endl;
+      drop_pending_level();
+      return -1;
+    }
+  }
+  pending.row = VIPS_RECT_BOTTOM( &area );
+  return( (pending.row >= out->Ysize) ? 1 : 0 );
+}
+
+
+bool PF::ImagePyramid::save_level()
+{
+  VipsImage* out = pending.image;
+  if( !out )
+    return false;
+  if( pending.row >= out->Ysize )
+    return true;
+
+  // The rows that were not computed in advance are saved in one go,
+  // using the vips worker threads
+  std::cout<<"ImagePyramid: saving cache file..."<<std::endl;
+  VipsImage* rest;
+  if( pending.row > 0 ) {
+    if( vips_extract_area( out, &rest, 0, pending.row, out->Xsize, out->Ysize - pending.row, NULL ) ) {
+      drop_pending_level();
+      return false;
+    }
+  } else {
+    rest = out;
+    PF_REF( rest, "ImagePyramid::save_level(): rest ref" );
+  }
+  int result = vips_rawsave_fd( rest, pending.fd, NULL );
+  PF_UNREF( rest, "ImagePyramid::save_level(): rest unref" );
+  if( result ) {
+    drop_pending_level();
+    return false;
+  }
+  pending.row = out->Ysize;
+  std::cout<<"ImagePyramid: cache file saved."<<std::endl;
+  return true;
+}
+
+
+bool PF::ImagePyramid::finish_level()
+{
+  char tstr[500];
+  VipsImage* img = levels[0].image;
+
+  void *profile_data;
+  size_t profile_length;
+  if( vips_image_get_blob( img, VIPS_META_ICC_NAME, 
+			   &profile_data, &profile_length ) )
+    profile_data = NULL;
+  
+  size_t blobsz;
+  void* image_data;
+  if( vips_image_get_blob( img, "raw_image_data",
+			   &image_data, 
+			   &blobsz ) )
+    image_data = NULL;
+
+  size_t exifsz;
+  void* exif_data;
+  if( vips_image_get_blob( img, PF_META_EXIF_NAME,
+      &exif_data,&exifsz ) ) {
+    std::cout<<"ImagePyramid::finish_level(): exif_custom_data not found in img("<<img<<")"<<std::endl;
+    exif_data = NULL;
+  }
+
+  bool half_float = pending.half_float;
+  int width = pending.image->Xsize;
+  int height = pending.image->Ysize;
+  size_t pelsz = VIPS_IMAGE_SIZEOF_PEL( pending.image );
+  std::string fname = pending.raw_file_name;
+  int fd = pending.fd;
+
+  // The file descriptor and the disk buffer are now owned by the new level
+  VIPS_UNREF( pending.region );
+  snprintf(tstr,499,"PF::ImagePyramid::finish_level() level #%d (after rawsave)",(int)levels.size());
+  PF_UNREF( pending.image, tstr );
+  pending = PendingLevel();
+
+  VipsImage* in;
+  VipsImage* out;
+  if( vips_rawload( fname.c_str(), &in, width, height, pelsz, NULL ) ) {
+    close( fd );
+    unlink( fname.c_str() );
+    return false;
+  }
+  std::cout<<"ImagePyramid: cache file loaded."<<std::endl;
+  //unlink( fname );
+  vips_copy( in, &out,
+	     "format", half_float ? VIPS_FORMAT_USHORT : img->BandFmt,
+	     "bands", img->Bands,
+	     "coding", img->Coding,
+	     "interpretation", img->Type,
+	     NULL );
+#ifndef NDEBUG
+  std::cout<<"ImagePyramid::finish_level() raw load in="<<in<<"  out="<<out<<std::endl;
+#endif
+  snprintf(tstr,499,"PF::ImagePyramid::finish_level() level #%d (after vips_copy)",(int)levels.size());
+  PF_UNREF( in, tstr );
+
+  if( half_float ) {
+    VipsImage* decoded = PF::half_float_decode( out );
+    PF_UNREF( out, "ImagePyramid::finish_level(): raw image unref" );
+    if( !decoded ) {
+      close( fd );
+      unlink( fname.c_str() );
+      return false;
+    }
+    out = decoded;
+  }
+
+  if( profile_data ) {
+    void* profile_data2 = malloc( profile_length );
+    if( profile_data2 ) {
+      memcpy( profile_data2, profile_data, profile_length );
+      vips_image_set_blob( out, VIPS_META_ICC_NAME,
+          (VipsCallbackFn) g_free,
+          profile_data2, profile_length );
+    }
+  }
+
+  if( image_data ) {
+    void* image_data2 = malloc( blobsz );
+    if( image_data2 ) {
+      memcpy( image_data2, image_data, blobsz );
+      vips_image_set_blob( out, "raw_image_data",
+          (VipsCallbackFn) g_free,
+          image_data2, blobsz );
+    }
+  }
+
+  if( exif_data ) {
+    void* exif_data2 = malloc( exifsz );
+    if( exif_data2 ) {
+      memcpy( exif_data2, exif_data, exifsz );
+      vips_image_set_blob( out, PF_META_EXIF_NAME,
+          (VipsCallbackFn) PF::exif_free,
+          exif_data2, exifsz );
+    }
+  }
+
+  PF::PyramidLevel newlevel;
+  newlevel.image = out;
+  newlevel.fd = fd;
+  newlevel.raw_file_name = fname;
+  newlevel.memory_size = pelsz*width*height;
+  newlevel.half_float = half_float;
+  levels.push_back( newlevel );
+  PF::MemoryManager::Instance().allocated( PF_MEM_PYRAMID, newlevel.memory_size );
+  return true;
+}
+
+
+void PF::ImagePyramid::drop_pending_level()
+{
+  if( !pending.image ) return;
+  VIPS_UNREF( pending.region );
+  PF_UNREF( pending.image, "ImagePyramid::drop_pending_level(): image unref" );
+  if( pending.fd >= 0 )
+    close( pending.fd );
+  unlink( pending.raw_file_name.c_str() );
+  pending = PendingLevel();
+}
+
+
 PF::PyramidLevel* PF::ImagePyramid::get_level( unsigned int& level )
 {  
   char tstr[500];
@@ -244,16 +547,6 @@ PF::PyramidLevel* PF::ImagePyramid::get_level( unsigned int& level )
   
   VipsImage* img = levels[0].image;
 
-  size_t exifsz;
-  void* exif_data;
-  if( !vips_image_get_blob( img, PF_META_EXIF_NAME,
-      &exif_data,&exifsz ) ) {
-    //std::cout<<"ImagePyramid::get_level(): exif_custom_data found in img("<<img<<")"<<std::endl;
-  } else {
-    std::cout<<"ImagePyramid::get_level(): exif_custom_data not found in img("<<img<<")"<<std::endl;
-    exif_data = NULL;
-  }
-
   if( level < levels.size() ) {
     // We add a reference to the returned pyramid level, since it must be kept alive until
     // the pyramid is re-built, in which case it will be unreff'd by the pyramid itself
@@ -269,119 +562,42 @@ PF::PyramidLevel* PF::ImagePyramid::get_level( unsigned int& level )
     return( &(levels[level]) );
   }
   
-  PF::PyramidLevel newlevel;
-  void *profile_data;
-  size_t profile_length;
-  
-  if( vips_image_get_blob( img, VIPS_META_ICC_NAME, 
-			   &profile_data, &profile_length ) )
-    profile_data = NULL;
-  
-  size_t blobsz;
-  void* image_data;
-  if( vips_image_get_blob( img, "raw_image_data",
-			   &image_data, 
-			   &blobsz ) )
-    image_data = NULL;
-
-
-  VipsImage* in = levels.back().image;
-  if( !in )
-    return NULL;
-
-  int width = in->Xsize;
-  int height = in->Ysize;
-  int size = (width>height) ? width : height;
-  int nbands = in->Bands;
-
-  while( size > 256 ) {
-    VipsImage* blurred;
-    if( vips_gaussblur( in, &blurred, 0.7, NULL ) )
-      return NULL;
-    VipsImage* out;
-    if( vips_subsample( blurred, &out, 2, 2, NULL ) )
+  while( true ) {
+    VipsImage* in = levels.back().image;
+    if( !in )
       return NULL;
-    PF_UNREF( blurred, "ImagePyramid::get_level(): blurred unref" );
-#ifndef NDEBUG
-    std::cout<<"ImagePyramid::get_level("<<level<<") subsample in="<<in<<"  out="<<out<<std::endl;
-#endif
-    //g_object_unref( in );
-    width = out->Xsize;
-    height = out->Ysize;
-    size = (width>height) ? width : height;
-
-    char fname[500];
-    sprintf( fname,"%spfraw-XXXXXX", PF::PhotoFlow::Instance().get_cache_dir().c_str() );
-    int fd = pf_mkstemp( fname );
-    if( fd < 0 )
-      return NULL;
-    std::cout<<"ImagePyramid: cache file: "<<fname<<std::endl;
-
-    std::cout<<"ImagePyramid: saving cache file..."<<std::endl;
-    vips_rawsave_fd( out, fd, NULL );
-    std::cout<<"ImagePyramid: cache file saved."<<std::endl;
-    //char tifname[500];
-    //sprintf(tifname,"/tmp/level_%d-1.tif",(int)levels.size());
-    //vips_image_write_to_file( out, tifname );
-    //g_object_unref( out );
-    snprintf(tstr,499,"PF::ImagePyramid::get_level(%d) level #%d (after rawsave)",level, (int)levels.size());
-    PF_UNREF( out, tstr );
-
-    vips_rawload( fname, &in, width, height, VIPS_IMAGE_SIZEOF_PEL( img ), NULL );
-    std::cout<<"ImagePyramid: cache file loaded."<<std::endl;
-    //unlink( fname );
-    vips_copy( in, &out,
-	       "format", img->BandFmt,
-	       "bands", img->Bands,
-	       "coding", img->Coding,
-	       "interpretation", img->Type,
-	       NULL );
-#ifndef NDEBUG
-    std::cout<<"ImagePyramid::get_level("<<level<<") raw load in="<<in<<"  out="<<out<<std::endl;
-#endif
-    //sprintf(tifname,"/tmp/level_%d-2.tif",(int)levels.size());
-    //vips_image_write_to_file( out, tifname );
-    //g_object_unref( in );
-    snprintf(tstr,499,"PF::ImagePyramid::get_level(%d) level #%d (after vips_copy)",level, (int)levels.size());
-    PF_UNREF( in, tstr );
-
-    if( profile_data ) {
-      void* profile_data2 = malloc( profile_length );
-      if( profile_data2 ) {
-        memcpy( profile_data2, profile_data, profile_length );
-        vips_image_set_blob( out, VIPS_META_ICC_NAME,
-            (VipsCallbackFn) g_free,
-            profile_data2, profile_length );
-      }
-    }
-
-    if( image_data ) {
-      void* image_data2 = malloc( blobsz );
-      if( image_data2 ) {
-        memcpy( image_data2, image_data, blobsz );
-        vips_image_set_blob( out, "raw_image_data",
-            (VipsCallbackFn) g_free,
-            image_data2, blobsz );
-      }
-    }
+    int size = (in->Xsize > in->Ysize) ? in->Xsize : in->Ysize;
+    if( size <= 256 )
+      break;
 
-    if( exif_data ) {
-      void* exif_data2 = malloc( exifsz );
-      if( exif_data2 ) {
-        memcpy( exif_data2, exif_data, exifsz );
-        vips_image_set_blob( out, PF_META_EXIF_NAME,
-            (VipsCallbackFn) PF::exif_free,
-            exif_data2, exifsz );
-      }
+    if( PF::PhotoFlow::Instance().is_out_of_core() ) {
+      // The level is not computed in advance, and the tiles are stored on disk
+      // when first requested. The image metadata is propagated by the vips pipeline.
+      bool half_float = PF::PhotoFlow::Instance().get_preview_cache_half() &&
+          (img->BandFmt == VIPS_FORMAT_FLOAT) && (img->Coding == VIPS_CODING_NONE);
+      VipsImage* out = reduce( in );
+      if( !out )
+        return NULL;
+      VipsImage* cached = PF::disk_tile_cache( out, half_float );
+      PF_UNREF( out, "ImagePyramid::get_level(): out unref" );
+      if( !cached )
+        return NULL;
+      PF::PyramidLevel odlevel;
+      odlevel.image = cached;
+      odlevel.half_float = half_float;
+      odlevel.on_demand = true;
+      levels.push_back( odlevel );
+    } else {
+      // The level might have been partially computed in advance by prefetch(),
+      // in which case only the remaining rows are saved
+      if( !pending.image && !start_level() )
+        return NULL;
+      if( !save_level() )
+        return NULL;
+      if( !finish_level() )
+        return NULL;
     }
 
-    newlevel.image = out;
-    newlevel.fd = fd;
-    newlevel.raw_file_name = fname;
-    levels.push_back( newlevel );
-
-    in = out;
-
     // If the desired level is reached, we stop
     if( levels.size() == (level+1) )
       break;
@@ -404,3 +620,56 @@ PF::PyramidLevel* PF::ImagePyramid::get_level( unsigned int& level )
   PF_REF( levels[level].image, tstr );
   return( &(levels[level]) );
 }
+
+
+bool PF::ImagePyramid::prefetch( unsigned int level )
+{
+  if( levels.empty() || level < levels.size() )
+    return false;
+
+  if( PF::PhotoFlow::Instance().is_out_of_core() ) {
+    // The on-demand levels are only computed when their tiles are requested,
+    // so creating them is cheap
+    unsigned int nlevels = levels.size();
+    unsigned int l = level;
+    PF::PyramidLevel* plevel = get_level( l );
+    if( !plevel )
+      return false;
+    // get_level() adds a reference for the caller, which we do not need
+    PF_UNREF( plevel->image, "ImagePyramid::prefetch() level unref" );
+    return( levels.size() > nlevels );
+  }
+
+  // The next missing level is computed one strip of rows at a time,
+  // so that the processing thread is never blocked for long
+  if( !pending.image ) {
+    VipsImage* in = levels.back().image;
+    if( !in || ((in->Xsize > in->Ysize) ? in->Xsize : in->Ysize) <= 256 )
+      return false;
+    if( !start_level() )
+      return false;
+  }
+  int result = save_level_rows( PF_PYRAMID_PREFETCH_ROWS );
+  if( result < 0 )
+    return false;
+  if( result > 0 && !finish_level() )
+    return false;
+  return true;
+}
+
+
+bool PF::ImagePyramid::prefetch_all( unsigned int level )
+{
+  // The pyramids cannot be destroyed while the lock is held
+  bool result = false;
+  g_mutex_lock( get_pyramids_mutex() );
+  std::list<PF::ImagePyramid*>::iterator i;
+  for( i = pyramids.begin(); i != pyramids.end(); i++ ) {
+    if( (*i)->prefetch( level ) ) {
+      result = true;
+      break;
+    }
+  }
+  g_mutex_unlock( get_pyramids_mutex() );
+  return result;
+}
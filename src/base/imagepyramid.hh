@@ -36,9 +36,12 @@
 
 
 #include <vector>
+#include <list>
 #include <string>
 #include <vips/vips.h>
 
+#include "memory_manager.hh"
+
 
 namespace PF
 {
@@ -51,18 +54,65 @@ namespace PF
     std::string raw_file_name;
     int fd;
     VipsImage* image;
+    // size of the data stored in the disk buffer
+    size_t memory_size;
+    // the disk buffer holds half values, which are converted to floats when read
+    bool half_float;
+    // the level is computed tile-by-tile on demand, and stored in a sparse disk cache
+    bool on_demand;
+
+    PyramidLevel(): fd( -1 ), image( NULL ), memory_size( 0 ), half_float( false ), on_demand( false ) {}
+  };
+
+
+  // Reduced-size level being saved to its disk buffer
+  struct PendingLevel
+  {
+    // image to be saved, encoded to half values if needed
+    VipsImage* image;
+    VipsRegion* region;
+    int fd;
+    std::string raw_file_name;
+    // number of rows already saved
+    int row;
+    bool half_float;
+
+    PendingLevel(): image( NULL ), region( NULL ), fd( -1 ), row( 0 ), half_float( false ) {}
   };
 
 
-  class ImagePyramid
+  class ImagePyramid: public MemoryClient
   {
     std::vector<PyramidLevel> levels;
 
+    // Level following the last one in "levels", possibly partially computed by prefetch()
+    PendingLevel pending;
+
+    // Unreference the levels starting from "first", and remove the associated disk buffers
+    void release_levels( unsigned int first );
+
+    static VipsImage* reduce( VipsImage* in );
+
+    // Set up the computation of the level following the last available one
+    bool start_level();
+    // Save the next "nrows" rows of the pending level to disk. Returns 1 when the
+    // level is complete, 0 if there are rows left, and -1 on error.
+    int save_level_rows( int nrows );
+    // Save all the remaining rows of the pending level
+    bool save_level();
+    // Load the saved pending level back and append it to the available ones
+    bool finish_level();
+    void drop_pending_level();
+
   public:
-    ImagePyramid() {}
+    ImagePyramid();
 
     ~ImagePyramid();
 
+    // Drop the reduced-size levels that are not used by any pipeline;
+    // they will be re-computed when needed
+    size_t release_memory( size_t amount );
+
     void init( VipsImage* image, int fd = -1 );
 
     void reset();
@@ -70,6 +120,14 @@ namespace PF
     void update( const VipsRect& area );
 
     PyramidLevel* get_level( unsigned int& level );
+
+    // Compute a strip of the given level in advance, without referencing it.
+    // Returns true if some work was done, false if the level is already available.
+    bool prefetch( unsigned int level );
+
+    // Compute a strip of the given level of the first pyramid where it is missing.
+    // Returns true if some work was done.
+    static bool prefetch_all( unsigned int level );
   };
 
 }
@@ -45,6 +45,7 @@ PF::Layer::Layer(int32_t i, bool c):
   modified_flag = true;
 
   visible = true;
+  visibility_changed = false;
 
   normal = true;
 
@@ -65,6 +65,8 @@ namespace PF
     bool modified_flag;
 
     bool visible;
+    // Set when the visibility is toggled, until the pipelines are updated
+    bool visibility_changed;
 
     bool normal;
 
@@ -109,8 +111,10 @@ namespace PF
     
 
     bool is_visible() { return visible; }
-    void set_visible( bool d ) { visible = d; }
-    void clear_visible( ) { visible = false; }
+    void set_visible( bool d ) { if( d != visible ) visibility_changed = true; visible = d; }
+    void clear_visible( ) { set_visible( false ); }
+    bool is_visibility_changed() { return visibility_changed; }
+    void clear_visibility_changed() { visibility_changed = false; }
     
     bool is_group() { return( !normal ); }
     bool is_normal() { return normal; }
@@ -122,7 +126,7 @@ namespace PF
       bool changed = (cached != c);
       cached = c;
       if( cached && cache_buffers.empty() ) {
-        cache_buffers.insert( std::make_pair(PF_RENDER_PREVIEW, new CacheBuffer()) );
+        cache_buffers.insert( std::make_pair(PF_RENDER_PREVIEW, new CacheBuffer(true)) );
         cache_buffers.insert( std::make_pair(PF_RENDER_NORMAL, new CacheBuffer()) );
       }
       if( cached && changed )
@@ -138,8 +142,11 @@ namespace PF
     {
       std::map<rendermode_t,CacheBuffer*>::iterator i;
       for(i = cache_buffers.begin(); i != cache_buffers.end(); i++ ) {
+        // The PREVIEW buffers are re-filled in the background by the image processor,
+        // while the NORMAL ones are only written when exporting, and therefore
+        // need to be flagged for re-initialization
         if( i->second )
-          i->second->reset();
+          i->second->reset( i->first == PF_RENDER_NORMAL );
       }
     }
 
@@ -31,6 +31,10 @@
 
 #include "layermanager.hh"
 #include "image.hh"
+#include "photoflow.hh"
+#include "../operations/blender.hh"
+#include "../operations/buffer.hh"
+#include "../operations/untiled_op.hh"
 
 
 PF::LayerManager::LayerManager( PF::Image* img ): image( img )
@@ -473,7 +477,7 @@ void PF::LayerManager::update_dirty( std::list<Layer*>& list, bool& dirty )
     // if the current layer is dirty the dirty flag is set to true
     // this will also qualify as "dirty" all the subsequent layers in the list
     // It probably means that the visibility of the layer has been toggled
-    if( l->is_dirty() )
+    if( l->is_dirty() || l->is_visibility_changed() )
       dirty = true;
 
     // If the operation associated to the current layer has been modified,
@@ -549,6 +553,24 @@ void PF::LayerManager::update_dirty( std::list<Layer*>& list, bool& dirty )
 
 
 
+void PF::LayerManager::get_whole_image_layers( std::list<Layer*>& list, std::list<Layer*>& found )
+{
+  std::list<PF::Layer*>::iterator li;
+  for(li = list.begin(); li != list.end(); ++li) {
+    PF::Layer* l = *li;
+    if( !l->is_visible() ) continue;
+
+    if( l->get_processor() && l->get_processor()->get_par() &&
+        l->get_processor()->get_par()->needs_whole_image() )
+      found.push_back( l );
+
+    get_whole_image_layers( l->imap_layers, found );
+    get_whole_image_layers( l->omap_layers, found );
+    get_whole_image_layers( l->sublayers, found );
+  }
+}
+
+
 void PF::LayerManager::reset_dirty( std::list<Layer*>& list )
 {  
   std::list<PF::Layer*>::iterator li = list.begin();
@@ -563,6 +585,7 @@ void PF::LayerManager::reset_dirty( std::list<Layer*>& list )
       l->get_blender()->get_par()->clear_modified();
 
     l->clear_dirty();
+    l->clear_visibility_changed();
 
     reset_dirty( l->imap_layers );
     reset_dirty( l->omap_layers );
@@ -646,8 +669,28 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
     }
 #endif
 
-    if( !l->is_visible() ) 
+    // Hidden layers are skipped, unless they are already built behind a switch
+    // node: in this case they stay in the pipeline with the switch turned off,
+    // so that they can be shown again without re-building
+    if( !l->is_visible() ) {
+      PF::PipelineNode* hidden_node = pipeline->get_node( l->get_id() );
+      PF::BlenderPar* hidden_switch = NULL;
+      if( hidden_node && hidden_node->blended && hidden_node->blender )
+        hidden_switch = dynamic_cast<PF::BlenderPar*>( hidden_node->blender->get_par() );
+      if( !hidden_switch || !hidden_switch->is_switch() )
+        continue;
+    }
+
+    // In out-of-core mode the operations that need the whole image at once
+    // cannot be run tile-by-tile, and are refused. The export of an image that
+    // contains such layers fails (see Image::export_merged()), and the editor
+    // hides them when they are created; here they are left out of the preview.
+    if( PF::PhotoFlow::Instance().is_out_of_core() && l->get_processor() &&
+        l->get_processor()->get_par() && l->get_processor()->get_par()->needs_whole_image() ) {
+      std::cerr<<"ERROR: layer \""<<name<<"\" needs the whole image at once,"<<std::endl
+               <<"       and cannot be processed in out-of-core mode"<<std::endl;
       continue;
+    }
 
 #ifndef NDEBUG
     std::cout<<"PF::LayerManager::rebuild_chain(): rebuilding layer \""<<name<<"\""<<std::endl;
@@ -698,6 +741,8 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
 
     pipelinepar->set_render_mode( pipeline->get_render_mode() );
     //std::cout<<"pipelinepar->set_render_mode( "<<pipeline->get_render_mode()<<" );"<<std::endl;
+    PF::UntiledOperationPar* untiledpar = dynamic_cast<PF::UntiledOperationPar*>( pipelinepar );
+    if( untiledpar && image ) untiledpar->set_preview_level( image->get_preview_level() );
 
     if( par ) {
 #ifndef NDEBUG
@@ -740,6 +785,8 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
     g_assert( pipelineblender != NULL );
 
     pipelineblender->set_render_mode( pipeline->get_render_mode() );
+    PF::BlenderPar* pipelineswitch = dynamic_cast<PF::BlenderPar*>( pipelineblender );
+    if( pipelineswitch ) pipelineswitch->set_enabled( l->is_visible() );
 
     if( blender ) {
 #ifndef NDEBUG
@@ -766,6 +813,15 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
       blender->set_image_hints( previous );
     }
     
+    // Cached data computed for a different pixel format cannot be re-used,
+    // and the buffer is flagged for re-initialization
+    PF::CacheBuffer* cbuf = l->is_cached() ? l->get_cache_buffer(pipeline->get_render_mode()) : NULL;
+    if( cbuf && cbuf->is_completed() && cbuf->get_cached_image() &&
+        cbuf->get_cached_image()->BandFmt != pipeline->get_format() ) {
+      std::cout<<"Layer \""<<l->get_name()<<"\": cache buffer format mismatch, resetting"<<std::endl;
+      cbuf->reset( true );
+    }
+
     if( l->is_cached() &&
         (l->get_cache_buffer(pipeline->get_render_mode()) != NULL) &&
         l->get_cache_buffer(pipeline->get_render_mode())->is_completed() ) {
@@ -832,7 +888,32 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
     std::vector<VipsImage*> newimgvec;
     VipsImage* imap = NULL;
     VipsImage* omap = NULL;
-    if( l->sublayers.empty() ) {
+
+    // A memoized group whose contents and input did not change keeps the output
+    // built previously, together with the tiles already stored in its memo.
+    // Changes above the group therefore do not cause its contents to be re-computed.
+    // The input is unchanged only if the layers below were not re-built, that is
+    // if the group receives the same image as the last time.
+    PF::BufferPar* bufpar = dynamic_cast<PF::BufferPar*>( par );
+    bool memo_valid = !l->sublayers.empty() && bufpar && bufpar->is_memoized() &&
+        !l->is_dirty() && node && node->image && (node->input == previous) &&
+        (node->image->Xsize == (previous ? previous->Xsize : width)) &&
+        (node->image->Ysize == (previous ? previous->Ysize : height)) &&
+        (node->image->BandFmt == pipeline->get_format());
+
+    if( memo_valid ) {
+#ifndef NDEBUG
+      std::cout<<"rebuild_chain(): re-using the memoized output of group \""<<l->get_name()<<"\""<<std::endl;
+#endif
+      if( previous && !l->omap_layers.empty() ) {
+        omap = rebuild_chain( pipeline, PF_COLORSPACE_GRAYSCALE, 
+                              previous->Xsize, previous->Ysize, 
+                              l->omap_layers, NULL );
+      }
+      newimg = node->image;
+      PF_REF( newimg, "rebuild_chain(): memoized group output ref" );
+      newimgvec.push_back( newimg );
+    } else if( l->sublayers.empty() ) {
       std::vector<VipsImage*> in;
       if( par->needs_input() && !previous ) {
         // Here we have a problem: the operation we are trying to insert in the chain requires
@@ -1126,6 +1207,7 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
       std::cout<<"rebuild_chain(): Layer \""<<l->get_name()<<"\"  blended: 0x"<<blendedimg<<std::endl;
 #endif
       pipeline->set_blended( blendedimg, l->get_id() );
+      if( node ) node->input = previous;
       out = blendedimg;
       //previous = newimg;
       previous_layer = l;
@@ -1136,6 +1218,71 @@ VipsImage* PF::LayerManager::rebuild_chain( PF::Pipeline* pipeline, colorspace_t
 }
 
 
+bool PF::LayerManager::collect_hot_layers( std::list<Layer*>& list, std::list<Layer*>& hot_layers,
+    std::list<Layer*>& switched_layers, bool& modified )
+{
+  std::list<PF::Layer*>::iterator li;
+  for(li = list.begin(); li != list.end(); ++li) {
+    PF::Layer* l = *li;
+
+    // Dirty layers have been added, removed or re-connected
+    if( l->is_dirty() ) return false;
+
+    if( !collect_hot_layers( l->imap_layers, hot_layers, switched_layers, modified ) ) return false;
+    if( !collect_hot_layers( l->omap_layers, hot_layers, switched_layers, modified ) ) return false;
+    if( !collect_hot_layers( l->sublayers, hot_layers, switched_layers, modified ) ) return false;
+
+    // Cached layers and memoized groups downstream of a modified one would
+    // keep the old pixels
+    PF::BufferPar* bufpar = NULL;
+    if( !l->sublayers.empty() && l->get_processor() )
+      bufpar = dynamic_cast<PF::BufferPar*>( l->get_processor()->get_par() );
+    bool memoized = bufpar && bufpar->is_memoized();
+    if( modified && (l->is_cached() || memoized) ) return false;
+
+    // Visibility, blend mode and opacity changes are handled by the switch nodes;
+    // whether the layer is actually built behind a switch in all pipelines is
+    // checked by Image::do_hot_update()
+    bool switched = l->is_visibility_changed();
+    if( l->get_blender() &&
+        l->get_blender()->get_par() &&
+        l->get_blender()->get_par()->is_modified() ) {
+      if( !l->get_blender()->get_par()->has_hot_changes_only() ) return false;
+      switched = true;
+    }
+
+    if( l->get_processor() &&
+        l->get_processor()->get_par() &&
+        l->get_processor()->get_par()->is_modified() ) {
+      if( !l->get_processor()->get_par()->has_hot_changes_only() ) return false;
+      if( l->is_cached() || memoized ) return false;
+      hot_layers.push_back( l );
+      modified = true;
+    }
+
+    if( switched ) {
+      switched_layers.push_back( l );
+      modified = true;
+    }
+  }
+  return true;
+}
+
+
+bool PF::LayerManager::get_hot_layers( std::list<Layer*>& hot_layers, std::list<Layer*>& switched_layers )
+{
+  hot_layers.clear();
+  switched_layers.clear();
+  bool modified = false;
+  if( !collect_hot_layers( layers, hot_layers, switched_layers, modified ) ) {
+    hot_layers.clear();
+    switched_layers.clear();
+    return false;
+  }
+  return modified;
+}
+
+
 bool PF::LayerManager::rebuild_prepare()
 {
 #ifndef NDEBUG
@@ -71,6 +71,11 @@ namespace PF
     void update_dirty( std::list<Layer*>& list, bool& dirty );
 
     void reset_dirty( std::list<Layer*>& list );
+
+    void get_whole_image_layers( std::list<Layer*>& list, std::list<Layer*>& found );
+
+    bool collect_hot_layers( std::list<Layer*>& list, std::list<Layer*>& hot_layers,
+                             std::list<Layer*>& switched_layers, bool& modified );
     
     VipsImage* rebuild_chain(Pipeline* pipeline, colorspace_t cs, 
 														 int width, int height, 
@@ -113,6 +118,16 @@ namespace PF
     PF::CacheBuffer* get_cache_buffer( rendermode_t mode );
     void reset_cache_buffers( rendermode_t mode, bool reinit );
 
+    // Fill found with the visible layers whose operation needs the whole image
+    // at once, and which are therefore refused in out-of-core mode
+    void get_whole_image_layers( std::list<Layer*>& found ) { get_whole_image_layers( layers, found ); }
+
+
+    // Fill hot_layers with the layers whose operation has only hot changes,
+    // see OpParBase::import_hot_settings(), and switched_layers with the ones
+    // whose visibility or blending has changed. Returns false if some other
+    // change requires the pipelines to be re-built.
+    bool get_hot_layers( std::list<Layer*>& hot_layers, std::list<Layer*>& switched_layers );
 
     bool rebuild_prepare();
     bool rebuild(Pipeline* pipeline, colorspace_t cs, int width, int height, VipsRect* area );
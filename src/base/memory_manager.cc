@@ -0,0 +1,282 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "memory_manager.hh"
+
+
+// Minimum size of the vips operation cache when it gets shrunk
+#define PF_MEM_VIPS_CACHE_MIN (16*1024*1024)
+
+// Fallback budget when the amount of physical memory cannot be determined
+#define PF_MEM_DEFAULT_BUDGET ((size_t)2*1024*1024*1024)
+
+
+PF::MemoryManager* PF::MemoryManager::instance = NULL;
+
+
+gpointer PF::MemoryManager::create_instance( gpointer data )
+{
+  return( new PF::MemoryManager() );
+}
+
+
+PF::MemoryManager::MemoryManager():
+  budget( PF_MEM_DEFAULT_BUDGET ), peak( 0 ), vips_cache_max( 0 )
+{
+  mutex = vips_g_mutex_new();
+  clients_mutex = vips_g_mutex_new();
+  for( int i = 0; i < PF_MEM_SUBSYSTEMS_NUM; i++ ) {
+    usage[i] = 0;
+    usage_peak[i] = 0;
+  }
+}
+
+
+PF::MemoryManager& PF::MemoryManager::Instance()
+{
+  // The manager is used from several threads, so the instance
+  // is created exactly once
+  static GOnce instance_once = G_ONCE_INIT;
+  g_once( &instance_once, PF::MemoryManager::create_instance, NULL );
+  PF::MemoryManager::instance = (PF::MemoryManager*)instance_once.retval;
+  return( *instance );
+}
+
+
+size_t PF::MemoryManager::get_default_budget()
+{
+  size_t b = PF_MEM_DEFAULT_BUDGET;
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+  long pages = sysconf( _SC_PHYS_PAGES );
+  long page_size = sysconf( _SC_PAGESIZE );
+  if( pages > 0 && page_size > 0 )
+    b = ((size_t)pages) * page_size / 2;
+#endif
+  return b;
+}
+
+
+void PF::MemoryManager::init( size_t b )
+{
+  if( b == 0 )
+    b = get_default_budget();
+  budget = b;
+
+  // Images decoded by libvips that are larger than 1/8 of the budget
+  // are written to a temporary file instead of being kept in memory
+  if( !g_getenv( "VIPS_DISC_THRESHOLD" ) ) {
+    char str[100];
+    snprintf( str, 99, "%lum", (unsigned long)(budget/8/1024/1024) );
+    g_setenv( "VIPS_DISC_THRESHOLD", str, TRUE );
+  }
+
+  std::cout<<"MemoryManager: budget set to "<<budget/1024/1024<<" MB"<<std::endl;
+}
+
+
+void PF::MemoryManager::allocated( memory_subsystem_t subsystem, size_t bytes )
+{
+  g_mutex_lock( mutex );
+  usage[subsystem] += bytes;
+  if( usage[subsystem] > usage_peak[subsystem] ) usage_peak[subsystem] = usage[subsystem];
+  size_t total = 0;
+  for( int i = 0; i < PF_MEM_SUBSYSTEMS_NUM; i++ )
+    total += usage[i];
+  if( total > peak ) peak = total;
+  g_mutex_unlock( mutex );
+}
+
+
+void PF::MemoryManager::released( memory_subsystem_t subsystem, size_t bytes )
+{
+  g_mutex_lock( mutex );
+  if( bytes > usage[subsystem] ) usage[subsystem] = 0;
+  else usage[subsystem] -= bytes;
+  g_mutex_unlock( mutex );
+}
+
+
+size_t PF::MemoryManager::get_total_usage_locked()
+{
+  // The memory allocated by libvips for regions, buffers and the
+  // operation cache is tracked by libvips itself
+  usage[PF_MEM_VIPS] = vips_tracked_get_mem();
+  if( usage[PF_MEM_VIPS] > usage_peak[PF_MEM_VIPS] ) usage_peak[PF_MEM_VIPS] = usage[PF_MEM_VIPS];
+  size_t total = 0;
+  for( int i = 0; i < PF_MEM_SUBSYSTEMS_NUM; i++ )
+    total += usage[i];
+  if( total > peak ) peak = total;
+  return total;
+}
+
+
+size_t PF::MemoryManager::get_usage( memory_subsystem_t subsystem )
+{
+  g_mutex_lock( mutex );
+  if( subsystem == PF_MEM_VIPS ) usage[PF_MEM_VIPS] = vips_tracked_get_mem();
+  size_t result = usage[subsystem];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+size_t PF::MemoryManager::get_total_usage()
+{
+  g_mutex_lock( mutex );
+  size_t result = get_total_usage_locked();
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+size_t PF::MemoryManager::get_peak_usage()
+{
+  g_mutex_lock( mutex );
+  size_t result = peak;
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+size_t PF::MemoryManager::get_peak_usage( memory_subsystem_t subsystem )
+{
+  g_mutex_lock( mutex );
+  size_t result = usage_peak[subsystem];
+  g_mutex_unlock( mutex );
+  return result;
+}
+
+
+void PF::MemoryManager::add_client( MemoryClient* client, int priority )
+{
+  g_mutex_lock( clients_mutex );
+  ClientInfo info = { client, priority };
+  std::list<ClientInfo>::iterator i = clients.begin();
+  while( i != clients.end() && i->priority <= priority ) ++i;
+  clients.insert( i, info );
+  g_mutex_unlock( clients_mutex );
+}
+
+
+void PF::MemoryManager::remove_client( MemoryClient* client )
+{
+  // Blocks while enforce_budget() is asking the clients to release memory,
+  // so that the client cannot be destroyed while it is being used
+  g_mutex_lock( clients_mutex );
+  std::list<ClientInfo>::iterator i = clients.begin();
+  while( i != clients.end() ) {
+    if( i->client == client ) i = clients.erase( i );
+    else ++i;
+  }
+  g_mutex_unlock( clients_mutex );
+}
+
+
+size_t PF::MemoryManager::release_vips_cache( size_t amount )
+{
+  size_t before = vips_tracked_get_mem();
+  if( vips_cache_max == 0 ) vips_cache_max = vips_cache_get_max_mem();
+  size_t cache_max = vips_cache_get_max_mem();
+  if( cache_max > PF_MEM_VIPS_CACHE_MIN ) {
+    // First try to shrink the cache...
+    vips_cache_set_max_mem( MAX( cache_max/2, (size_t)PF_MEM_VIPS_CACHE_MIN ) );
+  } else {
+    // ... then drop it completely
+    vips_cache_drop_all();
+  }
+  size_t after = vips_tracked_get_mem();
+  return( (after < before) ? before - after : 0 );
+}
+
+
+void PF::MemoryManager::enforce_budget()
+{
+  size_t total = get_total_usage();
+  if( total <= budget ) {
+    // Restore the vips operation cache once there is enough room again
+    if( vips_cache_max > 0 && total < budget/2 &&
+        vips_cache_get_max_mem() < vips_cache_max )
+      vips_cache_set_max_mem( vips_cache_max );
+    return;
+  }
+
+  std::cout<<"MemoryManager: usage "<<total/1024/1024<<" MB exceeds the budget of "
+           <<budget/1024/1024<<" MB"<<std::endl;
+
+  size_t needed = total - budget;
+  size_t freed = release_vips_cache( needed );
+
+  // The list of clients stays locked while they release their memory,
+  // so that none of them can be removed and destroyed in the meantime.
+  // The accounting mutex is not held, since the clients report the
+  // released memory through released().
+  g_mutex_lock( clients_mutex );
+  std::list<ClientInfo>::iterator i;
+  for( i = clients.begin(); i != clients.end() && freed < needed; i++ ) {
+    freed += i->client->release_memory( needed - freed );
+  }
+  g_mutex_unlock( clients_mutex );
+  if( freed < needed ) freed += release_vips_cache( needed - freed );
+
+#ifndef NDEBUG
+  std::cout<<"MemoryManager::enforce_budget(): "<<freed/1024/1024<<" MB released"<<std::endl;
+#endif
+}
+
+
+const char* PF::MemoryManager::get_subsystem_name( memory_subsystem_t subsystem )
+{
+  switch( subsystem ) {
+  case PF_MEM_CACHE_BUFFER: return "cache buffers";
+  case PF_MEM_PYRAMID: return "image pyramids";
+  case PF_MEM_RAW_IMAGE: return "raw images";
+  case PF_MEM_SCRATCH: return "scratch buffers";
+  case PF_MEM_GMIC: return "G'MIC";
+  case PF_MEM_VIPS: return "libvips";
+  default: return "unknown";
+  }
+}
+
+
+void PF::MemoryManager::print( std::ostream& str )
+{
+  str<<"Memory usage: "<<get_total_usage()/1024/1024<<" MB (peak "<<get_peak_usage()/1024/1024
+     <<" MB, budget "<<get_budget()/1024/1024<<" MB)"<<std::endl;
+  for( int i = 0; i < PF_MEM_SUBSYSTEMS_NUM; i++ ) {
+    memory_subsystem_t s = (memory_subsystem_t)i;
+    str<<"  "<<get_subsystem_name( s )<<": "<<get_usage( s )/1024/1024<<" MB (peak "
+       <<get_peak_usage( s )/1024/1024<<" MB)"<<std::endl;
+  }
+}
@@ -0,0 +1,162 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef PF_MEMORY_MANAGER_H
+#define PF_MEMORY_MANAGER_H
+
+#include <stddef.h>
+
+#include <list>
+#include <iostream>
+
+#include <vips/vips.h>
+
+
+namespace PF
+{
+
+  // Subsystems whose memory usage is tracked by the memory manager
+  enum memory_subsystem_t {
+    PF_MEM_CACHE_BUFFER,
+    PF_MEM_PYRAMID,
+    PF_MEM_RAW_IMAGE,
+    PF_MEM_SCRATCH,
+    PF_MEM_GMIC,
+    PF_MEM_VIPS,
+    PF_MEM_SUBSYSTEMS_NUM
+  };
+
+
+  // Priorities of the eviction policies; lower values are applied first
+  enum memory_priority_t {
+    PF_MEM_PRIORITY_VIPS_CACHE = 0,
+    PF_MEM_PRIORITY_SCRATCH = 5,
+    PF_MEM_PRIORITY_PYRAMID = 10,
+    PF_MEM_PRIORITY_CACHE_BUFFER = 20
+  };
+
+
+  /* Objects that hold memory which can be released on request,
+   * and re-created later if needed.
+   */
+  class MemoryClient
+  {
+  public:
+    virtual ~MemoryClient() {}
+
+    // Try to release at least "amount" bytes, and return the amount actually released.
+    // Only called from the image processing thread, with the list of clients locked:
+    // the implementations must not call add_client() or remove_client().
+    virtual size_t release_memory( size_t amount ) = 0;
+  };
+
+
+  /* Central accounting of the memory used by the various subsystems.
+   *
+   * The subsystems report their allocations and deallocations, which can
+   * happen from any thread. When the total usage exceeds the configured budget,
+   * the eviction policies are applied in priority order:
+   *  - the vips operation cache is shrunk, and eventually dropped;
+   *  - the registered clients (for example the unused pyramid levels)
+   *    are asked to release their memory.
+   * The policies are only applied from enforce_budget(), which is called by
+   * the image processing thread between two requests, so that the clients
+   * never get modified while they are being used.
+   * Decoded images larger than a fraction of the budget are spilled to disk
+   * by libvips, see init().
+   */
+  class MemoryManager
+  {
+    struct ClientInfo
+    {
+      MemoryClient* client;
+      int priority;
+    };
+
+    GMutex* mutex;
+    // Protects the list of clients; it is held while the clients release
+    // their memory, so that remove_client() waits until they are done
+    GMutex* clients_mutex;
+
+    size_t budget;
+    size_t usage[PF_MEM_SUBSYSTEMS_NUM];
+    // high-water mark of each subsystem
+    size_t usage_peak[PF_MEM_SUBSYSTEMS_NUM];
+    size_t peak;
+
+    // Initial maximum size of the vips operation cache
+    size_t vips_cache_max;
+
+    std::list<ClientInfo> clients;
+
+    static MemoryManager* instance;
+
+    MemoryManager();
+    static gpointer create_instance( gpointer data );
+
+    size_t get_total_usage_locked();
+    size_t release_vips_cache( size_t amount );
+
+  public:
+    static MemoryManager& Instance();
+
+    // Set the memory budget in bytes. If zero, half of the physical memory is used.
+    // Must be called before vips_init(), so that the disk spill threshold of
+    // libvips can be derived from the budget.
+    void init( size_t budget );
+
+    // Half of the physical memory, or 2GB if it cannot be determined
+    static size_t get_default_budget();
+
+    size_t get_budget() { return budget; }
+
+    void allocated( memory_subsystem_t subsystem, size_t bytes );
+    void released( memory_subsystem_t subsystem, size_t bytes );
+
+    size_t get_usage( memory_subsystem_t subsystem );
+    size_t get_total_usage();
+    size_t get_peak_usage();
+    size_t get_peak_usage( memory_subsystem_t subsystem );
+    bool over_budget() { return( get_total_usage() > budget ); }
+
+    void add_client( MemoryClient* client, int priority );
+    void remove_client( MemoryClient* client );
+
+    // Apply the eviction policies until the total usage fits into the budget
+    void enforce_budget();
+
+    static const char* get_subsystem_name( memory_subsystem_t subsystem );
+
+    void print( std::ostream& str );
+  };
+
+}
+
+
+#endif
@@ -31,6 +31,46 @@
 #include "layer.hh"
 //#include "../vips/vips_layer.h"
 
+
+template<class T>
+static PF::mask_tile_t mask_tile_state( VipsRegion* reg, const VipsRect& area )
+{
+  int line_size = area.width*reg->im->Bands;
+  T* p = (T*)VIPS_REGION_ADDR( reg, area.left, area.top );
+  T first = p[0];
+  float val;
+  PF::to_float( first, val );
+  if( val != 0 && val != 1 ) return PF::PF_MASK_TILE_MIXED;
+
+  for( int y = 0; y < area.height; y++ ) {
+    p = (T*)VIPS_REGION_ADDR( reg, area.left, area.top+y );
+    for( int x = 0; x < line_size; x++ ) {
+      if( p[x] != first ) return PF::PF_MASK_TILE_MIXED;
+    }
+  }
+  return( (val == 0) ? PF::PF_MASK_TILE_EMPTY : PF::PF_MASK_TILE_FULL );
+}
+
+
+PF::mask_tile_t PF::get_mask_tile_state( VipsRegion* reg, const VipsRect& area )
+{
+  if( !reg || !reg->im || area.width <= 0 || area.height <= 0 )
+    return PF_MASK_TILE_MIXED;
+  if( !vips_rect_includesrect( &(reg->valid), (VipsRect*)&area ) )
+    return PF_MASK_TILE_MIXED;
+
+  switch( reg->im->BandFmt ) {
+  case VIPS_FORMAT_UCHAR:
+    return mask_tile_state<unsigned char>( reg, area );
+  case VIPS_FORMAT_USHORT:
+    return mask_tile_state<unsigned short int>( reg, area );
+  case VIPS_FORMAT_FLOAT:
+    return mask_tile_state<float>( reg, area );
+  default:
+    return PF_MASK_TILE_MIXED;
+  }
+}
+
 int
 vips_layer( int n, VipsImage **out, 
             PF::ProcessorBase* proc,
@@ -55,6 +95,8 @@ PF::OpParBase::OpParBase():
   map_flag( false ),
   editing_flag( false ),
   modified_flag(false),
+  hot_readers( 0 ),
+  hot_writer( false ),
   intensity("intensity",this,1),
   grey_target_channel("grey_target_channel",this,-1,"Grey","Grey"),
   rgb_target_channel("rgb_target_channel",this,-1,"RGB","RGB"),
@@ -69,6 +111,9 @@ PF::OpParBase::OpParBase():
   lab_target_channel.set_internal(true);
   cmyk_target_channel.set_internal(true);
   
+  hot_mutex = vips_g_mutex_new();
+  hot_cond = vips_g_cond_new();
+
   processor = NULL;
   //out = NULL;
   config_ui = NULL;
@@ -224,6 +269,102 @@ bool PF::OpParBase::import_settings( OpParBase* pin )
 }
 
 
+bool PF::OpParBase::has_hot_changes_only()
+{
+  if( !is_modified() ) return false;
+
+  bool result = false;
+  std::list<PropertyBase*>::iterator pi;
+  for( pi = properties.begin(); pi != properties.end(); pi++ ) {
+    if( !(*pi)->is_modified() ) continue;
+    if( !(*pi)->is_hot() ) return false;
+    result = true;
+  }
+  for( pi = mapped_properties.begin(); pi != mapped_properties.end(); pi++ ) {
+    if( !(*pi)->is_modified() ) continue;
+    if( !(*pi)->is_hot() ) return false;
+    result = true;
+  }
+  return result;
+}
+
+
+bool PF::OpParBase::import_hot_settings( OpParBase* pin )
+{
+  if( !pin )
+    return false;
+
+  hot_write_lock();
+
+  std::list<PropertyBase*>& propin = pin->get_properties();
+  std::list<PropertyBase*>::iterator pi=propin.begin(), pj=properties.begin();
+  for( ; pi != propin.end() && pj != properties.end(); pi++, pj++ ) {
+    if( (*pi)->is_hot() && (*pi)->is_modified() )
+      (*pj)->import( *pi );
+  }
+
+  std::list<PropertyBase*>& mpropin = pin->get_mapped_properties();
+  std::list<PropertyBase*>::iterator mpi=mpropin.begin(), mpj=mapped_properties.begin();
+  for( ; mpi != mpropin.end() && mpj != mapped_properties.end(); mpi++, mpj++ ) {
+    if( (*mpi)->is_hot() && (*mpi)->is_modified() )
+      (*mpj)->import( *mpi );
+  }
+
+  bool result = update_hot_values();
+  // If the update fails, the properties stay modified so that
+  // the subsequent re-build takes them into account
+  if( result )
+    clear_modified();
+
+  hot_write_unlock();
+
+  return result;
+}
+
+
+void PF::OpParBase::hot_write_lock()
+{
+  // Wait until the tiles being computed are finished,
+  // and block the new ones until the values are updated
+  g_mutex_lock( hot_mutex );
+  while( hot_writer )
+    g_cond_wait( hot_cond, hot_mutex );
+  hot_writer = true;
+  while( hot_readers > 0 )
+    g_cond_wait( hot_cond, hot_mutex );
+  g_mutex_unlock( hot_mutex );
+}
+
+
+void PF::OpParBase::hot_write_unlock()
+{
+  g_mutex_lock( hot_mutex );
+  hot_writer = false;
+  g_cond_broadcast( hot_cond );
+  g_mutex_unlock( hot_mutex );
+}
+
+
+void PF::OpParBase::hot_read_lock()
+{
+  g_mutex_lock( hot_mutex );
+  while( hot_writer )
+    g_cond_wait( hot_cond, hot_mutex );
+  hot_readers += 1;
+  g_mutex_unlock( hot_mutex );
+}
+
+
+void PF::OpParBase::hot_read_unlock()
+{
+  g_mutex_lock( hot_mutex );
+  hot_readers -= 1;
+  if( hot_readers == 0 )
+    g_cond_broadcast( hot_cond );
+  g_mutex_unlock( hot_mutex );
+}
+
+
 VipsImage* PF::OpParBase::build(std::vector<VipsImage*>& in, int first, 
 				VipsImage* imap, VipsImage* omap, unsigned int& level)
 {
@@ -50,6 +50,7 @@
 #include "property.hh"
 
 #include "color.hh"
+#include "color_kernels.hh"
 
 #include "photoflow.hh"
 
@@ -103,6 +104,18 @@ namespace PF
   class ProcessorBase;
   class Layer;
 
+
+  // Content of a tile of an opacity map
+  enum mask_tile_t {
+    PF_MASK_TILE_MIXED,
+    PF_MASK_TILE_EMPTY,  // zero everywhere
+    PF_MASK_TILE_FULL    // one everywhere
+  };
+
+  // Classify the given area of an opacity map, which must be already computed
+  // in the region. The scan stops at the first pixel that differs from the first one.
+  mask_tile_t get_mask_tile_state( VipsRegion* reg, const VipsRect& area );
+
   class OperationConfigUI
   {
     std::list<std::string> initial_params;
@@ -152,6 +165,13 @@ namespace PF
 
     bool modified_flag;
 
+    // Readers-writer lock that prevents the hot properties from being
+    // changed while a tile is being computed
+    GMutex* hot_mutex;
+    GCond* hot_cond;
+    int hot_readers;
+    bool hot_writer;
+
     std::list<PropertyBase*> mapped_properties;
     std::list<PropertyBase*> properties;
 
@@ -170,6 +190,8 @@ namespace PF
     virtual ~OpParBase()
     {
       std::cout<<"~OpParBase(): deleting operation "<<(void*)this<<std::endl;
+      vips_g_mutex_free( hot_mutex );
+      vips_g_cond_free( hot_cond );
     }
 
     std::string get_type() { return type; }
@@ -201,6 +223,35 @@ namespace PF
 
     virtual bool import_settings( OpParBase* pin );
 
+    /* Hot parameter updates.
+     *
+     * Properties flagged with set_hot(true) do not change the structure of the
+     * graph, nor the size and format of the output image. When only such
+     * properties are modified, the new values are copied into the operations
+     * of the existing pipelines instead of re-building them.
+     */
+
+    // True if the operation is modified, and all the modified properties are hot
+    bool has_hot_changes_only();
+
+    // Copy the modified hot properties of pin, while no tile is being computed.
+    // Returns false if the new values require a re-build after all.
+    bool import_hot_settings( OpParBase* pin );
+
+    // Re-compute the values derived from the properties in build(), called
+    // after the hot properties are changed. Returns false if the pipeline
+    // needs to be re-built.
+    virtual bool update_hot_values() { return true; }
+
+    // Called around the computation of each tile
+    void hot_read_lock();
+    void hot_read_unlock();
+
+    // Called around the modification of the values used by the pixel loops;
+    // waits until the tiles being computed are finished
+    void hot_write_lock();
+    void hot_write_unlock();
+
     void set_processor(ProcessorBase* p) { processor = p; }
     ProcessorBase* get_processor() { return processor; }
 
@@ -271,6 +322,25 @@ namespace PF
     virtual bool needs_input() { return true; }
     virtual bool needs_caching() { return false; }
     virtual bool init_hidden() { return false; }
+    // Called by the file loader before the stored properties are applied.
+    // Operations whose defaults have changed restore here the values that
+    // documents not storing the property were created with.
+    virtual void set_legacy_defaults() {}
+
+    // Index of the input image that is copied unchanged to the output where
+    // the opacity map is zero, or -1 if the operation does not behave like that.
+    // The other inputs are then not computed for the empty tiles of the map.
+    virtual int get_masked_out_input() { return -1; }
+    // Whether an opacity map equal to one everywhere gives the same result as
+    // no map at all, in which case the faster unmasked code is used for the full tiles.
+    virtual bool ignores_full_opacity_map() { return false; }
+    // Index of the input image that is currently copied unchanged to the
+    // output, or -1 if the tiles have to be computed. Unlike the masked-out
+    // input, the choice can change without re-building the pipeline.
+    virtual int get_selected_input() { return -1; }
+    // The operation processes the whole image at once instead of tile-by-tile,
+    // and therefore cannot be used in out-of-core mode
+    virtual bool needs_whole_image() { return false; }
 
     rendermode_t get_render_mode() { return render_mode; }
     void set_render_mode(rendermode_t m) { render_mode = m; }
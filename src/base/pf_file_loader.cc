@@ -268,6 +268,7 @@ void start_element (GMarkupParseContext *context,
       if( processor ) {
         std::cout<<"PF::pf_file_loader(): operation created."<<std::endl;
         current_op = processor->get_par();
+        current_op->set_legacy_defaults();
         if( !PF::PhotoFlow::Instance().is_batch() && current_op->init_hidden() )
           current_layer->set_visible( false );
       }
@@ -293,7 +294,11 @@ void start_element (GMarkupParseContext *context,
       value_cursor++;
     }
 
-    std::cout<<"PF::pf_file_loader(): setting property \""<<pname<<"\" to \""<<pvalue<<"\""<<std::endl;
+    // Binary-encoded values can be very long, and are not worth printing
+    if( pvalue.size() > 200 )
+      std::cout<<"PF::pf_file_loader(): setting property \""<<pname<<"\" ("<<pvalue.size()<<" bytes)"<<std::endl;
+    else
+      std::cout<<"PF::pf_file_loader(): setting property \""<<pname<<"\" to \""<<pvalue<<"\""<<std::endl;
 
     if( !pname.empty() && !pvalue.empty() ) {
       if( version < 2 &&
@@ -34,6 +34,10 @@
 #include <stdlib.h>
 #include <glibmm.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #if defined(__MINGW32__) || defined(__MINGW64__)
   #include<windows.h>
 #endif
@@ -47,7 +51,11 @@
 
 PF::PhotoFlow::PhotoFlow(): 
   active_image( NULL ),
-  batch(true)
+  batch(true),
+  preview_lut_size(0),
+  preview_cache_half(false),
+  out_of_core(false),
+  thread_budget(1)
 {
   // Create the cache directory if possible
   char fname[500];
@@ -144,6 +152,41 @@ PF::PhotoFlow& PF::PhotoFlow::Instance()
 };
 
 
+void PF::PhotoFlow::set_thread_budget( int n )
+{
+  if( n <= 0 ) n = vips_concurrency_get();
+  if( n < 1 ) n = 1;
+  thread_budget = n;
+
+  vips_concurrency_set( n );
+#ifdef _OPENMP
+  // OpenMP teams are never nested: a parallel region inside another one
+  // runs serially instead of multiplying the number of threads
+  omp_set_num_threads( n );
+  omp_set_max_active_levels( 1 );
+#endif
+  std::cout<<"PhotoFlow: thread budget set to "<<n<<std::endl;
+}
+
+
+
+PF::WorkerThreadScope::WorkerThreadScope(): saved_nthreads( 0 )
+{
+#ifdef _OPENMP
+  saved_nthreads = omp_get_max_threads();
+  omp_set_num_threads( 1 );
+#endif
+}
+
+
+PF::WorkerThreadScope::~WorkerThreadScope()
+{
+#ifdef _OPENMP
+  omp_set_num_threads( saved_nthreads );
+#endif
+}
+
+
 
 void PF::PhotoFlow::obj_unref( GObject* obj, char* msg )
 {
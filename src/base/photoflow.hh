@@ -37,7 +37,7 @@
 
 //#include "image.hh"
 
-#define PF_FILE_VERSION 4
+#define PF_FILE_VERSION 5
 
 namespace PF
 {
@@ -61,6 +61,22 @@ namespace PF
 
     bool batch;
 
+    // size of the 3D LUTs used to speed-up the preview color conversions (0 = disabled)
+    int preview_lut_size;
+
+    // store the floating-point preview caches and the reduced-size pyramid levels
+    // as half-precision values, to halve their disk and memory footprint
+    bool preview_cache_half;
+
+    // out-of-core mode for very large images: the layer caches are tiled, sparse
+    // and filled on demand, and the operations that need the whole image are
+    // refused, so that none of their full-size cache files is written
+    bool out_of_core;
+
+    // number of threads shared by the vips threadpool and, in builds with
+    // USE_OPENMP, the OpenMP regions
+    int thread_budget;
+
     static PhotoFlow* instance;
   public:
     PhotoFlow();
@@ -76,6 +92,21 @@ namespace PF
     void set_batch( bool val ) { batch = val; }
     bool is_batch() { return batch; }
 
+    void set_preview_lut_size( int size ) { preview_lut_size = size; }
+    int get_preview_lut_size() { return preview_lut_size; }
+
+    void set_preview_cache_half( bool val ) { preview_cache_half = val; }
+    bool get_preview_cache_half() { return preview_cache_half; }
+
+    void set_out_of_core( bool val ) { out_of_core = val; }
+    bool is_out_of_core() { return out_of_core; }
+
+    // Set the number of threads used for the image processing (n <= 0 keeps the
+    // current vips concurrency). Must be called from the main thread, which
+    // keeps the whole budget for the operations that process the full image.
+    void set_thread_budget( int n );
+    int get_thread_budget() { return thread_budget; }
+
     ProcessorBase* new_operation(std::string opname, Layer* current_layer)
     {
       if( new_op_func ) return new_op_func( opname, current_layer );
@@ -101,6 +132,20 @@ namespace PF
   };
 
 
+  /* Declared at the beginning of the code executed by the vips worker threads:
+   * the OpenMP regions started by the thread are limited to a single thread
+   * while the object is alive, since the vips workers already use the whole
+   * thread budget. The previous setting is restored on destruction.
+   */
+  class WorkerThreadScope
+  {
+    int saved_nthreads;
+  public:
+    WorkerThreadScope();
+    ~WorkerThreadScope();
+  };
+
+
   void pf_object_ref(GObject* object, const char* msg);
 #define PF_REF( object, msg ) pf_object_ref( G_OBJECT(object), msg );
   void pf_object_unref(GObject* object, const char* msg);
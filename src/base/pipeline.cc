@@ -363,3 +363,20 @@ void PF::Pipeline::sink( const VipsRect& area )
   }
 }
 /**/
+
+
+void PF::Pipeline::invalidate()
+{
+  for( unsigned int i = 0; i < sinks.size(); i++) {
+    if( sinks[i] ) sinks[i]->invalidate();
+  }
+}
+
+
+bool PF::Pipeline::prefetch()
+{
+  for( unsigned int i = 0; i < sinks.size(); i++) {
+    if( sinks[i] && sinks[i]->prefetch() ) return true;
+  }
+  return false;
+}
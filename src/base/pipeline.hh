@@ -57,8 +57,11 @@ namespace PF
     std::vector<VipsImage*> images;
     VipsImage* blended;
     int input_id;
+    // Primary input the node was last built from. It is only compared with the
+    // current input, and stays valid as long as "image" depends on it.
+    VipsImage* input;
 
-    PipelineNode(): processor( NULL ), blender( NULL ), image( NULL ), blended( NULL ), input_id( -1 ) {}
+    PipelineNode(): processor( NULL ), blender( NULL ), image( NULL ), blended( NULL ), input_id( -1 ), input( NULL ) {}
   };
 
 
@@ -126,6 +129,14 @@ namespace PF
 
     void update( VipsRect* area );
     void sink( const VipsRect& area );
+
+    // Notify the sinks that the pixels have changed, while the
+    // structure of the pipeline stays the same
+    void invalidate();
+
+    // Let the sinks compute in advance some of the pixels they are likely
+    // to need soon. Returns false if none of the sinks had anything to do.
+    bool prefetch();
   };
 
 
@@ -157,9 +168,17 @@ namespace PF
     virtual void update( VipsRect* area ) = 0;
     virtual void sink( const VipsRect& area ) { }
 
+    // Called when the pipeline images have been invalidated without re-building
+    // them; sinks that keep the old output image only need to re-draw
+    virtual void invalidate() { update( NULL ); }
+
     virtual void process_area( const VipsRect& area ) {}
     virtual void process_start( const VipsRect& area ) {}
     virtual void process_end( const VipsRect& area ) {}
+
+    // Called by the image processor when it is idle; the sink should do a
+    // small amount of work and return true, or return false if there is nothing to do
+    virtual bool prefetch() { return false; }
   };
 
 }
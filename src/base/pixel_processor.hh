@@ -121,6 +121,9 @@ namespace PF
     
       int x, y, ch, dx=CHMAX-CHMIN+1;//, CHMAXplus1=CHMAX+1;
       int ximap, ni;
+      float irgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+      float orgb[PF_COLOR_ROW_CHUNK_SIZE*3];
+      float lumi[PF_COLOR_ROW_CHUNK_SIZE];
     
       for( y = 0; y < r->height; y++ ) {
         
@@ -138,54 +141,34 @@ namespace PF
         }
         if( CS != PF_COLORSPACE_RGB || blend == 0 ) continue;
 
-        if( blend > 0 ) {
-          // Blend the output luminance with the input colors
-          // Preserves the color information of the input image
-          // Equivalent to the "luminosity blend" in photoshop
-          double ired, ig, ib;
-          double ored, og, ob;
-          double ored2, og2, ob2;
-          for( x=0, ximap=0; x < line_size; ) {
-            ored = (double(pout[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            og = (double(pout[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ob = (double(pout[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            double lumi = PF::luminance( ored, og, ob );
-            ired = (double(p[0][x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ig = (double(p[0][x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ib = (double(p[0][x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            //std::cout<<"Input:  "<<ired<<" "<<ig<<" "<<ib<<std::endl;
-            //std::cout<<"Output: "<<ored<<" "<<og<<" "<<ob<<std::endl;
-            ored2 = ired; og2 = ig; ob2 = ib;
-            PF::lc_blend( ored2, og2, ob2, lumi );
-            pout[x] = (T)(( (ored2*blend)+(ored*(1.0f-blend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            pout[x+1] = (T)(( (og2*blend)+(og*(1.0f-blend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            pout[x+2] = (T)(( (ob2*blend)+(ob*(1.0f-blend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            //std::cout<<"ired="<<ired<<"  ored="<<ored<<"  (ored*blend)+(ired*(1.0f-blend))="<<(ored*blend)+(ired*(1.0f-blend))<<std::endl;
-            //std::cout<<"p[x]="<<p[0][x]<<"  pout[x]="<<pout[x]<<std::endl;
-            x += 3;
-          }
-        } else if( blend < 0 ) {
-          // Blend the output color with the input luminance
-          // Preserves the luminance information of the input image
-          // Equivalent to the "color blend" in photoshop
-          double ired, ig, ib;
-          double ored, og, ob;
-          double ored2, og2, ob2;
-          for( x=0, ximap=0; x < line_size; ) {
-            ired = (double(p[0][x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ig = (double(p[0][x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ib = (double(p[0][x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ored = (double(pout[x]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            og = (double(pout[x+1]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            ob = (double(pout[x+2]) + FormatInfo<T>::MIN)/FormatInfo<T>::RANGE;
-            double lumi = PF::luminance( ired, ig, ib );
-            ored2 = ored; og2 = og; ob2 = ob;
-            PF::lc_blend( ored2, og2, ob2, lumi );
-            pout[x] = (T)(( (ored2*nblend)+(ored*(1.0f-nblend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            pout[x+1] = (T)(( (og2*nblend)+(og*(1.0f-nblend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            pout[x+2] = (T)(( (ob2*nblend)+(ob*(1.0f-nblend)) )*FormatInfo<T>::RANGE - FormatInfo<T>::MIN);
-            x += 3;
+        // The pixels are processed in chunks, through small floating-point
+        // buffers and the row kernels from color_kernels.hh
+        for( int x0 = 0; x0 < r->width; x0 += PF_COLOR_ROW_CHUNK_SIZE ) {
+          int npix = r->width - x0;
+          if( npix > PF_COLOR_ROW_CHUNK_SIZE ) npix = PF_COLOR_ROW_CHUNK_SIZE;
+          int nval = npix*3, pos = x0*3;
+          to_float_row( p[0]+pos, irgb, nval );
+          to_float_row( pout+pos, orgb, nval );
+
+          if( blend > 0 ) {
+            // Blend the output luminance with the input colors
+            // Preserves the color information of the input image
+            // Equivalent to the "luminosity blend" in photoshop
+            luminance_row( orgb, lumi, npix );
+            lc_blend_row( irgb, lumi, npix );
+            for( x = 0; x < nval; x++ )
+              irgb[x] = (irgb[x]*blend)+(orgb[x]*(1.0f-blend));
+          } else {
+            // Blend the output color with the input luminance
+            // Preserves the luminance information of the input image
+            // Equivalent to the "color blend" in photoshop
+            luminance_row( irgb, lumi, npix );
+            for( x = 0; x < nval; x++ ) irgb[x] = orgb[x];
+            lc_blend_row( irgb, lumi, npix );
+            for( x = 0; x < nval; x++ )
+              irgb[x] = (irgb[x]*nblend)+(orgb[x]*(1.0f-nblend));
           }
+          from_float_row( irgb, pout+pos, nval );
         }
       }
     }
@@ -182,6 +182,10 @@ namespace PF
 
     bool internal;
 
+    // "Hot" properties can be changed without re-building the pipelines,
+    // see OpParBase::import_hot_settings()
+    bool hot;
+
     bool modified_flag;
 
   public:
@@ -197,6 +201,9 @@ namespace PF
     bool is_internal() { return internal; }
     void set_internal(bool i) { internal = i; }
 
+    bool is_hot() { return hot; }
+    void set_hot(bool h) { hot = h; }
+
     bool is_modified() { return modified_flag; }
     void set_modified() { modified_flag = true; }
     void clear_modified() { modified_flag = false; }
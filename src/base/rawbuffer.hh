@@ -48,6 +48,7 @@
 #include "format_info.hh"
 
 #include "property.hh"
+#include "binary_codec.hh"
 
 #include "imagepyramid.hh"
 
@@ -214,6 +215,68 @@ namespace PF
   }
 
 
+  inline void to_binary( BinaryWriter& w, const Pencil& pen )
+  {
+    const std::vector<float>& color = pen.get_color();
+    w.put_uint( color.size() );
+    for( unsigned int i = 0; i < color.size(); i++ )
+      w.put_float( color[i] );
+    w.put_uint( pen.get_size() );
+    w.put_float( pen.get_opacity() );
+  }
+
+  inline bool from_binary( BinaryReader& r, Pencil& pen )
+  {
+    unsigned int nch, size;
+    float opacity;
+    if( !r.get_uint( nch ) || nch > r.get_remaining() ) return false;
+    std::vector<float>& color = pen.get_color();
+    color.resize( nch );
+    for( unsigned int i = 0; i < nch; i++ )
+      if( !r.get_float( color[i] ) ) return false;
+    if( !r.get_uint( size ) || !r.get_float( opacity ) ) return false;
+    pen.set_size( size );
+    pen.set_opacity( opacity );
+    return true;
+  }
+
+
+  // The points are stored as differences from the previous point,
+  // which are small for hand-drawn strokes
+  template <class Pen>
+  inline void to_binary( BinaryWriter& w, const Stroke<Pen>& stroke )
+  {
+    to_binary( w, stroke.get_pen() );
+    const std::list< std::pair<unsigned int, unsigned int> >& points = stroke.get_points();
+    w.put_uint( points.size() );
+    unsigned int x = 0, y = 0;
+    std::list< std::pair<unsigned int, unsigned int> >::const_iterator i;
+    for( i = points.begin(); i != points.end(); i++ ) {
+      w.put_int( (int)(i->first - x) );
+      w.put_int( (int)(i->second - y) );
+      x = i->first; y = i->second;
+    }
+  }
+
+  template <class Pen>
+  inline bool from_binary( BinaryReader& r, Stroke<Pen>& stroke )
+  {
+    if( !from_binary( r, stroke.get_pen() ) ) return false;
+    std::list< std::pair<unsigned int, unsigned int> >& points = stroke.get_points();
+    points.clear();
+    unsigned int npoints;
+    if( !r.get_uint( npoints ) || npoints > r.get_remaining() ) return false;
+    unsigned int x = 0, y = 0;
+    for( unsigned int i = 0; i < npoints; i++ ) {
+      int dx, dy;
+      if( !r.get_int( dx ) || !r.get_int( dy ) ) return false;
+      x += dx; y += dy;
+      points.push_back( std::make_pair(x,y) );
+    }
+    return true;
+  }
+
+
   /*
   template <class Pen>
   inline std::istream& operator >>( std::istream& str, std::list< Stroke<Pen> >& strokes )
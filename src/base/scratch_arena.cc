@@ -0,0 +1,223 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#include <stdlib.h>
+
+#include <list>
+
+#include <glib.h>
+
+#include "memory_manager.hh"
+#include "scratch_arena.hh"
+
+
+// Smallest size class, as a power of two (4kB)
+#define PF_SCRATCH_MIN_SHIFT 12
+
+// Number of size classes, the largest one being 2GB
+#define PF_SCRATCH_NCLASSES 20
+
+// Maximum amount of memory kept in the free lists of each thread; below this
+// limit, the free lists are trimmed when the memory budget is exceeded
+#define PF_SCRATCH_MAX_CACHED ((size_t)128*1024*1024)
+
+
+// Arenas of the running threads, so that they can be trimmed when the
+// memory budget is exceeded
+static std::list<PF::ScratchArena*> arenas;
+static GMutex* arenas_mutex = NULL;
+
+
+// Gives the unused scratch buffers back to the system on request of the
+// memory manager
+class ScratchArenaClient: public PF::MemoryClient
+{
+public:
+  size_t release_memory( size_t amount )
+  {
+    return PF::ScratchArena::trim_all( amount );
+  }
+};
+
+
+static gpointer scratch_arenas_init( gpointer data )
+{
+  arenas_mutex = vips_g_mutex_new();
+  PF::MemoryManager::Instance().add_client( new ScratchArenaClient(), PF::PF_MEM_PRIORITY_SCRATCH );
+  return NULL;
+}
+
+
+static void scratch_arena_free( gpointer data )
+{
+  delete (PF::ScratchArena*)data;
+}
+
+
+#if GLIB_CHECK_VERSION(2,32,0)
+static GPrivate scratch_arena_key = G_PRIVATE_INIT( scratch_arena_free );
+#define SCRATCH_ARENA_KEY (&scratch_arena_key)
+#else
+static GPrivate* scratch_arena_key = g_private_new( scratch_arena_free );
+#define SCRATCH_ARENA_KEY (scratch_arena_key)
+#endif
+
+
+static int size_class( size_t size )
+{
+  int c = 0;
+  while( c < PF_SCRATCH_NCLASSES && (((size_t)1) << (c+PF_SCRATCH_MIN_SHIFT)) < size )
+    c += 1;
+  return c;
+}
+
+
+PF::ScratchArena::ScratchArena(): free_lists( PF_SCRATCH_NCLASSES ), cached( 0 )
+{
+  mutex = vips_g_mutex_new();
+}
+
+
+PF::ScratchArena::~ScratchArena()
+{
+  // Waits until the arena is no longer being trimmed
+  g_mutex_lock( arenas_mutex );
+  arenas.remove( this );
+  g_mutex_unlock( arenas_mutex );
+
+  for( int c = 0; c < PF_SCRATCH_NCLASSES; c++ ) {
+    size_t csize = ((size_t)1) << (c+PF_SCRATCH_MIN_SHIFT);
+    for( unsigned int i = 0; i < free_lists[c].size(); i++ ) {
+      free( free_lists[c][i] );
+      MemoryManager::Instance().released( PF_MEM_SCRATCH, csize );
+    }
+  }
+  vips_g_mutex_free( mutex );
+}
+
+
+PF::ScratchArena& PF::ScratchArena::get()
+{
+  ScratchArena* arena = (ScratchArena*)g_private_get( SCRATCH_ARENA_KEY );
+  if( !arena ) {
+    // The memory client is registered once, outside of the arenas lock
+    static GOnce init_once = G_ONCE_INIT;
+    g_once( &init_once, scratch_arenas_init, NULL );
+
+    arena = new ScratchArena();
+    g_private_set( SCRATCH_ARENA_KEY, arena );
+    g_mutex_lock( arenas_mutex );
+    arenas.push_back( arena );
+    g_mutex_unlock( arenas_mutex );
+  }
+  return *arena;
+}
+
+
+void* PF::ScratchArena::alloc( size_t size )
+{
+  int c = size_class( size );
+  if( c >= PF_SCRATCH_NCLASSES ) {
+    // Too large to be pooled
+    void* ptr = malloc( size );
+    if( ptr ) MemoryManager::Instance().allocated( PF_MEM_SCRATCH, size );
+    return ptr;
+  }
+
+  size_t csize = ((size_t)1) << (c+PF_SCRATCH_MIN_SHIFT);
+  g_mutex_lock( mutex );
+  if( !free_lists[c].empty() ) {
+    void* ptr = free_lists[c].back();
+    free_lists[c].pop_back();
+    cached -= csize;
+    g_mutex_unlock( mutex );
+    return ptr;
+  }
+  g_mutex_unlock( mutex );
+
+  void* ptr = malloc( csize );
+  if( ptr ) MemoryManager::Instance().allocated( PF_MEM_SCRATCH, csize );
+  return ptr;
+}
+
+
+void PF::ScratchArena::release( void* ptr, size_t size )
+{
+  if( !ptr ) return;
+  int c = size_class( size );
+  if( c >= PF_SCRATCH_NCLASSES ) {
+    free( ptr );
+    MemoryManager::Instance().released( PF_MEM_SCRATCH, size );
+    return;
+  }
+
+  size_t csize = ((size_t)1) << (c+PF_SCRATCH_MIN_SHIFT);
+  g_mutex_lock( mutex );
+  if( cached + csize > PF_SCRATCH_MAX_CACHED ) {
+    g_mutex_unlock( mutex );
+    free( ptr );
+    MemoryManager::Instance().released( PF_MEM_SCRATCH, csize );
+    return;
+  }
+  free_lists[c].push_back( ptr );
+  cached += csize;
+  g_mutex_unlock( mutex );
+}
+
+
+size_t PF::ScratchArena::trim( size_t amount )
+{
+  size_t freed = 0;
+  g_mutex_lock( mutex );
+  // Largest buffers first
+  for( int c = PF_SCRATCH_NCLASSES-1; c >= 0 && freed < amount; c-- ) {
+    size_t csize = ((size_t)1) << (c+PF_SCRATCH_MIN_SHIFT);
+    while( !free_lists[c].empty() && freed < amount ) {
+      free( free_lists[c].back() );
+      free_lists[c].pop_back();
+      cached -= csize;
+      freed += csize;
+      MemoryManager::Instance().released( PF_MEM_SCRATCH, csize );
+    }
+  }
+  g_mutex_unlock( mutex );
+  return freed;
+}
+
+
+size_t PF::ScratchArena::trim_all( size_t amount )
+{
+  size_t freed = 0;
+  g_mutex_lock( arenas_mutex );
+  std::list<ScratchArena*>::iterator i;
+  for( i = arenas.begin(); i != arenas.end() && freed < amount; i++ )
+    freed += (*i)->trim( amount - freed );
+  g_mutex_unlock( arenas_mutex );
+  return freed;
+}
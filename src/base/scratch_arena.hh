@@ -0,0 +1,109 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef PF_SCRATCH_ARENA_H
+#define PF_SCRATCH_ARENA_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <glib.h>
+
+
+namespace PF
+{
+
+  /* Per-thread pool of temporary buffers for the tile generators.
+   *
+   * The requested sizes are rounded up to a power of two, and the buffers that
+   * are given back are kept in a free list for their size class, so that the
+   * following tiles processed by the same thread get them back without
+   * going through the heap. Buffers can nevertheless be given back from a
+   * different thread.
+   * The memory held by the arenas is reported to the memory manager as
+   * "scratch buffers". The free lists are trimmed by the memory manager when
+   * the budget is exceeded, and are freed when the owning thread exits.
+   */
+  class ScratchArena
+  {
+    std::vector< std::vector<void*> > free_lists;
+    // total size of the buffers in the free lists
+    size_t cached;
+    // Protects the free lists; it is only contended while the arena is trimmed
+    GMutex* mutex;
+
+  public:
+    ScratchArena();
+    ~ScratchArena();
+
+    // Arena of the calling thread, created on first use
+    static ScratchArena& get();
+
+    // The returned buffer is at least "size" bytes large and not initialized
+    void* alloc( size_t size );
+    // "size" must be the one passed to alloc()
+    void release( void* ptr, size_t size );
+
+    // Free the unused buffers, until at least "amount" bytes are released.
+    // Returns the amount actually released.
+    size_t trim( size_t amount );
+    // Trim the arenas of all threads
+    static size_t trim_all( size_t amount );
+  };
+
+
+  // Typed scratch buffer, given back to the arena when going out of scope
+  template<class T>
+  class ScratchBuffer
+  {
+    T* ptr;
+    size_t size;
+
+    ScratchBuffer( const ScratchBuffer& );
+    ScratchBuffer& operator=( const ScratchBuffer& );
+
+  public:
+    ScratchBuffer( size_t n ): size( sizeof(T)*n )
+    {
+      ptr = (T*)ScratchArena::get().alloc( size );
+    }
+    ~ScratchBuffer()
+    {
+      ScratchArena::get().release( ptr, size );
+    }
+
+    T* get() { return ptr; }
+    operator T*() { return ptr; }
+  };
+
+}
+
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <fstream>
+
+#include <vips/vips.h>
+
+#include "photoflow.hh"
+#include "shared_resources.hh"
+
+/* We need C linkage for this.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus*/
+
+#include "../dt/common/colorspaces.h"
+
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+
+PF::SharedResources* PF::SharedResources::instance = NULL;
+
+
+gpointer PF::SharedResources::create_instance( gpointer data )
+{
+  return( new PF::SharedResources() );
+}
+
+
+PF::SharedResources& PF::SharedResources::Instance()
+{
+  // The resources can be requested from several threads,
+  // so the instance is created exactly once
+  static GOnce instance_once = G_ONCE_INIT;
+  g_once( &instance_once, PF::SharedResources::create_instance, NULL );
+  PF::SharedResources::instance = (PF::SharedResources*)instance_once.retval;
+  return( *instance );
+}
+
+
+PF::SharedResources::SharedResources():
+  init_thread( NULL ),
+  lensfun_time( -1 ), gmic_time( -1 ), profiles_time( -1 ),
+#ifdef PF_HAS_LENSFUN
+  lensfun_db( NULL ),
+#endif
+  gmic_commands( NULL )
+{
+  mutex = vips_g_mutex_new();
+}
+
+
+static double elapsed_seconds( gint64 start )
+{
+  return( (g_get_monotonic_time() - start) * 1.0e-6 );
+}
+
+
+gpointer PF::SharedResources::load_lensfun( gpointer data )
+{
+  SharedResources* res = (SharedResources*)data;
+  gint64 start = g_get_monotonic_time();
+#ifdef PF_HAS_LENSFUN
+  res->lensfun_db = lf_db_new();
+  res->lensfun_db->Load();
+#endif
+  double t = elapsed_seconds( start );
+  g_mutex_lock( res->mutex );
+  res->lensfun_time = t;
+  g_mutex_unlock( res->mutex );
+  std::cout<<"SharedResources: lensfun database loaded in "<<t<<" s"<<std::endl;
+  return data;
+}
+
+
+gpointer PF::SharedResources::load_gmic( gpointer data )
+{
+  SharedResources* res = (SharedResources*)data;
+  gint64 start = g_get_monotonic_time();
+
+  char fname[500]; fname[0] = 0;
+#if defined(WIN32) || defined(__MINGW32__) || defined(__MINGW64__)
+  snprintf( fname, 499, "%s\\gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
+#elif defined(__APPLE__) && defined (__MACH__)
+  snprintf( fname, 499, "%s/gmic_def.gmic", PF::PhotoFlow::Instance().get_data_dir().c_str() );
+#else
+  snprintf( fname, 499, "%s/share/photoflow/gmic_def.gmic", INSTALL_PREFIX );
+#endif
+  std::cout<<"G'MIC custom commands file: "<<fname<<std::endl;
+  struct stat buffer;
+  if( stat( fname, &buffer ) == 0 ) {
+    std::ifstream t( fname, std::ios::in | std::ios::binary );
+    t.seekg( 0, std::ios::end );
+    int length = t.tellg();
+    t.seekg( 0, std::ios::beg );
+    if( length > 0 ) {
+      // the G'MIC interpreter expects a null-terminated string
+      res->gmic_commands = new char[length+1];
+      t.read( res->gmic_commands, length );
+      res->gmic_commands[length] = 0;
+    }
+    t.close();
+  }
+
+  double t = elapsed_seconds( start );
+  g_mutex_lock( res->mutex );
+  res->gmic_time = t;
+  g_mutex_unlock( res->mutex );
+  std::cout<<"SharedResources: G'MIC custom commands "
+           <<(res->gmic_commands ? "loaded" : "not found")<<" in "<<t<<" s"<<std::endl;
+  return data;
+}
+
+
+static std::string profile_to_string( cmsHPROFILE profile )
+{
+  std::string result;
+  cmsUInt32Number length;
+  if( !profile ) return result;
+  if( cmsSaveProfileToMem( profile, NULL, &length ) ) {
+    result.resize( length );
+    cmsSaveProfileToMem( profile, &(result[0]), &length );
+  }
+  cmsCloseProfile( profile );
+  return result;
+}
+
+
+gpointer PF::SharedResources::load_profiles( gpointer data )
+{
+  SharedResources* res = (SharedResources*)data;
+  gint64 start = g_get_monotonic_time();
+
+  // The profiles are kept in serialized form, so that each transform gets
+  // its own handle and no lcms object is shared between threads
+  res->profile_data[STD_PROF_sRGB] = profile_to_string( dt_colorspaces_create_srgb_profile() );
+  res->profile_data[STD_PROF_ADOBE] = profile_to_string( dt_colorspaces_create_adobergb_profile() );
+  res->profile_data[STD_PROF_PROPHOTO] = profile_to_string( dt_colorspaces_create_prophotorgb_profile() );
+  res->profile_data[STD_PROF_LAB] = profile_to_string( dt_colorspaces_create_lab_profile() );
+
+  double t = elapsed_seconds( start );
+  g_mutex_lock( res->mutex );
+  res->profiles_time = t;
+  g_mutex_unlock( res->mutex );
+  std::cout<<"SharedResources: built-in ICC profiles created in "<<t<<" s"<<std::endl;
+  return data;
+}
+
+
+static GOnce lensfun_once = G_ONCE_INIT;
+static GOnce gmic_once = G_ONCE_INIT;
+static GOnce profiles_once = G_ONCE_INIT;
+
+
+gpointer PF::SharedResources::init_thread_func( gpointer data )
+{
+  SharedResources* res = (SharedResources*)data;
+  gint64 start = g_get_monotonic_time();
+  g_once( &profiles_once, load_profiles, res );
+  g_once( &lensfun_once, load_lensfun, res );
+  g_once( &gmic_once, load_gmic, res );
+  std::cout<<"SharedResources: background initialization completed in "
+           <<elapsed_seconds( start )<<" s"<<std::endl;
+  return NULL;
+}
+
+
+void PF::SharedResources::start_background_init()
+{
+  if( init_thread ) return;
+  init_thread = vips_g_thread_new( "pf_shared_init", init_thread_func, this );
+}
+
+
+#ifdef PF_HAS_LENSFUN
+lfDatabase* PF::SharedResources::get_lensfun_db()
+{
+  g_once( &lensfun_once, load_lensfun, this );
+  return lensfun_db;
+}
+#endif
+
+
+const char* PF::SharedResources::get_gmic_commands()
+{
+  g_once( &gmic_once, load_gmic, this );
+  return gmic_commands;
+}
+
+
+cmsHPROFILE PF::SharedResources::open_profile( std_profile_t type )
+{
+  if( type < 0 || type >= STD_PROF_LAST ) return NULL;
+  g_once( &profiles_once, load_profiles, this );
+  const std::string& data = profile_data[type];
+  if( data.empty() ) return NULL;
+  return( cmsOpenProfileFromMem( data.data(), data.size() ) );
+}
+
+
+void PF::SharedResources::print( std::ostream& str )
+{
+  g_mutex_lock( mutex );
+  str<<"Shared resources loading time:"<<std::endl;
+  str<<"  lensfun database:      ";
+  if( lensfun_time < 0 ) str<<"not loaded"<<std::endl; else str<<lensfun_time<<" s"<<std::endl;
+  str<<"  G'MIC custom commands: ";
+  if( gmic_time < 0 ) str<<"not loaded"<<std::endl; else str<<gmic_time<<" s"<<std::endl;
+  str<<"  built-in ICC profiles: ";
+  if( profiles_time < 0 ) str<<"not loaded"<<std::endl; else str<<profiles_time<<" s"<<std::endl;
+  g_mutex_unlock( mutex );
+}
@@ -0,0 +1,116 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef PF_SHARED_RESOURCES_H
+#define PF_SHARED_RESOURCES_H
+
+#include <string>
+#include <iostream>
+
+#include <glib.h>
+#include <lcms2.h>
+
+#ifdef PF_HAS_LENSFUN
+#include <lensfun.h>
+#endif
+
+
+namespace PF
+{
+
+  // Built-in color profiles that are shared by all the color conversions
+  enum std_profile_t {
+    STD_PROF_sRGB,
+    STD_PROF_ADOBE,
+    STD_PROF_PROPHOTO,
+    STD_PROF_LAB,
+    STD_PROF_LAST
+  };
+
+
+  /* Process-wide registry of the read-only databases needed by the operations:
+   * the lensfun camera/lens database, the G'MIC custom commands and the
+   * built-in ICC profiles.
+   *
+   * Each resource is loaded once, the first time it is requested, and shared by
+   * all the operations and pipelines afterwards. Concurrent requests block until
+   * the first one has completed the loading.
+   * start_background_init() loads everything in a separate thread, so that the
+   * cost is paid while the user interface or the first image is being opened.
+   */
+  class SharedResources
+  {
+    static SharedResources* instance;
+
+    GMutex* mutex;
+    GThread* init_thread;
+
+    // Loading time of each resource, in seconds (negative if not loaded yet)
+    double lensfun_time, gmic_time, profiles_time;
+
+#ifdef PF_HAS_LENSFUN
+    lfDatabase* lensfun_db;
+#endif
+    char* gmic_commands;
+    std::string profile_data[STD_PROF_LAST];
+
+    static gpointer load_lensfun( gpointer data );
+    static gpointer load_gmic( gpointer data );
+    static gpointer load_profiles( gpointer data );
+    static gpointer init_thread_func( gpointer data );
+
+    static gpointer create_instance( gpointer data );
+    SharedResources();
+
+  public:
+    static SharedResources& Instance();
+
+    // Load all the resources in a background thread
+    void start_background_init();
+
+#ifdef PF_HAS_LENSFUN
+    // The returned database is owned by the registry and must not be destroyed
+    lfDatabase* get_lensfun_db();
+#endif
+
+    // Content of the gmic_def.gmic file, or NULL if it could not be found
+    const char* get_gmic_commands();
+
+    // Returns a new handle to the given built-in profile,
+    // which must be released with cmsCloseProfile()
+    cmsHPROFILE open_profile( std_profile_t type );
+
+    void print( std::ostream& str );
+  };
+
+}
+
+
+#endif
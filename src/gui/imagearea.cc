@@ -45,6 +45,10 @@ extern "C" {
   
   extern void vips_invalidate_area( VipsImage *image, VipsRect* r  );
 
+  extern void vips_sink_screen2_set_focus( VipsImage *image, VipsRect *visible, int x, int y );
+
+  extern int vips_sink_screen2_prefetch( VipsImage *image, int ring );
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -135,6 +139,13 @@ PF::ImageArea::ImageArea( Pipeline* v ):
   xoffset( 0 ),
   yoffset( 0 ),
   pending_pixels( 0 ),
+  placeholder_width( 0 ),
+  placeholder_height( 0 ),
+  placeholder_done( false ),
+  pointer_x( 0 ),
+  pointer_y( 0 ),
+  pointer_valid( 0 ),
+  prefetch_ring( PF_PREFETCH_RING ),
   draw_requested( false ),
   display_merged( true ),
   active_layer( -1 ),
@@ -160,6 +171,9 @@ PF::ImageArea::ImageArea( Pipeline* v ):
   draw_done = vips_g_cond_new();
   draw_mutex = vips_g_mutex_new();
 
+  if( getenv("PF_PREFETCH_RING") )
+    prefetch_ring = atoi( getenv("PF_PREFETCH_RING") );
+
   //get_window()->set_back_pixmap( Glib::RefPtr<Gdk::Pixmap>(), FALSE );
   //set_double_buffered( TRUE );
 
@@ -181,6 +195,63 @@ PF::ImageArea::~ImageArea ()
 
 
 
+void PF::ImageArea::set_placeholder( VipsImage* thumb, int full_width, int full_height )
+{
+  placeholder.reset();
+  placeholder_scaled.reset();
+  if( !thumb || thumb->Bands != 3 || thumb->BandFmt != VIPS_FORMAT_UCHAR ) return;
+
+  VipsRegion* reg = vips_region_new( thumb );
+  VipsRect r = { 0, 0, thumb->Xsize, thumb->Ysize };
+  if( vips_region_prepare( reg, &r ) ) {
+    PF_UNREF( reg, "ImageArea::set_placeholder(): reg unref" );
+    return;
+  }
+  placeholder = Gdk::Pixbuf::create( Gdk::COLORSPACE_RGB, false, 8, r.width, r.height );
+  guint8* px = placeholder->get_pixels();
+  int rs = placeholder->get_rowstride();
+  for( int y = 0; y < r.height; y++ )
+    memcpy( px+rs*y, VIPS_REGION_ADDR( reg, 0, y ), r.width*3 );
+  PF_UNREF( reg, "ImageArea::set_placeholder(): reg unref" );
+
+  placeholder_width = full_width;
+  placeholder_height = full_height;
+  double_buffer.lock();
+  placeholder_done = false;
+  double_buffer.unlock();
+
+  set_size_request( full_width, full_height );
+  queue_draw();
+}
+
+
+// Returns the placeholder scaled to the current zoom level, and its position
+// in the drawing area. The placeholder is dropped once a processed image
+// has been fully drawn.
+Glib::RefPtr< Gdk::Pixbuf > PF::ImageArea::get_placeholder( int& x, int& y )
+{
+  if( placeholder_done ) {
+    placeholder.reset();
+    placeholder_scaled.reset();
+  }
+  if( !placeholder ) return placeholder;
+
+  int level = get_pipeline() ? get_pipeline()->get_level() : 0;
+  int width = (placeholder_width >> level)*shrink_factor;
+  int height = (placeholder_height >> level)*shrink_factor;
+  if( width < 1 || height < 1 ) return placeholder_scaled;
+  if( !placeholder_scaled ||
+      placeholder_scaled->get_width() != width ||
+      placeholder_scaled->get_height() != height )
+    placeholder_scaled = placeholder->scale_simple( width, height, Gdk::INTERP_BILINEAR );
+
+  x = y = 0;
+  if( hadj && width < hadj->get_page_size() ) x = (hadj->get_page_size()-width)/2;
+  if( vadj && height < vadj->get_page_size() ) y = (vadj->get_page_size()-height)/2;
+  return placeholder_scaled;
+}
+
+
 // Submit the given area to the image processor
 void PF::ImageArea::submit_area( const VipsRect& area )
 {
@@ -228,6 +299,22 @@ void PF::ImageArea::submit_area( const VipsRect& area )
 */
 void PF::ImageArea::process_start( const VipsRect& area )
 {
+  // Tiles are computed outwards from the pointer, or from the centre of
+  // the visible area if the pointer is elsewhere
+  VipsRect image = {0, 0, display_image->Xsize, display_image->Ysize};
+  VipsRect visible;
+  vips_rect_intersectrect( &image, (VipsRect*)&area, &visible );
+  if( !vips_rect_isempty( &visible ) ) {
+    int fx = visible.left + visible.width/2;
+    int fy = visible.top + visible.height/2;
+    int px = g_atomic_int_get( &pointer_x ), py = g_atomic_int_get( &pointer_y );
+    if( g_atomic_int_get( &pointer_valid ) && px >= visible.left && px < VIPS_RECT_RIGHT(&visible) &&
+        py >= visible.top && py < VIPS_RECT_BOTTOM(&visible) ) {
+      fx = px; fy = py;
+    }
+    vips_sink_screen2_set_focus( display_image, &visible, fx, fy );
+  }
+
   // Resize the inactive buffer to match the size of the image portion being displayed
   double_buffer.get_inactive().resize( area.left, area.top, area.width, area.height );
 
@@ -268,6 +355,8 @@ void PF::ImageArea::process_end( const VipsRect& area )
   double_buffer.swap();
   double_buffer.get_active().set_dirty(false);
   double_buffer.get_inactive().set_dirty(true);
+  // The processed image now replaces the embedded preview
+  placeholder_done = true;
 #ifdef DEBUG_DISPLAY
   std::cout<<"Buffer swapped"<<std::endl;
 #endif
@@ -304,6 +393,8 @@ void PF::ImageArea::process_area( const VipsRect& area )
   if (vips_region_prepare (region, parea))
     return;
 
+  display_stats.update( region, area );
+
   double_buffer.get_inactive().copy( region, area, xoffset, yoffset );
 #ifdef DEBUG_DISPLAY
   std::cout<<"Region "<<parea->width<<","<<parea->height<<"+"<<parea->left<<"+"<<parea->top<<" copied into inactive buffer"<<std::endl;
@@ -311,6 +402,23 @@ void PF::ImageArea::process_area( const VipsRect& area )
 }
 
 
+// Compute one of the tiles around the visible area, so that they are
+// immediately available when scrolling. When all of them are ready,
+// the next pyramid level is computed, one strip per call, so that zooming
+// out does not stall on the down-scaling of the input images.
+bool PF::ImageArea::prefetch()
+{
+  if( !display_image || prefetch_ring < 0 ) return false;
+
+  if( vips_sink_screen2_prefetch( display_image, prefetch_ring ) > 0 )
+    return true;
+
+  PF::Pipeline* pipeline = get_pipeline();
+  if( !pipeline || PF::MemoryManager::Instance().over_budget() ) return false;
+  return PF::ImagePyramid::prefetch_all( pipeline->get_level()+1 );
+}
+
+
 // Pass the active Pixbuf to the current layer dialog to eventually
 // draw additional informations on the preview image
 Glib::RefPtr< Gdk::Pixbuf > PF::ImageArea::modify_preview()
@@ -433,6 +541,17 @@ bool PF::ImageArea::on_expose_event (GdkEventExpose * event)
 {
   //return true;
 
+  // Draw the embedded preview below the processed image,
+  // so that it remains visible where no tile is available yet
+  int px, py;
+  double_buffer.lock();
+  Glib::RefPtr< Gdk::Pixbuf > ph = get_placeholder( px, py );
+  double_buffer.unlock();
+  if( ph )
+    get_window()->draw_pixbuf( get_style ()->get_white_gc (), ph,
+        0, 0, px, py, ph->get_width(), ph->get_height(),
+        Gdk::RGB_DITHER_NONE, 0, 0 );
+
   // We draw only if there is already a VipsImage attached to this display
   if( !display_image ) return true;
 
@@ -567,6 +686,18 @@ bool PF::ImageArea::on_expose_event (GdkEventExpose * event)
 bool PF::ImageArea::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
 {
   //std::cout<<"ImageArea::on_draw() called."<<std::endl;
+
+  // Draw the embedded preview below the processed image,
+  // so that it remains visible where no tile is available yet
+  int px, py;
+  double_buffer.lock();
+  Glib::RefPtr< Gdk::Pixbuf > ph = get_placeholder( px, py );
+  double_buffer.unlock();
+  if( ph ) {
+    Gdk::Cairo::set_source_pixbuf( cr, ph, px, py );
+    cr->paint();
+  }
+
   // We draw only if there is already a VipsImage attached to this display
   if( !display_image ) return true;
 
@@ -688,6 +819,29 @@ bool PF::ImageArea::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
 
 
 
+void PF::ImageArea::invalidate()
+{
+  if( !display_image ) {
+    update( NULL );
+    return;
+  }
+
+  // The display chain is still valid, and the invalidated tiles will be
+  // re-computed by the render threads; only the screen needs to be re-drawn
+  display_stats.reset();
+
+  double_buffer.lock();
+  double_buffer.get_active().set_dirty( true );
+  double_buffer.get_inactive().set_dirty( true );
+  double_buffer.unlock();
+
+  Update * update = g_new (Update, 1);
+  update->image_area = this;
+  update->rect.width = update->rect.height = 0;
+  gdk_threads_add_idle ((GSourceFunc) queue_draw_cb, update);
+}
+
+
 void PF::ImageArea::update( VipsRect* area ) 
 {
   //PF::Pipeline* pipeline = pf_image->get_pipeline(0);
@@ -783,6 +937,9 @@ void PF::ImageArea::update( VipsRect* area )
 
   convert2srgb->get_par()->set_image_hints( image );
   convert2srgb->get_par()->set_format( get_pipeline()->get_format() );
+  // The output only goes to the screen
+  PF::Convert2sRGBPar* srgbpar = dynamic_cast<PF::Convert2sRGBPar*>( convert2srgb->get_par() );
+  if( srgbpar ) srgbpar->set_display_lut( true );
   std::vector<VipsImage*> in; in.push_back( image );
   VipsImage* srgbimg = convert2srgb->get_par()->build(in, 0, NULL, NULL, level );
   //PF_UNREF( image, "ImageArea::update() image unref" );
@@ -925,6 +1082,10 @@ void PF::ImageArea::update( VipsRect* area )
   }
 	*/
 
+  // The displayed image has changed, the statistics will be
+  // re-accumulated as the new tiles get rendered
+  display_stats.reset();
+
   display_image = im_open( "display_image", "p" );
 
   region = vips_region_new (display_image);
@@ -1079,6 +1240,9 @@ void PF::ImageArea::sink( const VipsRect& area )
     std::cout<<"ImageArea::sink(): vips_region_prepare() failed."<<std::endl;
     return;
   }
+  // The statistics are only accumulated in process_area(), when the
+  // modified area gets redrawn; here the old values are simply dropped
+  display_stats.invalidate( scaled_area );
   unsigned char* pout = (unsigned char*)VIPS_REGION_ADDR( region2, parea->left, parea->top ); 
 	/*
 	std::cout<<"Plotting scaled area "<<scaled_area.width<<","<<scaled_area.height
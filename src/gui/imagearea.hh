@@ -59,6 +59,11 @@
 #include "doublebuffer.hh"
 
 
+// Default number of tiles computed in advance around the visible area,
+// can be changed through the PF_PREFETCH_RING environment variable
+#define PF_PREFETCH_RING 2
+
+
 /*
   The ImageArea performs the image update aynchronously, inside a dedicated thread.
   Upon a drawing request from the Gtk system (on_expose_event or on_draw)
@@ -98,6 +103,9 @@ class ImageArea : public PipelineSink, public Gtk::DrawingArea
   DoubleBuffer double_buffer;
   PixelBuffer temp_buffer;
 
+  // Statistics of the displayed image, updated as the tiles are rendered
+  ImageStats display_stats;
+
   GCond* draw_done;
   GMutex* draw_mutex;
 
@@ -129,6 +137,25 @@ class ImageArea : public PipelineSink, public Gtk::DrawingArea
 
   long int pending_pixels;
 
+  // Preview embedded in the raw file, shown until the first processed
+  // image is available. The scaled version is only accessed by the GUI thread.
+  Glib::RefPtr< Gdk::Pixbuf > placeholder;
+  Glib::RefPtr< Gdk::Pixbuf > placeholder_scaled;
+  int placeholder_width, placeholder_height;
+  bool placeholder_done;
+
+  Glib::RefPtr< Gdk::Pixbuf > get_placeholder( int& x, int& y );
+
+  // Last known pointer position, in display image coordinates.
+  // Written by the GUI thread and read by the processing thread, therefore
+  // only accessed through atomic operations. The two coordinates are not
+  // updated together, which is fine since they are only used as a hint.
+  volatile gint pointer_x, pointer_y;
+  volatile gint pointer_valid;
+
+  // Number of tiles computed in advance around the visible area
+  int prefetch_ring;
+
   /* We send this packet of data from the bg worker thread to the main GUI
    * thread when a tile has been calculated.
    */
@@ -175,6 +202,8 @@ public:
 
   DoubleBuffer& get_double_buffer() { return double_buffer; }
 
+  ImageStats& get_display_stats() { return display_stats; }
+
 #ifdef GTKMM_2
   //void expose_rect (const VipsRect& area);
   bool on_expose_event (GdkEventExpose * event);
@@ -188,10 +217,27 @@ public:
   void process_start( const VipsRect& area );
   void process_area( const VipsRect& area );
   void process_end( const VipsRect& area );
+  bool prefetch();
   void draw_area();
 
   Glib::RefPtr< Gdk::Pixbuf > modify_preview();
 
+  // Display a preview of the image while the processing pipeline is being built.
+  // full_width and full_height give the size of the image at zoom level 0.
+  void set_placeholder( VipsImage* thumb, int full_width, int full_height );
+
+  // Set the pointer position in widget coordinates; the tiles nearest
+  // to the pointer are computed first
+  void set_pointer( int x, int y )
+  {
+    g_atomic_int_set( &pointer_x, x - xoffset );
+    g_atomic_int_set( &pointer_y, y - yoffset );
+    g_atomic_int_set( &pointer_valid, 1 );
+  }
+
+  int get_prefetch_ring() { return prefetch_ring; }
+  void set_prefetch_ring( int n ) { prefetch_ring = n; }
+
 	float get_shrink_factor() { return shrink_factor; }
 	void set_shrink_factor( float val ) { shrink_factor = val; }
 
@@ -225,6 +271,8 @@ public:
 
   void update( VipsRect* area );
 
+  void invalidate();
+
   void sink( const VipsRect& area );
 
   void set_active_layer( int id ) { 
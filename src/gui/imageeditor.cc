@@ -27,9 +27,16 @@
 
  */
 
+#include <stdio.h>
+
+#include <sstream>
+
 #include <gdk/gdk.h>
 
 #include "../base/imageprocessor.hh"
+#include "../base/memory_manager.hh"
+#include "../base/fileutils.hh"
+#include "../operations/raw_image.hh"
 #include "imageeditor.hh"
 
 
@@ -78,7 +85,16 @@ PF::ImageEditor::ImageEditor( std::string fname ):
 
   pack1( imageBox, true, false );
 
-  pack2( layersWidget, false, false );
+  histogram.set_stats( &(imageArea->get_display_stats()) );
+  sideBox.pack_start( histogram, Gtk::PACK_SHRINK );
+  sideBox.pack_start( memoryLabel, Gtk::PACK_SHRINK );
+  sideBox.pack_start( layersWidget );
+
+  update_memory_label();
+  memory_timeout_connection = Glib::signal_timeout().connect( sigc::mem_fun(*this,
+      &PF::ImageEditor::update_memory_label), 1000 );
+
+  pack2( sideBox, false, false );
 
   buttonZoomIn.signal_clicked().connect( sigc::mem_fun(*this,
 						       &PF::ImageEditor::zoom_in) );
@@ -127,6 +143,7 @@ PF::ImageEditor::ImageEditor( std::string fname ):
 
 PF::ImageEditor::~ImageEditor()
 {
+  memory_timeout_connection.disconnect();
 	/*
   if( image )
     delete image;
@@ -138,6 +155,26 @@ PF::ImageEditor::~ImageEditor()
 }
 
 
+bool PF::ImageEditor::update_memory_label()
+{
+  PF::MemoryManager& mm = PF::MemoryManager::Instance();
+  char str[200];
+  snprintf( str, 199, "Memory: %d / %d MB", (int)(mm.get_total_usage()/1024/1024),
+            (int)(mm.get_budget()/1024/1024) );
+  memoryLabel.set_text( str );
+
+  std::ostringstream details;
+  for( int i = 0; i < PF::PF_MEM_SUBSYSTEMS_NUM; i++ ) {
+    PF::memory_subsystem_t s = (PF::memory_subsystem_t)i;
+    if( i > 0 ) details<<std::endl;
+    details<<PF::MemoryManager::get_subsystem_name( s )<<": "<<mm.get_usage( s )/1024/1024<<" MB (peak "
+           <<mm.get_peak_usage( s )/1024/1024<<" MB)";
+  }
+  memoryLabel.set_tooltip_text( details.str() );
+  return true;
+}
+
+
 
 // Fills a list with all children of the current layer
 void PF::ImageEditor::expand_layer( PF::Layer* layer, std::list<PF::Layer*>& list )
@@ -252,6 +289,21 @@ void PF::ImageEditor::get_child_layers()
 void PF::ImageEditor::open_image()
 {
   if( image_opened ) return;
+
+  // Raw files take a while to be decoded: in the meantime,
+  // the preview embedded in the file is displayed
+  std::string ext;
+  if( PF::getFileExtensionLowcase( "/", filename, ext ) &&
+      ext != "pfi" && ext != "tiff" && ext != "tif" &&
+      ext != "jpg" && ext != "jpeg" && ext != "png" ) {
+    int width = 0, height = 0;
+    VipsImage* thumb = PF::load_embedded_preview( filename, width, height );
+    if( thumb ) {
+      imageArea->set_placeholder( thumb, width, height );
+      PF_UNREF( thumb, "ImageEditor::open_image(): thumb unref" );
+    }
+  }
+
   std::cout<<"ImageEditor::open_image(): opening image..."<<std::endl;
   image->open( filename );
   std::cout<<"ImageEditor::open_image(): ... done."<<std::endl;
@@ -758,6 +810,9 @@ bool PF::ImageEditor::on_motion_notify_event( GdkEventMotion* event )
 		y = event->y;
 		state = event->state;	
 	}
+  // The tiles near the pointer get computed first
+  imageArea->set_pointer( x, y );
+
 	int button = -1;
   if(state & GDK_BUTTON1_MASK) button = 1;
   if(state & GDK_BUTTON2_MASK) button = 2;
@@ -36,6 +36,7 @@
 
 #include "imagearea.hh"
 #include "layerwidget.hh"
+#include "widgets/histogram.hh"
 
 
 namespace PF {
@@ -54,6 +55,10 @@ namespace PF {
     Gtk::EventBox imageArea_eventBox;
     Gtk::ScrolledWindow imageArea_scrolledWindow;
     LayerWidget layersWidget;
+    Gtk::VBox sideBox;
+    HistogramArea histogram;
+    Gtk::Label memoryLabel;
+    sigc::connection memory_timeout_connection;
     Gtk::HBox controlsBox;
     Gtk::Button buttonZoomIn, buttonZoomOut, buttonZoom100, buttonZoomFit;
     Gtk::VBox radioBox;
@@ -64,6 +69,9 @@ namespace PF {
                            std::list<Layer*>& children );
     void get_child_layers();
 
+    // Periodically refresh the memory usage summary
+    bool update_memory_label();
+
   public:
     ImageEditor( std::string filename );
     ~ImageEditor();
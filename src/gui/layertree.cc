@@ -228,8 +228,9 @@ void PF::LayerTree::on_cell_toggled( const Glib::ustring& path )
 #ifndef NDEBUG
     std::cout<<"Toggled visibility of layer \""<<l->get_name()<<"\": "<<visible<<std::endl;
 #endif
+    // The layer is flagged as changed by set_visible(); layers that are
+    // built behind a switch node are then toggled without re-building
     l->set_visible( visible );
-    l->set_dirty( true );
     //layer_manager->rebuild( PF::PF_COLORSPACE_RGB, VIPS_FORMAT_UCHAR, 100,100 );
     l->get_image()->update();
   }
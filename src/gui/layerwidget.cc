@@ -32,6 +32,7 @@
 #include "../base/pf_file_loader.hh"
 #include "../operations/buffer.hh"
 #include "../operations/blender.hh"
+#include "operations/buffer_config.hh"
 #include "tablabelwidget.hh"
 #include "layerwidget.hh"
 #include "imageeditor.hh"
@@ -546,7 +547,7 @@ void PF::LayerWidget::on_button_add_group()
   add_layer( layer );
 
   PF::OperationConfigDialog* dialog = 
-    new PF::OperationConfigDialog( layer, Glib::ustring("Group Layer Config") );
+    new PF::BufferConfigDialog( layer, Glib::ustring("Group Layer Config") );
   processor->get_par()->set_config_ui( dialog );
   //dialog->update();
   dialog->open();
@@ -537,8 +537,14 @@ void PF::MainWindow::on_button_export_clicked()
       Gtk::Widget* widget = viewerNotebook.get_nth_page( page );
       if( widget ) {
 	PF::ImageEditor* editor = dynamic_cast<PF::ImageEditor*>( widget );
-	if( editor && editor->get_image() )
-	  editor->get_image()->export_merged( filename );
+	if( editor && editor->get_image() &&
+	    !editor->get_image()->export_merged( filename ) ) {
+	  Gtk::MessageDialog msg( *this, "The image cannot be exported", false,
+				  Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true );
+	  msg.set_secondary_text( "Some layers need the whole image at once, and cannot be "
+				  "processed in out-of-core mode." );
+	  msg.run();
+	}
       }
       break;
     }
@@ -52,6 +52,7 @@
 #include "../gui/operations/clone_stamp_config.hh"
 #include "../gui/operations/convert_colorspace_config.hh"
 #include "../gui/operations/lensfun_config.hh"
+#include "../gui/operations/buffer_config.hh"
 
 #include "operations/gmic/new_gmic_operation_config.hh"
 
@@ -490,6 +491,16 @@ PF::ProcessorBase* PF::new_operation_with_gui( std::string op_type, PF::Layer* c
   PF::ProcessorBase* processor = PF::new_operation( op_type, current_layer );
   if( !processor ) return NULL;
 
+  // The operations that need the whole image at once are refused in
+  // out-of-core mode: the layer is disabled, so that the user can see
+  // that it does not contribute to the preview
+  if( PF::PhotoFlow::Instance().is_out_of_core() && processor->get_par() &&
+      processor->get_par()->needs_whole_image() ) {
+    std::cerr<<"ERROR: layer \""<<current_layer->get_name()<<"\" needs the whole image at once,"<<std::endl
+             <<"       and is disabled in out-of-core mode"<<std::endl;
+    current_layer->set_visible( false );
+  }
+
   PF::OperationConfigDialog* dialog = NULL;
 
   if( op_type == "imageread" ) { 
@@ -510,7 +521,7 @@ PF::ProcessorBase* PF::new_operation_with_gui( std::string op_type, PF::Layer* c
 
   } else if( op_type == "buffer" ) {
 
-    dialog = new PF::OperationConfigDialog( current_layer, "Buffer" );
+    dialog = new PF::BufferConfigDialog( current_layer, "Buffer" );
 
   } else if( op_type == "blender" ) {
 
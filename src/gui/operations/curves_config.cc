@@ -279,12 +279,17 @@ bool PF::CurvesConfigDialog::pointer_release_event( int button, double x, double
   PF::Layer* lin = image->get_layer_manager().get_layer( node->input_id );
   if( !lin ) return false;
 
-  // Sample a 5x5 pixels region of the input layer
+  // Sample a 5x5 pixels region of the input layer; approximate values
+  // are accepted, so that the area can be read from the preview tiles
   std::vector<float> values;
   double lx = x, ly = y, lw = 1, lh = 1;
   screen2layer( lx, ly, lw, lh );
-  std::cout<<"image->sample( lin->get_id(), "<<lx<<", "<<ly<<", 5, NULL, values );"<<std::endl;
-  image->sample( lin->get_id(), lx, ly, 5, NULL, values );
+  VipsRect area = { (int)lx-2, (int)ly-2, 5, 5 };
+  std::vector<VipsRect> areas( 1, area );
+  std::vector<PF::SampleStats> stats;
+  if( image->sample( lin->get_id(), areas, stats, false ) && !stats.empty() )
+    values = stats[0].mean;
+  if( values.empty() ) return false;
 
   std::cout<<"CurvesConfigDialog::pointer_release_event(): values="<<values[0]<<","<<values[1]<<","<<values[2]<<std::endl;
 
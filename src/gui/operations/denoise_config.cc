@@ -34,7 +34,10 @@
 
 PF::DenoiseConfigDialog::DenoiseConfigDialog( PF::Layer* layer ):
   OperationConfigDialog( layer, "Noise Reduction" ),
-	modeSelector( this, "nr_mode", "N.R. mode: ", PF_NR_ANIBLUR ),
+	modeSelector( this, "nr_mode", "N.R. mode: ", PF_NR_NLMEANS ),
+  nlmPatchSlider( this, "nlm_patch_radius", "Patch radius", 2, 0, 5, 1, 1, 1),
+  nlmSearchSlider( this, "nlm_search_radius", "Search radius", 5, 1, 15, 1, 1, 1),
+  nlmStrengthSlider( this, "nlm_strength", "Strength", 30, 0, 200, 1, 10, 1),
   iterationsSlider( this, "iterations", "Iterations", 1, 1, 10, 1, 1, 1),
   amplitudeSlider( this, "amplitude", "Amplitude", 1, 0, 100, 1, 1, 1),
   sharpnessSlider( this, "sharpness", "Sharpness", 1, 0, 10, 0.1, 1, 1),
@@ -43,6 +46,9 @@ PF::DenoiseConfigDialog::DenoiseConfigDialog( PF::Layer* layer ):
   sigmaSlider( this, "sigma", "Sigma", 1, 0, 10, 0.1, 1, 1)
 {
   controlsBox.pack_start( modeSelector );
+  controlsBox.pack_start( nlmPatchSlider );
+  controlsBox.pack_start( nlmSearchSlider );
+  controlsBox.pack_start( nlmStrengthSlider );
   controlsBox.pack_start( iterationsSlider );
   controlsBox.pack_start( amplitudeSlider );
   controlsBox.pack_start( sharpnessSlider );
@@ -50,6 +50,7 @@ namespace PF {
   //#endif
 
   Selector modeSelector;
+  Slider nlmPatchSlider, nlmSearchSlider, nlmStrengthSlider;
   Slider iterationsSlider, amplitudeSlider, sharpnessSlider,
     anisotropySlider, alphaSlider, sigmaSlider;
 
@@ -34,7 +34,7 @@
 
 PF::GaussBlurConfigDialog::GaussBlurConfigDialog( PF::Layer* layer ):
   OperationConfigDialog( layer, "Gaussian Blur" ),
-	modeSelector( this, "preview_mode", "Preview mode: ", PF_BLUR_FAST ),
+	modeSelector( this, "preview_mode", "Algorithm: ", PF_BLUR_NATIVE ),
   radiusSlider( this, "radius", "Radius", 5, 0, 1000, 0.1, 1, 1)
 {
   controlsBox.pack_start( modeSelector );
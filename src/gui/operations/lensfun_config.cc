@@ -28,6 +28,7 @@
  */
 
 #include "../../base/exif_data.hh"
+#include "../../base/shared_resources.hh"
 #include "../../operations/lensfun.hh"
 
 #include "lensfun_config.hh"
@@ -58,8 +59,7 @@ PF::LensFunConfigDialog::LensFunConfigDialog( PF::Layer* layer ):
   add_widget( controlsBox );
 
 #ifdef PF_HAS_LENSFUN
-  ldb = lf_db_new();
-  ldb->Load ();
+  ldb = PF::SharedResources::Instance().get_lensfun_db();
 #endif
 
   makerEntry.signal_activate().
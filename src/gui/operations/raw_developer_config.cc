@@ -45,6 +45,24 @@
 #define MAX3( a, b, c ) MAX(a,MAX(b,c))
 
 
+// Average values of a square area centered on (x,y), computed by the image
+// processor in a single sampling request. Approximate values are accepted,
+// so that the area can be read from the already computed preview tiles.
+static bool sample_spot( PF::Image* img, int layer_id, double x, double y,
+                         int size, std::vector<float>& values )
+{
+  VipsRect area = { (int)x-size/2, (int)y-size/2, size, size };
+  std::vector<VipsRect> areas( 1, area );
+  std::vector<PF::SampleStats> stats;
+
+  values.clear();
+  if( !img->sample( layer_id, areas, stats, false ) || stats.empty() )
+    return false;
+  values = stats[0].mean;
+  return true;
+}
+
+
 PF::RawDeveloperConfigDialog::RawDeveloperConfigDialog( PF::Layer* layer ):
   OperationConfigDialog( layer, "Raw Developer" ),
   wbModeSelector( this, "wb_mode", "WB mode: ", 0 ),
@@ -300,8 +318,9 @@ void PF::RawDeveloperConfigDialog::spot_wb( double x, double y )
   PF::Pipeline* pipeline = img->get_pipeline( 0 );
   if( !pipeline ) return;
 
-	// Make sure the first pipeline is up-to-date
-	img->update( pipeline, true );
+	// Make sure all the pipelines are up-to-date, since the spot
+	// can be sampled from any of them
+	img->update( NULL, true );
   img->unlock();
 
   // Get the node associated to the layer
@@ -327,8 +346,14 @@ void PF::RawDeveloperConfigDialog::spot_wb( double x, double y )
     float rgb_avg[3] = {0, 0, 0};
 		std::vector<float> values;
 
-    std::cout<<"RawDeveloperConfigDialog: getting spot WB ("<<x<<","<<y<<")"<<std::endl;
-		img->sample( l->get_id(), x, y, 7, NULL, values );
+    // The values checked at the end of the previous iteration are still
+    // valid, since the image has not been modified in the meantime
+    if( i == 0 ) {
+      std::cout<<"RawDeveloperConfigDialog: getting spot WB ("<<x<<","<<y<<")"<<std::endl;
+      sample_spot( img, l->get_id(), x, y, 7, values );
+    } else {
+      values.assign( rgb_check, rgb_check+3 );
+    }
 		if( values.size() != 3 ) {
 			std::cout<<"RawDeveloperConfigDialog::pointer_relese_event(): values.size() "
 							 <<values.size()<<" (!= 3)"<<std::endl;
@@ -395,12 +420,12 @@ void PF::RawDeveloperConfigDialog::spot_wb( double x, double y )
       wbGreenSlider.init();
       wbBlueSlider.init();
 
-      img->update( pipeline, true );
+      img->update( NULL, true );
       img->unlock();
     }
 
     std::cout<<"RawDeveloperConfigDialog: checking spot WB"<<std::endl;
-		img->sample( l->get_id(), x, y, 7, NULL, values );
+		sample_spot( img, l->get_id(), x, y, 7, values );
 		if( values.size() != 3 ) {
 			std::cout<<"RawDeveloperConfigDialog::pointer_relese_event(): values.size() "
 							 <<values.size()<<" (!= 3)"<<std::endl;
@@ -520,6 +545,7 @@ void PF::RawDeveloperConfigDialog::color_spot_wb( double x, double y )
 
   float Lab_check[3] = { 0, 0, 0 };
   float Lab_prev[3] = { 0, 1000, 1000 };
+  std::vector<float> values_check;
   for( int i = 0; i < 100; i++ ) {
     // Now we have to process a small portion of the image 
     // to get the corresponding Lab values
@@ -594,8 +620,14 @@ void PF::RawDeveloperConfigDialog::color_spot_wb( double x, double y )
     rgb_avg[1] /= rspot.width*rspot.height;
     rgb_avg[2] /= rspot.width*rspot.height;
 		*/
-    std::cout<<"RawDeveloperConfigDialog: getting color spot WB ("<<x<<","<<y<<")"<<std::endl;
-		img->sample( l->get_id(), x, y, sample_size, NULL, values );
+    // The values checked at the end of the previous iteration are still
+    // valid, since the image has not been modified in the meantime
+    if( values_check.size() == 3 ) {
+      values = values_check;
+    } else {
+      std::cout<<"RawDeveloperConfigDialog: getting color spot WB ("<<x<<","<<y<<")"<<std::endl;
+      sample_spot( img, l->get_id(), x, y, sample_size, values );
+    }
 		//values.clear(); img->sample( l->get_id(), x, y, sample_size, NULL, values );
 		if( values.size() != 3 ) {
 			std::cout<<"RawDeveloperConfigDialog::pointer_relese_event(): values.size() "
@@ -871,12 +903,13 @@ void PF::RawDeveloperConfigDialog::color_spot_wb( double x, double y )
     rgb_avg[2] /= rspot.width*rspot.height;
 		*/
     std::cout<<"RawDeveloperConfigDialog: checking spot WB"<<std::endl;
-		img->sample( l->get_id(), x, y, sample_size, NULL, values );
+		sample_spot( img, l->get_id(), x, y, sample_size, values );
 		if( values.size() != 3 ) {
 			std::cout<<"RawDeveloperConfigDialog::pointer_relese_event(): values.size() "
 							 <<values.size()<<" (!= 3)"<<std::endl;
 			return;
 		}
+    values_check = values;
 		rgb_avg[0] = values[0];
 		rgb_avg[1] = values[1];
 		rgb_avg[2] = values[2];
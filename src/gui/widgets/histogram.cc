@@ -0,0 +1,144 @@
+/* 
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#include <vector>
+
+#include "histogram.hh"
+
+
+PF::HistogramArea::HistogramArea():
+  stats( NULL ), serial( 0 )
+{
+  set_size_request( 256, 100 );
+  timeout_connection = Glib::signal_timeout().connect( sigc::mem_fun(*this,
+      &PF::HistogramArea::check_stats), 500 );
+}
+
+
+PF::HistogramArea::~HistogramArea()
+{
+  timeout_connection.disconnect();
+}
+
+
+bool PF::HistogramArea::check_stats()
+{
+  if( stats && stats->get_serial() != serial ) {
+    serial = stats->get_serial();
+    queue_draw();
+  }
+  return true;
+}
+
+
+void PF::HistogramArea::draw( const Cairo::RefPtr<Cairo::Context>& cr, int width, int height )
+{
+  cr->save();
+  cr->set_source_rgba(0.2, 0.2, 0.2, 1.0);
+  cr->paint();
+  cr->restore();
+
+  if( !stats || width < 2 || height < 2 ) return;
+
+  int nbands = stats->get_nbands();
+  if( nbands < 1 ) return;
+  // Only the color channels are shown, the alpha channel is skipped
+  if( nbands > 3 ) nbands = 3;
+
+  std::vector< std::vector<long int> > hist( nbands );
+  long int hmax = 0;
+  for( int b = 0; b < nbands; b++ ) {
+    stats->get_histogram( b, hist[b] );
+    // The first and last bins contain the clipped pixels and are not
+    // considered for the vertical scaling, as they would often dominate
+    for( int i = 1; i < (int)(hist[b].size())-1; i++ )
+      if( hist[b][i] > hmax ) hmax = hist[b][i];
+  }
+  if( hmax == 0 ) return;
+
+  double colors[3][3] = { {0.9, 0.2, 0.2}, {0.2, 0.9, 0.2}, {0.3, 0.3, 0.9} };
+
+  cr->set_antialias( Cairo::ANTIALIAS_GRAY );
+  for( int b = 0; b < nbands; b++ ) {
+    if( hist[b].empty() ) continue;
+    if( nbands == 1 ) cr->set_source_rgba( 0.9, 0.9, 0.9, 0.5 );
+    else cr->set_source_rgba( colors[b][0], colors[b][1], colors[b][2], 0.5 );
+    double dx = double(width) / hist[b].size();
+    cr->move_to( 0, height );
+    for( unsigned int i = 0; i < hist[b].size(); i++ ) {
+      double h = double(hist[b][i]) * height / hmax;
+      if( h > height ) h = height;
+      cr->line_to( dx*i, height - h );
+      cr->line_to( dx*(i+1), height - h );
+    }
+    cr->line_to( width, height );
+    cr->close_path();
+    cr->fill();
+  }
+
+  // Grid lines at 1/4, 1/2 and 3/4 of the range
+  std::vector<double> ds (2);
+  ds[0] = 4;
+  ds[1] = 4;
+  cr->set_source_rgb( 0.5, 0.5, 0.5 );
+  cr->set_line_width( 0.5 );
+  cr->set_dash (ds, 0);
+  for( int i = 1; i <= 3; i++ ) {
+    cr->move_to( double(0.5+width*i/4), double(0) );
+    cr->rel_line_to (double(0), double(height) );
+  }
+  cr->stroke ();
+  cr->unset_dash ();
+}
+
+
+#ifdef GTKMM_2
+bool PF::HistogramArea::on_expose_event(GdkEventExpose* event)
+{
+  Glib::RefPtr<Gdk::Window> window = get_window();
+  if( !window )
+    return true;
+
+  Gtk::Allocation allocation = get_allocation();
+  Cairo::RefPtr<Cairo::Context> cr = window->create_cairo_context();
+  draw( cr, allocation.get_width(), allocation.get_height() );
+  return true;
+}
+#endif
+
+
+#ifdef GTKMM_3
+bool PF::HistogramArea::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+  Gtk::Allocation allocation = get_allocation();
+  draw( cr, allocation.get_width(), allocation.get_height() );
+  return true;
+}
+#endif
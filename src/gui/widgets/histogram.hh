@@ -0,0 +1,72 @@
+/* 
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef PF_HISTOGRAM_HH
+#define PF_HISTOGRAM_HH
+
+#include <gtkmm.h>
+
+#include "../../base/image_stats.hh"
+
+namespace PF {
+
+
+  /* Widget displaying the per-channel histograms of an ImageStats object.
+   * The statistics are polled periodically, and the widget is redrawn
+   * only when they have changed.
+   */
+  class HistogramArea: public Gtk::DrawingArea
+  {
+    ImageStats* stats;
+    unsigned int serial;
+
+    sigc::connection timeout_connection;
+
+    bool check_stats();
+    void draw( const Cairo::RefPtr<Cairo::Context>& cr, int width, int height );
+
+#ifdef GTKMM_2
+    bool on_expose_event(GdkEventExpose* event);
+#endif
+#ifdef GTKMM_3
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr);
+#endif
+  public:
+    HistogramArea();
+    ~HistogramArea();
+
+    void set_stats( ImageStats* s ) { stats = s; serial = 0; queue_draw(); }
+    ImageStats* get_stats() { return stats; }
+  };
+
+
+}
+
+#endif
@@ -63,6 +63,9 @@
 #include <vips/vips.h>
 
 #include "base/pf_mkstemp.hh"
+#include "base/color_lut.hh"
+#include "base/memory_manager.hh"
+#include "base/shared_resources.hh"
 #include "base/imageprocessor.hh"
 #include "gui/mainwindow.hh"
 
@@ -119,6 +122,13 @@ int main (int argc, char *argv[])
   signal(SIGSEGV, handler);   // install our handler
 #endif
 
+  // Memory budget in MB, half of the physical memory by default.
+  // It must be set before initializing vips, see MemoryManager::init()
+  size_t memory_budget = 0;
+  if( getenv("PF_MEMORY_BUDGET") )
+    memory_budget = ((size_t)atol( getenv("PF_MEMORY_BUDGET") ))*1024*1024;
+  PF::MemoryManager::Instance().init( memory_budget );
+
   if (vips_init (argv[0]))
     //vips::verror ();
     return 1;
@@ -161,6 +171,31 @@ int main (int argc, char *argv[])
   PF::PhotoFlow::Instance().set_new_op_func_nogui( PF::new_operation );
   PF::PhotoFlow::Instance().set_batch( false );
 
+  // Load the lensfun database, the G'MIC commands and the built-in profiles
+  // while the user interface is being created
+  PF::SharedResources::Instance().start_background_init();
+
+  // Approximate the preview color conversions with 3D LUTs (33^3 nodes by default,
+  // 65^3 if PF_PREVIEW_LUT=65); the exported images always use the exact transforms
+  if( getenv("PF_PREVIEW_LUT") ) {
+    int lut_size = atoi( getenv("PF_PREVIEW_LUT") );
+    PF::PhotoFlow::Instance().set_preview_lut_size( (lut_size==65) ? 65 : PF_LUT3D_DEFAULT_SIZE );
+  }
+
+  // Store the floating-point preview caches in half precision (PF_PREVIEW_CACHE_HALF=1);
+  // the export caches always keep the full precision
+  if( getenv("PF_PREVIEW_CACHE_HALF") )
+    PF::PhotoFlow::Instance().set_preview_cache_half( atoi( getenv("PF_PREVIEW_CACHE_HALF") ) != 0 );
+
+  // Out-of-core mode for gigapixel images (PF_OUT_OF_CORE=1): the caches are filled
+  // tile-by-tile on demand, so that the memory use does not depend on the image size
+  if( getenv("PF_OUT_OF_CORE") )
+    PF::PhotoFlow::Instance().set_out_of_core( atoi( getenv("PF_OUT_OF_CORE") ) != 0 );
+
+  // Number of threads used for the image processing (PF_NUM_THREADS=n);
+  // by default the vips concurrency setting is used
+  PF::PhotoFlow::Instance().set_thread_budget( getenv("PF_NUM_THREADS") ? atoi( getenv("PF_NUM_THREADS") ) : 0 );
+
   std::cout<<"Starting image processor..."<<std::endl;
   PF::ImageProcessor::Instance().start();
   std::cout<<"Image processor started."<<std::endl;
@@ -36,7 +36,7 @@
 
 
 PF::AmazeDemosaicPar::AmazeDemosaicPar(): 
-  OpParBase()
+  DemosaicBasePar()
 {
   set_demand_hint( VIPS_DEMAND_STYLE_SMALLTILE );
   set_type( "amaze_demosaic" );
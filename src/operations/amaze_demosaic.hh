@@ -35,6 +35,7 @@
 #include <libraw/libraw.h>
 
 #include "../base/operation.hh"
+#include "demosaic_base.hh"
 #include "../rt/rtengine/rawimagesource.hh"
 
 
@@ -42,7 +43,7 @@
 namespace PF
 {
 
-  class AmazeDemosaicPar: public OpParBase
+  class AmazeDemosaicPar: public DemosaicBasePar
   {
   public:
     AmazeDemosaicPar();
@@ -130,8 +131,11 @@ namespace PF
 								VipsRegion* imap, VipsRegion* omap, 
 								VipsRegion* out, AmazeDemosaicPar* par) 
     {
+			VipsRegion* ireg = raw_wb_region( in[0], par );
+			if( !ireg ) return;
 			rtengine::RawImageSource rawimg;
-			rawimg.amaze_demosaic( in[0], out );
+			rawimg.amaze_demosaic( ireg, out );
+			g_object_unref( ireg );
     }
   };
 
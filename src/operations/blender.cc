@@ -27,6 +27,8 @@
 
 */
 
+#include <string.h>
+
 #include "blender.hh"
 #include "../base/processor.hh"
 #include "../base/new_operation.hh"
@@ -111,7 +113,10 @@ PF::BlenderPar::BlenderPar():
   blend_mode("blend_mode",this),
   opacity("opacity",this,1),
   shift_x("shift_x",this,0),
-  shift_y("shift_y",this,0)
+  shift_y("shift_y",this,0),
+  enabled( true ),
+  built_as_switch( false ),
+  passthrough_allowed( false )
 {
   white = PF::new_operation( "uniform", NULL );
   PropertyBase* R = white->get_par()->get_property( "R" );
@@ -124,6 +129,53 @@ PF::BlenderPar::BlenderPar():
   //blend_mode.set_enum_value( PF_BLEND_PASSTHROUGH );
   blend_mode.set_enum_value( PF_BLEND_NORMAL );
   set_type( "blender" );
+
+  blend_mode.set_hot( true );
+  opacity.set_hot( true );
+}
+
+
+int PF::BlenderPar::get_selected_input()
+{
+  if( !built_as_switch ) return -1;
+  if( !enabled ) return 0;
+  if( get_blend_mode() == PF_BLEND_PASSTHROUGH ) return 1;
+  if( (get_blend_mode() == PF_BLEND_NORMAL) && 
+      (get_opacity() > 0.999999f) && passthrough_allowed ) return 1;
+  return -1;
+}
+
+
+// The switch output inherits the pixel layout and the metadata of the background,
+// therefore the foreground can only be forwarded if they are equivalent
+static bool same_pixel_layout( VipsImage* img1, VipsImage* img2 )
+{
+  if( img1->Xsize != img2->Xsize || img1->Ysize != img2->Ysize ) return false;
+  if( img1->Bands != img2->Bands || img1->BandFmt != img2->BandFmt ) return false;
+  if( img1->Type != img2->Type ) return false;
+
+  void *data1, *data2;
+  size_t length1, length2;
+  bool has_profile1 = !vips_image_get_blob( img1, VIPS_META_ICC_NAME, &data1, &length1 );
+  bool has_profile2 = !vips_image_get_blob( img2, VIPS_META_ICC_NAME, &data2, &length2 );
+  if( has_profile1 != has_profile2 ) return false;
+  if( has_profile1 && (length1 != length2 || memcmp( data1, data2, length1 )) ) return false;
+  return true;
+}
+
+
+int PF::BlenderPar::get_masked_out_input()
+{
+  switch( get_blend_mode() ) {
+  case PF_BLEND_HARD_LIGHT:
+  case PF_BLEND_LUMI:
+  case PF_BLEND_COLOR:
+  case PF_BLEND_PASSTHROUGH:
+  case PF_BLEND_UNKNOWN:
+    return -1;
+  default:
+    return 0;
+  }
 }
 
 
@@ -178,37 +230,52 @@ VipsImage* PF::BlenderPar::build(std::vector<VipsImage*>& in, int first,
   // The mode will be forced to passthrough also when the blending mode is set to "normal",
   // the opacity is 100% and the opacity map is NULL, since in this case the underlying
   // image is useless. This improves performance for the default layer settings.
-  bool is_passthrough = false;
-  if( get_blend_mode() == PF_BLEND_PASSTHROUGH ) is_passthrough = true;
-  if( (get_blend_mode() == PF_BLEND_NORMAL) && 
-      (get_opacity() > 0.999999f) &&
-      same_size && (do_shift == false) &&
-      (omap == NULL) ) is_passthrough = true;
-
-  if( is_passthrough && (get_blend_mode() != PF_BLEND_PASSTHROUGH) ) {
+  passthrough_allowed = same_size && (do_shift == false) && (omap == NULL);
+  if( passthrough_allowed ) {
     switch( get_colorspace() ) {
     case PF_COLORSPACE_RGB:
       if( get_rgb_target_channel()>= 0 )
-        is_passthrough = false;
+        passthrough_allowed = false;
       break;
     case PF_COLORSPACE_LAB:
       if( get_lab_target_channel()>= 0 )
-        is_passthrough = false;
+        passthrough_allowed = false;
       break;
     case PF_COLORSPACE_CMYK:
       if( get_cmyk_target_channel()>= 0 )
-        is_passthrough = false;
+        passthrough_allowed = false;
       break;
     default:
       break;
     }
   }
 
-  // If both images are not NULL and the blending mode is not "passthrough-equivalent",
-  // we activate the blending code.
-  // In all other cases, one of the input images is copied to the output
-  // without further processing (and without any performance overhead)
-  if( (background != NULL) && (foreground != NULL) && (!is_passthrough) ) {
+  bool is_passthrough = false;
+  if( get_blend_mode() == PF_BLEND_PASSTHROUGH ) is_passthrough = true;
+  if( (get_blend_mode() == PF_BLEND_NORMAL) && 
+      (get_opacity() > 0.999999f) && passthrough_allowed ) is_passthrough = true;
+
+  built_as_switch = false;
+  if( (get_render_mode() == PF_RENDER_PREVIEW) &&
+      (background != NULL) && (foreground != NULL) &&
+      (do_shift == false) && same_pixel_layout( background, foreground ) ) {
+    // The passthrough and the actual blend are chosen at tile time,
+    // see get_selected_input()
+    std::vector<VipsImage*> in_;
+    in_.push_back( background );
+    in_.push_back( foreground );
+    set_image_hints( background );
+    outnew = PF::OpParBase::build( in_, first, NULL, omap, level );
+    if( outnew ) built_as_switch = true;
+  } else if( !enabled ) {
+    // Hidden layer that cannot be switched: the background is passed through
+    outnew = background ? background : foreground;
+    PF_REF( outnew, "BlenderPar::build() hidden layer ref" );
+  } else if( (background != NULL) && (foreground != NULL) && (!is_passthrough) ) {
+    // If both images are not NULL and the blending mode is not "passthrough-equivalent",
+    // we activate the blending code.
+    // In all other cases, one of the input images is copied to the output
+    // without further processing (and without any performance overhead)
     VipsImage* foreground2 = foreground;
     VipsImage* omap2 = omap;
 
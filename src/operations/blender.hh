@@ -48,6 +48,13 @@ namespace PF
 
     ProcessorBase* white;
 
+    // State of the switch: when the layer is hidden the background
+    // is copied to the output
+    bool enabled;
+    bool built_as_switch;
+    // Whether the foreground can replace the blend in "normal" mode at 100% opacity
+    bool passthrough_allowed;
+
     bool adjust_geom( VipsImage* in, VipsImage** out,
                       int width, int height, unsigned int level );
 
@@ -74,6 +81,26 @@ namespace PF
     bool has_intensity() { return false; }
     bool needs_input() { return false; }
 
+    /* Where the opacity map is zero the background is copied to the output,
+       except for the modes that blend the layers in reverse order (hard light)
+       or that do not give back the exact background values at zero opacity
+       (luminosity and color).
+       Where the map is one, the result is the same as without map.
+    */
+    int get_masked_out_input();
+    bool ignores_full_opacity_map() { return true; }
+
+    /* In the interactive pipelines the blender is built as a switch node, which
+       selects at tile time between the background, the foreground and the actual
+       blend. Visibility, blend mode and opacity changes then do not require to
+       re-build the pipeline; see LayerManager::get_hot_layers().
+    */
+    void set_enabled( bool e ) { enabled = e; }
+    bool is_enabled() { return enabled; }
+    bool is_switch() { return built_as_switch; }
+    int get_selected_input();
+    bool update_hot_values() { return built_as_switch; }
+
     VipsImage* build(std::vector<VipsImage*>& in, int first, 
                      VipsImage* imap, VipsImage* omap, 
                      unsigned int& level);
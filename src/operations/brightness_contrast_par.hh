@@ -8,6 +8,8 @@
       contrast("contrast",this,0) 
     {
       set_type( "brightness_contrast" );
+      brightness.set_hot( true );
+      contrast.set_hot( true );
     }
     float get_brightness() { return brightness.get(); }
     float get_contrast() { return contrast.get(); }
@@ -29,6 +29,7 @@
 
 #include "buffer.hh"
 #include "../base/processor.hh"
+#include "../base/disk_tile_cache.hh"
 
 //#include "../vips/vips_layer.h"
 
@@ -46,6 +47,14 @@ VipsImage* PF::BufferPar::build(std::vector<VipsImage*>& in, int first,
   std::cout<<"BufferPar::build(): type="<<get_type()<<"  format="<<get_format()<<std::endl;
 #endif
 
+  if( is_memoized() && in[0] ) {
+    bool half_float = (get_render_mode() == PF_RENDER_PREVIEW) &&
+        PF::PhotoFlow::Instance().get_preview_cache_half();
+    VipsImage* out = PF::disk_tile_cache( in[0], half_float );
+    if( out ) return out;
+    std::cout<<"PF::BufferPar::build(): cannot create the output memo"<<std::endl;
+  }
+
   g_object_ref( in[0] );
   return in[0];
 }
@@ -39,12 +39,18 @@ namespace PF
 
   class BufferPar: public OpParBase
   {
+    // Keep the computed tiles of the output in a disk cache, which is re-used
+    // as long as the layers inside the group and the group input do not change
+    Property<bool> memoize;
+
   public:
-    BufferPar(): OpParBase()
+    BufferPar(): OpParBase(), memoize("memoize",this,0)
     {
       set_type( "buffer" );
     }
 
+    bool is_memoized() { return memoize.get(); }
+
     /* Set processing hints:
        1. the intensity parameter makes no sense for a blending operation, 
           creation of an intensity map is not allowed
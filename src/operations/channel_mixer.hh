@@ -47,6 +47,9 @@ namespace PF
       blue_mix("blue_mix",this,0)
     {
       set_type( "channel_mixer" );
+      red_mix.set_hot( true );
+      green_mix.set_hot( true );
+      blue_mix.set_hot( true );
     }
     float get_red_mix() { return red_mix.get(); }
     float get_green_mix() { return green_mix.get(); }
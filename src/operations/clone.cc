@@ -400,6 +400,7 @@ VipsImage* PF::ClonePar::L2rgb(VipsImage* srcimg, unsigned int& level)
   in.clear(); in.push_back( greyimg );
   convert_cs->get_par()->set_image_hints( greyimg );
   convert_cs->get_par()->set_format( get_format() );
+  convert_cs->get_par()->set_render_mode( get_render_mode() );
   
   PF::ConvertColorspacePar* csconvpar = dynamic_cast<PF::ConvertColorspacePar*>(convert_cs->get_par());
   if(csconvpar) {
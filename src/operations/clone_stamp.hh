@@ -211,6 +211,28 @@ inline std::ostream& operator <<( std::ostream& str, const Stamp& pen )
 
 
 
+inline void to_binary( BinaryWriter& w, const Stamp& pen )
+{
+  w.put_uint( pen.get_size() );
+  w.put_float( pen.get_opacity() );
+  w.put_float( pen.get_smoothness() );
+}
+
+inline bool from_binary( BinaryReader& r, Stamp& pen )
+{
+  unsigned int size;
+  float opacity;
+  float smoothness;
+  if( !r.get_uint( size ) || !r.get_float( opacity ) || !r.get_float( smoothness ) )
+    return false;
+  pen.set_opacity( opacity );
+  pen.set_smoothness( smoothness );
+  pen.set_size( size );
+  return true;
+}
+
+
+
 class StrokesGroup
 {
   int delta_row, delta_col;
@@ -265,6 +287,25 @@ inline std::ostream& operator <<( std::ostream& str, const StrokesGroup& group )
 
 
 
+inline void to_binary( BinaryWriter& w, const StrokesGroup& group )
+{
+  w.put_int( group.get_delta_row() );
+  w.put_int( group.get_delta_col() );
+  to_binary( w, group.get_strokes() );
+}
+
+inline bool from_binary( BinaryReader& r, StrokesGroup& group )
+{
+  int delta_row, delta_col;
+  if( !r.get_int( delta_row ) || !r.get_int( delta_col ) ) return false;
+  if( !from_binary( r, group.get_strokes() ) ) return false;
+  group.set_delta_row( delta_row );
+  group.set_delta_col( delta_col );
+  return true;
+}
+
+
+
 template<> inline
 void set_gobject_property< std::vector<StrokesGroup> >(gpointer object, const std::string name,
     const std::vector<StrokesGroup>& value)
@@ -278,7 +319,7 @@ class CloneStampPar: public OpParBase
   Property<int> stamp_size;
   Property<float> stamp_opacity;
   Property<float> stamp_smoothness;
-  Property< std::vector<StrokesGroup> > strokes;
+  BinaryProperty< std::vector<StrokesGroup> > strokes;
 
   int scale_factor;
 
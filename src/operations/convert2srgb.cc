@@ -44,7 +44,8 @@ PF::Convert2sRGBPar::Convert2sRGBPar():
   OpParBase(),
   profile_in( NULL ),
   profile_out( NULL ),
-  transform( NULL )
+  transform( NULL ),
+  display_lut( false )
 {
   profile_out = cmsCreate_sRGBProfile();
   cmsSetLogErrorHandler( lcms2ErrorLogger );
@@ -91,10 +92,21 @@ VipsImage* PF::Convert2sRGBPar::build(std::vector<VipsImage*>& in, int first,
 				      profile_out, 
 				      outfmt,
 				      INTENT_PERCEPTUAL, cmsFLAGS_NOCACHE );
+
+      // The display conversion uses a pre-computed LUT if enabled, which is only
+      // re-computed when the input profile changes
+      int lut_size = PF::PhotoFlow::Instance().get_preview_lut_size();
+      if( transform && display_lut && (lut_size > 0) ) {
+        if( !lut.is_computed_for( profile_in, profile_out, lut_size ) )
+          lut.init( profile_in, profile_out, INTENT_PERCEPTUAL, lut_size );
+      } else {
+        lut.reset();
+      }
     }
   }
 
   if( !transform ) {
+    lut.reset();
 		//std::cout<<"Convert2sRGBPar::build(): null transform"<<std::endl;
     PF_REF( in[0], "Convert2sRGBPar::build(): null transform" );
     return( in[0] );
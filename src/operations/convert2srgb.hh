@@ -37,6 +37,7 @@
 #include <lcms2.h>
 
 #include "../base/format_info.hh"
+#include "../base/color_lut.hh"
 #include "../base/operation.hh"
 
 namespace PF 
@@ -48,6 +49,11 @@ namespace PF
     cmsHPROFILE profile_out;
     cmsHTRANSFORM transform;
 
+    // Pre-computed approximation of the transform, only used when the
+    // output goes to the screen
+    bool display_lut;
+    ColorLUT3D lut;
+
   public:
     Convert2sRGBPar();
     bool has_imap() { return false; }
@@ -55,6 +61,8 @@ namespace PF
     bool needs_input() { return true; }
 
     cmsHTRANSFORM get_transform() { return transform; }
+    ColorLUT3D* get_lut() { return( lut.is_valid() ? &lut : NULL ); }
+    void set_display_lut( bool val ) { display_lut = val; }
 
     void set_image_hints( VipsImage* img )
     {
@@ -91,6 +99,7 @@ namespace PF
     int height = r->height;
     int line_size = width * oreg->im->Bands; //layer->in_all[0]->Bands; 
     cmsHTRANSFORM transform = par->get_transform();
+    ColorLUT3D* lut = par->get_lut();
 
     T* p;    
     T* pout;
@@ -100,7 +109,10 @@ namespace PF
       
       p = ir ? (T*)VIPS_REGION_ADDR( ir[0], r->left, r->top + y ) : NULL; 
       pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
-      if(transform) {
+      // Float rows with values outside of [0,1] would be clipped by the LUT
+      if( lut && ColorLUT3D::in_domain( p, line_size ) ) {
+        lut->apply( p, pout, width );
+      } else if(transform) {
 	cmsDoTransform( transform, p, pout, width );
 	if( false && (r->left==0) && (r->top==0) && (y==0) ) {
 	  for(int xx  = 0; xx < line_size; xx++)
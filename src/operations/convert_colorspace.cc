@@ -29,6 +29,7 @@
 
 //#include <arpa/inet.h>
 
+#include "../base/shared_resources.hh"
 #include "convert_colorspace.hh"
 
 /* We need C linkage for this.
@@ -125,19 +126,19 @@ VipsImage* PF::ConvertColorspacePar::build(std::vector<VipsImage*>& in, int firs
     //std::cout<<"  out_profile_mode="<<out_profile_mode.get_enum_value().first<<std::endl;
     switch( out_profile_mode.get_enum_value().first ) {
     case OUT_PROF_sRGB:
-      out_profile = dt_colorspaces_create_srgb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_sRGB );
       //std::cout<<"ConvertColorspacePar::build(): created sRGB output profile"<<std::endl;
       break;
     case OUT_PROF_ADOBE:
-      out_profile = dt_colorspaces_create_adobergb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_ADOBE );
       //std::cout<<"ConvertColorspacePar::build(): created AdobeRGB output profile"<<std::endl;
       break;
     case OUT_PROF_PROPHOTO:
-      out_profile = dt_colorspaces_create_prophotorgb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_PROPHOTO );
       //std::cout<<"ConvertColorspacePar::build(): created ProPhoto output profile"<<std::endl;
       break;
     case OUT_PROF_LAB:
-      out_profile = dt_colorspaces_create_lab_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_LAB );
       //std::cout<<"ConvertColorspacePar::build(): created Lab output profile"<<std::endl;
       break;
     case OUT_PROF_CUSTOM:
@@ -166,6 +167,11 @@ VipsImage* PF::ConvertColorspacePar::build(std::vector<VipsImage*>& in, int firs
                                       INTENT_PERCEPTUAL, cmsFLAGS_NOCACHE );
     }
 
+    lut.reset();
+    int lut_size = PF::PhotoFlow::Instance().get_preview_lut_size();
+    if( transform && (get_render_mode() == PF_RENDER_PREVIEW) && (lut_size > 0) )
+      lut.init( in_profile, out_profile, INTENT_PERCEPTUAL, lut_size );
+
     if( out_profile) {
       output_cs_type = cmsGetColorSpace(out_profile);
       switch( output_cs_type ) {
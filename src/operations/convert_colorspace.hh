@@ -36,6 +36,7 @@
 
 #include <libraw/libraw.h>
 
+#include "../base/color_lut.hh"
 #include "../base/processor.hh"
 
 
@@ -67,6 +68,9 @@ namespace PF
 
     cmsHTRANSFORM transform;
 
+    // Pre-computed approximation of RGB -> RGB transforms, used for the preview
+    ColorLUT3D lut;
+
     ProcessorBase* convert2lab;
 
     cmsColorSpaceSignature input_cs_type;
@@ -77,6 +81,7 @@ namespace PF
     ConvertColorspacePar();
 
     cmsHTRANSFORM get_transform() { return transform; }
+    ColorLUT3D* get_lut() { return( lut.is_valid() ? &lut : NULL ); }
 
     int get_out_profile_mode() { return out_profile_mode.get_enum_value().first; }
     void set_out_profile_mode( output_profile_t mode ) { out_profile_mode.set_enum_value( mode ); }
@@ -134,12 +139,18 @@ namespace PF
       T* pout;
       int x, y;
 
+      // Integer pixel values are always within the LUT domain, therefore the LUT
+      // can be safely used in place of the exact transform when rendering the preview
+      ColorLUT3D* lut = PREVIEW ? opar->get_lut() : NULL;
+
       for( y = 0; y < height; y++ ) {
         p = (T*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
         pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
 
         pin = p;
-        if(opar->get_transform()) 
+        if( lut )
+          lut->apply( pin, pout, width );
+        else if(opar->get_transform()) 
           cmsDoTransform( opar->get_transform(), pin, pout, width );
         else 
           memcpy( pout, pin, sizeof(T)*line_size );
@@ -51,6 +51,23 @@ PF::CurvesPar::CurvesPar():
   CMYK_active_curve( "CMYK_active_curve", this, 8, "C", "C" )
 {
   set_type( "curves" );
+
+  // The curves only change the look-up tables used by the pixel loops
+  grey_curve.set_hot( true );
+  RGB_curve.set_hot( true );
+  R_curve.set_hot( true );
+  G_curve.set_hot( true );
+  B_curve.set_hot( true );
+  L_curve.set_hot( true );
+  a_curve.set_hot( true );
+  b_curve.set_hot( true );
+  C_curve.set_hot( true );
+  M_curve.set_hot( true );
+  Y_curve.set_hot( true );
+  K_curve.set_hot( true );
+  RGB_active_curve.set_hot( true );
+  Lab_active_curve.set_hot( true );
+  CMYK_active_curve.set_hot( true );
   
   RGB_active_curve.add_enum_value( 1, "RGB", "RGB" );
   RGB_active_curve.add_enum_value( 2, "R", "R" );
@@ -105,12 +122,8 @@ void PF::CurvesPar::update_curve( PF::Property<PF::SplineCurve>& curve,
 
 
 
-VipsImage* PF::CurvesPar::build(std::vector<VipsImage*>& in, int first, 
-				VipsImage* imap, VipsImage* omap, 
-				unsigned int& level)
+bool PF::CurvesPar::update_hot_values()
 {
-  VipsImage* out = PF::OpParBase::build( in, first, imap, omap, level );
-
   if( grey_curve.is_modified() ) {
 	  std::cout<<"update_curve( grey_curve, Greyvec8, Greyvec16 );"<<std::endl;std::cout.flush();
 	    update_curve( grey_curve, Greyvec8, Greyvec16 );
@@ -136,6 +149,18 @@ VipsImage* PF::CurvesPar::build(std::vector<VipsImage*>& in, int first,
       }
     }
   }
+  return true;
+}
+
+
+
+VipsImage* PF::CurvesPar::build(std::vector<VipsImage*>& in, int first, 
+				VipsImage* imap, VipsImage* omap, 
+				unsigned int& level)
+{
+  VipsImage* out = PF::OpParBase::build( in, first, imap, omap, level );
+
+  update_hot_values();
 
   if( L_curve.is_modified() )
     //update_curve( L_curve, Labvec8[0], Labvec16[0] );
@@ -83,6 +83,8 @@ namespace PF
 
     CurvesPar();
 
+    bool update_hot_values();
+
     VipsImage* build(std::vector<VipsImage*>& in, int first, 
                      VipsImage* imap, VipsImage* omap, 
                      unsigned int& level);
@@ -0,0 +1,123 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "demosaic_base.hh"
+
+//#define RT_EMU 1
+
+
+// Same range as the CLIP() function used by the raw processing
+#define RAW_WB_MAX 65535.0f
+
+
+static inline float raw_wb_clip( float val )
+{
+  return( (val < 0) ? 0 : ((val > RAW_WB_MAX) ? RAW_WB_MAX : val) );
+}
+
+
+void PF::raw_wb_row( const float* p, float* pout, int width, const float* mul )
+{
+  int x = 0;
+#ifdef __SSE2__
+  // Two raw pixels per vector: the multiplier of each pixel is selected with
+  // comparison masks on its color index, instead of a table lookup, and the
+  // color lanes are multiplied by one, so that no branch is needed
+  const __m128 m0 = _mm_set1_ps( mul[0] );
+  const __m128 m1 = _mm_set1_ps( mul[1] );
+  const __m128 m2 = _mm_set1_ps( mul[2] );
+  const __m128 m3 = _mm_set1_ps( mul[3] );
+  const __m128 c1 = _mm_set1_ps( 1.0f );
+  const __m128 c2 = _mm_set1_ps( 2.0f );
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 vmax = _mm_set1_ps( RAW_WB_MAX );
+  const __m128 color_lanes = _mm_castsi128_ps( _mm_set_epi32( -1, 0, -1, 0 ) );
+#ifdef RT_EMU
+  const __m128 emu_scale = _mm_set_ps( 1.0f, 65535.0f, 1.0f, 65535.0f );
+#endif
+  for( ; x < width-1; x += 2 ) {
+    __m128 v = _mm_loadu_ps( p + x*2 );
+    __m128 m = m3;
+    __m128 mask = _mm_cmpeq_ps( v, c2 );
+    m = _mm_or_ps( _mm_and_ps( mask, m2 ), _mm_andnot_ps( mask, m ) );
+    mask = _mm_cmpeq_ps( v, c1 );
+    m = _mm_or_ps( _mm_and_ps( mask, m1 ), _mm_andnot_ps( mask, m ) );
+    mask = _mm_cmpeq_ps( v, zero );
+    m = _mm_or_ps( _mm_and_ps( mask, m0 ), _mm_andnot_ps( mask, m ) );
+    // move the multiplier of each pixel from its color lane to its value lane
+    m = _mm_shuffle_ps( m, m, _MM_SHUFFLE(3,3,1,1) );
+    m = _mm_or_ps( _mm_and_ps( color_lanes, c1 ), _mm_andnot_ps( color_lanes, m ) );
+    v = _mm_min_ps( _mm_max_ps( _mm_mul_ps( v, m ), zero ), vmax );
+#ifdef RT_EMU
+    /* RawTherapee emulation */
+    v = _mm_mul_ps( v, emu_scale );
+#endif
+    _mm_storeu_ps( pout + x*2, v );
+  }
+#endif
+  for( ; x < width; x++ ) {
+    pout[x*2+1] = p[x*2+1];
+    pout[x*2] = raw_wb_clip( p[x*2] * mul[ ((int)p[x*2+1]) & 3 ] );
+#ifdef RT_EMU
+    /* RawTherapee emulation */
+    pout[x*2] *= 65535;
+#endif
+  }
+}
+
+
+VipsRegion* PF::raw_wb_region( VipsRegion* ireg, DemosaicBasePar* par )
+{
+  if( !ireg ) return NULL;
+  if( !par || !par->get_apply_wb() ) {
+    g_object_ref( ireg );
+    return ireg;
+  }
+
+  VipsRegion* reg = vips_region_new( ireg->im );
+  if( !reg ) return NULL;
+  if( vips_region_buffer( reg, &ireg->valid ) ) {
+    g_object_unref( reg );
+    return NULL;
+  }
+
+  const float* mul = par->get_wb_multipliers();
+  VipsRect* r = &ireg->valid;
+  for( int y = 0; y < r->height; y++ ) {
+    float* p = (float*)VIPS_REGION_ADDR( ireg, r->left, r->top + y );
+    float* pout = (float*)VIPS_REGION_ADDR( reg, r->left, r->top + y );
+    raw_wb_row( p, pout, r->width, mul );
+  }
+  return reg;
+}
@@ -0,0 +1,83 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+#ifndef DEMOSAIC_BASE_H
+#define DEMOSAIC_BASE_H
+
+#include <vips/vips.h>
+
+#include "../base/operation.hh"
+
+
+namespace PF
+{
+
+  /* Common base of the demosaicing operations.
+   * When white balance multipliers are set, the raw pixels are white balanced
+   * while they are loaded by the demosaicing step, instead of going through
+   * a separate pre-processing pass over the whole image.
+   */
+  class DemosaicBasePar: public OpParBase
+  {
+    bool apply_wb;
+    // Multipliers of the four CFA colors
+    float wb_mul[4];
+
+  public:
+    DemosaicBasePar(): OpParBase(), apply_wb( false )
+    {
+      for( int i = 0; i < 4; i++ ) wb_mul[i] = 1;
+    }
+
+    // NULL disables the white balance
+    void set_wb_multipliers( const float* mul )
+    {
+      apply_wb = (mul != NULL);
+      if( mul ) for( int i = 0; i < 4; i++ ) wb_mul[i] = mul[i];
+    }
+    bool get_apply_wb() { return apply_wb; }
+    const float* get_wb_multipliers() { return wb_mul; }
+  };
+
+
+  /* White balance and clipping of a row of "width" raw pixels, stored as
+   * (value, color) pairs of floats. The color indexes are copied unchanged.
+   */
+  void raw_wb_row( const float* p, float* pout, int width, const float* mul );
+
+  /* Input region of the demosaicing step, white balanced if the operation
+   * has multipliers set: in this case the pixels are copied into a new region
+   * over the same area. Returns a new reference, or NULL on failure.
+   */
+  VipsRegion* raw_wb_region( VipsRegion* ireg, DemosaicBasePar* par );
+}
+
+
+#endif
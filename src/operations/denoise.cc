@@ -27,6 +27,9 @@
 
  */
 
+#include <string.h>
+#include <stdlib.h>
+
 #include <vips/cimg_funcs.h>
 
 #include "denoise.hh"
@@ -43,9 +46,43 @@ PF::DenoisePar::DenoisePar():
   anisotropy("anisotropy",this,0.15),
   alpha("alpha",this,0.6),
   sigma("sigma",this,1.1),
-	nr_mode("nr_mode",this,PF_NR_ANIBLUR,"ANIBLUR","Anisotropic Blur (G'Mic)")
+	nr_mode("nr_mode",this,PF_NR_NLMEANS,"NLMEANS","Non-local means"),
+  nlm_patch_radius("nlm_patch_radius",this,2),
+  nlm_search_radius("nlm_search_radius",this,5),
+  nlm_strength("nlm_strength",this,30),
+  patch_radius( 0 ), search_radius( 0 ), strength( 0 ), built_level( 0 )
 {	
+	nr_mode.add_enum_value(PF_NR_NLMEANS,"NLMEANS","Non-local means");
+	nr_mode.add_enum_value(PF_NR_ANIBLUR,"ANIBLUR","Anisotropic Blur (G'Mic)");
+
+  set_demand_hint( VIPS_DEMAND_STYLE_SMALLTILE );
   set_type( "denoise" );
+
+  nlm_strength.set_hot( true );
+}
+
+
+float PF::DenoisePar::get_scaled_strength( unsigned int level )
+{
+  // The strength is expressed in thousandths of the full pixel range.
+  // At reduced pyramid levels the noise is averaged out, therefore
+  // the strength is scaled down accordingly
+  float result = nlm_strength.get() / 1000;
+  for( unsigned int l = 1; l <= level; l++ )
+    result /= 2;
+  return result;
+}
+
+
+bool PF::DenoisePar::update_hot_values()
+{
+  // A zero strength turns the operation into a pass-through,
+  // which changes the structure of the pipeline
+  if( nr_mode.get_enum_value().first != PF_NR_NLMEANS ) return false;
+  float new_strength = get_scaled_strength( built_level );
+  if( strength <= 0 || new_strength <= 0 ) return false;
+  strength = new_strength;
+  return true;
 }
 
 
@@ -61,6 +98,28 @@ VipsImage* PF::DenoisePar::build(std::vector<VipsImage*>& in, int first,
 
   if( !out ) return NULL;
 
+	if( nr_mode.get_enum_value().first == PF_NR_NLMEANS ) {
+		// Like the strength, the radii are scaled down at reduced pyramid levels
+		built_level = level;
+		patch_radius = nlm_patch_radius.get();
+		search_radius = nlm_search_radius.get();
+		strength = get_scaled_strength( level );
+		for( unsigned int l = 1; l <= level; l++ ) {
+			patch_radius /= 2;
+			search_radius /= 2;
+		}
+		if( patch_radius < 0 ) patch_radius = 0;
+		if( search_radius < 1 ) search_radius = 1;
+
+		if( strength <= 0 ) {
+			PF_REF( out, "PF::DenoisePar::build(): out ref" );
+			return out;
+		}
+		std::vector<VipsImage*> in2;
+		in2.push_back( srcimg );
+		return PF::OpParBase::build( in2, 0, NULL, NULL, level );
+	}
+
 	if( (get_render_mode() == PF_RENDER_PREVIEW && level>0) ) {
 		PF_REF( out, "PF::DenoisePar::build(): out ref" );
 		return out;
@@ -80,6 +139,130 @@ VipsImage* PF::DenoisePar::build(std::vector<VipsImage*>& in, int first,
 }
 
 
+// Approximation of exp(-x) for x >= 0, computed as (1-x/64)^64.
+// It does not involve any function call, so that the weight loops can be vectorized.
+static inline float nlm_weight( float x )
+{
+  float t = 1.0f - x*(1.0f/64);
+  t = (t > 0) ? t : 0;
+  t *= t; t *= t; t *= t; t *= t; t *= t; t *= t;
+  return t;
+}
+
+
+void PF::nlmeans_filter( const float* in, float* out, int width, int height, int nb,
+                         int patch_radius, int search_radius, float strength )
+{
+  const int pad = patch_radius + search_radius;
+  const int in_stride = (width + pad*2) * nb;
+  const int line_size = width * nb;
+  const int npatch = 2*patch_radius + 1;
+
+  if( strength <= 0 ) {
+    for( int y = 0; y < height; y++ )
+      memcpy( out + y*line_size, in + (pad+y)*in_stride + pad*nb, sizeof(float)*line_size );
+    return;
+  }
+
+  // The squared differences are needed over the output area enlarged by the patch radius
+  const int dh = height + patch_radius*2;
+  const int dline = (width + patch_radius*2) * nb;
+  const float norm = 1.0f / (strength*strength*npatch*npatch*nb);
+
+  float* diff = (float*)malloc( sizeof(float)*dline*dh );
+  float* hsum = (float*)malloc( sizeof(float)*line_size*dh );
+  float* vsum = (float*)malloc( sizeof(float)*line_size );
+  float* wrow = (float*)malloc( sizeof(float)*width );
+  float* wsum = (float*)malloc( sizeof(float)*width*height );
+  float* acc = (float*)malloc( sizeof(float)*line_size*height );
+  if( !diff || !hsum || !vsum || !wrow || !wsum || !acc ) {
+    std::cout<<"nlmeans_filter(): cannot allocate temporary buffers"<<std::endl;
+    if( diff ) free( diff );
+    if( hsum ) free( hsum );
+    if( vsum ) free( vsum );
+    if( wrow ) free( wrow );
+    if( wsum ) free( wsum );
+    if( acc ) free( acc );
+    return;
+  }
+  memset( wsum, 0, sizeof(float)*width*height );
+  memset( acc, 0, sizeof(float)*line_size*height );
+
+  for( int dy = -search_radius; dy <= search_radius; dy++ ) {
+    for( int dx = -search_radius; dx <= search_radius; dx++ ) {
+      const int offset = dy*in_stride + dx*nb;
+
+      // Squared differences between the image and its shifted copy
+      for( int y = 0; y < dh; y++ ) {
+        const float* a = in + (search_radius+y)*in_stride + search_radius*nb;
+        const float* b = a + offset;
+        float* d = diff + y*dline;
+        for( int j = 0; j < dline; j++ ) {
+          float delta = a[j] - b[j];
+          d[j] = delta*delta;
+        }
+      }
+
+      // Horizontal box sums over the patch width
+      for( int y = 0; y < dh; y++ ) {
+        const float* d = diff + y*dline;
+        float* h = hsum + y*line_size;
+        for( int j = 0; j < line_size; j++ ) h[j] = d[j];
+        for( int k = 1; k < npatch; k++ ) {
+          const float* dk = d + k*nb;
+          for( int j = 0; j < line_size; j++ ) h[j] += dk[j];
+        }
+      }
+
+      // Vertical running sums over the patch height, and accumulation of the weighted pixels
+      for( int j = 0; j < line_size; j++ ) vsum[j] = 0;
+      for( int k = 0; k < npatch; k++ ) {
+        const float* h = hsum + k*line_size;
+        for( int j = 0; j < line_size; j++ ) vsum[j] += h[j];
+      }
+      for( int y = 0; y < height; y++ ) {
+        for( int x = 0; x < width; x++ ) {
+          float dist = 0;
+          for( int b = 0; b < nb; b++ ) dist += vsum[x*nb+b];
+          wrow[x] = nlm_weight( dist*norm );
+        }
+
+        const float* b = in + (pad+y)*in_stride + pad*nb + offset;
+        float* ws = wsum + y*width;
+        float* pacc = acc + y*line_size;
+        for( int x = 0; x < width; x++ ) {
+          ws[x] += wrow[x];
+          for( int ch = 0; ch < nb; ch++ )
+            pacc[x*nb+ch] += wrow[x] * b[x*nb+ch];
+        }
+
+        if( y < height-1 ) {
+          const float* hin = hsum + (y+npatch)*line_size;
+          const float* hout = hsum + y*line_size;
+          for( int j = 0; j < line_size; j++ ) vsum[j] += hin[j] - hout[j];
+        }
+      }
+    }
+  }
+
+  // The weight of the central pixel is always 1, so that wsum is never zero
+  for( int y = 0; y < height; y++ ) {
+    for( int x = 0; x < width; x++ ) {
+      float scale = 1.0f / wsum[y*width+x];
+      for( int ch = 0; ch < nb; ch++ )
+        out[y*line_size+x*nb+ch] = acc[y*line_size+x*nb+ch] * scale;
+    }
+  }
+
+  free( diff );
+  free( hsum );
+  free( vsum );
+  free( wrow );
+  free( wsum );
+  free( acc );
+}
+
+
 PF::ProcessorBase* PF::new_denoise()
 {
   return( new PF::Processor<PF::DenoisePar,PF::DenoiseProc>() );
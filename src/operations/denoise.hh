@@ -34,16 +34,28 @@
 #include <string>
 
 #include "../base/processor.hh"
+#include "../base/color.hh"
 
 
 namespace PF 
 {
 
 	enum denoise_mode_t {
-		PF_NR_ANIBLUR
+		PF_NR_ANIBLUR,
+		PF_NR_NLMEANS
 	};
 
 
+  /* Non-local means filtering of a buffer of nb interleaved float channels.
+   * The input buffer has (width+2*pad)x(height+2*pad) pixels, with
+   * pad = patch_radius + search_radius, while the output one has width x height pixels.
+   * The cost per pixel is proportional to the size of the search window,
+   * and does not depend on the patch size.
+   */
+  void nlmeans_filter( const float* in, float* out, int width, int height, int nb,
+                       int patch_radius, int search_radius, float strength );
+
+
   class DenoisePar: public OpParBase
   {
     Property<int> iterations;
@@ -53,6 +65,17 @@ namespace PF
     Property<float> alpha; 
     Property<float> sigma;
 		PropertyBase nr_mode;
+    Property<int> nlm_patch_radius;
+    Property<int> nlm_search_radius;
+    Property<float> nlm_strength;
+
+    // Non-local means parameters, scaled to the current pyramid level
+    int patch_radius, search_radius;
+    float strength;
+    // pyramid level for which the operation was last built
+    unsigned int built_level;
+
+    float get_scaled_strength( unsigned int level );
 
   public:
     DenoisePar();
@@ -60,7 +83,34 @@ namespace PF
     bool has_intensity() { return false; }
     bool has_opacity() { return false; }
 
-      
+    int get_patch_radius() { return patch_radius; }
+    int get_search_radius() { return search_radius; }
+    float get_strength() { return strength; }
+
+    bool update_hot_values();
+
+    /* Function to derive the output area from the input area
+     */
+    virtual void transform(const Rect* rin, Rect* rout)
+    {
+			int pad = patch_radius + search_radius;
+      rout->left = rin->left+pad;
+      rout->top = rin->top+pad;
+      rout->width = rin->width-pad*2;
+      rout->height = rin->height-pad*2;
+    }
+       
+    /* Function to derive the area to be read from input images,
+       based on the requested output area
+    */
+    virtual void transform_inv(const Rect* rout, Rect* rin)
+    {
+			int pad = patch_radius + search_radius;
+      rin->left = rout->left-pad;
+      rin->top = rout->top-pad;
+      rin->width = rout->width+pad*2;
+      rin->height = rout->height+pad*2;
+    }
 
     VipsImage* build(std::vector<VipsImage*>& in, int first, 
 		     VipsImage* imap, VipsImage* omap, 
@@ -69,21 +119,67 @@ namespace PF
 
   
 
+  /* Non-local means denoising. The input region is padded by the patch and
+   * search radii; pixels outside of the image are replaced by the nearest
+   * valid one, so that each tile can be computed independently.
+   */
   template < OP_TEMPLATE_DEF > 
   class DenoiseProc
   {
   public: 
     void render(VipsRegion** ireg, int n, int in_first,
 		VipsRegion* imap, VipsRegion* omap, 
-		VipsRegion* oreg, OpParBase* par)
+		VipsRegion* oreg, DenoisePar* par)
     {
-			
+			if( !par ) return;
+			Rect *ir = &(ireg[0]->valid);
+			Rect *r = &oreg->valid;
+			const int nb = oreg->im->Bands;
+			const int pad = par->get_patch_radius() + par->get_search_radius();
+			const int pw = r->width + pad*2;
+			const int ph = r->height + pad*2;
+			const int line_size = r->width * nb;
+
+			float* in = (float*)malloc( sizeof(float)*pw*ph*nb );
+			float* out = (float*)malloc( sizeof(float)*line_size*r->height );
+			if( !in || !out ) {
+				std::cout<<"DenoiseProc::render(): cannot allocate temporary buffers"<<std::endl;
+				if( in ) free( in );
+				if( out ) free( out );
+				return;
+			}
+
+			float* pin = in;
+			for( int y = 0; y < ph; y++ ) {
+				int iy = r->top - pad + y;
+				if( iy < ir->top ) iy = ir->top;
+				if( iy >= ir->top+ir->height ) iy = ir->top+ir->height-1;
+				T* p = (T*)VIPS_REGION_ADDR( ireg[0], ir->left, iy );
+				for( int x = 0; x < pw; x++ ) {
+					int ix = r->left - pad + x - ir->left;
+					if( ix < 0 ) ix = 0;
+					if( ix >= ir->width ) ix = ir->width-1;
+					for( int b = 0; b < nb; b++, pin++ )
+						to_float( p[ix*nb+b], *pin );
+				}
+			}
+
+			nlmeans_filter( in, out, r->width, r->height, nb, par->get_patch_radius(),
+											par->get_search_radius(), par->get_strength() );
+
+			float* pout = out;
+			for( int y = 0; y < r->height; y++ ) {
+				T* p = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y );
+				for( int x = 0; x < line_size; x++, pout++ )
+					from_float( *pout, p[x] );
+			}
+
+			free( in );
+			free( out );
     }
   };
 
 
-
-
   ProcessorBase* new_denoise();
 }
 
@@ -113,6 +113,7 @@ VipsImage* PF::DesaturatePar::build(std::vector<VipsImage*>& in, int first,
       in2.clear(); in2.push_back( greyimg );
       convert_cs->get_par()->set_image_hints( greyimg );
       convert_cs->get_par()->set_format( get_format() );
+      convert_cs->get_par()->set_render_mode( get_render_mode() );
   
       PF::ConvertColorspacePar* csconvpar = dynamic_cast<PF::ConvertColorspacePar*>(convert_cs->get_par());
       if(csconvpar) {
@@ -100,7 +100,7 @@ namespace PF
     Property<RGBColor> bgd_color;
     Property<int> pen_size;
     Property<float> pen_opacity;
-    Property< std::list< Stroke<Pencil> > > strokes;
+    BinaryProperty< std::list< Stroke<Pencil> > > strokes;
 
 		ProcessorBase* diskbuf;
     RawBuffer* rawbuf;
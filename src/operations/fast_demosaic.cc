@@ -36,7 +36,7 @@
 
 
 PF::FastDemosaicPar::FastDemosaicPar(): 
-  OpParBase(), invGrad( 0x10000 )
+  DemosaicBasePar(), invGrad( 0x10000 )
 {
   //set up directional weight function
   for (int i=0; i<0x10000; i++)
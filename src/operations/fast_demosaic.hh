@@ -36,6 +36,7 @@
 
 #include "../base/operation.hh"
 #include "../base/rawmatrix.hh"
+#include "demosaic_base.hh"
 
 
 // bit representations of flags
@@ -239,7 +240,7 @@ inline const _Tp& max(const _Tp& a, const _Tp& b, const _Tp& c, const _Tp& d) {
 
 
 
-class FastDemosaicPar: public OpParBase
+class FastDemosaicPar: public DemosaicBasePar
 {
   PF_LUTf invGrad;
 
@@ -316,8 +317,11 @@ public:
       VipsRegion* imap, VipsRegion* omap,
       VipsRegion* out, FastDemosaicPar* par)
   {
-    fast_demosaic( in, n, in_first,
+    VipsRegion* ireg = raw_wb_region( in[in_first], par );
+    if( !ireg ) return;
+    fast_demosaic( &ireg, 1, 0,
         imap, omap, out, par );
+    g_object_unref( ireg );
   }
 };
 
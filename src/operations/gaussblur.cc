@@ -36,10 +36,11 @@
 PF::GaussBlurPar::GaussBlurPar(): 
   BlenderPar(),
   radius("radius",this,5),
-	preview_mode("preview_mode",this,PF_BLUR_FAST,"FAST","Fast")
+	preview_mode("preview_mode",this,PF_BLUR_NATIVE,"NATIVE","Fast (preview and export)")
 {
 	preview_mode.add_enum_value(PF_BLUR_FAST,"FAST","Fast");
 	preview_mode.add_enum_value(PF_BLUR_EXACT,"ACCURATE","Accurate");
+	preview_mode.add_enum_value(PF_BLUR_NATIVE,"NATIVE","Fast (preview and export)");
 	
   convert_format = new PF::Processor<PF::ConvertFormatPar,PF::ConvertFormatProc>();
 
@@ -48,6 +49,14 @@ PF::GaussBlurPar::GaussBlurPar():
 }
 
 
+// Documents that do not store the blur mode were created when "Fast" was
+// the default, and keep exporting through the vips convolution
+void PF::GaussBlurPar::set_legacy_defaults()
+{
+	preview_mode.set_enum_value( PF_BLUR_FAST );
+}
+
+
 
 VipsImage* PF::GaussBlurPar::build(std::vector<VipsImage*>& in, int first, 
 				   VipsImage* imap, VipsImage* omap, 
@@ -68,24 +77,26 @@ VipsImage* PF::GaussBlurPar::build(std::vector<VipsImage*>& in, int first,
 		return blurred;
 	}
 
-	sii_precomp( &coeffs, radius2, 3 );
-
-	
-	if( (get_render_mode() == PF_RENDER_PREVIEW) &&
-			(preview_mode.get_enum_value().first == PF_BLUR_FAST) &&
-			(radius2 > 5) ){
+	// The "native" mode, which is the default for new layers, uses the native
+	// blur in both preview and export mode, so that the two give the same result.
+	// The "Fast" mode, kept for documents that do not specify any mode, only
+	// uses it for the preview, so that the export of those documents is not changed.
+	int mode = preview_mode.get_enum_value().first;
+	bool native = (mode == PF_BLUR_NATIVE) ||
+			( (mode == PF_BLUR_FAST) && (get_render_mode() == PF_RENDER_PREVIEW) );
+	if( srcimg && native && (radius2 > PF_BLUR_SII_MIN_RADIUS) ){
+		sii_precomp( &coeffs, radius2, 3 );
 		VipsImage* outnew = PF::OpParBase::build( in, first, NULL, omap, level );
 		return outnew;
 	}
-	
+
 
   if( srcimg ) {
     int size = (srcimg->Xsize > srcimg->Ysize) ? srcimg->Xsize : srcimg->Ysize;
   
 		float accuracy = 0.05;
 		VipsPrecision precision = VIPS_PRECISION_FLOAT;
-		if( get_render_mode() == PF_RENDER_PREVIEW &&
-				(preview_mode.get_enum_value().first == PF_BLUR_FAST) ) {
+		if( (mode == PF_BLUR_FAST) && (get_render_mode() == PF_RENDER_PREVIEW) ) {
 			accuracy = 0.2;
 			//if( radius2 > 2 )
 			//	precision = VIPS_PRECISION_APPROXIMATE;
@@ -40,12 +40,26 @@
 #include "gaussian_conv_sii.hh"
 
 
+// Radius above which the native blur is used instead of the vips convolution.
+// The cost per pixel of the vips convolution grows as O(R). The native blur
+// has a constant cost per input pixel, but each output tile of size T reads
+// an input area padded by R on each side, hence the cost per output pixel
+// grows as O((1+2R/T)^2).
+#define PF_BLUR_SII_MIN_RADIUS 5
+
+
 namespace PF 
 {
 
 	enum gaussblur_preview_mode_t {
+		// native blur in preview mode, vips convolution when exporting;
+		// only used by documents that do not store the mode
 		PF_BLUR_FAST,
-		PF_BLUR_EXACT
+		// vips convolution in all modes
+		PF_BLUR_EXACT,
+		// native blur in all modes, so that preview and export are identical;
+		// default for new layers
+		PF_BLUR_NATIVE
 	};
 
 
@@ -60,7 +74,11 @@ namespace PF
     GaussBlurPar();
 
     bool has_intensity() { return false; }
+    // Large radii are still cached: the padded input areas make the
+    // upstream layers compute each pixel about (1+2R/T)^2 times, which
+    // would otherwise be repeated whenever a layer above is edited
     bool needs_caching() { return( radius.get() >= 50 ); }
+    void set_legacy_defaults();
 
 		sii_coeffs& get_coeffs() { return coeffs; }
 
@@ -95,94 +113,58 @@ namespace PF
 
   
 
-  template < OP_TEMPLATE_DEF > 
-  class GaussBlurProc
-  {
-  public: 
-    void render(VipsRegion** ireg, int n, int in_first,
-		VipsRegion* imap, VipsRegion* omap, 
-		VipsRegion* oreg, OpParBase* par)
-    {
-			
-    }
-  };
+#include "gaussian_conv_sii_imp.hh"
 
 
-  template < OP_TEMPLATE_DEF_PREVIEW_SPEC > 
-  class GaussBlurProc<OP_TEMPLATE_IMP_PREVIEW_SPEC(true)>
+  /* Native blur, used for large radii in preview mode, and also when exporting
+   * if the PF_BLUR_NATIVE mode is selected.
+   * The rows are first blurred into a floating-point buffer, which is then
+   * blurred vertically. The input region is padded by the largest box radius,
+   * so that the result does not depend on the tile position.
+   */
+  template < OP_TEMPLATE_DEF > 
+  class GaussBlurProc
   {
-		void sii_gaussian_conv_h(sii_coeffs& c, T *dest, double *buffer, const T *src, 
-														 long start, long N, long width);
-		void sii_gaussian_conv_v(sii_coeffs& c, T *dest, double *buffer, const T *src, 
-														 long start, long N, long heigth, long src_stride, long dest_stride);
-
   public: 
     void render(VipsRegion** ireg, int n, int in_first,
 								VipsRegion* imap, VipsRegion* omap, 
-								VipsRegion* oreg, OpParBase* par)
+								VipsRegion* oreg, GaussBlurPar* par)
     {
-			GaussBlurPar* gpar = dynamic_cast<GaussBlurPar*>(par);
-			if( !gpar ) return;
+			if( !par ) return;
+			sii_coeffs& coeffs = par->get_coeffs();
 			Rect *ir = &(ireg[0]->valid);
 			Rect *r = &oreg->valid;
-			//int sz = oreg->im->Bands;//IM_REGION_N_ELEMENTS( oreg );
-			//int line_size = r->width * oreg->im->Bands; //layer->in_all[0]->Bands; 
-			const int NCH = PF::ColorspaceInfo<CS>::NCH;
-			const int out_stride = VIPS_REGION_LSKIP( oreg )/sizeof(T)/oreg->im->Bands;
-
-			T* p;
-			T* pout;
+			const int nb = oreg->im->Bands;
+			const long line_size = (long)r->width * nb;
+			const long out_stride = VIPS_REGION_LSKIP( oreg )/sizeof(T);
 
 			// Temporary buffer to hold the row blur step
-			long buf_width = r->width;
-			long buf_width2 = buf_width*NCH;
-			long buf_height = ir->height;
-			//long buf_stride = buf_width;
-			T* row_buf = (T*)malloc(sizeof(T)*NCH*buf_width*buf_height);
-			T* row_buf_y = row_buf;
-			T* row_buf_x = row_buf;
-
-			long tmp_buf_size = sii_buffer_size( gpar->get_coeffs(), 
-																					 ( (r->width>ir->height) ? r->width : ir->height ) );
-			double* tmp_buf = (double*)malloc(sizeof(double)*NCH*tmp_buf_size);
-
-			//std::cout<<"tmp_buf_size: "<<NCH*tmp_buf_size<<std::endl;
-
-			int x, y;
-			//int ch, dx=CHMAX-CHMIN+1, CHMAXplus1=CHMAX+1;
-			//int ximap, ni;
-			int pad = gpar->get_coeffs().radii[0] + 1; 
-    
-			for( y = 0; y < ir->height; y++ ) {
-      
-				p = (T*)VIPS_REGION_ADDR( ireg[0], r->left, ir->top + y ); 
-				pout = (T*)VIPS_REGION_ADDR( oreg, r->left, ir->top + y ); 
-				row_buf_y = &(row_buf[buf_width2*y]);
-
-				sii_gaussian_conv_h(gpar->get_coeffs(), row_buf_y, tmp_buf, p, r->left, r->width, oreg->im->Xsize);
-				//sii_gaussian_conv_h(gpar->get_coeffs(), pout, tmp_buf, p, r->left, r->width, oreg->im->Xsize);
-				//row_buf_y += NCH*buf_width;
-			}			
-    
-			int voffs = r->top - ir->top;
-			for( x = 0; x < r->width; x++ ) {
-      
-				row_buf_x = &(row_buf[buf_width2*voffs+NCH*x]);
-				//p = (T*)VIPS_REGION_ADDR( ireg[0], r->left+x, r->top ); 
-				pout = (T*)VIPS_REGION_ADDR( oreg, r->left+x, r->top ); 
-
-				sii_gaussian_conv_v(gpar->get_coeffs(), pout, tmp_buf, row_buf_x, r->top, r->height, oreg->im->Ysize, buf_width, out_stride );
-			}	
+			float* row_buf = (float*)malloc( sizeof(float)*line_size*ir->height );
+			// Running box sums, plus one line for the vertical step output
+			double* acc = (double*)malloc( sizeof(double)*(coeffs.K+1)*line_size );
+			if( !row_buf || !acc ) {
+				std::cout<<"GaussBlurProc::render(): cannot allocate temporary buffers"<<std::endl;
+				if( row_buf ) free( row_buf );
+				if( acc ) free( acc );
+				return;
+			}
+
+			for( int y = 0; y < ir->height; y++ ) {
+				T* p = (T*)VIPS_REGION_ADDR( ireg[0], ir->left, ir->top + y ); 
+				sii_gaussian_conv_h( coeffs, row_buf + line_size*y, acc, p,
+														 r->left - ir->left, r->width, ir->width, nb );
+			}
+
+			T* pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top ); 
+			sii_gaussian_conv_v( coeffs, pout, out_stride, acc, row_buf,
+													 r->top - ir->top, r->height, ir->height, line_size );
 
 			free( row_buf );
-			free( tmp_buf );
+			free( acc );
     }
   };
 
 
-#include "gaussian_conv_sii_imp.hh"
-
-
   ProcessorBase* new_gaussblur();
 }
 
@@ -53,184 +53,112 @@
 
 /**
  * \brief Gaussian convolution SII approximation
- * \param c         sii_coeffs created by sii_precomp()
- * \param dest      output convolved data
- * \param buffer    array with space for sii_buffer_size() samples
- * \param src       input, modified in-place if src = dest
- * \param N         number of samples
- * \param stride    stride between successive samples
  *
- * This routine performs stacked integral images approximation of Gaussian
- * convolution with half-sample symmetric boundary handling. The buffer array
- * is used to store the cumulative sum of the input, and must have space for
- * at least sii_buffer_size(c,N) samples.
+ * The Gaussian is approximated as a weighted sum of K box filters, as in
+ * the original implementation. Instead of storing the cumulative sum of
+ * the input, the K box sums are kept as running sums that are updated
+ * incrementally, so that the cost of the convolution itself does not depend
+ * on the radius.
  *
- * The convolution can be performed in-place by setting `src` = `dest` (the
- * source array is overwritten with the result). However, the buffer array
- * must be distinct from `src` and `dest`.
+ * When the image is processed in tiles, the input of each tile is padded by
+ * the largest box radius R. The rows of the padding are blurred horizontally
+ * again for every tile, and the running sums are primed over R samples at
+ * the start of each row and column, so for a TxT tile the cost per output
+ * pixel grows as O(1 + R/T).
+ *
+ * The output of each pixel only depends on the input samples within the
+ * largest box radius, with the samples outside of the valid input area
+ * replaced by the nearest valid one. Tiles computed independently therefore
+ * give the same result as a single pass over the whole image, both in
+ * preview and in export mode.
  */
 /*
 	Separated into horizontal and vertical steps and adapted to PhotoFlow 08/2014
+	Rewritten with running box sums and row-wise vertical step
  */
-	template < OP_TEMPLATE_DEF_PREVIEW_SPEC > 
-	void GaussBlurProc<OP_TEMPLATE_IMP_PREVIEW_SPEC(true)>::sii_gaussian_conv_h(sii_coeffs& c, T *dest, double *buffer, const T *src, 
-																																							long start, long N, long width)
-	{
-		const int NCH = PF::ColorspaceInfo<CS>::NCH;
-
-		//return;
-    
-		double accum[10/*NCH*/];
-		long pad, pad2, N2, n, n2, n3, ch, stride2, x_start = 0, x_end = width-1, x_end2 = x_end*NCH, x0, x1, x2, x3;
-		int k;
-
-		assert(dest && buffer && src && N > 0);
-    
-		pad = c.radii[0] + 1; //pad=0;
-		pad2 = pad * NCH;
-		buffer += pad2;
-
-		N2 = N * NCH;
-		x0 = (start - pad) * NCH;
-		x1 = start * NCH;
-		x2 = (start + N - 1) * NCH;
-		x3 = (start + N + pad - 1) * NCH;
-		stride2 = NCH;
-
-		for (ch = CHMIN; ch <= CHMAX; ++ch) accum[ch] = 0; 
-
-		/* Compute cumulative sum of src over n = -pad,..., N + pad - 1. */
-		//std::cout<<"1) left edge: x0="<<x0<<"  x3="<<x3<<"  x_start="<<x_start<<std::endl;
-		for (n = x0, n2 = -pad2, n3 = -pad*stride2;
-				 n < (x3<x_start ? x3 : x_start); 
-				 n += NCH, n2 += NCH, n3 += stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[ch];
-				//std::cout<<"1) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-
-		//std::cout<<"2) image: n="<<n<<"  x3="<<x3<<"  x_end2="<<x_end2<<std::endl;
-		for (; n <= (x3<x_end2 ? x3 : x_end2); n += NCH, n2 += NCH, n3 += stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[n3+ch];
-				//std::cout<<"2) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-
-		//std::cout<<"3) right edge: n="<<x_end2+1<<"  x3="<<x3<<"  x_end2="<<x_end2<<std::endl;
-		for (n = x_end2+1; n <= x3; n += NCH, n2 += NCH, n3 += stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[N2+ch];
-				//std::cout<<"3) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-    
-		long n1k[SII_MAX_K];
-		long n2k[SII_MAX_K];
-		/* Compute stacked box filters. */
-		for (n = 0; n < N; ++n, dest += stride2) {
-			for (k = 0; k < c.K; ++k) {
-				n1k[k] = (n + c.radii[k]) * NCH;
-				n2k[k] = (n - c.radii[k] - 1) * NCH;
-			}
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] = c.weights[0] * (buffer[n1k[0] + ch]
-																		- buffer[n2k[0] + ch]);
-        
-				for (k = 1; k < c.K; ++k)
-					accum[ch] += c.weights[k] * (buffer[n1k[k] + ch]
-																			 - buffer[n2k[k] + ch]);
-        
-				dest[ch] = (T)accum[ch];
-			}
-		}
-			
-		return;
-	}
-
-
-
-	template < OP_TEMPLATE_DEF_PREVIEW_SPEC > 
-	void GaussBlurProc<OP_TEMPLATE_IMP_PREVIEW_SPEC(true)>::sii_gaussian_conv_v(sii_coeffs& c, T *dest, double *buffer, const T *src, 
-																																							long start, long N, long heigth, long src_stride, long dest_stride)
-	{
-		const int NCH = PF::ColorspaceInfo<CS>::NCH;
-
-		//return;
-    
-		double accum[10/*NCH*/];
-		long pad, pad2, N2, n, n2, n3, ch, src_stride2, dest_stride2, y_start = 0, y_end = heigth-1, y_end2 = y_end*NCH, y0, y1, y2, y3;
-		int k;
-
-		assert(dest && buffer && src && N > 0);
-    
-		pad = c.radii[0] + 1; //pad=0;
-		pad2 = pad * NCH;
-		buffer += pad2;
-
-		N2 = N * NCH;
-		y0 = (start - pad) * NCH;
-		y1 = start * NCH;
-		y2 = (start + N - 1) * NCH;
-		y3 = (start + N + pad - 1) * NCH;
-		src_stride2 = src_stride*NCH;
-		dest_stride2 = dest_stride*NCH;
-
-		for (ch = CHMIN; ch <= CHMAX; ++ch) accum[ch] = 0; 
-
-		/* Compute cumulative sum of src over n = -pad,..., N + pad - 1. */
-		//std::cout<<"1) left edge: y0="<<y0<<"  y3="<<y3<<"  y_start="<<y_start<<std::endl;
-		for (n = y0, n2 = -pad2, n3 = -pad*src_stride2;
-				 n < (y3<y_start ? y3 : y_start); 
-				 n += NCH, n2 += NCH, n3 += src_stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[ch];
-				//std::cout<<"1) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-
-		//std::cout<<"2) image: n="<<n<<"  y3="<<y3<<"  y_end2="<<y_end2<<std::endl;
-		for (; n <= (y3<y_end2 ? y3 : y_end2); n += NCH, n2 += NCH, n3 += src_stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[n3+ch];
-				//std::cout<<"2) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-
-		//std::cout<<"3) right edge: n="<<y_end2+1<<"  y3="<<y3<<"  y_end2="<<y_end2<<std::endl;
-		for (n = y_end2+1; n <= y3; n += NCH, n2 += NCH, n3 += src_stride2) {
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] += src[N2+ch];
-				//std::cout<<"3) buffer["<<n2<<"+"<<ch<<"]="<<accum[ch]<<std::endl;
-				buffer[n2+ch] = accum[ch];
-			}
-		}
-    
-		long n1k[SII_MAX_K];
-		long n2k[SII_MAX_K];
-		/* Compute stacked box filters. */
-		for (n = 0; n < N; ++n, dest += dest_stride2) {
-			for (k = 0; k < c.K; ++k) {
-				n1k[k] = (n + c.radii[k]) * NCH;
-				n2k[k] = (n - c.radii[k] - 1) * NCH;
-			}
-			for (ch = CHMIN; ch <= CHMAX; ++ch) {
-				accum[ch] = c.weights[0] * (buffer[n1k[0] + ch]
-																		- buffer[n2k[0] + ch]);
-        
-				for (k = 1; k < c.K; ++k)
-					accum[ch] += c.weights[k] * (buffer[n1k[k] + ch]
-																			 - buffer[n2k[k] + ch]);
-        
-				dest[ch] = (T)accum[ch];
-			}
-		}
-			
-		return;
-	}
+
+  inline long sii_clamp( long i, long N )
+  {
+    return( (i < 0) ? 0 : ((i >= N) ? N-1 : i) );
+  }
+
+
+  /* Horizontal step: blurs the N pixels starting at "start" of a row with nb interleaved
+   * channels, "width" being the number of valid pixels in src.
+   * acc must have space for c.K*nb values.
+   */
+  template<class T>
+  void sii_gaussian_conv_h( sii_coeffs& c, float* dest, double* acc, const T* src,
+                            long start, long N, long width, int nb )
+  {
+    long n, i;
+    int k, ch;
+
+    for( k = 0; k < c.K; k++ ) {
+      double* a = acc + k*nb;
+      for( ch = 0; ch < nb; ch++ ) a[ch] = 0;
+      for( i = start - c.radii[k]; i <= start + c.radii[k]; i++ ) {
+        const T* p = src + sii_clamp( i, width )*nb;
+        for( ch = 0; ch < nb; ch++ ) a[ch] += p[ch];
+      }
+    }
+
+    for( n = 0; n < N; n++, dest += nb ) {
+      for( ch = 0; ch < nb; ch++ ) {
+        double val = 0;
+        for( k = 0; k < c.K; k++ )
+          val += c.weights[k] * acc[k*nb+ch];
+        dest[ch] = val;
+      }
+      // slide the boxes by one pixel
+      for( k = 0; k < c.K; k++ ) {
+        double* a = acc + k*nb;
+        const T* pin = src + sii_clamp( start + n + c.radii[k] + 1, width )*nb;
+        const T* pout = src + sii_clamp( start + n - c.radii[k], width )*nb;
+        for( ch = 0; ch < nb; ch++ )
+          a[ch] += static_cast<double>(pin[ch]) - static_cast<double>(pout[ch]);
+      }
+    }
+  }
+
+
+  /* Vertical step: blurs N rows starting at "start", "height" being the number of rows
+   * of line_size samples available in src. The rows are processed as a whole,
+   * so that the inner loops run over contiguous memory and can be vectorized.
+   * acc must have space for (c.K+1)*line_size values.
+   */
+  template<class T>
+  void sii_gaussian_conv_v( sii_coeffs& c, T* dest, long dest_stride, double* acc,
+                            const float* src, long start, long N, long height, long line_size )
+  {
+    long n, i, j;
+    int k;
+    double* out = acc + c.K*line_size;
+
+    for( k = 0; k < c.K; k++ ) {
+      double* a = acc + k*line_size;
+      for( j = 0; j < line_size; j++ ) a[j] = 0;
+      for( i = start - c.radii[k]; i <= start + c.radii[k]; i++ ) {
+        const float* row = src + sii_clamp( i, height )*line_size;
+        for( j = 0; j < line_size; j++ ) a[j] += row[j];
+      }
+    }
+
+    for( n = 0; n < N; n++, dest += dest_stride ) {
+      for( j = 0; j < line_size; j++ ) out[j] = 0;
+      for( k = 0; k < c.K; k++ ) {
+        const double w = c.weights[k];
+        const double* a = acc + k*line_size;
+        for( j = 0; j < line_size; j++ ) out[j] += w * a[j];
+      }
+      for( j = 0; j < line_size; j++ ) dest[j] = (T)out[j];
+
+      // slide the boxes by one row
+      for( k = 0; k < c.K; k++ ) {
+        double* a = acc + k*line_size;
+        const float* rin = src + sii_clamp( start + n + c.radii[k] + 1, height )*line_size;
+        const float* rout = src + sii_clamp( start + n - c.radii[k], height )*line_size;
+        for( j = 0; j < line_size; j++ ) a[j] += static_cast<double>(rin[j]) - rout[j];
+      }
+    }
+  }
@@ -101,11 +101,14 @@ VipsImage* PF::GmicDreamSmoothPar::build(std::vector<VipsImage*>& in, int first,
 
   if( !srcimg ) return NULL;
 
+  init_run_level( srcimg, level );
   update_raster_images();
   PF::RasterImage* raster_image = get_raster_image(0);
   //if( !raster_image || (raster_image->get_file_name () != get_cache_file_name()) ) {
   if( !raster_image ) {
-    std::string tempfile = save_image( srcimg, IM_BANDFMT_FLOAT );
+    VipsImage* runimg = get_run_input( srcimg, level );
+    if( !runimg ) return NULL;
+    std::string tempfile = save_image( runimg, IM_BANDFMT_FLOAT );
 
     std::string command = "-verbose - -input ";
     command = command + tempfile + std::string(" -n 0,255 -gimp_dreamsmooth ");
@@ -117,7 +120,8 @@ VipsImage* PF::GmicDreamSmoothPar::build(std::vector<VipsImage*>& in, int first,
     command = command + std::string(",") + prop_smoothness.get_str() + ",1,0 -n 0,1 -output " + get_cache_file_name(0) + ",float,lzw";
     std::cout<<"dream smooth command: "<<command<<std::endl;
 
-    run_gmic( srcimg, command );
+    run_gmic( runimg, command );
+    PF_UNREF( runimg, "GmicDreamSmoothPar::build(): runimg unref" );
 
     unlink( tempfile.c_str() );
   }
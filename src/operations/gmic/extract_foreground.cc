@@ -29,6 +29,7 @@
 
 
 #include "../base/pf_mkstemp.hh"
+#include "../base/shared_resources.hh"
 
 #include "../raster_image.hh"
 
@@ -113,7 +114,6 @@ PF::GmicExtractForegroundPar::GmicExtractForegroundPar():
   OpParBase(),
   fg_points( "fg_points", this ),
   bg_points( "bg_points", this ),
-  custom_gmic_commands( NULL ),
   gmic_instance( NULL ),
   do_update( true ),
   raster_image( NULL )
@@ -152,50 +152,11 @@ PF::GmicExtractForegroundPar::~GmicExtractForegroundPar()
 
 gmic* PF::GmicExtractForegroundPar::new_gmic()
 {
-  if( custom_gmic_commands ) delete [] custom_gmic_commands;
   if( gmic_instance ) delete gmic_instance;
 
-  std::cout<<"Loading G'MIC custom commands..."<<std::endl;
-  char fname[500]; fname[0] = 0;
-#if defined(WIN32) || defined(__MINGW32__) || defined(__MINGW64__)
-  snprintf( fname, 499, "%s\gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
-  struct stat buffer;   
-  int stat_result = stat( fname, &buffer );
-  if( stat_result != 0 ) {
-    fname[0] = 0;
-  }
-#else
-  if( getenv("HOME") ) {
-    //snprintf( fname, 499, "%s/.photoflow/gmic_update.gmic", getenv("HOME") );
-    snprintf( fname, 499, "%s/share/photoflow/gmic_def.gmic", INSTALL_PREFIX );
-    std::cout<<"G'MIC custom commands file: "<<fname<<std::endl;
-    struct stat buffer;   
-    int stat_result = stat( fname, &buffer );
-    if( stat_result != 0 ) {
-      //snprintf( fname, 499, "%s/gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
-      //stat_result = stat( fname, &buffer );
-      //if( stat_result != 0 ) {
-      fname[0] = 0;
-      //}
-    }
-  }
-#endif
-  if( strlen( fname ) > 0 ) {
-    std::ifstream t;
-    int length;
-    t.open(fname);      // open input file
-    t.seekg(0, std::ios::end);    // go to the end
-    length = t.tellg();           // report location (this is the length)
-    t.seekg(0, std::ios::beg);    // go back to the beginning
-    custom_gmic_commands = new char[length];    // allocate memory for a buffer of appropriate dimension
-    t.read(custom_gmic_commands, length);       // read the whole file into the buffer
-    t.close();                    // close file handle
-    std::cout<<"G'MIC custom commands loaded"<<std::endl;
-  }
-
   /* Make a gmic for this thread.
    */
-  gmic_instance = new gmic( 0, custom_gmic_commands, false, 0, 0 ); 
+  gmic_instance = new gmic( 0, PF::SharedResources::Instance().get_gmic_commands(), false, 0, 0 );
   return gmic_instance;
 }
 
@@ -56,7 +56,6 @@ namespace PF
     PF::ProcessorBase* convert_format2;
     PF::ProcessorBase* blender;
 
-    char* custom_gmic_commands;
     gmic* gmic_instance;
 
     bool do_update;
@@ -45,7 +45,6 @@ namespace PF
 
   class GmicUntiledOperationPar: public UntiledOperationPar
   {
-    char* custom_gmic_commands;
     gmic* gmic_instance;
 
   protected:
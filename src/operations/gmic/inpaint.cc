@@ -149,36 +149,41 @@ VipsImage* PF::GmicInpaintPar::build(std::vector<VipsImage*>& in, int first,
       PF_REF( srcimg, "GmicInpaintPar::build() srcimg ref (strokes.get().size() < 1)" );
       return srcimg;
     }
+    init_run_level( srcimg, level );
     update_raster_images();
     PF::RasterImage* raster_image = get_raster_image(0);
     //if( !raster_image || (raster_image->get_file_name () != get_cache_file_name()) ) {
     if( !raster_image ) {
-      std::string tempfile = save_image( srcimg, IM_BANDFMT_FLOAT );
+      // The mask is drawn directly at the run level
+      unsigned int rlevel = get_run_level();
+      VipsImage* runimg = get_run_input( srcimg, level );
+      if( !runimg ) return NULL;
+      std::string tempfile = save_image( runimg, IM_BANDFMT_FLOAT );
 
       in2.clear();
-      black->get_par()->set_image_hints( srcimg );
+      black->get_par()->set_image_hints( runimg );
       black->get_par()->set_format( get_format() );
-      VipsImage* blackimage = black->get_par()->build(in2, 0, NULL, NULL, level );
+      VipsImage* blackimage = black->get_par()->build(in2, 0, NULL, NULL, rlevel );
 
       in2.clear();
-      uniform->get_par()->set_image_hints( srcimg );
+      uniform->get_par()->set_image_hints( runimg );
       uniform->get_par()->set_format( get_format() );
-      VipsImage* redimage = uniform->get_par()->build(in2, 0, NULL, NULL, level );
+      VipsImage* redimage = uniform->get_par()->build(in2, 0, NULL, NULL, rlevel );
 
       in2.clear();
-      draw_op2->get_par()->set_image_hints( srcimg );
-      draw_op2->get_par()->grayscale_image( srcimg->Xsize, srcimg->Ysize );
+      draw_op2->get_par()->set_image_hints( runimg );
+      draw_op2->get_par()->grayscale_image( runimg->Xsize, runimg->Ysize );
       draw_op2->get_par()->set_format( get_format() );
-      VipsImage* mask = draw_op2->get_par()->build( in2, first, imap, omap, level );
+      VipsImage* mask = draw_op2->get_par()->build( in2, first, imap, omap, rlevel );
 
-      maskblend->get_par()->set_image_hints( srcimg );
+      maskblend->get_par()->set_image_hints( runimg );
       maskblend->get_par()->set_format( get_format() );
       maskblend->get_par()->set_blend_mode( PF::PF_BLEND_NORMAL );
       maskblend->get_par()->set_opacity( 0.8 );
       in2.clear(); 
       in2.push_back( blackimage );
       in2.push_back( redimage );
-      VipsImage* blendimage = maskblend->get_par()->build(in2, 0, NULL, mask, level );
+      VipsImage* blendimage = maskblend->get_par()->build(in2, 0, NULL, mask, rlevel );
       //PF_UNREF( srcimg, "GmicInpaintPar::build() srcimg unref" );
       PF_UNREF( mask, "GmicInpaintPar::build() mask unref" );
       PF_UNREF( blackimage, "GmicInpaintPar::build() blackimage unref" );
@@ -189,16 +194,20 @@ VipsImage* PF::GmicInpaintPar::build(std::vector<VipsImage*>& in, int first,
       std::string command = "-verbose + ";
       command = command + "-input " + tempfile + " -n 0,255 ";
       command = command + "-input " + tempfile2 + " -inpaint[0] [1],";
-      command = command + patch_size.get_str();
-      command = command + std::string(",") + convert2string( lookup_size.get()*patch_size.get() );
+      // The patch size is expressed in pixels, the other sizes are relative to it
+      int psize = (int)(patch_size.get()*get_run_scale() + 0.5f);
+      if( psize < 1 ) psize = 1;
+      command = command + convert2string( psize );
+      command = command + std::string(",") + convert2string( lookup_size.get()*psize );
       command = command + std::string(",") + lookup_factor.get_str() + ",1";
-      command = command + std::string(",") + convert2string( blend_size.get()*patch_size.get() );
+      command = command + std::string(",") + convert2string( blend_size.get()*psize );
       command = command + std::string(",") + blend_threshold.get_str();
       command = command + std::string(",") + blend_decay.get_str();
       command = command + std::string(",") + blend_scales.get_str();
       command = command + std::string(",") + allow_outer_blending.get_str();
       command = command + " -n[0] 0,1 -output[0] " + get_cache_file_name(0) + ",float,lzw";
-      run_gmic( srcimg, command );
+      run_gmic( runimg, command );
+      PF_UNREF( runimg, "GmicInpaintPar::build() runimg unref" );
 
       unlink( tempfile.c_str() );
       PF_UNREF( blendimage, "GmicInpaintPar::build() blendimage unref after write" );
@@ -62,7 +62,7 @@ namespace PF
     Property<int> blend_scales;
     Property<int> allow_outer_blending;
     Property<int> pen_size;
-    Property< std::list< Stroke<Pencil> > > strokes;
+    BinaryProperty< std::list< Stroke<Pencil> > > strokes;
     PropertyBase display_mode;
 
     Processor<PF::DrawPar,PF::DrawProc>* draw_op1;
@@ -54,11 +54,15 @@ std::vector<VipsImage*> PF::GmicSplitDetailsPar::build_many(std::vector<VipsImag
 
   if( !srcimg ) return outvec;
   
+  init_run_level( srcimg, level );
   update_raster_images();
   PF::RasterImage* raster_image = get_raster_image(0);
   //if( !raster_image || (raster_image->get_file_name () != get_cache_file_name()) ) {
   if( !raster_image ) {
-    std::string tempfile = save_image( srcimg, IM_BANDFMT_FLOAT );
+    // The scales are relative to the image size, and need not be adjusted
+    VipsImage* runimg = get_run_input( srcimg, level );
+    if( !runimg ) return outvec;
+    std::string tempfile = save_image( runimg, IM_BANDFMT_FLOAT );
 
     std::string command = "-verbose + ";
     command = command + "-input " + tempfile + " -mul 255 ";
@@ -77,7 +81,8 @@ std::vector<VipsImage*> PF::GmicSplitDetailsPar::build_many(std::vector<VipsImag
       command = command + " -add["+id+"] 127 -c["+id+"] 0,255 -div["+id+"] 255 -output["+id+"] " + get_cache_file_name(i) + ",float";
     }
     
-    run_gmic( srcimg, command );
+    run_gmic( runimg, command );
+    PF_UNREF( runimg, "GmicSplitDetailsPar::build_many(): runimg unref" );
 
     unlink( tempfile.c_str() );
   }
@@ -28,6 +28,8 @@
  */
 
 
+#include <sstream>
+
 #include "gmic.hh"
 #include "tone_mapping.hh"
 
@@ -72,22 +74,30 @@ VipsImage* PF::GmicToneMappingPar::build(std::vector<VipsImage*>& in, int first,
 
   if( !srcimg ) return NULL;
   
+  init_run_level( srcimg, level );
   update_raster_images();
   PF::RasterImage* raster_image = get_raster_image(0);
   //if( !raster_image || (raster_image->get_file_name () != get_cache_file_name()) ) {
   if( !raster_image ) {
-    std::string tempfile = save_image( srcimg, IM_BANDFMT_FLOAT );
+    VipsImage* runimg = get_run_input( srcimg, level );
+    if( !runimg ) return NULL;
+    std::string tempfile = save_image( runimg, IM_BANDFMT_FLOAT );
+
+    // The smoothness is expressed in pixels
+    std::ostringstream smoothness;
+    smoothness<<prop_smoothness.get()*get_run_scale();
 
     std::string command = "-verbose + ";
     command = command + "-input " + tempfile + " -n 0,255 -gimp_map_tones ";
     command = command + prop_threshold.get_str();
     command = command + std::string(",") + prop_gamma.get_str();
-    command = command + std::string(",") + prop_smoothness.get_str();
+    command = command + std::string(",") + smoothness.str();
     command = command + std::string(",") + prop_iterations.get_str();
     command = command + std::string(",") + prop_channels.get_enum_value_str();
     command = command + " -n 0,1 -output " + get_cache_file_name(0) + ",float,lzw";
     
-    run_gmic( srcimg, command );
+    run_gmic( runimg, command );
+    PF_UNREF( runimg, "GmicToneMappingPar::build(): runimg unref" );
 
     unlink( tempfile.c_str() );
   }
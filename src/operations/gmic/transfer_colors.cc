@@ -67,11 +67,15 @@ std::vector<VipsImage*> PF::GmicTransferColorsPar::build_many(std::vector<VipsIm
     return outvec;
   }
 
+  init_run_level( srcimg, level );
   update_raster_images();
   PF::RasterImage* raster_image = get_raster_image(0);
   //if( !raster_image || (raster_image->get_file_name () != get_cache_file_name()) ) {
   if( !raster_image ) {
-    std::string tempfile1 = save_image( srcimg, IM_BANDFMT_FLOAT );
+    // Only the image to be modified is reduced, the color reference is used as it is
+    VipsImage* runimg = get_run_input( srcimg, level );
+    if( !runimg ) return outvec;
+    std::string tempfile1 = save_image( runimg, IM_BANDFMT_FLOAT );
     std::string tempfile2 = save_image( refimg, IM_BANDFMT_FLOAT );
 
     std::string command = "-verbose + ";
@@ -87,7 +91,8 @@ std::vector<VipsImage*> PF::GmicTransferColorsPar::build_many(std::vector<VipsIm
     //command = command + std::string(",") + prop_channels.get_enum_value_str();
     command = command + " -div[0] 255 -output[0] " + get_cache_file_name(0) + ",float";
     
-    run_gmic( srcimg, command );
+    run_gmic( runimg, command );
+    PF_UNREF( runimg, "GmicTransferColorsPar::build_many(): runimg unref" );
 
     unlink( tempfile1.c_str() );
     unlink( tempfile2.c_str() );
@@ -36,9 +36,30 @@
 PF::HueSaturationPar::HueSaturationPar(): 
   OpParBase(),
   hue("hue",this,0),
-  saturation("saturation",this,0)
+  saturation("saturation",this,0),
+  hue_value( 0 ),
+  saturation_value( 0 )
 {
   set_type("hue_saturation" );
+  hue.set_hot( true );
+  saturation.set_hot( true );
+}
+
+
+bool PF::HueSaturationPar::update_hot_values()
+{
+  hue_value = hue.get();
+  saturation_value = saturation.get();
+  return true;
+}
+
+
+VipsImage* PF::HueSaturationPar::build(std::vector<VipsImage*>& in, int first, 
+                                       VipsImage* imap, VipsImage* omap, 
+                                       unsigned int& level)
+{
+  update_hot_values();
+  return OpParBase::build( in, first, imap, omap, level );
 }
 
 
@@ -37,9 +37,14 @@
 #include <libraw/libraw.h>
 
 #include "../base/color.hh"
+#include "../base/color_kernels.hh"
 #include "../base/processor.hh"
 
 
+// Number of pixels converted at once by the RGB renderer
+#define PF_HSV_CHUNK_SIZE 256
+
+
 namespace PF 
 {
 
@@ -48,16 +53,26 @@ namespace PF
     Property<float> hue;
     Property<float> saturation;
 
+    // Parameter values resolved when the operation is built,
+    // to avoid accessing the properties while rendering
+    float hue_value;
+    float saturation_value;
+
   public:
 
     HueSaturationPar();
 
-    float get_hue() { return hue.get(); }
-    float get_saturation() { return saturation.get(); }
+    float get_hue() { return hue_value; }
+    float get_saturation() { return saturation_value; }
 
     bool has_intensity() { return true; }
     bool has_opacity() { return true; }
     bool needs_input() { return true; }
+
+    bool update_hot_values();
+
+    VipsImage* build(std::vector<VipsImage*>& in, int first, 
+                     VipsImage* imap, VipsImage* omap, unsigned int& level);
   };
 
   
@@ -68,7 +83,7 @@ namespace PF
   public: 
     void render(VipsRegion** ireg, int n, int in_first,
                 VipsRegion* imap, VipsRegion* omap, 
-                VipsRegion* oreg, OpParBase* par)
+                VipsRegion* oreg, HueSaturationPar* par)
     {
     }
   };
@@ -82,46 +97,49 @@ namespace PF
   public: 
     void render(VipsRegion** ireg, int n, int in_first,
                 VipsRegion* imap, VipsRegion* omap, 
-                VipsRegion* oreg, OpParBase* par)
+                VipsRegion* oreg, HueSaturationPar* par)
     {
-      HueSaturationPar* opar = dynamic_cast<HueSaturationPar*>(par);
-      if( !opar ) return;
       Rect *r = &oreg->valid;
-      int line_size = r->width * oreg->im->Bands;
-      //int width = r->width;
+      int width = r->width;
       int height = r->height;
 
+      const float hue = par->get_hue();
+      const float saturation = par->get_saturation();
+
       T* pin;
       T* pout;
-      T R, G, B;
-      float h, s, v;
       int x, y;
 
+      // The pixels are converted in fixed-size chunks, using a small
+      // floating-point buffer on the stack to hold the HSV values
+      float hsv[PF_HSV_CHUNK_SIZE*3];
+
       for( y = 0; y < height; y++ ) {
         pin = (T*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
         pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
 
-        for( x = 0; x < line_size; x+=3 ) {
-          R = pin[x];
-          G = pin[x+1];
-          B = pin[x+2];
-          rgb2hsv( R, G, B, h, s, v );
+        for( int x0 = 0; x0 < width; x0 += PF_HSV_CHUNK_SIZE ) {
+          int npix = width - x0;
+          if( npix > PF_HSV_CHUNK_SIZE ) npix = PF_HSV_CHUNK_SIZE;
+          int nval = npix*3;
 
-          //std::cout<<"in RGB: "<<R<<" "<<G<<" "<<B<<"  HSV: "<<h<<" "<<s<<" "<<v<<std::endl;
+          to_float_row( pin+x0*3, hsv, nval );
+          rgb2hsv_row( hsv, hsv, npix );
 
-          h += opar->get_hue();
-          if( h > 360 ) h -= 360;
-          else if( h < 0 ) h+= 360;
+          for( x = 0; x < nval; x+=3 ) {
+            float h = hsv[x] + hue;
+            if( h > 360 ) h -= 360;
+            else if( h < 0 ) h+= 360;
+            hsv[x] = h;
 
-          s += opar->get_saturation();
-          if( s < 0 ) s = 0;
-          else if( s > 1 ) s = 1;
+            float s = hsv[x+1] + saturation;
+            if( s < 0 ) s = 0;
+            else if( s > 1 ) s = 1;
+            hsv[x+1] = s;
+          }
 
-          hsv2rgb2( h, s, v, R, G, B );
-          //std::cout<<"out RGB: "<<R<<" "<<G<<" "<<B<<"  HSV: "<<h<<" "<<s<<" "<<v<<std::endl;
-          pout[x] = R;
-          pout[x+1] = G;
-          pout[x+2] = B;          
+          hsv2rgb_row( hsv, hsv, npix );
+          from_float_row( hsv, pout+x0*3, nval );
         }
       }
     }
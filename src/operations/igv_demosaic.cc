@@ -36,7 +36,7 @@
 
 
 PF::IgvDemosaicPar::IgvDemosaicPar(): 
-  OpParBase()
+  DemosaicBasePar()
 {
   set_type( "igv_demosaic" );
 }
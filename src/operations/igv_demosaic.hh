@@ -35,6 +35,7 @@
 #include <libraw/libraw.h>
 
 #include "../base/operation.hh"
+#include "demosaic_base.hh"
 #include "../rt/rtengine/rawimagesource.hh"
 
 
@@ -42,7 +43,7 @@
 namespace PF
 {
 
-  class IgvDemosaicPar: public OpParBase
+  class IgvDemosaicPar: public DemosaicBasePar
   {
   public:
     IgvDemosaicPar();
@@ -118,8 +119,11 @@ namespace PF
 								VipsRegion* imap, VipsRegion* omap, 
 								VipsRegion* out, IgvDemosaicPar* par) 
     {
+			VipsRegion* ireg = raw_wb_region( in[0], par );
+			if( !ireg ) return;
 			rtengine::RawImageSource rawimg;
-			rawimg.igv_demosaic( in[0], out );
+			rawimg.igv_demosaic( ireg, out );
+			g_object_unref( ireg );
     }
   };
 
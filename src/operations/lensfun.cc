@@ -28,6 +28,7 @@
  */
 
 #include "../base/exif_data.hh"
+#include "../base/shared_resources.hh"
 #include "lensfun.hh"
 
 int vips_lensfun( VipsImage* in, VipsImage **out, PF::ProcessorBase* proc, ... );
@@ -40,10 +41,6 @@ PF::LensFunPar::LensFunPar():
     prop_camera_model( "camera_model", this ),
     prop_lens( "lens", this )
 {
-#ifdef PF_HAS_LENSFUN
-  ldb = lf_db_new();
-  ldb->Load ();
-#endif
   set_type("lensfun" );
 }
 
@@ -76,6 +73,7 @@ std::cout<<"LensFunPar::build() called."<<std::endl;
   }
 
 #ifdef PF_HAS_LENSFUN
+  lfDatabase* ldb = PF::SharedResources::Instance().get_lensfun_db();
   const lfCamera** cameras = ldb->FindCameras( exif_data->exif_maker,
       exif_data->exif_model );
   if( !cameras ) {
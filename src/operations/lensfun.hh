@@ -49,9 +49,6 @@ class LensFunPar: public OpParBase
   Property<std::string> prop_camera_maker;
   Property<std::string> prop_camera_model;
   Property<std::string> prop_lens;
-#ifdef PF_HAS_LENSFUN
-  lfDatabase* ldb;
-#endif
   float focal_length, aperture, distance;
 
 public:
@@ -76,6 +76,7 @@ VipsImage* PF::RawDeveloperPar::build(std::vector<VipsImage*>& in, int first,
   
   VipsImage* out_demo;
   std::vector<VipsImage*> in2;
+  const float* wb_mul = NULL;
 
   size_t blobsz;
   if( vips_image_get_blob( in[0], "raw_image_data",
@@ -87,16 +88,17 @@ VipsImage* PF::RawDeveloperPar::build(std::vector<VipsImage*>& in, int first,
     return NULL;
   
   
+  // The white balance is not applied by a separate pre-processing pass over the
+  // raw data: the multipliers are passed to the demosaicing step or, if the
+  // image does not need to be demosaiced, to the output stage
+  RawPreprocessorPar* wbpar = dynamic_cast<RawPreprocessorPar*>( raw_preprocessor->get_par() );
+  if( !wbpar || !wbpar->init_wb_multipliers( in[0] ) )
+    return NULL;
+
   VipsImage* input_img = in[0];
 	//std::cout<<"RawDeveloperPar::build(): input_img->Bands="<<input_img->Bands<<std::endl;
   if( input_img->Bands != 3 ) {
-    raw_preprocessor->get_par()->set_image_hints( in[0] );
-    raw_preprocessor->get_par()->set_format( VIPS_FORMAT_FLOAT );
-    VipsImage* image = raw_preprocessor->get_par()->build( in, 0, NULL, NULL, level );
-    if( !image )
-      return NULL;
-  
-    in2.push_back( image );
+    in2.push_back( input_img );
 		PF::ProcessorBase* demo = NULL;
 		switch( demo_method.get_enum_value().first ) {
 		case PF::PF_DEMO_FAST: demo = fast_demosaic; break;
@@ -108,10 +110,11 @@ VipsImage* PF::RawDeveloperPar::build(std::vector<VipsImage*>& in, int first,
 		//PF::ProcessorBase* demo = igv_demosaic;
 		//PF::ProcessorBase* demo = fast_demosaic;
 		if( !demo ) return NULL;
-    demo->get_par()->set_image_hints( image );
+    DemosaicBasePar* demopar = dynamic_cast<DemosaicBasePar*>( demo->get_par() );
+    if( demopar ) demopar->set_wb_multipliers( wbpar->get_wb_multipliers() );
+    demo->get_par()->set_image_hints( input_img );
     demo->get_par()->set_format( VIPS_FORMAT_FLOAT );
     out_demo = demo->get_par()->build( in2, 0, NULL, NULL, level );
-    g_object_unref( image );
 
 		for(int ifcs = 0; ifcs < VIPS_MIN(fcs_steps.get(),4); ifcs++) {
 			VipsImage* temp = out_demo;
@@ -122,16 +125,16 @@ VipsImage* PF::RawDeveloperPar::build(std::vector<VipsImage*>& in, int first,
 			PF_UNREF( temp, "RawDeveloperPar::build(): temp unref");
 		}
   } else {
-    raw_preprocessor->get_par()->set_image_hints( in[0] );
-    raw_preprocessor->get_par()->set_format( VIPS_FORMAT_FLOAT );
-    VipsImage* image = raw_preprocessor->get_par()->build( in, 0, NULL, NULL, level );
-    if( !image )
-      return NULL;
-  
-    out_demo = image;
+    // The white balance is applied in the same pass as the color conversion
+    wb_mul = wbpar->get_wb_multipliers();
+
+    out_demo = in[0];
+    PF_REF( out_demo, "RawDeveloperPar::build(): in[0] ref" );
   }
 
   /**/
+  RawOutputPar* outpar = dynamic_cast<RawOutputPar*>( raw_output->get_par() );
+  if( outpar ) outpar->set_wb_multipliers( wb_mul );
   raw_output->get_par()->set_image_hints( out_demo );
   raw_output->get_par()->set_format( VIPS_FORMAT_FLOAT );
   in2.clear(); in2.push_back( out_demo );
@@ -27,6 +27,12 @@
 
  */
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
 #include "../base/pf_mkstemp.hh"
 #include "../base/rawmatrix.hh"
 
@@ -35,35 +41,197 @@
 
 
 
+// Number of image rows that are normalized in parallel before being written to disk
+#define PF_RAW_BAND_HEIGHT 256
+
+
+#ifdef PF_USE_LIBRAW
+// Horizontal strip of the raw mosaic to be normalized by one thread
+struct raw_strip_t
+{
+  LibRaw* loader;
+  // packed sensor data, or NULL if the 4-channels image produced by raw2image() has to be used
+  const unsigned short* raw;
+  int raw_pitch;
+  // per-color black levels and white/black scaling factor
+  float black[4];
+  float scale;
+  int row_start, row_end, width;
+  // output buffer, starting at row_start
+  float* out;
+};
+
+
+static gpointer raw_normalize_strip( gpointer data )
+{
+  raw_strip_t* strip = (raw_strip_t*)data;
+  LibRaw* loader = strip->loader;
+  libraw_colordata_t& C = loader->imgdata.color;
+  libraw_sizes_t& S = loader->imgdata.sizes;
+  bool pattern = (C.cblack[4] > 0) && (C.cblack[5] > 0);
+  float* fptr = strip->out;
+  for( int row = strip->row_start; row < strip->row_end; row++ ) {
+    const unsigned short* praw = NULL;
+    if( strip->raw )
+      praw = strip->raw + (size_t)(row+S.top_margin)*strip->raw_pitch + S.left_margin;
+    for( int col = 0; col < strip->width; col++, fptr += 2 ) {
+      int color = loader->COLOR(row,col);
+      float val;
+      if( praw ) {
+        val = praw[col];
+        val -= strip->black[color];
+        if( pattern )
+          val -= C.cblack[6 + (row%C.cblack[4])*C.cblack[5] + col%C.cblack[5]];
+        if( val < 0 ) val = 0;
+      } else {
+        val = loader->imgdata.image[(size_t)row*S.iwidth+col][color];
+      }
+      // The demosaicing only knows about three colors
+      if( color == 3 && loader->imgdata.idata.colors == 3 ) color = 1;
+      fptr[0] = val*strip->scale;
+      fptr[1] = color;
+    }
+  }
+  return NULL;
+}
+
+
+// Strips of the current band that are still being normalized
+struct raw_band_t
+{
+  GMutex* mutex;
+  GCond* done;
+  int pending;
+};
+
+
+static void raw_normalize_task( gpointer data, gpointer user_data )
+{
+  raw_normalize_strip( data );
+  raw_band_t* band = (raw_band_t*)user_data;
+  g_mutex_lock( band->mutex );
+  band->pending -= 1;
+  if( band->pending == 0 ) g_cond_signal( band->done );
+  g_mutex_unlock( band->mutex );
+}
+
+
+// Maps the raw file in memory, so that LibRaw can decode it without
+// additional buffering; returns NULL if the file cannot be mapped
+static void* raw_file_map( const std::string& name, size_t& size )
+{
+#ifndef WIN32
+  int fd = open( name.c_str(), O_RDONLY );
+  if( fd < 0 ) return NULL;
+  struct stat st;
+  if( fstat( fd, &st ) != 0 || st.st_size <= 0 ) {
+    close( fd );
+    return NULL;
+  }
+  size = st.st_size;
+  void* map = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( map == MAP_FAILED ) return NULL;
+  madvise( map, size, MADV_SEQUENTIAL );
+  return map;
+#else
+  return NULL;
+#endif
+}
+
+
+static void raw_file_unmap( void* map, size_t size )
+{
+#ifndef WIN32
+  if( map ) munmap( map, size );
+#endif
+}
+#endif
+
+
+#ifdef PF_USE_DCRAW_RT
+static gpointer init_camera_constants( gpointer data )
+{
+  rtengine::CameraConstantsStore::initCameraConstants(PF::PhotoFlow::Instance().get_base_dir(),"");
+  return NULL;
+}
+#endif
+
+
 PF::RawImage::RawImage( const std::string f ):
 #ifdef PF_USE_DCRAW_RT
   rtengine::RawImage(f), 
 #endif
 	nref(1), file_name( f ),
-  image( NULL ), demo_image( NULL )
+  image( NULL ), demo_image( NULL ), memory_size( 0 )
 {
 	dcraw_data_t* pdata;
 #ifdef PF_USE_LIBRAW
   LibRaw* raw_loader = new LibRaw();
-  int result = raw_loader->open_file( file_name.c_str() );
-  if( result != 0 ) return;
+  size_t raw_file_size = 0;
+  void* raw_file_data = raw_file_map( file_name, raw_file_size );
+  int result = -1;
+  if( raw_file_data )
+    result = raw_loader->open_buffer( raw_file_data, raw_file_size );
+  if( result != 0 ) {
+    // some formats cannot be decoded from a memory buffer
+    raw_loader->recycle();
+    raw_file_unmap( raw_file_data, raw_file_size );
+    raw_file_data = NULL;
+    result = raw_loader->open_file( file_name.c_str() );
+  }
+  if( result != 0 ) {
+    delete raw_loader;
+    return;
+  }
   if( (raw_loader->imgdata.idata.cdesc[0] != 'R') ||
       (raw_loader->imgdata.idata.cdesc[1] != 'G') ||
       (raw_loader->imgdata.idata.cdesc[2] != 'B') ||
-      (raw_loader->imgdata.idata.cdesc[3] != 'G') )
+      (raw_loader->imgdata.idata.cdesc[3] != 'G') ) {
+    delete raw_loader;
+    raw_file_unmap( raw_file_data, raw_file_size );
     return;
+  }
 
   raw_loader->imgdata.params.no_auto_bright = 1;
   result = raw_loader->unpack();
-  if( result != 0 ) 
+  if( result != 0 ) {
+    delete raw_loader;
+    raw_file_unmap( raw_file_data, raw_file_size );
     return;
+  }
 
-  raw_loader->raw2image();
-
+  // Bayer and X-Trans mosaics are read directly from the packed sensor data,
+  // without expanding them to four channels; other sensor layouts still go
+  // through raw2image()
+  const unsigned short* raw_data = raw_loader->imgdata.rawdata.raw_image;
+  if( raw_loader->imgdata.idata.filters == 0 ||
+      raw_loader->imgdata.params.half_size ||
+      raw_loader->is_fuji_rotated() )
+    raw_data = NULL;
+
+  float raw_black[4];
+  float raw_white;
+  if( raw_data ) {
+    libraw_colordata_t& C = raw_loader->imgdata.color;
+    float black_min = 0;
+    for( int c = 0; c < 4; c++ ) {
+      raw_black[c] = C.black + C.cblack[c];
+      if( c == 0 || raw_black[c] < black_min ) black_min = raw_black[c];
+    }
+    // same white level as the one left by subtract_black()
+    raw_white = C.maximum - black_min;
+    raw_loader->imgdata.sizes.iwidth = raw_loader->imgdata.sizes.width;
+    raw_loader->imgdata.sizes.iheight = raw_loader->imgdata.sizes.height;
+  } else {
+    raw_loader->raw2image();
 #ifdef DO_WARNINGS
 #warning "TODO: add a custom subtract_black() function that works in unbounded mode"
 #endif
-  raw_loader->subtract_black();
+    raw_loader->subtract_black();
+    for( int c = 0; c < 4; c++ ) raw_black[c] = 0;
+    raw_white = raw_loader->imgdata.color.maximum;
+  }
 
 	int iwidth = raw_loader->imgdata.sizes.iwidth;
 	int iheight = raw_loader->imgdata.sizes.iheight;
@@ -76,11 +244,15 @@ PF::RawImage::RawImage( const std::string f ):
 					 <<" "<<pdata->color.cam_mul[2]<<" "<<pdata->color.cam_mul[3]<<std::endl;
 	if(pdata->color.cam_mul[3] < 0.00000001) 
 		pdata->color.cam_mul[3] = pdata->color.cam_mul[1];
+  memory_size = (size_t)raw_loader->imgdata.sizes.raw_pitch*raw_loader->imgdata.sizes.raw_height;
+  if( !raw_data )
+    memory_size += sizeof(unsigned short)*4*iwidth*iheight;
 #endif
   
 #ifdef PF_USE_DCRAW_RT
-	if( !rtengine::CameraConstantsStore::getInstance() )
-		rtengine::CameraConstantsStore::initCameraConstants(PF::PhotoFlow::Instance().get_base_dir(),"");
+  // camconst.json is parsed only once, even if several raw files are opened concurrently
+  static GOnce camconst_once = G_ONCE_INIT;
+  g_once( &camconst_once, init_camera_constants, NULL );
 	int result = loadRaw( true, true, NULL, 1 );
 	if( result != 0 ) {
 		std::cout<<"RawImage::RawImage("<<f <<"): loadRaw() result="<<result<<std::endl;
@@ -90,6 +262,7 @@ PF::RawImage::RawImage( const std::string f ):
 		return;
 
 	compress_image();
+  memory_size = sizeof(float)*iwidth*iheight;
 	if ((this->get_cblack(4)+1)/2 == 1 && (this->get_cblack(5)+1)/2 == 1) {
 		for (int c = 0; c < 4; c++){
 			c_black[FC(c/2,c%2)] = this->get_cblack(6 + c/2 % this->get_cblack(4) * this->get_cblack(5) + c%2 % this->get_cblack(5));
@@ -113,6 +286,7 @@ PF::RawImage::RawImage( const std::string f ):
 			dcraw_data.color.cam_xyz[i][j] = get_cam_xyz(i,j);
 	pdata = &dcraw_data;
 #endif
+  PF::MemoryManager::Instance().allocated( PF_MEM_RAW_IMAGE, memory_size );
   //==================================================================
   // Save decoded data to cache file on disk.
   // The pixel values are normalized to the [0..65535] range 
@@ -127,10 +301,75 @@ PF::RawImage::RawImage( const std::string f ):
 #ifndef NDEBUG
   std::cout<<"Saving raw data to buffer..."<<std::endl;
 #endif
-  int row, col, col2;
+  int row;
   //size_t pxsize = sizeof(PF::RawPixel);
   //size_t pxsize = sizeof(float)+sizeof(guint8);
   size_t pxsize = sizeof(float)*2;
+#ifdef PF_USE_LIBRAW
+  // The rows are normalized in bands, each band being split into strips
+  // that are processed in parallel and then written to disk in one go.
+  // The strips are run by a pool of threads that is created once for the
+  // whole image, plus the calling thread.
+  int nthreads = vips_concurrency_get();
+  if( nthreads < 1 ) nthreads = 1;
+  float* bandbuf = (float*)malloc( pxsize*iwidth*PF_RAW_BAND_HEIGHT );
+  if( !bandbuf ) {
+    delete raw_loader;
+    raw_file_unmap( raw_file_data, raw_file_size );
+    return;
+  }
+  std::vector<raw_strip_t> strips( nthreads );
+  raw_band_t band;
+  band.mutex = vips_g_mutex_new();
+  band.done = vips_g_cond_new();
+  band.pending = 0;
+  GThreadPool* pool = NULL;
+  if( nthreads > 1 )
+    pool = g_thread_pool_new( raw_normalize_task, &band, nthreads-1, TRUE, NULL );
+  for(row=0;row<iheight;row+=PF_RAW_BAND_HEIGHT) {
+    int nrows = MIN( PF_RAW_BAND_HEIGHT, iheight-row );
+    int strip_height = (nrows+nthreads-1)/nthreads;
+    for( int t = 0; t < nthreads; t++ ) {
+      raw_strip_t& strip = strips[t];
+      strip.loader = raw_loader;
+      strip.raw = raw_data;
+      strip.raw_pitch = raw_loader->imgdata.sizes.raw_pitch/sizeof(unsigned short);
+      for( int c = 0; c < 4; c++ ) strip.black[c] = raw_black[c];
+      strip.scale = 65535.0f/raw_white;
+      strip.width = iwidth;
+      strip.row_start = row + MIN( t*strip_height, nrows );
+      strip.row_end = row + MIN( (t+1)*strip_height, nrows );
+      strip.out = bandbuf + (size_t)(strip.row_start-row)*iwidth*2;
+      if( strip.row_end <= strip.row_start ) continue;
+      // the last strip is processed by the calling thread
+      if( pool && t < nthreads-1 ) {
+        g_mutex_lock( band.mutex );
+        band.pending += 1;
+        g_mutex_unlock( band.mutex );
+        g_thread_pool_push( pool, &strip, NULL );
+      } else {
+        raw_normalize_strip( &strip );
+      }
+    }
+    g_mutex_lock( band.mutex );
+    while( band.pending > 0 )
+      g_cond_wait( band.done, band.mutex );
+    g_mutex_unlock( band.mutex );
+
+    if( write( temp_fd, bandbuf, pxsize*iwidth*nrows ) != (ssize_t)(pxsize*iwidth*nrows) )
+      break;
+#ifndef NDEBUG
+    std::cout<<"  rows "<<row<<"-"<<row+nrows-1<<" saved."<<std::endl;
+#endif
+  }
+  if( pool ) g_thread_pool_free( pool, FALSE, TRUE );
+  vips_g_mutex_free( band.mutex );
+  vips_g_cond_free( band.done );
+  free( bandbuf );
+  if( row > iheight ) row = iheight;
+#endif
+#ifdef PF_USE_DCRAW_RT
+  int col;
   guint8* rowbuf = (guint8*)malloc( iwidth*pxsize );
 #ifndef NDEBUG
   std::cout<<"Row buffer allocated: "<<(void*)rowbuf<<std::endl;
@@ -138,43 +377,24 @@ PF::RawImage::RawImage( const std::string f ):
 	guint8* ptr;
 	float* fptr;
   for(row=0;row<iheight;row++) {
-    unsigned int row_offset = row*iwidth;
 		ptr = rowbuf;
-		/**/
     for(col=0; col<iwidth; col++) {
-#ifdef PF_USE_LIBRAW
-      unsigned char color = (unsigned char)raw_loader->COLOR(row,col);
-      float val = raw_loader->imgdata.image[row_offset+col][color];
-			val /= raw_loader->imgdata.color.maximum;
-			val *= 65535;
-			if( row==10 && col==11 ) {
-				//std::cout<<"raw pixel @ (0,0): val="<<*fptr<<"  c="<<(int)ptr[sizeof(float)]<<std::endl;
-				std::cout<<"raw pixel @ ("<<row<<","<<col<<"): val="<<val<<"  c="<<(int)color<<std::endl;
-			}
-#endif
-#ifdef PF_USE_DCRAW_RT
       unsigned char color = (unsigned char)FC(row,col);
       float val = (data[row][col]-c_black[color])*65535/(this->get_white(color)-c_black[color]);
-#endif
 			fptr = (float*)ptr;
-      //*fptr = val;
-      //ptr[sizeof(float)] = color;
       fptr[0] = val;
       fptr[1] = color;
 			ptr += pxsize;
     }
-		/**/
     if( write( temp_fd, rowbuf, pxsize*iwidth ) != (pxsize*iwidth) )
       break;
 #ifndef NDEBUG
     if( (row%100) == 0 ) std::cout<<"  row "<<row<<" saved."<<std::endl;
-#ifdef PF_USE_DCRAW_RT
 		if( row==0 ) {
 			for(col=0; col<10; col++) {
 				std::cout<<"  val="<<data[row][col]<<"  c="<<(unsigned int)FC(row,col)<<std::endl;
 			}
 		}
-#endif
 #endif
   }
 #ifndef NDEBUG
@@ -183,6 +403,7 @@ PF::RawImage::RawImage( const std::string f ):
   free( rowbuf );
 #ifndef NDEBUG
   std::cout<<"Row buffer deleted"<<std::endl;
+#endif
 #endif
 
   std::cout<<"iwidth="<<iwidth<<std::endl
@@ -231,7 +452,12 @@ PF::RawImage::RawImage( const std::string f ):
   print_exif();
 
 #ifdef PF_USE_LIBRAW
+  // The decoded data is not needed anymore, since the normalized values
+  // are read back from the cache file
   delete raw_loader;
+  raw_file_unmap( raw_file_data, raw_file_size );
+  PF::MemoryManager::Instance().released( PF_MEM_RAW_IMAGE, memory_size );
+  memory_size = 0;
   //return;
 #endif
 
@@ -299,6 +525,7 @@ PF::RawImage::~RawImage()
 {
   if( image ) PF_UNREF( image, "RawImage::~RawImage() image" );
   if( demo_image ) PF_UNREF( demo_image, "RawImage::~RawImage() demo_image" );
+  PF::MemoryManager::Instance().released( PF_MEM_RAW_IMAGE, memory_size );
 	std::cout<<"RawImage::~RawImage() called."<<std::endl;
 	if( !(cache_file_name.empty()) )
 		unlink( cache_file_name.c_str() );
@@ -367,3 +594,64 @@ void PF::RawImage::print_exif()
 std::map<Glib::ustring, PF::RawImage*> PF::raw_images;
 
 
+VipsImage* PF::load_embedded_preview( const std::string& fname, int& width, int& height )
+{
+  VipsImage* thumb = NULL;
+#ifdef PF_USE_LIBRAW
+  // Only the metadata and the embedded preview are read, which is
+  // much faster than decoding the raw data
+  LibRaw* loader = new LibRaw();
+  if( loader->open_file( fname.c_str() ) != 0 ||
+      loader->unpack_thumb() != 0 ) {
+    delete loader;
+    return NULL;
+  }
+  width = loader->imgdata.sizes.width;
+  height = loader->imgdata.sizes.height;
+  int flip = loader->imgdata.sizes.flip;
+
+  int err = 0;
+  libraw_processed_image_t* pimg = loader->dcraw_make_mem_thumb( &err );
+  if( pimg ) {
+    VipsImage* tmp = NULL;
+    if( pimg->type == LIBRAW_IMAGE_JPEG ) {
+      if( vips_jpegload_buffer( pimg->data, pimg->data_size, &tmp, NULL ) )
+        tmp = NULL;
+    } else if( pimg->type == LIBRAW_IMAGE_BITMAP && pimg->bits == 8 ) {
+      tmp = vips_image_new_from_memory( pimg->data, pimg->data_size,
+          pimg->width, pimg->height, pimg->colors, VIPS_FORMAT_UCHAR );
+    }
+    // The pixels are copied, since the LibRaw buffer is released below
+    if( tmp ) {
+      if( tmp->Bands == 3 && tmp->BandFmt == VIPS_FORMAT_UCHAR ) {
+        thumb = vips_image_new_memory();
+        if( vips_image_write( tmp, thumb ) ) {
+          PF_UNREF( thumb, "load_embedded_preview(): thumb unref" );
+          thumb = NULL;
+        }
+      }
+      PF_UNREF( tmp, "load_embedded_preview(): tmp unref" );
+    }
+    LibRaw::dcraw_clear_mem( pimg );
+  }
+  delete loader;
+
+  // Some cameras store the preview already rotated to the shooting orientation,
+  // while the decoded raw data is not
+  if( thumb && ((thumb->Xsize > thumb->Ysize) != (width > height)) ) {
+    VipsImage* rotated = NULL;
+    if( !vips_rot( thumb, &rotated, (flip == 5) ? VIPS_ANGLE_D90 : VIPS_ANGLE_D270, NULL ) ) {
+      PF_UNREF( thumb, "load_embedded_preview(): thumb unref" );
+      thumb = rotated;
+    }
+  }
+#ifndef NDEBUG
+  if( thumb )
+    std::cout<<"load_embedded_preview(): "<<thumb->Xsize<<"x"<<thumb->Ysize
+             <<" preview found for "<<width<<"x"<<height<<" image"<<std::endl;
+#endif
+#endif
+  return thumb;
+}
+
+
@@ -100,6 +100,9 @@ namespace PF
 
     PF::ImagePyramid pyramid;
 
+    // Size of the decoded raw data kept in memory by the raw loader
+    size_t memory_size;
+
   public:
     RawImage( const std::string name );
     ~RawImage();
@@ -116,6 +119,11 @@ namespace PF
 
 	extern std::map<Glib::ustring, PF::RawImage*> raw_images;
 
+  // Extract the preview image embedded in a raw file, as an 8-bit RGB image
+  // oriented like the decoded raw data. The size of the decoded raw data is
+  // returned in width and height. Returns NULL if no usable preview is found.
+  VipsImage* load_embedded_preview( const std::string& file_name, int& width, int& height );
+
 }
 
 #endif
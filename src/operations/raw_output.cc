@@ -29,6 +29,7 @@
 
 //#include <arpa/inet.h>
 
+#include "../base/shared_resources.hh"
 #include "raw_output.hh"
 
 /* We need C linkage for this.
@@ -63,7 +64,8 @@ PF::RawOutputPar::RawOutputPar():
   current_out_profile_mode( OUT_PROF_sRGB ),
   out_profile_name("out_profile_name", this),
   out_profile( NULL ),
-  transform( NULL )
+  transform( NULL ),
+  apply_wb( false )
 {
   profile_mode.add_enum_value(PF::IN_PROF_NONE,"NONE","NONE");
   profile_mode.add_enum_value(PF::IN_PROF_MATRIX,"MATRIX","MATRIX");
@@ -170,19 +172,19 @@ VipsImage* PF::RawOutputPar::build(std::vector<VipsImage*>& in, int first,
     //std::cout<<"  out_profile_mode="<<out_profile_mode.get_enum_value().first<<std::endl;
     switch( out_profile_mode.get_enum_value().first ) {
     case OUT_PROF_sRGB:
-      out_profile = dt_colorspaces_create_srgb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_sRGB );
       //std::cout<<"RawOutputPar::build(): created sRGB output profile"<<std::endl;
       break;
     case OUT_PROF_ADOBE:
-      out_profile = dt_colorspaces_create_adobergb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_ADOBE );
       //std::cout<<"RawOutputPar::build(): created AdobeRGB output profile"<<std::endl;
       break;
     case OUT_PROF_PROPHOTO:
-      out_profile = dt_colorspaces_create_prophotorgb_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_PROPHOTO );
       //std::cout<<"RawOutputPar::build(): created ProPhoto output profile"<<std::endl;
       break;
     case OUT_PROF_LAB:
-      out_profile = dt_colorspaces_create_lab_profile();
+      out_profile = PF::SharedResources::Instance().open_profile( PF::STD_PROF_LAB );
       //std::cout<<"RawOutputPar::build(): created Lab output profile"<<std::endl;
       break;
     case OUT_PROF_CUSTOM:
@@ -118,6 +118,11 @@ namespace PF
 
     cmsHTRANSFORM transform;
 
+    // White balance multipliers applied before the color conversion, when the
+    // input image is not demosaiced and the pre-processing pass is skipped
+    bool apply_wb;
+    float wb_mul[3];
+
   public:
 
     RawOutputPar();
@@ -128,6 +133,14 @@ namespace PF
     cmsToneCurve* get_srgb_curve() { return srgb_curve; }
     cmsHTRANSFORM get_transform() { return transform; }
 
+    void set_wb_multipliers( const float* mul )
+    {
+      apply_wb = (mul != NULL);
+      if( mul ) for( int i = 0; i < 3; i++ ) wb_mul[i] = mul[i];
+    }
+    bool get_apply_wb() { return apply_wb; }
+    const float* get_wb_multipliers() { return wb_mul; }
+
     void set_image_hints( VipsImage* img )
     {
       if( !img ) return;
@@ -201,10 +214,28 @@ namespace PF
       std::cout<<"("<<r->left<<","<<r->top<<"): max = "<<max[0]<<"  "<<max[1]<<"  "<<max[2]<<std::endl;
       */
 
+      const float* mul = opar->get_wb_multipliers();
+
       for( y = 0; y < height; y++ ) {
         p = (T*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
         pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
 
+        if( opar->get_apply_wb() ) {
+          // white balance and clipping, fused with the color conversion below
+          for( x = 0; x < line_size; x+=3 ) {
+            line[x] = CLIP(p[x] * mul[0]);
+            line[x+1] = CLIP(p[x+1] * mul[1]);
+            line[x+2] = CLIP(p[x+2] * mul[2]);
+#ifdef RT_EMU
+            /* RawTherapee emulation */
+            line[x] *= 65535;
+            line[x+1] *= 65535;
+            line[x+2] *= 65535;
+#endif
+          }
+          p = line;
+        }
+
           if( false && r->top==0 && r->left==0 ) {
             std::cout<<"RawOutput::render(): camera_profile_mode="<<opar->get_camera_profile_mode()<<std::endl;
           }
@@ -253,7 +284,7 @@ namespace PF
 
         }
       }
-      delete line;
+      delete[] line;
     }
   };
 
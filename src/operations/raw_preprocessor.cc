@@ -53,10 +53,54 @@ PF::RawPreprocessorPar::RawPreprocessorPar():
   wb_mode.add_enum_value(PF::WB_CAMERA,"CAMERA","CAMERA");
   wb_mode.add_enum_value(PF::WB_SPOT,"SPOT","Spot");
   wb_mode.add_enum_value(PF::WB_COLOR_SPOT,"COLOR_SPOT","Color spot");
+  for( int i = 0; i < 4; i++ ) wb_mul[i] = 1;
   set_type("raw_preprocessor" );
 }
 
 
+bool PF::RawPreprocessorPar::init_wb_multipliers( VipsImage* img )
+{
+  size_t blobsz;
+  if( !img ||
+      vips_image_get_blob( img, "raw_image_data", (void**)&image_data, &blobsz ) ||
+      (blobsz != sizeof(dcraw_data_t)) )
+    return false;
+
+  float mul[4];
+  switch( get_wb_mode() ) {
+  case WB_CAMERA:
+    mul[0] = image_data->color.cam_mul[0]*get_camwb_corr_red();
+    mul[1] = image_data->color.cam_mul[1]*get_camwb_corr_green();
+    mul[2] = image_data->color.cam_mul[2]*get_camwb_corr_blue();
+    mul[3] = image_data->color.cam_mul[3]*get_camwb_corr_green();
+    break;
+  default:
+    mul[0] = get_wb_red();
+    mul[1] = get_wb_green();
+    mul[2] = get_wb_blue();
+    mul[3] = get_wb_green();
+    break;
+  }
+
+  float min_mul = mul[0];
+  float max_mul = mul[0];
+  for( int i = 1; i < 4; i++ ) {
+    if( mul[i] < min_mul ) min_mul = mul[i];
+    if( mul[i] > max_mul ) max_mul = mul[i];
+  }
+#ifdef RT_EMU
+  /* RawTherapee emulation */
+  float range = max_mul;
+#else
+  float range = min_mul;
+#endif
+
+  for( int i = 0; i < 4; i++ )
+    wb_mul[i] = mul[i] * get_exposure() / range;
+  return true;
+}
+
+
 VipsImage* PF::RawPreprocessorPar::build(std::vector<VipsImage*>& in, int first, 
 				     VipsImage* imap, VipsImage* omap, 
 				     unsigned int& level)
@@ -64,12 +108,11 @@ VipsImage* PF::RawPreprocessorPar::build(std::vector<VipsImage*>& in, int first,
   if( (in.size()<1) || (in[0]==NULL) )
     return NULL;
   
-  size_t blobsz;
-  if( vips_image_get_blob( in[0], "raw_image_data",
-			   (void**)&image_data, 
-			   &blobsz ) )
+  // Only CFA data is processed here, see RawPreprocessor::render()
+  if( in[0]->Bands == 3 )
     return NULL;
-  if( blobsz != sizeof(dcraw_data_t) )
+
+  if( !init_wb_multipliers( in[0] ) )
     return NULL;
 
   VipsImage* image = OpParBase::build( in, first, NULL, NULL, level );
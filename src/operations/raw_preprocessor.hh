@@ -36,6 +36,7 @@
 #include "../base/rawmatrix.hh"
 
 #include "raw_image.hh"
+#include "demosaic_base.hh"
 
 
 //#define RT_EMU 1
@@ -72,6 +73,10 @@ namespace PF
 
     Property<float> exposure;
 
+    // Exposure and white balance multipliers for the four CFA colors,
+    // including the normalization of the output range
+    float wb_mul[4];
+
   public:
     RawPreprocessorPar();
 
@@ -99,6 +104,12 @@ namespace PF
 
     float get_exposure() { return exposure.get(); }
 
+    const float* get_wb_multipliers() { return wb_mul; }
+
+    // Read the raw data attached to the image and compute the multipliers.
+    // Also used when the white balance is applied by a later processing stage.
+    bool init_wb_multipliers( VipsImage* img );
+
     VipsImage* build(std::vector<VipsImage*>& in, int first, 
 										 VipsImage* imap, VipsImage* omap, unsigned int& level);
   };
@@ -109,211 +120,25 @@ namespace PF
   class RawPreprocessor
   {
   public: 
-    void render_camwb(VipsRegion** ireg, int n, int in_first,
-											VipsRegion* imap, VipsRegion* omap, 
-											VipsRegion* oreg, RawPreprocessorPar* par)
-    {
-      dcraw_data_t* image_data = par->get_image_data();
-      float exposure = par->get_exposure();
-      Rect *r = &oreg->valid;
-      int nbands = ireg[in_first]->im->Bands;
-    
-      int x, y;
-      //float range = image_data->color.maximum - image_data->color.black;
-      float range = 1;
-			float mul[4] = {
-				image_data->color.cam_mul[0]*par->get_camwb_corr_red(),
-				image_data->color.cam_mul[1]*par->get_camwb_corr_green(),
-				image_data->color.cam_mul[2]*par->get_camwb_corr_blue(),
-				image_data->color.cam_mul[3]*par->get_camwb_corr_green()
-			};
-      float min_mul = mul[0];
-      float max_mul = mul[0];
-			/*
-      for(int i = 0; i < 4; i++) {
-				std::cout<<"cam_mu["<<i<<"]="<<image_data->color.cam_mul[i]<<"  ";
-      }
-      std::cout<<std::endl;
-			*/
-      for(int i = 1; i < 4; i++) {
-				if( mul[i] < min_mul )
-					min_mul = mul[i];
-				if( mul[i] > max_mul )
-					max_mul = mul[i];
-      }
-      //std::cout<<"range="<<range<<"  min_mul="<<min_mul<<"  new range="<<range*min_mul<<std::endl;
-#ifdef RT_EMU
-      /* RawTherapee emulation */
-      range *= max_mul;
-#else      
-      range *= min_mul;
-      //range *= max_mul;
-#endif
-    
-      for(int i = 0; i < 4; i++) 
-				mul[i] = mul[i] * exposure / range;
-    
-      //if(r->left==0 && r->top==0) std::cout<<"RawPreprocessor::render_camwb(): nbands="<<nbands<<std::endl;
-      if( nbands == 3 ) {
-				float* p;
-				float* pout;
-				int line_sz = r->width*3;
-				for( y = 0; y < r->height; y++ ) {
-					p = (float*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
-					pout = (float*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
-					for( x=0; x < line_sz; x+=3) {
-						pout[x] = CLIP(p[x] * mul[0]);
-						pout[x+1] = CLIP(p[x+1] * mul[1]);
-						pout[x+2] = CLIP(p[x+2] * mul[2]);
-						//if(r->left==0 && r->top==0) std::cout<<"  p["<<x<<"]="<<p[x]<<"  pout["<<x<<"]="<<pout[x]<<std::endl;
-#ifdef RT_EMU
-						/* RawTherapee emulation */
-						pout[x] *= 65535;
-						pout[x+1] *= 65535;
-						pout[x+2] *= 65535;
-#endif
-					}
-				}
-      } else {
-				PF::raw_pixel_t* p;
-				PF::raw_pixel_t* pout;
-				for( y = 0; y < r->height; y++ ) {
-					p = (PF::raw_pixel_t*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
-					pout = (PF::raw_pixel_t*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
-					PF::RawMatrixRow rp( p );
-					PF::RawMatrixRow rpout( pout );
-					for( x=0; x < r->width; x++) {
-					  //std::cout<<"RawPreprocessor: x="<<x<<"  r->width="<<r->width
-					  //      <<"  size of pel="<<VIPS_IMAGE_SIZEOF_PEL(ireg[in_first]->im)
-					  //      <<","<<VIPS_IMAGE_SIZEOF_PEL(oreg->im)<<std::endl;
-						rpout.color(x) = rp.color(x);
-						rpout[x] = CLIP(rp[x] * mul[ rp.icolor(x) ]);
-            //std::cout<<"  rp.color(x)="<<rp.color(x)
-            //    <<"  rp[x]="<<rp[x]<<"  mul[ rp.icolor(x) ]="
-            //    <<mul[ rp.icolor(x) ]<<"  rpout[x]="<<rpout[x]<<std::endl;
-#ifdef RT_EMU
-						/* RawTherapee emulation */
-						rpout[x] *= 65535;
-#endif
-					}
-				}
-      }
-    }
-
-
-    void render_spotwb(VipsRegion** ireg, int n, int in_first,
-											 VipsRegion* imap, VipsRegion* omap, 
-											 VipsRegion* oreg, RawPreprocessorPar* par)
-    {
-      //dcraw_data_t* image_data = par->get_image_data();
-      float exposure = par->get_exposure();
-      Rect *r = &oreg->valid;
-      int nbands = ireg[in_first]->im->Bands;
-    
-      //PF::RawPixel* p;
-      //PF::RawPixel* pout;
-      int x, y;
-      //float range = image_data->color.maximum - image_data->color.black;
-      float range = 1;
-      float min_mul = par->get_wb_red();
-      float max_mul = par->get_wb_red();
-
-      if( par->get_wb_green() < min_mul )
-				min_mul = par->get_wb_green();
-      if( par->get_wb_green() > max_mul )
-				max_mul = par->get_wb_green();
-
-      if( par->get_wb_blue() < min_mul )
-				min_mul = par->get_wb_blue();
-      if( par->get_wb_blue() > max_mul )
-				max_mul = par->get_wb_blue();
-
-      //std::cout<<"WB mult: "<<par->get_wb_red()<<" "<<par->get_wb_green()<<" "<<par->get_wb_blue()<<std::endl;
-      //std::cout<<"range="<<range<<"  min_mul="<<min_mul<<"  new range="<<range*min_mul<<std::endl;
-#ifdef RT_EMU
-      /* RawTherapee emulation */
-      range *= max_mul;
-#else
-      range *= min_mul;
-#endif
-
-      float mul[4] = { 
-				par->get_wb_red() * exposure / range, 
-				par->get_wb_green() * exposure / range, 
-				par->get_wb_blue() * exposure / range, 
-				par->get_wb_green() * exposure / range
-      };
-
-      //std::cout<<"render_spotwb(): region left/top="<<r->left<<","<<r->top<<"+"<<r->width<<"+"<<r->height<<std::endl;
-      //std::cout<<"  raw_preproc_sample_x="<<raw_preproc_sample_x<<std::endl;
-      //std::cout<<"  raw_preproc_sample_y="<<raw_preproc_sample_y<<std::endl;
-    
-      if( nbands == 3 ) {
-				float* p;
-				float* pout;
-				int line_sz = r->width*3;
-				for( y = 0; y < r->height; y++ ) {
-					p = (float*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
-					pout = (float*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
-					for( x=0; x < line_sz; x+=3) {
-						pout[x] = CLIP(p[x] * mul[0]);
-						pout[x+1] = CLIP(p[x+1] * mul[1]);
-						pout[x+2] = CLIP(p[x+2] * mul[2]);
-#ifdef RT_EMU
-						/* RawTherapee emulation */
-						pout[x] *= 65535;
-						pout[x+1] *= 65535;
-						pout[x+2] *= 65535;
-#endif
-					}
-				}
-      } else {
-				PF::raw_pixel_t* p;
-				PF::raw_pixel_t* pout;
-				for( y = 0; y < r->height; y++ ) {
-					p = (PF::raw_pixel_t*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
-					pout = (PF::raw_pixel_t*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
-					PF::RawMatrixRow rp( p );
-					PF::RawMatrixRow rpout( pout );
-					for( x=0; x < r->width; x++) {
-						rpout.color(x) = rp.color(x);
-						rpout[x] = CLIP(rp[x] * mul[ rp.icolor(x) ]);
-            
-            int dx = r->left+x-raw_preproc_sample_x;
-            int dy = r->top+y-raw_preproc_sample_y;
-            //if( raw_preproc_sample_x > 0 && raw_preproc_sample_y > 0 )
-            //  std::cout<<"  dx="<<dx<<"  dy="<<dy<<std::endl;
-						if( false && abs(dx)<2 && abs(dy)<1 ) 
-              std::cout<<"  rp["<<x<<"]="<<rp[x]
-                       <<"  mul["<<(int)rp.color(x)<<"]="<<mul[ rp.icolor(x) ]
-                       <<"  rpout["<<x<<"]="<<rpout[x]<<std::endl;
-#ifdef RT_EMU
-						/* RawTherapee emulation */
-						rpout[x] *= 65535;
-#endif
-					}
-				}
-      }
-    }
-
-
+    /* Single pass over the CFA data: white balance, exposure and clipping
+       are applied with the multipliers pre-computed by the build() method.
+       The RAW developer does not use this pass, since the white balance is
+       applied by the demosaicing step (CFA data) or by the output stage
+       (3-channel data)
+    */
     void render(VipsRegion** ireg, int n, int in_first,
 								VipsRegion* imap, VipsRegion* omap, 
 								VipsRegion* oreg, OpParBase* par)
     {
       RawPreprocessorPar* rdpar = dynamic_cast<RawPreprocessorPar*>(par);
       if( !rdpar ) return;
-      //std::cout<<"RawPreprocessor::render(): rdpar->get_wb_mode()="<<rdpar->get_wb_mode()<<std::endl;
-      switch( rdpar->get_wb_mode() ) {
-      case WB_CAMERA:
-				render_camwb(ireg, n, in_first, imap, omap, oreg, rdpar);
-				//std::cout<<"render_camwb() called"<<std::endl;
-				break;
-      case WB_SPOT:
-      case WB_COLOR_SPOT:
-				render_spotwb(ireg, n, in_first, imap, omap, oreg, rdpar);
-				//std::cout<<"render_spotwb() called"<<std::endl;
-				break;
+      const float* mul = rdpar->get_wb_multipliers();
+      Rect *r = &oreg->valid;
+
+      for( int y = 0; y < r->height; y++ ) {
+				float* p = (float*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
+				float* pout = (float*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
+				raw_wb_row( p, pout, r->width, mul );
       }
     }
   };
@@ -0,0 +1,94 @@
+/* 
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+#ifndef STATS_TAP_H
+#define STATS_TAP_H
+
+#include <string.h>
+
+#include <iostream>
+
+#include "../base/format_info.hh"
+#include "../base/image_stats.hh"
+#include "../base/operation.hh"
+
+namespace PF 
+{
+
+  /* Pass-through operation that accumulates the statistics of the pixels
+   * flowing through it, so that they are obtained without an additional
+   * pass over the image
+   */
+  class StatsTapPar: public OpParBase
+  {
+    ImageStats* stats;
+
+  public:
+    StatsTapPar();
+    bool has_intensity() { return false; }
+    bool has_opacity() { return false; }
+    bool has_imap() { return false; }
+    bool has_omap() { return false; }
+    bool needs_input() { return true; }
+
+    ImageStats* get_stats() { return stats; }
+    void set_stats( ImageStats* s ) { stats = s; }
+  };
+
+  
+
+  template < OP_TEMPLATE_DEF > 
+  class StatsTapProc
+  {
+  public: 
+    void render(VipsRegion** ireg, int n, int in_first,
+                VipsRegion* imap, VipsRegion* omap, 
+                VipsRegion* oreg, OpParBase* par)
+    {
+      StatsTapPar* opar = dynamic_cast<StatsTapPar*>(par);
+      if( !opar ) return;
+      Rect *r = &oreg->valid;
+      int line_size = r->width * oreg->im->Bands;
+
+      for( int y = 0; y < r->height; y++ ) {
+        T* p = (T*)VIPS_REGION_ADDR( ireg[in_first], r->left, r->top + y ); 
+        T* pout = (T*)VIPS_REGION_ADDR( oreg, r->left, r->top + y ); 
+        memcpy( pout, p, sizeof(T)*line_size );
+      }
+
+      if( opar->get_stats() )
+        opar->get_stats()->update( oreg, *r );
+    }
+  };
+
+
+  ProcessorBase* new_stats_tap();
+}
+
+#endif 
@@ -36,6 +36,10 @@ PF::UnsharpMaskPar::UnsharpMaskPar():
 	amount("amount",this,100)
 {
 	blur = new_gaussblur();
+	// The internal blur is not stored in the document, and always uses the
+	// native blur for large radii, in preview as well as when exporting
+	PropertyBase* pmode = blur->get_par()->get_property("preview_mode");
+	if( pmode ) pmode->set_enum_value( PF_BLUR_NATIVE );
 	
 	set_type( "unsharp_mask" );
 }
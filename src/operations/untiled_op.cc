@@ -28,6 +28,8 @@
  */
 
 
+#include <sstream>
+
 #include "../base/pf_mkstemp.hh"
 
 #include "untiled_op.hh"
@@ -37,7 +39,10 @@
 PF::UntiledOperationPar::UntiledOperationPar():
   OpParBase(),
   do_update( true ),
-  cache_files_num( 0 )
+  cache_files_num( 0 ),
+  preview_level( 0 ),
+  out_width( 0 ), out_height( 0 ),
+  run_level( 0 )
 {	
   set_cache_files_num(1);
   convert_format_in = new PF::Processor<PF::ConvertFormatPar,PF::ConvertFormatProc>();
@@ -138,6 +143,12 @@ std::string PF::UntiledOperationPar::get_cache_file_name( unsigned int n )
              <<cache_file_name<<")"<<std::endl;
 #endif
   }
+  // Each run level has its own cache file, derived from the full-resolution one
+  if( (run_level > 0) && (cache_file_name.size() > 4) ) {
+    std::ostringstream str;
+    str<<cache_file_name.substr( 0, cache_file_name.size()-4 )<<"-l"<<run_level<<".tif";
+    cache_file_name = str.str();
+  }
 #ifndef NDEBUG
   std::cout<<"UntiledOperationPar: render_mode="<<get_render_mode()<<"  cache_file_name="<<cache_file_name<<std::endl;
 #endif
@@ -146,6 +157,59 @@ std::string PF::UntiledOperationPar::get_cache_file_name( unsigned int n )
 }
 
 
+void PF::UntiledOperationPar::init_run_level( VipsImage* in, unsigned int level )
+{
+  run_level = level;
+  out_width = in ? in->Xsize : 0;
+  out_height = in ? in->Ysize : 0;
+  if( (get_render_mode() != PF_RENDER_PREVIEW) || !in )
+    return;
+
+  // Same size limit as the image pyramids
+  int width = in->Xsize, height = in->Ysize;
+  while( (run_level < preview_level) && (((width>height) ? width : height) > 256) ) {
+    width /= 2;
+    height /= 2;
+    run_level += 1;
+  }
+#ifndef NDEBUG
+  std::cout<<"UntiledOperationPar::init_run_level(): level="<<level<<"  preview level="<<preview_level
+           <<"  run level="<<run_level<<std::endl;
+#endif
+}
+
+
+float PF::UntiledOperationPar::get_run_scale()
+{
+  float scale = 1;
+  for( unsigned int l = 0; l < run_level; l++ )
+    scale /= 2;
+  return scale;
+}
+
+
+VipsImage* PF::UntiledOperationPar::get_run_input( VipsImage* in, unsigned int level )
+{
+  if( !in ) return NULL;
+  PF_REF( in, "UntiledOperationPar::get_run_input(): in ref" );
+  // The image is reduced in the same way as the pyramid levels
+  for( unsigned int l = level; l < run_level; l++ ) {
+    VipsImage* blurred;
+    if( vips_gaussblur( in, &blurred, 0.7, NULL ) ) {
+      PF_UNREF( in, "UntiledOperationPar::get_run_input(): in unref" );
+      return NULL;
+    }
+    PF_UNREF( in, "UntiledOperationPar::get_run_input(): in unref" );
+    if( vips_subsample( blurred, &in, 2, 2, NULL ) ) {
+      PF_UNREF( blurred, "UntiledOperationPar::get_run_input(): blurred unref" );
+      return NULL;
+    }
+    PF_UNREF( blurred, "UntiledOperationPar::get_run_input(): blurred unref" );
+  }
+  return in;
+}
+
+
 std::string PF::UntiledOperationPar::save_image( VipsImage* image, VipsBandFmt format )
 {
   char fname[500];
@@ -297,7 +361,9 @@ std::vector<VipsImage*> PF::UntiledOperationPar::get_output( unsigned int& level
 
     //raster_image->print_icc();
 
-    VipsImage* image = raster_image->get_image( level );
+    // The cache files are already at the run level
+    unsigned int raster_level = 0;
+    VipsImage* image = raster_image->get_image( raster_level );
 
     //#ifndef NDEBUG
     std::cout<<"UntiledOperationPar::get_output(): image="<<image<<std::endl;
@@ -305,6 +371,27 @@ std::vector<VipsImage*> PF::UntiledOperationPar::get_output( unsigned int& level
     if( !image ) continue;
     raster_image->print_icc( image );
 
+    if( (run_level > level) &&
+        ((image->Xsize != out_width) || (image->Ysize != out_height)) ) {
+      // The operation was run at a lower resolution than the one of the pipeline,
+      // and the result is interpolated back to the size of the input image
+      double fact = 1;
+      for( unsigned int l = level; l < run_level; l++ )
+        fact *= 2;
+      VipsImage* scaled;
+      if( vips_affine( image, &scaled, fact, 0, 0, fact, NULL ) ) {
+        PF_UNREF( image, "UntiledOperationPar::get_output(): image unref after failed vips_affine()" );
+        continue;
+      }
+      PF_UNREF( image, "UntiledOperationPar::get_output(): image unref after vips_affine()" );
+      if( vips_embed( scaled, &image, 0, 0, out_width, out_height,
+          "extend", VIPS_EXTEND_COPY, NULL ) ) {
+        PF_UNREF( scaled, "UntiledOperationPar::get_output(): scaled unref after failed vips_embed()" );
+        continue;
+      }
+      PF_UNREF( scaled, "UntiledOperationPar::get_output(): scaled unref after vips_embed()" );
+    }
+
     VipsImage* out = image;
     if( (get_format() != image->BandFmt) ) {
       std::vector<VipsImage*> in;
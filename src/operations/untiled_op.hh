@@ -50,10 +50,20 @@ namespace PF
     std::vector<std::string> render_cache_file_names;
     unsigned int cache_files_num;
 
+    // Lowest level of the displayed preview pipelines; in preview mode the
+    // operation is never run at a higher resolution than this
+    unsigned int preview_level;
+
+    // Size of the images returned by get_output()
+    int out_width, out_height;
+
   protected:
 
     std::vector<RasterImage*> raster_image_vec;
 
+    // Pyramid level of the images processed by the operation
+    unsigned int run_level;
+
   public:
     UntiledOperationPar();
     ~UntiledOperationPar();
@@ -62,6 +72,7 @@ namespace PF
     bool has_opacity() { return true; }
     bool needs_caching() { return false; }
     bool init_hidden() { return false; }
+    bool needs_whole_image() { return true; }
 
     void set_cache_files_num( unsigned int n )
     {
@@ -90,6 +101,20 @@ namespace PF
 
     void refresh() { do_update = true; }
 
+    void set_preview_level( unsigned int l ) { preview_level = l; }
+
+    // Select the level at which the operation is run, given the input image
+    // and the level of the pipeline. The full resolution is only used for
+    // exporting, or when the preview is displayed at 1:1 zoom.
+    void init_run_level( VipsImage* in, unsigned int level );
+    unsigned int get_run_level() { return run_level; }
+    // Size of the processed images relative to the full-resolution ones,
+    // used to scale the parameters expressed in pixels
+    float get_run_scale();
+    // Reduce an input image from the pipeline level to the run level.
+    // Returns a new reference.
+    VipsImage* get_run_input( VipsImage* in, unsigned int level );
+
     int get_padding( int level );      
 
     bool import_settings( OpParBase* pin );
@@ -70,6 +70,8 @@
 #include "base/pf_file_loader.hh"
 
 #include "base/image.hh"
+#include "base/memory_manager.hh"
+#include "base/shared_resources.hh"
 
 #include "base/new_operation.hh"
 
@@ -125,6 +127,13 @@ int main (int argc, char *argv[])
   signal(SIGSEGV, handler);   // install our handler
 #endif
 
+  // Memory budget in MB, half of the physical memory by default.
+  // It must be set before initializing vips, see MemoryManager::init()
+  size_t memory_budget = 0;
+  if( getenv("PF_MEMORY_BUDGET") )
+    memory_budget = ((size_t)atol( getenv("PF_MEMORY_BUDGET") ))*1024*1024;
+  PF::MemoryManager::Instance().init( memory_budget );
+
   if (vips_init (argv[0]))
     //vips::verror ();
     return 1;
@@ -132,11 +141,18 @@ int main (int argc, char *argv[])
   vips_layer_get_type();
   vips_gmic_get_type();
 
+  // Out-of-core mode for gigapixel images, see main.cc
+  if( getenv("PF_OUT_OF_CORE") )
+    PF::PhotoFlow::Instance().set_out_of_core( atoi( getenv("PF_OUT_OF_CORE") ) != 0 );
+
 #ifndef NDEBUG
   im_concurrency_set( 1 );
   vips_cache_set_trace( true );
 #endif
 
+  // Number of image processing threads, see main.cc
+  PF::PhotoFlow::Instance().set_thread_budget( getenv("PF_NUM_THREADS") ? atoi( getenv("PF_NUM_THREADS") ) : 0 );
+
   //vips__leak = 1;
 
   //im_package* result = im_load_plugin("src/pfvips.plg");
@@ -160,6 +176,9 @@ int main (int argc, char *argv[])
   PF::PhotoFlow::Instance().set_new_op_func_nogui( PF::new_operation );
   PF::PhotoFlow::Instance().set_batch( true );
 
+  // Load the shared databases while the input image is being opened
+  PF::SharedResources::Instance().start_background_init();
+
   //PF::ImageProcessor::Instance();
 
   if( PF::PhotoFlow::Instance().get_cache_dir().empty() ) {
@@ -222,7 +241,16 @@ int main (int argc, char *argv[])
       PF::insert_pf_preset( argv[i], image, NULL, &(image->get_layer_manager().get_layers()), false );
     }
 
-    image->export_merged( img_out );
+    PF::MemoryManager::Instance().enforce_budget();
+    if( !image->export_merged( img_out ) ) {
+      std::cout<<"Cannot export "<<img_out<<". Exiting."<<std::endl;
+      delete image;
+      vips_shutdown();
+      return 1;
+    }
+    image->get_export_stats().print( std::cout );
+    PF::MemoryManager::Instance().print( std::cout );
+    PF::SharedResources::Instance().print( std::cout );
   }
   //Shows the window and returns when it is closed.
 
@@ -0,0 +1,154 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+/*
+    Command-line client of the PhotoFlow render daemon.
+
+    Usage:
+      pfclient [-s socket] [-p priority] <input> [presets...] <output>
+      pfclient [-s socket] --status
+      pfclient [-s socket] --shutdown
+
+    The arguments of a render job are the same as for pfbatch. The client waits
+    for the job to be finished, and exits with a non-zero status if it failed.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pfdaemon.hh"
+
+
+static std::string absolute_path( const char* name )
+{
+  char* path = realpath( name, NULL );
+  if( path ) {
+    std::string result = path;
+    free( path );
+    return result;
+  }
+  if( name[0] == '/' )
+    return std::string( name );
+  char cwd[PATH_MAX];
+  if( !getcwd( cwd, sizeof(cwd) ) )
+    return std::string( name );
+  return( std::string(cwd) + "/" + name );
+}
+
+
+int main( int argc, char** argv )
+{
+  std::string socket_path = PF::daemon_default_socket();
+  std::string priority = "0";
+  std::vector<std::string> request;
+
+  int i = 1;
+  for( ; i < argc; i++ ) {
+    if( !strcmp( argv[i], "-s" ) && i+1 < argc ) socket_path = argv[++i];
+    else if( !strcmp( argv[i], "-p" ) && i+1 < argc ) priority = argv[++i];
+    else break;
+  }
+
+  if( i == argc-1 && !strcmp( argv[i], "--status" ) ) {
+    request.push_back( PF_DAEMON_STATUS );
+  } else if( i == argc-1 && !strcmp( argv[i], "--shutdown" ) ) {
+    request.push_back( PF_DAEMON_SHUTDOWN );
+  } else if( argc-i >= 2 ) {
+    request.push_back( PF_DAEMON_RENDER );
+    request.push_back( priority );
+    request.push_back( absolute_path( argv[i] ) );
+    request.push_back( absolute_path( argv[argc-1] ) );
+    for( int j = i+1; j < argc-1; j++ )
+      request.push_back( absolute_path( argv[j] ) );
+  } else {
+    std::cout<<"usage: "<<argv[0]<<" [-s socket] [-p priority] <input> [presets...] <output>"<<std::endl
+        <<"       "<<argv[0]<<" [-s socket] --status|--shutdown"<<std::endl;
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX;
+  if( socket_path.size() >= sizeof(addr.sun_path) ) {
+    std::cout<<"pfclient: socket path too long: "<<socket_path<<std::endl;
+    return 1;
+  }
+  strcpy( addr.sun_path, socket_path.c_str() );
+
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd < 0 || connect( fd, (struct sockaddr*)&addr, sizeof(addr) ) != 0 ) {
+    std::cout<<"pfclient: cannot connect to "<<socket_path<<": "<<strerror(errno)<<std::endl;
+    return 1;
+  }
+
+  std::string line = PF::daemon_join( request ) + "\n";
+  if( write( fd, line.c_str(), line.size() ) != (ssize_t)line.size() ) {
+    std::cout<<"pfclient: cannot send the request"<<std::endl;
+    close( fd );
+    return 1;
+  }
+
+  // Print the answers until the daemon closes the connection
+  int result = 1;
+  std::string buf;
+  char data[1024];
+  ssize_t n;
+  while( (n = read( fd, data, sizeof(data) )) != 0 ) {
+    if( n < 0 ) {
+      if( errno == EINTR ) continue;
+      break;
+    }
+    buf.append( data, n );
+    size_t pos;
+    while( (pos = buf.find( '\n' )) != std::string::npos ) {
+      std::vector<std::string> answer = PF::daemon_split( buf.substr( 0, pos ) );
+      buf.erase( 0, pos+1 );
+      for( unsigned int j = 0; j < answer.size(); j++ )
+        std::cout<<(j>0 ? " " : "")<<answer[j];
+      std::cout<<std::endl;
+      if( answer[0] == PF_DAEMON_DONE || answer[0] == PF_DAEMON_STATUS ||
+          answer[0] == PF_DAEMON_SHUTDOWN )
+        result = 0;
+    }
+  }
+  close( fd );
+  return result;
+}
@@ -0,0 +1,734 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+/*
+    PhotoFlow render daemon.
+
+    The daemon keeps a pool of worker processes, each of them with libvips and
+    the PhotoFlow core already initialized, and feeds them with the export jobs
+    received through a UNIX domain socket (see pfdaemon.hh for the protocol).
+    The workers are forked before any library is initialized, and process one
+    job at a time; the number of workers is therefore the maximum number of
+    jobs that are rendered concurrently.
+    Each worker keeps the decoded data of the most recently used raw files,
+    so that repeated exports of the same input skip the raw decoding.
+
+    Usage: pfdaemon [-s socket] [-j workers] [-c cached inputs per worker]
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <vips/vips.h>
+
+#include "pfdaemon.hh"
+
+#include "base/pf_mkstemp.hh"
+#include "base/pf_file_loader.hh"
+#include "base/image.hh"
+#include "base/memory_manager.hh"
+#include "base/shared_resources.hh"
+#include "base/new_operation.hh"
+#include "operations/raw_image.hh"
+
+/* We need C linkage for this.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus*/
+
+  extern GType vips_layer_get_type( void );
+  extern GType vips_gmic_get_type( void );
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+
+#define PF_DAEMON_DEFAULT_WORKERS 1
+#define PF_DAEMON_DEFAULT_CACHE 4
+
+
+static bool write_line( int fd, const std::string& line )
+{
+  std::string str = line + "\n";
+  const char* p = str.c_str();
+  size_t left = str.size();
+  while( left > 0 ) {
+    ssize_t n = write( fd, p, left );
+    if( n < 0 && errno == EINTR ) continue;
+    if( n <= 0 ) return false;
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+
+// Extract the next complete line from the buffer, if any
+static bool next_line( std::string& buf, std::string& line )
+{
+  size_t pos = buf.find( '\n' );
+  if( pos == std::string::npos ) return false;
+  line = buf.substr( 0, pos );
+  buf.erase( 0, pos+1 );
+  return true;
+}
+
+
+// Append the available data to the buffer; returns false on EOF or error
+static bool read_available( int fd, std::string& buf )
+{
+  char data[4096];
+  ssize_t n;
+  do {
+    n = read( fd, data, sizeof(data) );
+  } while( n < 0 && errno == EINTR );
+  if( n <= 0 ) return false;
+  buf.append( data, n );
+  return true;
+}
+
+
+/*
+ * Worker side
+ */
+
+// Inputs of the most recent jobs, most recent first. The corresponding raw images
+// hold an additional reference, which keeps them alive after the job is finished.
+static std::list<std::string> warm_inputs;
+
+
+static void release_warm_input( const std::string& input )
+{
+  std::map<Glib::ustring, PF::RawImage*>::iterator ri = PF::raw_images.find( input );
+  if( ri == PF::raw_images.end() ) return;
+  PF::RawImage* raw_image = ri->second;
+  raw_image->unref();
+  if( raw_image->get_nref() == 0 ) {
+    PF::raw_images.erase( ri );
+    delete raw_image;
+  }
+}
+
+
+static void keep_warm( const std::string& input, unsigned int cache_size )
+{
+  std::list<std::string>::iterator i = std::find( warm_inputs.begin(), warm_inputs.end(), input );
+  if( i != warm_inputs.end() ) {
+    warm_inputs.splice( warm_inputs.begin(), warm_inputs, i );
+    return;
+  }
+  if( cache_size == 0 ) return;
+
+  // Only the raw files are worth keeping, the other formats are cheap to re-open
+  std::map<Glib::ustring, PF::RawImage*>::iterator ri = PF::raw_images.find( input );
+  if( ri == PF::raw_images.end() ) return;
+  ri->second->ref();
+  warm_inputs.push_front( input );
+
+  while( warm_inputs.size() > cache_size ) {
+    release_warm_input( warm_inputs.back() );
+    warm_inputs.pop_back();
+  }
+}
+
+
+// Render one job; returns an empty string on success, the error message otherwise.
+// The job fields are: id, input, output, presets...
+static std::string run_job( const std::vector<std::string>& job, unsigned int cache_size )
+{
+  const std::string& input = job[1];
+  const std::string& output = job[2];
+
+  struct stat st;
+  if( stat( input.c_str(), &st ) != 0 )
+    return( std::string("cannot access ") + input );
+  for( unsigned int i = 3; i < job.size(); i++ ) {
+    if( stat( job[i].c_str(), &st ) != 0 )
+      return( std::string("cannot access ") + job[i] );
+  }
+
+  time_t start = time( NULL );
+
+  PF::Image* image = new PF::Image();
+  image->open( input );
+  for( unsigned int i = 3; i < job.size(); i++ )
+    PF::insert_pf_preset( job[i], image, NULL, &(image->get_layer_manager().get_layers()), false );
+
+  PF::MemoryManager::Instance().enforce_budget();
+  bool exported = image->export_merged( output );
+  delete image;
+  if( !exported )
+    return( std::string("cannot export ") + output );
+
+  keep_warm( input, cache_size );
+  PF::MemoryManager::Instance().enforce_budget();
+
+  if( stat( output.c_str(), &st ) != 0 || st.st_mtime < start )
+    return( std::string("cannot write ") + output );
+  return std::string();
+}
+
+
+static int worker_main( int fd, const char* argv0, size_t budget, unsigned int cache_size )
+{
+  PF::MemoryManager::Instance().init( budget );
+
+  if( vips_init( argv0 ) )
+    return 1;
+
+  vips_layer_get_type();
+  vips_gmic_get_type();
+
+  PF::PhotoFlow::Instance().set_new_op_func( PF::new_operation );
+  PF::PhotoFlow::Instance().set_new_op_func_nogui( PF::new_operation );
+  PF::PhotoFlow::Instance().set_batch( true );
+
+  // Each worker loads the shared databases once, before the first job arrives
+  PF::SharedResources::Instance().start_background_init();
+
+  if( PF::PhotoFlow::Instance().get_cache_dir().empty() ) {
+    std::cout<<"pfdaemon: cannot create cache dir."<<std::endl;
+    return 1;
+  }
+
+  std::string buf, line;
+  while( true ) {
+    if( !next_line( buf, line ) ) {
+      if( !read_available( fd, buf ) ) break;
+      continue;
+    }
+    std::vector<std::string> job = PF::daemon_split( line );
+    std::vector<std::string> reply;
+    reply.push_back( job[0] );
+    if( job.size() < 3 ) {
+      reply.push_back( PF_DAEMON_ERROR );
+      reply.push_back( "malformed job" );
+    } else {
+      std::cout<<"pfdaemon["<<getpid()<<"]: job "<<job[0]<<": "<<job[1]<<" -> "<<job[2]<<std::endl;
+      gint64 t0 = g_get_monotonic_time();
+      std::string error = run_job( job, cache_size );
+      if( error.empty() ) {
+        std::ostringstream ms;
+        ms<<(g_get_monotonic_time()-t0)/1000;
+        reply.push_back( PF_DAEMON_DONE );
+        reply.push_back( ms.str() );
+      } else {
+        reply.push_back( PF_DAEMON_ERROR );
+        reply.push_back( error );
+      }
+    }
+    if( !write_line( fd, PF::daemon_join( reply ) ) ) break;
+  }
+
+  while( !warm_inputs.empty() ) {
+    release_warm_input( warm_inputs.back() );
+    warm_inputs.pop_back();
+  }
+  vips_shutdown();
+
+  std::list<std::string>::iterator fi;
+  for( fi = cache_files.begin(); fi != cache_files.end(); fi++ )
+    unlink( fi->c_str() );
+  return 0;
+}
+
+
+/*
+ * Dispatcher side
+ */
+
+struct Job
+{
+  int id;
+  int priority;
+  unsigned long seq;
+  // input, output and presets
+  std::vector<std::string> files;
+};
+
+struct JobCompare
+{
+  bool operator()( const Job& a, const Job& b ) const
+  {
+    if( a.priority != b.priority ) return( a.priority < b.priority );
+    return( a.seq > b.seq );
+  }
+};
+
+struct Worker
+{
+  pid_t pid;
+  int fd;
+  // job being processed, -1 if idle
+  int job_id;
+  std::string buf;
+
+  Worker(): pid( -1 ), fd( -1 ), job_id( -1 ) {}
+};
+
+struct Client
+{
+  int fd;
+  std::string buf;
+  // set when the request has been processed, and no further input is expected
+  bool done;
+};
+
+
+class Dispatcher
+{
+  std::string socket_path;
+  int listen_fd;
+  const char* argv0;
+  size_t budget;
+  unsigned int cache_size;
+
+  std::vector<Worker> workers;
+  std::list<Client> clients;
+  std::priority_queue<Job, std::vector<Job>, JobCompare> queue;
+  // client connection waiting for each job, -1 if the client has gone away
+  std::map<int, int> job_clients;
+
+  int next_id;
+  unsigned long next_seq;
+  bool running;
+  // Incremented each time a connection is closed or a worker is replaced,
+  // since the file descriptor numbers can then be reused
+  unsigned int fd_changes;
+
+  bool spawn_worker( Worker& w );
+  void dispatch();
+  void finish_job( int id, const std::vector<std::string>& result );
+  void handle_request( Client& c, const std::string& line );
+  void handle_worker( Worker& w );
+  void close_client( int fd );
+
+public:
+  Dispatcher( const std::string& path, const char* a0, size_t b, unsigned int cs ):
+    socket_path( path ), listen_fd( -1 ), argv0( a0 ), budget( b ), cache_size( cs ),
+    next_id( 1 ), next_seq( 0 ), running( true ), fd_changes( 0 ) {}
+
+  bool init( unsigned int nworkers );
+  void run();
+};
+
+
+bool Dispatcher::init( unsigned int nworkers )
+{
+  struct sockaddr_un addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX;
+  if( socket_path.size() >= sizeof(addr.sun_path) ) {
+    std::cout<<"pfdaemon: socket path too long: "<<socket_path<<std::endl;
+    return false;
+  }
+  strcpy( addr.sun_path, socket_path.c_str() );
+
+  size_t slash = socket_path.rfind( '/' );
+  if( slash != std::string::npos && slash > 0 )
+    mkdir( socket_path.substr( 0, slash ).c_str(), 0700 );
+
+  listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( listen_fd < 0 ) return false;
+
+  // Remove a stale socket, but refuse to replace a running daemon
+  if( connect( listen_fd, (struct sockaddr*)&addr, sizeof(addr) ) == 0 ) {
+    std::cout<<"pfdaemon: another daemon is listening on "<<socket_path<<std::endl;
+    return false;
+  }
+  close( listen_fd );
+  unlink( socket_path.c_str() );
+
+  listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( listen_fd < 0 ||
+      bind( listen_fd, (struct sockaddr*)&addr, sizeof(addr) ) != 0 ||
+      listen( listen_fd, 16 ) != 0 ) {
+    std::cout<<"pfdaemon: cannot listen on "<<socket_path<<": "<<strerror(errno)<<std::endl;
+    return false;
+  }
+  chmod( socket_path.c_str(), 0600 );
+
+  // Each worker gets an equal share of the memory budget
+  if( budget == 0 ) budget = PF::MemoryManager::get_default_budget();
+  budget /= nworkers;
+
+  workers.resize( nworkers );
+  for( unsigned int i = 0; i < nworkers; i++ ) {
+    if( !spawn_worker( workers[i] ) )
+      return false;
+  }
+
+  std::cout<<"pfdaemon: listening on "<<socket_path<<" with "<<nworkers<<" worker(s)"<<std::endl;
+  return true;
+}
+
+
+bool Dispatcher::spawn_worker( Worker& w )
+{
+  int sv[2];
+  if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 )
+    return false;
+
+  pid_t pid = fork();
+  if( pid < 0 ) {
+    close( sv[0] );
+    close( sv[1] );
+    return false;
+  }
+  if( pid == 0 ) {
+    // The worker only keeps its own end of the socket pair
+    close( sv[0] );
+    close( listen_fd );
+    for( unsigned int i = 0; i < workers.size(); i++ )
+      if( workers[i].pid > 0 && workers[i].fd >= 0 ) close( workers[i].fd );
+    std::list<Client>::iterator ci;
+    for( ci = clients.begin(); ci != clients.end(); ci++ )
+      close( ci->fd );
+    _exit( worker_main( sv[1], argv0, budget, cache_size ) );
+  }
+
+  close( sv[1] );
+  fd_changes += 1;
+  w.pid = pid;
+  w.fd = sv[0];
+  w.job_id = -1;
+  w.buf.clear();
+  return true;
+}
+
+
+void Dispatcher::close_client( int fd )
+{
+  std::map<int, int>::iterator ji;
+  for( ji = job_clients.begin(); ji != job_clients.end(); ji++ )
+    if( ji->second == fd ) ji->second = -1;
+  std::list<Client>::iterator ci;
+  for( ci = clients.begin(); ci != clients.end(); ci++ ) {
+    if( ci->fd == fd ) {
+      clients.erase( ci );
+      break;
+    }
+  }
+  close( fd );
+  fd_changes += 1;
+}
+
+
+void Dispatcher::finish_job( int id, const std::vector<std::string>& result )
+{
+  std::map<int, int>::iterator ji = job_clients.find( id );
+  if( ji == job_clients.end() ) return;
+  int fd = ji->second;
+  job_clients.erase( ji );
+  std::cout<<"pfdaemon: job "<<id<<": "<<PF::daemon_join( result )<<std::endl;
+  if( fd >= 0 ) {
+    write_line( fd, PF::daemon_join( result ) );
+    close_client( fd );
+  }
+}
+
+
+void Dispatcher::dispatch()
+{
+  for( unsigned int i = 0; i < workers.size() && !queue.empty(); i++ ) {
+    Worker& w = workers[i];
+    if( w.pid <= 0 || w.job_id >= 0 ) continue;
+    Job job = queue.top();
+    queue.pop();
+
+    std::ostringstream id;
+    id<<job.id;
+    std::vector<std::string> fields;
+    fields.push_back( id.str() );
+    fields.insert( fields.end(), job.files.begin(), job.files.end() );
+    if( write_line( w.fd, PF::daemon_join( fields ) ) ) {
+      w.job_id = job.id;
+    } else {
+      std::vector<std::string> result;
+      result.push_back( PF_DAEMON_ERROR );
+      result.push_back( id.str() );
+      result.push_back( "worker not available" );
+      finish_job( job.id, result );
+    }
+  }
+}
+
+
+void Dispatcher::handle_request( Client& c, const std::string& line )
+{
+  std::vector<std::string> req = PF::daemon_split( line );
+  std::vector<std::string> reply;
+  c.done = true;
+
+  if( req[0] == PF_DAEMON_RENDER && req.size() >= 4 && running ) {
+    for( unsigned int i = 2; i < req.size(); i++ ) {
+      if( req[i].empty() || req[i][0] != '/' ) {
+        reply.push_back( PF_DAEMON_ERROR );
+        reply.push_back( "0" );
+        reply.push_back( std::string("file name is not absolute: ") + req[i] );
+        write_line( c.fd, PF::daemon_join( reply ) );
+        close_client( c.fd );
+        return;
+      }
+    }
+    Job job;
+    job.id = next_id++;
+    job.priority = atoi( req[1].c_str() );
+    job.seq = next_seq++;
+    job.files.assign( req.begin()+2, req.end() );
+    queue.push( job );
+    job_clients[job.id] = c.fd;
+
+    std::ostringstream id;
+    id<<job.id;
+    reply.push_back( PF_DAEMON_QUEUED );
+    reply.push_back( id.str() );
+    write_line( c.fd, PF::daemon_join( reply ) );
+    return;
+  }
+
+  if( req[0] == PF_DAEMON_STATUS ) {
+    unsigned int nrunning = 0;
+    for( unsigned int i = 0; i < workers.size(); i++ )
+      if( workers[i].job_id >= 0 ) nrunning += 1;
+    std::ostringstream str;
+    str<<PF_DAEMON_STATUS<<PF_DAEMON_SEPARATOR<<queue.size()<<PF_DAEMON_SEPARATOR
+        <<nrunning<<PF_DAEMON_SEPARATOR<<workers.size();
+    write_line( c.fd, str.str() );
+  } else if( req[0] == PF_DAEMON_SHUTDOWN ) {
+    std::cout<<"pfdaemon: shutdown requested"<<std::endl;
+    running = false;
+    write_line( c.fd, PF_DAEMON_SHUTDOWN );
+  } else {
+    reply.push_back( PF_DAEMON_ERROR );
+    reply.push_back( "0" );
+    reply.push_back( running ? "malformed request" : "daemon is shutting down" );
+    write_line( c.fd, PF::daemon_join( reply ) );
+  }
+  close_client( c.fd );
+}
+
+
+void Dispatcher::handle_worker( Worker& w )
+{
+  if( !read_available( w.fd, w.buf ) ) {
+    // The worker has crashed: report the failure of its job and replace it
+    std::cout<<"pfdaemon: worker "<<w.pid<<" terminated unexpectedly"<<std::endl;
+    close( w.fd );
+    fd_changes += 1;
+    waitpid( w.pid, NULL, 0 );
+    w.pid = -1;
+    w.fd = -1;
+    if( w.job_id >= 0 ) {
+      std::ostringstream id;
+      id<<w.job_id;
+      std::vector<std::string> result;
+      result.push_back( PF_DAEMON_ERROR );
+      result.push_back( id.str() );
+      result.push_back( "worker crashed" );
+      finish_job( w.job_id, result );
+    }
+    if( running ) spawn_worker( w );
+    return;
+  }
+
+  std::string line;
+  while( next_line( w.buf, line ) ) {
+    // id, status, time or message
+    std::vector<std::string> reply = PF::daemon_split( line );
+    if( reply.size() < 3 ) continue;
+    std::vector<std::string> result;
+    result.push_back( reply[1] );
+    result.push_back( reply[0] );
+    result.push_back( reply[2] );
+    finish_job( atoi( reply[0].c_str() ), result );
+    w.job_id = -1;
+  }
+}
+
+
+void Dispatcher::run()
+{
+  while( true ) {
+    if( running ) dispatch();
+
+    unsigned int nbusy = 0;
+    for( unsigned int i = 0; i < workers.size(); i++ )
+      if( workers[i].pid > 0 && workers[i].job_id >= 0 ) nbusy += 1;
+    if( !running && nbusy == 0 ) break;
+
+    std::vector<struct pollfd> fds;
+    struct pollfd pfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if( running ) {
+      pfd.fd = listen_fd;
+      fds.push_back( pfd );
+    }
+    for( unsigned int i = 0; i < workers.size(); i++ ) {
+      pfd.fd = workers[i].fd;
+      fds.push_back( pfd );
+    }
+    std::list<Client>::iterator ci;
+    for( ci = clients.begin(); ci != clients.end(); ci++ ) {
+      pfd.fd = ci->fd;
+      fds.push_back( pfd );
+    }
+
+    if( poll( &(fds[0]), fds.size(), -1 ) < 0 ) {
+      if( errno == EINTR ) continue;
+      break;
+    }
+
+    // The snapshot in fds is only valid until a connection is closed or a
+    // worker is replaced: a new descriptor could then get the number of one
+    // still in the list. In that case the list is rebuilt before handling
+    // the remaining events, which are reported again by the next poll().
+    unsigned int changes = fd_changes;
+    for( unsigned int i = 0; i < fds.size() && changes == fd_changes; i++ ) {
+      if( !fds[i].revents ) continue;
+      int fd = fds[i].fd;
+      if( fd < 0 ) continue;
+
+      if( running && fd == listen_fd ) {
+        int cfd = accept( listen_fd, NULL, NULL );
+        if( cfd >= 0 ) {
+          Client c;
+          c.fd = cfd;
+          c.done = false;
+          clients.push_back( c );
+        }
+        continue;
+      }
+
+      bool is_worker = false;
+      for( unsigned int wi = 0; wi < workers.size(); wi++ ) {
+        if( workers[wi].fd == fd ) {
+          handle_worker( workers[wi] );
+          is_worker = true;
+          break;
+        }
+      }
+      if( is_worker ) continue;
+
+      for( ci = clients.begin(); ci != clients.end(); ci++ ) {
+        if( ci->fd != fd ) continue;
+        if( !read_available( fd, ci->buf ) ) {
+          close_client( fd );
+        } else if( !ci->done ) {
+          std::string line;
+          if( next_line( ci->buf, line ) )
+            handle_request( *ci, line );
+        }
+        break;
+      }
+    }
+  }
+
+  // Jobs still in the queue are not processed
+  while( !queue.empty() ) {
+    std::ostringstream id;
+    id<<queue.top().id;
+    std::vector<std::string> result;
+    result.push_back( PF_DAEMON_ERROR );
+    result.push_back( id.str() );
+    result.push_back( "daemon is shutting down" );
+    finish_job( queue.top().id, result );
+    queue.pop();
+  }
+
+  // Closing the connection makes the workers exit
+  for( unsigned int i = 0; i < workers.size(); i++ ) {
+    if( workers[i].pid <= 0 ) continue;
+    close( workers[i].fd );
+    waitpid( workers[i].pid, NULL, 0 );
+  }
+  while( !clients.empty() )
+    close_client( clients.front().fd );
+  close( listen_fd );
+  unlink( socket_path.c_str() );
+}
+
+
+int main( int argc, char** argv )
+{
+  std::string socket_path = PF::daemon_default_socket();
+  unsigned int nworkers = PF_DAEMON_DEFAULT_WORKERS;
+  unsigned int cache_size = PF_DAEMON_DEFAULT_CACHE;
+
+  for( int i = 1; i < argc; i++ ) {
+    if( !strcmp( argv[i], "-s" ) && i+1 < argc ) {
+      socket_path = argv[++i];
+    } else if( !strcmp( argv[i], "-j" ) && i+1 < argc ) {
+      nworkers = atoi( argv[++i] );
+      if( nworkers < 1 ) nworkers = 1;
+    } else if( !strcmp( argv[i], "-c" ) && i+1 < argc ) {
+      cache_size = atoi( argv[++i] );
+    } else {
+      std::cout<<"usage: "<<argv[0]<<" [-s socket] [-j workers] [-c cached inputs per worker]"<<std::endl;
+      return 1;
+    }
+  }
+
+  // Memory budget in MB for all the workers together, half of the physical memory by default
+  size_t memory_budget = 0;
+  if( getenv("PF_MEMORY_BUDGET") )
+    memory_budget = ((size_t)atol( getenv("PF_MEMORY_BUDGET") ))*1024*1024;
+
+  // Clients that go away must not kill the daemon
+  signal( SIGPIPE, SIG_IGN );
+
+  Dispatcher dispatcher( socket_path, argv[0], memory_budget, cache_size );
+  if( !dispatcher.init( nworkers ) )
+    return 1;
+  dispatcher.run();
+  return 0;
+}
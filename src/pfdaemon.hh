@@ -0,0 +1,123 @@
+/*
+ */
+
+/*
+
+    Copyright (C) 2014 Ferrero Andrea
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+ */
+
+/*
+
+    These files are distributed with PhotoFlow - http://aferrero2707.github.io/PhotoFlow/
+
+ */
+
+
+/*
+    Protocol of the PhotoFlow render daemon (pfdaemon) and its client (pfclient).
+
+    Clients connect to the daemon through a UNIX domain socket and send a single
+    request line, with the fields separated by TAB characters:
+
+      RENDER <priority> <input file> <output file> [<preset file> ...]
+      STATUS
+      SHUTDOWN
+
+    All file names must be absolute. Jobs with higher priority are processed first,
+    jobs with the same priority in submission order. The daemon answers to a RENDER
+    request with
+
+      QUEUED <job id>
+
+    as soon as the job is accepted, followed by one of
+
+      DONE <job id> <processing time in ms>
+      ERROR <job id> <message>
+
+    when the job is finished, after which the connection is closed.
+    The answer to STATUS is
+
+      STATUS <queued jobs> <running jobs> <workers>
+
+    and SHUTDOWN terminates the daemon once the running jobs are finished.
+ */
+
+#ifndef PF_DAEMON_HH
+#define PF_DAEMON_HH
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+
+#define PF_DAEMON_SEPARATOR '\t'
+
+#define PF_DAEMON_RENDER "RENDER"
+#define PF_DAEMON_STATUS "STATUS"
+#define PF_DAEMON_SHUTDOWN "SHUTDOWN"
+#define PF_DAEMON_QUEUED "QUEUED"
+#define PF_DAEMON_DONE "DONE"
+#define PF_DAEMON_ERROR "ERROR"
+
+
+namespace PF
+{
+
+  // Socket used when none is specified: $PF_DAEMON_SOCKET, or ~/.photoflow/pfdaemon.sock
+  inline std::string daemon_default_socket()
+  {
+    if( getenv("PF_DAEMON_SOCKET") )
+      return std::string( getenv("PF_DAEMON_SOCKET") );
+    std::string path;
+    if( getenv("HOME") ) {
+      path = getenv("HOME");
+      path += "/";
+    }
+    path += ".photoflow/pfdaemon.sock";
+    return path;
+  }
+
+  // Split a protocol line into its TAB-separated fields
+  inline std::vector<std::string> daemon_split( const std::string& line )
+  {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while( true ) {
+      size_t pos = line.find( PF_DAEMON_SEPARATOR, start );
+      fields.push_back( line.substr( start, pos-start ) );
+      if( pos == std::string::npos ) break;
+      start = pos + 1;
+    }
+    return fields;
+  }
+
+  inline std::string daemon_join( const std::vector<std::string>& fields )
+  {
+    std::string line;
+    for( unsigned int i = 0; i < fields.size(); i++ ) {
+      if( i > 0 ) line += PF_DAEMON_SEPARATOR;
+      line += fields[i];
+    }
+    return line;
+  }
+
+}
+
+
+#endif
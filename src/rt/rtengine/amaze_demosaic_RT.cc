@@ -28,6 +28,7 @@
 
 //#include "rtengine.h"
 #include "rawimagesource.hh"
+#include "../../base/scratch_arena.hh"
 #include "rt_math.h"
 //#include "../rtgui/multilangmgr.h"
 //#include "procparams.h"
@@ -165,7 +166,13 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
 
 #define CLF 1
     // assign working space
-    buffer = (char *) calloc(22*sizeof(float)*TS*TS + sizeof(char)*TS*TSH+23*CLF*64 + 63, 1);
+    // the working space is re-used from one tile to the next
+    const size_t buffer_size = 22*sizeof(float)*TS*TS + sizeof(char)*TS*TSH+23*CLF*64 + 63;
+    buffer = (char *) PF::ScratchArena::get().alloc(buffer_size);
+    if( buffer )
+      memset(buffer, 0, buffer_size);
+    else
+      std::cout<<"amaze_demosaic_RT(): cannot allocate the working space, tiles not processed"<<std::endl;
     char 	*data;
     data = (char*)( ( uintptr_t(buffer) + uintptr_t(63)) / 64 * 64);
 
@@ -219,6 +226,7 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
      */
     for (top=tiley-16; top < tiley+tileh; top += TS-32)
       for (left=tilex-16; left < tilex+tilew; left += TS-32) {
+        if( !buffer ) continue;
         memset(nyquist, 0, sizeof(char)*TS*TSH);
         memset(rbint, 0, sizeof(float)*TS*TSH);
         //location of tile bottom edge
@@ -1438,7 +1446,7 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
 
 
     // clean up
-    free(buffer);
+    PF::ScratchArena::get().release(buffer, buffer_size);
   }
   /*
 	if(plistener)
@@ -19,6 +19,7 @@
 
 //#include "rtengine.h"
 #include "rawimagesource.hh"
+#include "../../base/scratch_arena.hh"
 #include "rt_math.h"
 //#include "../rtgui/multilangmgr.h"
 //#include "procparams.h"
@@ -44,17 +45,33 @@ namespace rtengine {
 		float* chr[2];
 		float (*rgbarray), *vdif, *hdif, (*chrarray);
 
-		rgbarray	= (float (*)) calloc(width*height*3, sizeof( float));
+		// the working arrays are re-used from one tile to the next
+		PF::ScratchArena& arena = PF::ScratchArena::get();
+		const size_t rgbarray_size = sizeof(float)*width*height*3;
+		const size_t chrarray_size = sizeof(float)*width*height*2;
+		const size_t dif_size = sizeof(float)*(width*height/2);
+		rgbarray	= (float (*)) arena.alloc(rgbarray_size);
+		chrarray	= (float (*)) arena.alloc(chrarray_size);
+		vdif  = (float (*))    arena.alloc(dif_size);
+		hdif  = (float (*))    arena.alloc(dif_size);
+		if( !rgbarray || !chrarray || !vdif || !hdif ) {
+			std::cout<<"igv_demosaic_RT(): cannot allocate the working arrays, tile not processed"<<std::endl;
+			arena.release(chrarray, chrarray_size); arena.release(rgbarray, rgbarray_size);
+			arena.release(vdif, dif_size); arena.release(hdif, dif_size);
+			return;
+		}
+
+		memset(rgbarray, 0, rgbarray_size);
 		rgb[0] = rgbarray;
 		rgb[1] = rgbarray + (width*height);
 		rgb[2] = rgbarray + 2*(width*height);
 
-		chrarray	= (float (*)) calloc(width*height*2, sizeof( float));
+		memset(chrarray, 0, chrarray_size);
 		chr[0] = chrarray;
 		chr[1] = chrarray + (width*height);
 
-		vdif  = (float (*))    calloc(width*height/2, sizeof *vdif);
-		hdif  = (float (*))    calloc(width*height/2, sizeof *hdif);
+		memset(vdif, 0, dif_size);
+		memset(hdif, 0, dif_size);
 
 		//border_interpolate2(winw,winh,7);
 
@@ -275,8 +292,8 @@ namespace rtengine {
 
 		//if (plistener) plistener->setProgress (1.0);
 
-		free(chrarray); free(rgbarray);
-		free(vdif); free(hdif);
+		arena.release(chrarray, chrarray_size); arena.release(rgbarray, rgbarray_size);
+		arena.release(vdif, dif_size); arena.release(hdif, dif_size);
 		
 	}
 }
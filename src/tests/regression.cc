@@ -0,0 +1,463 @@
+/*
+    Golden-image regression tests.
+
+    Each test case renders a synthetic input image through a single operation,
+    with reduced-size floating-point and 16-bit preview pipelines and with a
+    full-size export pipeline, and compares the result with the reference images
+    stored in <case dir>/reference.
+    The maximum and mean absolute differences must stay below the tolerances given
+    for the case in <case dir>/cases.txt. For each failing case the rendered image and
+    an amplified difference image are written into the output directory.
+
+    Usage:
+      pfregression [--update] <case dir> <output dir> [case names...]
+
+    With --update the reference images are (re-)generated instead of being checked.
+    A case without a reference image counts as a failure; the ctest target is
+    only defined once the reference directory has been generated.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <vips/vips.h>
+#include <lcms2.h>
+
+#include "../base/photoflow.hh"
+#include "../base/image.hh"
+#include "../base/memory_manager.hh"
+#include "../base/new_operation.hh"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus*/
+
+  extern GType vips_layer_get_type( void );
+  extern GType vips_gmic_get_type( void );
+
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+
+#define PF_REGRESSION_SIZE 128
+
+
+struct RegressionCase
+{
+  std::string name;
+  std::string op;
+  // maximum and mean absolute differences allowed, in normalized [0,1] units
+  double max_tol, mean_tol;
+  // name=value pairs passed to the operation properties; the special name
+  // "input" adds the output of the given layer as an extra input, and the
+  // names starting with "blender." refer to the properties of the layer blender
+  std::vector< std::pair<std::string,std::string> > props;
+};
+
+
+struct RenderMode
+{
+  const char* name;
+  rendermode_t mode;
+  int level;
+  VipsBandFormat format;
+};
+
+// The 16-bit preview is the one used by the editor for the display
+static RenderMode render_modes[] = {
+  { "preview", PF_RENDER_PREVIEW, 1, VIPS_FORMAT_FLOAT },
+  { "preview16", PF_RENDER_PREVIEW, 1, VIPS_FORMAT_USHORT },
+  { "export", PF_RENDER_NORMAL, 0, VIPS_FORMAT_FLOAT }
+};
+
+
+// Prefix of the properties that are set on the layer blender
+#define PF_REGRESSION_BLENDER_PREFIX "blender."
+// Property value replaced by the file name of the synthetic input image
+#define PF_REGRESSION_INPUT_FILE "$INPUT"
+
+
+// Split a list of property=value items separated by blanks; values that contain
+// blanks must be enclosed in double quotes
+static bool split_props( const std::string& line, std::vector<std::string>& items )
+{
+  std::string item;
+  bool quoted = false, have_item = false;
+  for( unsigned int i = 0; i < line.size(); i++ ) {
+    char c = line[i];
+    if( c == '"' ) {
+      quoted = !quoted;
+      have_item = true;
+    } else if( !quoted && (c == ' ' || c == '\t') ) {
+      if( have_item ) items.push_back( item );
+      item.clear();
+      have_item = false;
+    } else {
+      item += c;
+      have_item = true;
+    }
+  }
+  if( have_item ) items.push_back( item );
+  return !quoted;
+}
+
+
+// Read the list of test cases. Each non-empty line not starting with '#' has the form
+//   name op max_tol mean_tol [property=value ...]
+static bool read_cases( const std::string& fname, std::vector<RegressionCase>& cases )
+{
+  std::ifstream in( fname.c_str() );
+  if( !in ) return false;
+  std::string line;
+  int lineno = 0;
+  while( std::getline( in, line ) ) {
+    lineno += 1;
+    size_t start = line.find_first_not_of( " \t" );
+    if( start == std::string::npos || line[start] == '#' ) continue;
+    std::istringstream str( line );
+    RegressionCase c;
+    if( !(str>>c.name>>c.op>>c.max_tol>>c.mean_tol) ) {
+      std::cout<<fname<<":"<<lineno<<": malformed test case"<<std::endl;
+      return false;
+    }
+    std::string rest;
+    std::getline( str, rest );
+    std::vector<std::string> items;
+    if( !split_props( rest, items ) ) {
+      std::cout<<fname<<":"<<lineno<<": unterminated quoted value"<<std::endl;
+      return false;
+    }
+    for( unsigned int i = 0; i < items.size(); i++ ) {
+      const std::string& prop = items[i];
+      size_t pos = prop.find( '=' );
+      if( pos == std::string::npos ) {
+        std::cout<<fname<<":"<<lineno<<": malformed property \""<<prop<<"\""<<std::endl;
+        return false;
+      }
+      c.props.push_back( std::make_pair( prop.substr(0,pos), prop.substr(pos+1) ) );
+    }
+    cases.push_back( c );
+  }
+  return true;
+}
+
+
+// Deterministic synthetic input: hue ramp along x, exposure ramp along y,
+// a grey wedge and a block of pseudo-random noise, in linear sRGB
+static bool write_synthetic_image( const std::string& fname )
+{
+  const int size = PF_REGRESSION_SIZE;
+  std::vector<float> buf( size*size*3 );
+  unsigned int seed = 12345;
+  for( int y = 0; y < size; y++ ) {
+    for( int x = 0; x < size; x++ ) {
+      float* p = &(buf[(y*size+x)*3]);
+      if( y < size/8 ) {
+        // grey wedge, 16 steps
+        p[0] = p[1] = p[2] = (float)(x*16/size)/15.0f;
+      } else if( x >= size*3/4 && y >= size*3/4 ) {
+        for( int b = 0; b < 3; b++ ) {
+          seed = seed*1103515245 + 12345;
+          p[b] = (float)((seed>>8)&0xffff)/65535.0f;
+        }
+      } else {
+        float h = 6.0f*x/size;
+        float v = (float)(y-size/8)/(size-size/8-1);
+        int i = (int)h;
+        float f = h - i;
+        float rgb[6][3] = { {1,f,0}, {1-f,1,0}, {0,1,f}, {0,1-f,1}, {f,0,1}, {1,0,1-f} };
+        for( int b = 0; b < 3; b++ )
+          p[b] = (0.1f + 0.9f*rgb[i%6][b])*v;
+      }
+    }
+  }
+
+  VipsImage* img = vips_image_new_from_memory( &(buf[0]), sizeof(float)*buf.size(),
+      size, size, 3, VIPS_FORMAT_FLOAT );
+  if( !img ) return false;
+  img->Type = VIPS_INTERPRETATION_RGB;
+
+  // Attach a linear sRGB profile, so that the colorspace conversions are well defined
+  cmsCIExyY d65;
+  cmsWhitePointFromTemp( &d65, 6504 );
+  cmsCIExyYTRIPLE primaries = {
+    {0.6400, 0.3300, 1.0}, {0.3000, 0.6000, 1.0}, {0.1500, 0.0600, 1.0}
+  };
+  cmsToneCurve* gamma = cmsBuildGamma( NULL, 1.0 );
+  cmsToneCurve* curves[3] = { gamma, gamma, gamma };
+  cmsHPROFILE profile = cmsCreateRGBProfile( &d65, &primaries, curves );
+  cmsFreeToneCurve( gamma );
+  cmsUInt32Number length;
+  if( profile && cmsSaveProfileToMem( profile, NULL, &length ) ) {
+    void* data = malloc( length );
+    cmsSaveProfileToMem( profile, data, &length );
+    vips_image_set_blob( img, VIPS_META_ICC_NAME,
+        (VipsCallbackFn) g_free, data, length );
+  }
+  if( profile ) cmsCloseProfile( profile );
+
+  int result = vips_tiffsave( img, fname.c_str(), NULL );
+  g_object_unref( img );
+  return( result == 0 );
+}
+
+
+// Render the test case into a memory image. Returns NULL on failure.
+static VipsImage* render_case( const RegressionCase& c, const std::string& input, const RenderMode& mode )
+{
+  PF::Image* image = new PF::Image();
+  if( !image->open( input ) ) {
+    std::cout<<c.name<<": cannot open "<<input<<std::endl;
+    delete image;
+    return NULL;
+  }
+
+  PF::LayerManager& layer_manager = image->get_layer_manager();
+  PF::Layer* layer = layer_manager.new_layer();
+  PF::ProcessorBase* proc = PF::new_operation( c.op, layer );
+  if( !proc || !proc->get_par() ) {
+    std::cout<<c.name<<": unknown operation \""<<c.op<<"\""<<std::endl;
+    delete image;
+    return NULL;
+  }
+  for( unsigned int i = 0; i < c.props.size(); i++ ) {
+    if( c.props[i].first == "input" ) {
+      // Use the output of an existing layer as extra input, for example
+      // the source of the clone operation
+      unsigned int li = atoi( c.props[i].second.c_str() );
+      std::list<PF::Layer*>& layers = layer_manager.get_layers();
+      std::list<PF::Layer*>::iterator l = layers.begin();
+      for( unsigned int j = 0; j < li && l != layers.end(); j++ ) ++l;
+      if( l == layers.end() ) {
+        std::cout<<c.name<<": no layer #"<<li<<" to be used as input"<<std::endl;
+        delete image;
+        return NULL;
+      }
+      layer->add_input( (*l)->get_id(), 0 );
+      continue;
+    }
+    std::string pname = c.props[i].first;
+    PF::OpParBase* par = proc->get_par();
+    const std::string prefix = PF_REGRESSION_BLENDER_PREFIX;
+    if( pname.compare( 0, prefix.size(), prefix ) == 0 ) {
+      par = layer->get_blender() ? layer->get_blender()->get_par() : NULL;
+      pname = pname.substr( prefix.size() );
+    }
+    PF::PropertyBase* prop = par ? par->get_property( pname ) : NULL;
+    if( !prop ) {
+      std::cout<<c.name<<": unknown property \""<<c.props[i].first<<"\""<<std::endl;
+      delete image;
+      return NULL;
+    }
+    if( c.props[i].second == PF_REGRESSION_INPUT_FILE )
+      prop->set_str( input );
+    else
+      prop->set_str( c.props[i].second );
+  }
+  layer->set_name( c.name );
+  layer_manager.get_layers().push_back( layer );
+
+  image->add_pipeline( mode.format, mode.level, mode.mode );
+  image->do_update( NULL );
+
+  VipsImage* result = NULL;
+  PF::Pipeline* pipeline = image->get_pipeline( 0 );
+  VipsImage* out = pipeline ? pipeline->get_output() : NULL;
+  if( out ) {
+    result = vips_image_new_memory();
+    if( vips_image_write( out, result ) ) {
+      g_object_unref( result );
+      result = NULL;
+    }
+  }
+  delete image;
+
+  // 16-bit results are normalized to [0,1], so that the same tolerances apply
+  if( result && result->BandFmt == VIPS_FORMAT_USHORT ) {
+    VipsImage* normalized;
+    int fail = vips_linear1( result, &normalized, 1.0/65535, 0, NULL );
+    g_object_unref( result );
+    result = fail ? NULL : normalized;
+  }
+  return result;
+}
+
+
+static bool save_tiff( VipsImage* img, const std::string& fname )
+{
+  return( vips_tiffsave( img, fname.c_str(),
+      "compression", VIPS_FOREIGN_TIFF_COMPRESSION_DEFLATE,
+      "predictor", VIPS_FOREIGN_TIFF_PREDICTOR_FLOAT, NULL ) == 0 );
+}
+
+
+// Compare the rendered image with the reference one. On failure, the rendered image
+// and the absolute difference scaled such that max_tol corresponds to 255 are saved
+static bool compare( const RegressionCase& c, VipsImage* out, VipsImage* ref,
+    const std::string& out_name )
+{
+  if( out->Xsize != ref->Xsize || out->Ysize != ref->Ysize || out->Bands != ref->Bands ) {
+    std::cout<<"  size mismatch: "<<out->Xsize<<"x"<<out->Ysize<<"x"<<out->Bands
+        <<" instead of "<<ref->Xsize<<"x"<<ref->Ysize<<"x"<<ref->Bands<<std::endl;
+    save_tiff( out, out_name+".tif" );
+    return false;
+  }
+
+  VipsImage *diff, *absdiff;
+  double max_diff = 0, mean_diff = 0;
+  if( vips_subtract( out, ref, &diff, NULL ) ) return false;
+  int fail = vips_abs( diff, &absdiff, NULL );
+  g_object_unref( diff );
+  if( fail ) return false;
+  if( vips_max( absdiff, &max_diff, NULL ) || vips_avg( absdiff, &mean_diff, NULL ) ) {
+    g_object_unref( absdiff );
+    return false;
+  }
+
+  bool result = (max_diff <= c.max_tol) && (mean_diff <= c.mean_tol);
+  std::cout<<"  max. diff="<<max_diff<<" (tol. "<<c.max_tol<<")  mean diff="<<mean_diff
+      <<" (tol. "<<c.mean_tol<<")"<<std::endl;
+
+  if( !result ) {
+    save_tiff( out, out_name+".tif" );
+    VipsImage *scaled, *diffimg;
+    double scale = (c.max_tol > 0) ? 255.0/c.max_tol : 255.0;
+    if( !vips_linear1( absdiff, &scaled, scale, 0, NULL ) ) {
+      if( !vips_cast( scaled, &diffimg, VIPS_FORMAT_UCHAR, NULL ) ) {
+        vips_tiffsave( diffimg, (out_name+"-diff.tif").c_str(), NULL );
+        g_object_unref( diffimg );
+      }
+      g_object_unref( scaled );
+    }
+  }
+  g_object_unref( absdiff );
+  return result;
+}
+
+
+int main( int argc, char** argv )
+{
+  bool update = false;
+  int argi = 1;
+  if( argc > 1 && !strcmp( argv[1], "--update" ) ) {
+    update = true;
+    argi += 1;
+  }
+  if( argc < argi+2 ) {
+    std::cout<<"usage: "<<argv[0]<<" [--update] <case dir> <output dir> [case names...]"<<std::endl;
+    return 1;
+  }
+  std::string case_dir = argv[argi];
+  std::string out_dir = argv[argi+1];
+  std::vector<std::string> selected;
+  for( int i = argi+2; i < argc; i++ )
+    selected.push_back( argv[i] );
+
+  PF::MemoryManager::Instance().init( 0 );
+  if( vips_init( argv[0] ) )
+    return 1;
+  vips_layer_get_type();
+  vips_gmic_get_type();
+
+  PF::PhotoFlow::Instance().set_new_op_func( PF::new_operation );
+  PF::PhotoFlow::Instance().set_new_op_func_nogui( PF::new_operation );
+  PF::PhotoFlow::Instance().set_batch( true );
+  if( PF::PhotoFlow::Instance().get_cache_dir().empty() ) {
+    std::cout<<"FATAL: Cannot create cache dir."<<std::endl;
+    return 1;
+  }
+
+  std::vector<RegressionCase> cases;
+  if( !read_cases( case_dir+"/cases.txt", cases ) ) {
+    std::cout<<"Cannot read "<<case_dir<<"/cases.txt"<<std::endl;
+    return 1;
+  }
+
+  g_mkdir_with_parents( out_dir.c_str(), 0755 );
+  std::string ref_dir = case_dir+"/reference";
+  if( update )
+    g_mkdir_with_parents( ref_dir.c_str(), 0755 );
+
+  std::string input = out_dir+"/synthetic.tif";
+  if( !write_synthetic_image( input ) ) {
+    std::cout<<"Cannot write "<<input<<std::endl;
+    return 1;
+  }
+
+  int nchecked = 0, nfailed = 0, nmissing = 0;
+  std::vector<std::string> failed;
+  for( unsigned int ci = 0; ci < cases.size(); ci++ ) {
+    const RegressionCase& c = cases[ci];
+    if( !selected.empty() &&
+        std::find( selected.begin(), selected.end(), c.name ) == selected.end() )
+      continue;
+
+    for( unsigned int mi = 0; mi < sizeof(render_modes)/sizeof(RenderMode); mi++ ) {
+      const RenderMode& mode = render_modes[mi];
+      std::string id = c.name+"-"+mode.name;
+      std::string ref_name = ref_dir+"/"+id+".tif";
+      std::cout<<id<<" ("<<c.op<<")"<<std::endl;
+
+      VipsImage* out = render_case( c, input, mode );
+      if( !out ) {
+        std::cout<<"  FAILED: cannot render"<<std::endl;
+        nfailed += 1;
+        failed.push_back( id );
+        continue;
+      }
+
+      if( update ) {
+        if( save_tiff( out, ref_name ) ) {
+          std::cout<<"  reference updated"<<std::endl;
+        } else {
+          std::cout<<"  FAILED: cannot write "<<ref_name<<std::endl;
+          nfailed += 1;
+          failed.push_back( id );
+        }
+        g_object_unref( out );
+        continue;
+      }
+
+      struct stat st;
+      if( stat( ref_name.c_str(), &st ) != 0 ) {
+        std::cout<<"  FAILED: no reference image, run with --update to create it"<<std::endl;
+        save_tiff( out, out_dir+"/"+id+".tif" );
+        nmissing += 1;
+        nfailed += 1;
+        failed.push_back( id );
+        g_object_unref( out );
+        continue;
+      }
+
+      VipsImage* ref = vips_image_new_from_file( ref_name.c_str(), NULL );
+      nchecked += 1;
+      if( !ref || !compare( c, out, ref, out_dir+"/"+id ) ) {
+        std::cout<<"  FAILED"<<std::endl;
+        nfailed += 1;
+        failed.push_back( id );
+      }
+      if( ref ) g_object_unref( ref );
+      g_object_unref( out );
+    }
+  }
+
+  std::cout<<std::endl<<nchecked<<" images checked, "<<nfailed<<" failed, "
+      <<nmissing<<" without reference"<<std::endl;
+  for( unsigned int i = 0; i < failed.size(); i++ )
+    std::cout<<"  failed: "<<failed[i]<<std::endl;
+
+  vips_shutdown();
+
+  if( nfailed > 0 ) return 1;
+  return 0;
+}
@@ -45,8 +45,9 @@
 //#include "gmic.h"
 
 #include "../../base/photoflow.hh"
+#include "../../base/memory_manager.hh"
+#include "../../base/shared_resources.hh"
 
-static char* custom_gmic_commands = 0;
 
 using namespace cimg_library;
 
@@ -247,59 +248,9 @@ vips_gmic_start( VipsImage *out, void *a, void *b )
 		}
 	seq->ir[n] = NULL;
 
-  if( !custom_gmic_commands ) {
-    std::cout<<"Loading G'MIC custom commands..."<<std::endl;
-    char fname[500]; fname[0] = 0;
-#if defined(WIN32) || defined(__MINGW32__) || defined(__MINGW64__)
-    snprintf( fname, 499, "%s\\gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
-    std::cout<<"G'MIC commands definition file: "<<fname<<std::endl;
-    struct stat buffer;   
-    int stat_result = stat( fname, &buffer );
-    if( stat_result != 0 ) {
-      fname[0] = 0;
-    }
-#elif defined(__APPLE__) && defined (__MACH__)
-    //snprintf( fname, 499, "%s/../share/photoflow/gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
-    snprintf( fname, 499, "%s/gmic_def.gmic", PF::PhotoFlow::Instance().get_data_dir().c_str() );
-    std::cout<<"G'MIC commands definition file: "<<fname<<std::endl;
-    struct stat buffer;   
-    int stat_result = stat( fname, &buffer );
-    if( stat_result != 0 ) {
-      fname[0] = 0;
-    }
-#else
-    if( getenv("HOME") ) {
-      //snprintf( fname, 499, "%s/.photoflow/gmic_update.gmic", getenv("HOME") );
-      snprintf( fname, 499, "%s/share/photoflow/gmic_def.gmic", INSTALL_PREFIX );
-      std::cout<<"G'MIC custom commands file: "<<fname<<std::endl;
-      struct stat buffer;   
-      int stat_result = stat( fname, &buffer );
-      if( stat_result != 0 ) {
-        //snprintf( fname, 499, "%s/gmic_def.gmic", PF::PhotoFlow::Instance().get_base_dir().c_str() );
-        //stat_result = stat( fname, &buffer );
-        //if( stat_result != 0 ) {
-          fname[0] = 0;
-          //}
-      }
-    }
-#endif
-    if( strlen( fname ) > 0 ) {
-      std::ifstream t;
-      int length;
-      t.open(fname);      // open input file
-      t.seekg(0, std::ios::end);    // go to the end
-      length = t.tellg();           // report location (this is the length)
-      t.seekg(0, std::ios::beg);    // go back to the beginning
-      custom_gmic_commands = new char[length];    // allocate memory for a buffer of appropriate dimension
-      t.read(custom_gmic_commands, length);       // read the whole file into the buffer
-      t.close();                    // close file handle
-      std::cout<<"G'MIC custom commands loaded"<<std::endl;
-    }
-  }
-
 	/* Make a gmic for this thread.
 	 */
-	seq->gmic_instance = new gmic( 0, custom_gmic_commands, false, 0, 0 ); 
+	seq->gmic_instance = new gmic( 0, PF::SharedResources::Instance().get_gmic_commands(), false, 0, 0 );
 
 	return( (void *) seq );
 }
@@ -333,6 +284,11 @@ vips_gmic_gen_template( VipsRegion *oreg,
 	gmic_list<float> images;
 	gmic_list<char> images_names;
 
+	size_t gmic_mem = 0;
+	for( int i = 0; seq->ir[i]; i++ )
+		gmic_mem += sizeof(float)*need.width*need.height*seq->ir[i]->im->Bands;
+	PF::MemoryManager::Instance().allocated( PF::PF_MEM_GMIC, gmic_mem );
+
 	try {
 		images.assign( (guint) ninput );
 
@@ -349,12 +305,14 @@ vips_gmic_gen_template( VipsRegion *oreg,
 	}
 	catch( gmic_exception e ) { 
 		images.assign( (guint) 0 );
+		PF::MemoryManager::Instance().released( PF::PF_MEM_GMIC, gmic_mem );
 
 		vips_error( "VipsGMic", "%s", e.what() );
 
 		return( -1 );
 	}
 	images.assign( (guint) 0 );
+	PF::MemoryManager::Instance().released( PF::PF_MEM_GMIC, gmic_mem );
 
 	return( 0 );
 }
@@ -363,6 +321,7 @@ static int
 vips_gmic_gen( VipsRegion *oreg, void *vseq, void *a, void *b, gboolean *stop )
 {
 	VipsGMicSequence *seq = (VipsGMicSequence *) vseq;
+	PF::WorkerThreadScope thread_scope;
 
 	switch( seq->ir[0]->im->BandFmt ) {
 	case VIPS_FORMAT_UCHAR:
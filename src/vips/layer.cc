@@ -145,7 +145,7 @@ G_DEFINE_TYPE( VipsLayer, vips_layer, VIPS_TYPE_OPERATION );
 /* Run the PhotoFlow image editing code
  */
 static int
-vips_layer_gen( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
+vips_layer_gen_tile( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
 {
   VipsRegion **ir = (VipsRegion **) seq;
   VipsLayer *layer = (VipsLayer *) b;
@@ -172,26 +172,75 @@ vips_layer_gen( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
       <<" height="<<oreg->valid.height<<std::endl;
 #endif
   /**/
+  /* Area of input we need.
+   */
+  layer->processor->get_par()->transform_inv(r,&s);
+
+  /* Switch nodes simply forward one of the inputs, and the
+   * other ones are not computed at all
+   */
+  int selected = layer->processor->get_par()->get_selected_input();
+  if( ir && selected >= 0 && selected < ninput && ir[selected] &&
+      ir[selected]->im->Bands == oreg->im->Bands &&
+      ir[selected]->im->BandFmt == oreg->im->BandFmt ) {
+    if( vips_region_prepare( ir[selected], (VipsRect*)r ) )
+      return( -1 );
+    return( vips_region_region( oreg, ir[selected], (VipsRect*)r, r->left, r->top ) );
+  }
+
+  /* If there is an opacity map, compute it first: the tiles where the map
+   * is zero or one everywhere might not require all the inputs
+   */
+  PF::mask_tile_t mask_state = PF::PF_MASK_TILE_MIXED;
+  VipsRegion* romap = NULL;
+  if( ir && layer->omap ) {
+    for( i = 0; ir[i]; i++ )
+      if(ir[i]->im == layer->omap) romap = ir[i];
+  }
+  if( romap ) {
+    VipsRect s_omap;
+    VipsRect r_img = {0, 0, romap->im->Xsize, romap->im->Ysize};
+    vips_rect_intersectrect (&s, &r_img, &s_omap);
+    if( vips_region_prepare( romap, &s_omap ) )
+      return( -1 );
+    mask_state = PF::get_mask_tile_state( romap, *r );
+  }
+
+  if( mask_state == PF::PF_MASK_TILE_EMPTY ) {
+    /* The layer does not contribute to this tile: copy the input that passes
+     * through unchanged, and skip the computation of the other ones
+     */
+    int id = layer->processor->get_par()->get_masked_out_input();
+    if( id >= 0 && id < ninput && ir[id] &&
+        ir[id]->im->Bands == oreg->im->Bands &&
+        ir[id]->im->BandFmt == oreg->im->BandFmt ) {
+      if( vips_region_prepare( ir[id], (VipsRect*)r ) )
+        return( -1 );
+#ifndef NDEBUG
+      std::cout<<"vips_layer_gen(): empty opacity map, copying input #"<<id<<std::endl;
+#endif
+      vips_region_copy( ir[id], oreg, (VipsRect*)r, r->left, r->top );
+      return( 0 );
+    }
+  }
+
   /* Prepare the input images
    */
   if(ir) {
     for( i = 0; ir[i]; i++ ) {
-      /**/
-      /* Area of input we need.
-       */
-      layer->processor->get_par()->transform_inv(r,&s);
+      if( ir[i] == romap ) continue;
 
       VipsRect r_img = {0, 0, ir[i]->im->Xsize, ir[i]->im->Ysize};
-      vips_rect_intersectrect (&s, &r_img, &s);
+      VipsRect s_img;
+      vips_rect_intersectrect (&s, &r_img, &s_img);
 #ifndef NDEBUG
       std::cout<<"  preparing region ir["<<i<<"]:  im="<<ir[i]->im
-          <<"  top="<<s.top
-	       <<" left="<<s.left
-	       <<" width="<<s.width
-	       <<" height="<<s.height<<std::endl;
+          <<"  top="<<s_img.top
+	       <<" left="<<s_img.left
+	       <<" width="<<s_img.width
+	       <<" height="<<s_img.height<<std::endl;
 #endif
-      /**/
-      if( vips_region_prepare( ir[i], &s ) )
+      if( vips_region_prepare( ir[i], &s_img ) )
 	return( -1 );
     }
   }
@@ -225,16 +274,20 @@ vips_layer_gen( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
 
   // Get pointers to imap and omap regions
   VipsRegion* rimap = NULL;
-  VipsRegion* romap = NULL;
   if(ir) {
     for( i = 0; ir[i]; i++ ) {
       //std::cout<<"  array["<<i<<"]="<<array[i]<<"  imap="<<layer->imap<<std::endl;
       if(ir[i]->im == layer->imap) { rimap = ir[i]; }
-      if(ir[i]->im == layer->omap) { romap = ir[i]; }
       //std::cout<<"  rimap="<<rimap<<std::endl;
     }
   }
 
+  // A map equal to one everywhere can be dropped, so that
+  // the faster code without opacity map is used
+  if( mask_state == PF::PF_MASK_TILE_FULL &&
+      layer->processor->get_par()->ignores_full_opacity_map() )
+    romap = NULL;
+
   //pf_process(pflayer->processor,r,&s,pflayer);
 #ifndef NDEBUG
   std::cout<<"Calling processor function..."<<std::endl;
@@ -247,6 +300,27 @@ vips_layer_gen( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
 }
 
 
+static int
+vips_layer_gen( VipsRegion *oreg, void *seq, void *a, void *b, gboolean *stop )
+{
+  VipsLayer *layer = (VipsLayer *) b;
+  PF::OpParBase* par = layer->processor->get_par();
+
+  /* The RawTherapee routines called by some operations open OpenMP
+   * regions, which must not spawn new teams from a vips worker
+   */
+  PF::WorkerThreadScope thread_scope;
+
+  /* The hot parameters, including the input selected by switch nodes,
+   * cannot change while the tile is being computed
+   */
+  par->hot_read_lock();
+  int result = vips_layer_gen_tile( oreg, seq, a, b, stop );
+  par->hot_read_unlock();
+  return( result );
+}
+
+
 static int
 vips_layer_build( VipsObject *object )
 {
@@ -55,6 +55,8 @@
 #include <vips/dispatch.h>
 
 #include "../base/processor.hh"
+#include "../base/scratch_arena.hh"
+#include "../base/shared_resources.hh"
 #include "../operations/lensfun.hh"
 
 #define PF_MAX_INPUT_IMAGES 10
@@ -151,7 +153,7 @@ vips_lensfun_gen_template( VipsRegion *oreg, void *seq, void *a, void *b, gboole
      <<" width="<<oreg->valid.width
      <<" height="<<oreg->valid.height<<std::endl;
 #endif
-  float* buf = new float[r->width*r->height*2*3];
+  PF::ScratchBuffer<float> buf( r->width*r->height*2*3 );
 #ifdef PF_HAS_LENSFUN
   bool ok = lensfun->modifier->ApplySubpixelGeometryDistortion( r->left, r->top, r->width, r->height, buf );
 #endif
@@ -203,8 +205,9 @@ vips_lensfun_gen_template( VipsRegion *oreg, void *seq, void *a, void *b, gboole
         <<" height="<<s.height<<std::endl;
 #endif
     /**/
-    if( vips_region_prepare( ir, &s ) )
+    if( vips_region_prepare( ir, &s ) ) {
       return( -1 );
+    }
   }
 
   /* Do the actual processing
@@ -239,7 +242,6 @@ vips_lensfun_gen_template( VipsRegion *oreg, void *seq, void *a, void *b, gboole
 	   <<"  colorspace = "<<oreg->im->Type<<std::endl;
 #endif
   /**/
-  delete[] buf;
 
   return( 0 );
 }
@@ -424,8 +426,7 @@ static void
 vips_lensfun_init( VipsLensFun *lensfun )
 {
 #ifdef PF_HAS_LENSFUN
-  lensfun->ldb = lf_db_new();
-  lensfun->ldb->Load ();
+  lensfun->ldb = PF::SharedResources::Instance().get_lensfun_db();
 #endif
 }
 
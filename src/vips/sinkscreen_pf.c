@@ -94,6 +94,16 @@ typedef struct {
 	 */
 	gboolean dirty;
 
+	/* The tile is being calculated by vips_sink_screen2_prefetch() without
+	 * the render lock. It must not be queued or reused until it is done.
+	 */
+	gboolean busy;
+
+	/* The tile was requested while busy, so clients must be told when
+	 * it is done.
+	 */
+	gboolean wanted;
+
 	/* Time of last use, for LRU flush 
 	 */
 	int ticks;
@@ -138,6 +148,19 @@ typedef struct _Render {
 	/* Hash of tiles with positions. Tiles can be dirty or painted.
 	 */
 	GHashTable *tiles;
+
+	/* The part of the image the user is looking at, and the point 
+	 * tiles are calculated outwards from (the pointer, or the centre of
+	 * the visible area). Only meaningful if has_focus is set.
+	 */
+	gboolean has_focus;
+	VipsRect visible;
+	int focus_x;
+	int focus_y;
+
+	/* Calculate prefetched tiles with this.
+	 */
+	VipsRegion *prefetch_reg;
 } Render;
 
 /* Our per-thread state.
@@ -238,6 +261,7 @@ render_free( Render *render )
 	render->ntiles = 0;
 	VIPS_FREEF( g_slist_free, render->dirty );
 	VIPS_FREEF( g_hash_table_destroy, render->tiles );
+	VIPS_UNREF( render->prefetch_reg );
 
 	vips_free( render );
 
@@ -312,6 +336,22 @@ render_dirty_get( void )
 	return( render );
 }
 
+/* Scheduling order of a tile: tiles in the visible area come first, then the
+ * nearest to the focus point. Smaller numbers are done sooner.
+ */
+static gint64
+render_tile_order( Render *render, VipsRect *area )
+{
+	gint64 dx = area->left + area->width / 2 - render->focus_x;
+	gint64 dy = area->top + area->height / 2 - render->focus_y;
+	gint64 order = dx * dx + dy * dy;
+
+	if( !vips_rect_overlapsrect( area, &render->visible ) )
+		order += G_MAXINT64 / 2;
+
+	return( order );
+}
+
 /* Get the next tile to paint off the dirty list.
  */
 static Tile *
@@ -321,6 +361,28 @@ render_tile_dirty_get( Render *render )
 
 	if( !render->dirty )
 		tile = NULL;
+	else if( render->has_focus ) {
+		/* Start from the tile nearest to where the user is looking.
+		 */
+		GSList *p;
+		gint64 best;
+
+		tile = (Tile *) render->dirty->data;
+		best = render_tile_order( render, &tile->area );
+		for( p = render->dirty->next; p; p = p->next ) {
+			Tile *t = (Tile *) p->data;
+			gint64 order = render_tile_order( render, &t->area );
+
+			if( order < best ) {
+				best = order;
+				tile = t;
+			}
+		}
+
+		g_assert( tile->dirty );
+		render->dirty = g_slist_remove( render->dirty, tile );
+		tile->dirty = FALSE;
+	}
 	else {
 		tile = (Tile *) render->dirty->data;
 		g_assert( tile->dirty );
@@ -642,6 +704,11 @@ render_new( VipsImage *in, VipsImage *out, VipsImage *mask,
 
 	render->dirty = NULL;
 
+	render->has_focus = FALSE;
+	render->focus_x = 0;
+	render->focus_y = 0;
+	render->prefetch_reg = NULL;
+
 	/* Both out and mask must close before we can free the render.
 	 */
 	g_signal_connect( out, "close", 
@@ -685,6 +752,8 @@ tile_new( Render *render )
 	tile->region = NULL;
 	tile->painted = FALSE;
 	tile->dirty = FALSE;
+	tile->busy = FALSE;
+	tile->wanted = FALSE;
 	tile->ticks = render->ticks;
 
 	if( !(tile->region = vips_region_new( render->in )) ) {
@@ -812,6 +881,35 @@ tile_test_clean_ticks( VipsRect *key, Tile *value, Tile **best )
 			*best = value;
 }
 
+typedef struct {
+	VipsRect *keep;
+	Tile *best;
+} TileReuse;
+
+static void 
+tile_test_clean_ticks_outside( VipsRect *key, Tile *value, TileReuse *reuse )
+{
+	if( value->painted && 
+		!vips_rect_overlapsrect( &value->area, reuse->keep ) )
+		if( !reuse->best || value->ticks < reuse->best->ticks )
+			reuse->best = value;
+}
+
+/* Pick a painted tile outside @keep to reuse. Search for LRU (slow!).
+ */
+static Tile *
+render_tile_get_painted_outside( Render *render, VipsRect *keep )
+{
+	TileReuse reuse;
+
+	reuse.keep = keep;
+	reuse.best = NULL;
+	g_hash_table_foreach( render->tiles,
+		(GHFunc) tile_test_clean_ticks_outside, &reuse );
+
+	return( reuse.best );
+}
+
 /* Pick a painted tile to reuse. Search for LRU (slow!).
  */
 static Tile *
@@ -851,7 +949,13 @@ render_tile_request( Render *render, VipsRegion *reg, VipsRect *area )
 		 */
 		//printf("render_tile_request:  tile->region->invalid=%d\n",
 		//			 (int)tile->region->invalid );
-		if( tile->region->invalid ) 
+		if( tile->busy ) {
+			/* Being prefetched, the clients get notified when done.
+			 */
+			tile->wanted = TRUE;
+			tile_touch( tile );
+		}
+		else if( tile->region->invalid ) 
 			tile_queue( tile, reg );
 		else
 			tile_touch( tile );
@@ -926,6 +1030,15 @@ tile_copy( Tile *tile, VipsRegion *to )
 	}
 }
 
+static int
+render_tile_compare( VipsRect *a, VipsRect *b, Render *render )
+{
+	gint64 oa = render_tile_order( render, a );
+	gint64 ob = render_tile_order( render, b );
+
+	return( oa < ob ? -1 : (oa > ob ? 1 : 0) );
+}
+
 static void *
 image_start( IMAGE *out, void *a, void *b )
 {
@@ -946,6 +1059,8 @@ image_fill( VipsRegion *out, void *seq, void *a, void *b, gboolean *stop )
 	VipsRect *r = &out->valid;
 
 	int x, y;
+	int ntiles, i;
+	VipsRect *areas;
 
 	/* Find top left of tiles we need.
 	 */
@@ -956,8 +1071,30 @@ image_fill( VipsRegion *out, void *seq, void *a, void *b, gboolean *stop )
 									"width = %d, height = %d\n",
 									r->left, r->top, r->width, r->height );
 
+	/* List the tiles we need, so that they can be requested in 
+	 * order of distance from the focus point.
+	 */
+	ntiles = ((VIPS_RECT_RIGHT( r ) - xs + tile_width - 1) / tile_width) *
+		((VIPS_RECT_BOTTOM( r ) - ys + tile_height - 1) / tile_height);
+	if( !(areas = VIPS_ARRAY( NULL, ntiles, VipsRect )) )
+		return( -1 );
+
+	i = 0;
+	for( y = ys; y < VIPS_RECT_BOTTOM( r ); y += tile_height )
+		for( x = xs; x < VIPS_RECT_RIGHT( r ); x += tile_width ) {
+			areas[i].left = x;
+			areas[i].top = y;
+			areas[i].width = tile_width;
+			areas[i].height = tile_height;
+			i += 1;
+		}
+
 	g_mutex_lock( render->lock );
 
+	if( render->has_focus && ntiles > 1 )
+		g_qsort_with_data( areas, ntiles, sizeof( VipsRect ),
+			(GCompareDataFunc) render_tile_compare, render );
+
 	/* 
 
 		FIXME ... if r fits inside a single tile, we could skip the 
@@ -965,25 +1102,20 @@ image_fill( VipsRegion *out, void *seq, void *a, void *b, gboolean *stop )
 
 	 */
 
-	for( y = ys; y < VIPS_RECT_BOTTOM( r ); y += tile_height )
-		for( x = xs; x < VIPS_RECT_RIGHT( r ); x += tile_width ) {
-			VipsRect area;
-			Tile *tile;
+	for( i = 0; i < ntiles; i++ ) {
+		Tile *tile;
 
-			area.left = x;
-			area.top = y;
-			area.width = tile_width;
-			area.height = tile_height;
-
-			tile = render_tile_request( render, reg, &area );
-			if( tile )
-				tile_copy( tile, out );
-			else
-				VIPS_DEBUG_MSG_RED( "image_fill: argh!\n" );
-		}
+		tile = render_tile_request( render, reg, &areas[i] );
+		if( tile )
+			tile_copy( tile, out );
+		else
+			VIPS_DEBUG_MSG_RED( "image_fill: argh!\n" );
+	}
 
 	g_mutex_unlock( render->lock );
 
+	vips_free( areas );
+
 	return( 0 );
 }
 
@@ -1199,3 +1331,207 @@ vips_invalidate_area( VipsImage *image, VipsRect* r  )
 
   g_mutex_unlock( render->lock );
 }
+
+
+/**
+ * vips_sink_screen2_set_focus:
+ * @image: output image of vips_sink_screen2()
+ * @visible: the visible part of @image, or %NULL
+ * @x: horizontal position of the focus point
+ * @y: vertical position of the focus point
+ *
+ * Tell the render which part of the image is on screen. Tiles are then
+ * calculated outwards from (@x, @y), usually the pointer or the centre of
+ * @visible, and vips_sink_screen2_prefetch() can compute the tiles around
+ * @visible in advance. Pass %NULL for @visible to go back to the default
+ * order.
+ */
+void
+vips_sink_screen2_set_focus( VipsImage *image, VipsRect *visible, int x, int y )
+{
+  Render *render = (Render *) image->client1;
+
+  g_mutex_lock( render->lock );
+
+  if( visible ) {
+    render->has_focus = TRUE;
+    render->visible = *visible;
+    render->focus_x = x;
+    render->focus_y = y;
+  }
+  else
+    render->has_focus = FALSE;
+
+  g_mutex_unlock( render->lock );
+}
+
+
+/**
+ * vips_sink_screen2_prefetch:
+ * @image: output image of vips_sink_screen2()
+ * @ring: number of tiles to prefetch around the visible area
+ *
+ * Calculate one of the tiles that are not on screen yet, but that are
+ * likely to be needed soon: the visible area set with
+ * vips_sink_screen2_set_focus() is enlarged by @ring tiles on each side,
+ * and the missing tile nearest to the focus point is painted synchronously.
+ * The ring is reduced if the enlarged area does not fit in the cache, and
+ * painted tiles inside the enlarged area are never reused, so that
+ * prefetching cannot evict the visible tiles.
+ *
+ * Call this repeatedly when the program is idle.
+ *
+ * Returns: 1 if a tile was calculated, 0 if there is nothing left to do,
+ * -1 on error.
+ */
+int
+vips_sink_screen2_prefetch( VipsImage *image, int ring )
+{
+  Render *render = (Render *) image->client1;
+  int tile_width = render->tile_width;
+  int tile_height = render->tile_height;
+  VipsRect all = { 0, 0, render->in->Xsize, render->in->Ysize };
+  VipsRect keep;
+  Tile *tile;
+  VipsRect best_area;
+  gint64 best_order;
+  int x, y, xs, ys;
+  int result;
+  gboolean wanted;
+
+  g_mutex_lock( render->lock );
+
+  if( !render->has_focus ) {
+    g_mutex_unlock( render->lock );
+    return( 0 );
+  }
+
+  /* Enlarge the visible area by the ring of tiles, reducing it until
+   * it fits in the cache.
+   */
+  for( ; ring >= 0; ring-- ) {
+    VipsRect grid;
+
+    keep.left = render->visible.left - ring * tile_width;
+    keep.top = render->visible.top - ring * tile_height;
+    keep.width = render->visible.width + 2 * ring * tile_width;
+    keep.height = render->visible.height + 2 * ring * tile_height;
+    vips_rect_intersectrect( &keep, &all, &keep );
+
+    grid.left = (keep.left / tile_width) * tile_width;
+    grid.top = (keep.top / tile_height) * tile_height;
+    grid.width = VIPS_RECT_RIGHT( &keep ) - grid.left;
+    grid.height = VIPS_RECT_BOTTOM( &keep ) - grid.top;
+    if( render->max_tiles == -1 ||
+      ((grid.width + tile_width - 1) / tile_width) *
+      ((grid.height + tile_height - 1) / tile_height) <= 
+      render->max_tiles )
+      break;
+  }
+  if( ring < 0 || vips_rect_isempty( &keep ) ) {
+    g_mutex_unlock( render->lock );
+    return( 0 );
+  }
+
+  /* Find the missing tile nearest to the focus.
+   */
+  best_order = G_MAXINT64;
+  xs = (keep.left / tile_width) * tile_width;
+  ys = (keep.top / tile_height) * tile_height;
+  for( y = ys; y < VIPS_RECT_BOTTOM( &keep ); y += tile_height )
+    for( x = xs; x < VIPS_RECT_RIGHT( &keep ); x += tile_width ) {
+      VipsRect area = { x, y, tile_width, tile_height };
+      gint64 order;
+
+      tile = render_tile_lookup( render, &area );
+
+      /* Painted, already queued for the bg thread, or being
+       * prefetched by another call.
+       */
+      if( tile && 
+        ((tile->painted && !tile->region->invalid) || tile->dirty ||
+         tile->busy) )
+        continue;
+
+      order = render_tile_order( render, &area );
+      if( order < best_order ) {
+        best_order = order;
+        best_area = area;
+      }
+    }
+
+  if( best_order == G_MAXINT64 ) {
+    g_mutex_unlock( render->lock );
+    return( 0 );
+  }
+
+  if( !(tile = render_tile_lookup( render, &best_area )) ) {
+    if( render->ntiles < render->max_tiles || 
+      render->max_tiles == -1 ) {
+      if( !(tile = tile_new( render )) ) {
+        g_mutex_unlock( render->lock );
+        return( -1 );
+      }
+      render_tile_add( tile, &best_area );
+    }
+    else if( (tile = render_tile_get_painted_outside( render, &keep )) ) 
+      render_tile_move( tile, &best_area );
+    else {
+      /* The cache is full of tiles we want to keep.
+       */
+      g_mutex_unlock( render->lock );
+      return( 0 );
+    }
+  }
+
+  if( !render->prefetch_reg &&
+    !(render->prefetch_reg = vips_region_new( render->in )) ) {
+    g_mutex_unlock( render->lock );
+    return( -1 );
+  }
+
+  VIPS_DEBUG_MSG_AMBER( "vips_sink_screen2_prefetch: tile %p %dx%d\n",
+    tile, tile->area.left, tile->area.top );
+
+  tile->painted = FALSE;
+  tile_touch( tile );
+
+  /* As in tile_queue(), let other threads use the cache while we compute.
+   * The tile is neither painted nor dirty, so it is marked as busy to
+   * keep render_tile_request() from queueing it a second time.
+   */
+  tile->busy = TRUE;
+  tile->wanted = FALSE;
+  g_mutex_unlock( render->lock );
+
+  result = 1;
+  if( vips_region_prepare_to( render->prefetch_reg, tile->region, 
+    &tile->area, tile->area.left, tile->area.top ) ) {
+    VIPS_DEBUG_MSG_RED( "vips_sink_screen2_prefetch: prepare failed\n" ); 
+    result = -1;
+  }
+
+  g_mutex_lock( render->lock );
+
+  tile->busy = FALSE;
+  if( result > 0 )
+    tile->painted = TRUE;
+  wanted = tile->wanted;
+  tile->wanted = FALSE;
+  /* The tile can be reused as soon as the lock is released.
+   */
+  best_area = tile->area;
+
+  g_mutex_unlock( render->lock );
+
+  /* The tile became visible in the meantime.
+   */
+  if( result > 0 && wanted && render->notify ) {
+    vips_image_invalidate_all( render->out ); 
+    if( render->mask ) 
+      vips_image_invalidate_all( render->mask ); 
+    render->notify( render->out, &best_area, render->a );
+  }
+
+  return( result );
+}